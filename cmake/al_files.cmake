@@ -30,10 +30,12 @@ set(core_headers
   include/al/core/graphics/al_Viewpoint.hpp
   include/al/core/io/al_AudioIO.hpp
   include/al/core/io/al_AudioIOData.hpp
+  include/al/core/io/al_AudioProfiler.hpp
   include/al/core/io/al_ControlNav.hpp
   include/al/core/io/al_CSVReader.hpp
   include/al/core/io/al_File.hpp
   include/al/core/io/al_MIDI.hpp
+  include/al/core/io/al_OfflineAudio.hpp
   include/al/core/io/al_Window.hpp
   include/al/core/math/al_Constants.hpp
   include/al/core/math/al_Mat.hpp
@@ -42,9 +44,11 @@ set(core_headers
   include/al/core/math/al_StdRandom.hpp
   include/al/core/math/al_Vec.hpp
   include/al/core/protocol/al_OSC.hpp
+  include/al/core/protocol/al_StateDistribution.hpp
   include/al/core/sound/al_Ambisonics.hpp
   include/al/core/sound/al_AudioScene.hpp
   include/al/core/sound/al_Biquad.hpp
+  include/al/core/sound/al_PartitionedConvolver.hpp
   include/al/core/sound/al_Crossover.hpp
   include/al/core/sound/al_Dbap.hpp
   include/al/core/sound/al_Lbap.hpp
@@ -60,6 +64,10 @@ set(core_headers
   include/al/core/system/al_Thread.hpp
   include/al/core/system/al_Time.hpp
   include/al/core/types/al_Color.hpp
+  include/al/core/types/al_SingleRWRingBuffer.hpp
+  include/al/core/types/al_AtomicValue.hpp
+  include/al/core/types/al_AtomicHandoff.hpp
+  include/al/core/types/al_SPSCRing.hpp
 )
 
 set(core_sources
@@ -89,17 +97,21 @@ set(core_sources
   ${al_path}/src/core/graphics/al_Viewpoint.cpp
   ${al_path}/src/core/io/al_AudioIO.cpp
   ${al_path}/src/core/io/al_AudioIOData.cpp
+  ${al_path}/src/core/io/al_AudioProfiler.cpp
   ${al_path}/src/core/io/al_ControlNav.cpp
   ${al_path}/src/core/io/al_CSVReader.cpp
   ${al_path}/src/core/io/al_File.cpp
   ${al_path}/src/core/io/al_MIDI.cpp
+  ${al_path}/src/core/io/al_OfflineAudio.cpp
   ${al_path}/src/core/io/al_Window.cpp
   ${al_path}/src/core/io/al_WindowGLFW.cpp
   ${al_path}/src/core/math/al_StdRandom.cpp
   ${al_path}/src/core/protocol/al_OSC.cpp
+  ${al_path}/src/core/protocol/al_StateDistribution.cpp
   ${al_path}/src/core/sound/al_Ambisonics.cpp
   ${al_path}/src/core/sound/al_AudioScene.cpp
   ${al_path}/src/core/sound/al_Biquad.cpp
+  ${al_path}/src/core/sound/al_PartitionedConvolver.cpp
   ${al_path}/src/core/sound/al_Dbap.cpp
   ${al_path}/src/core/sound/al_Vbap.cpp
   ${al_path}/src/core/sound/al_Spatializer.cpp
@@ -116,6 +128,7 @@ set(core_sources
 set(util_headers
   include/al/util/al_Array.h
   include/al/util/al_Array.hpp
+  include/al/util/al_MPSCRingBuffer.hpp
   include/al/util/imgui/al_Imgui.hpp
   include/al/util/imgui/imgui_impl_glfw_gl3.h
   include/al/util/ui/al_Composition.hpp
@@ -128,6 +141,7 @@ set(util_headers
   include/al/util/ui/al_FileSelector.hpp
   include/al/util/ui/al_HtmlInterfaceServer.hpp
   include/al/util/ui/al_PresetMapper.hpp
+  include/al/util/ui/al_PresetMorpher.hpp
   include/al/util/ui/al_PresetMIDI.hpp
   include/al/util/ui/al_Pickable.hpp
   include/al/util/ui/al_PickableManager.hpp
@@ -136,6 +150,7 @@ set(util_headers
   include/al/util/ui/al_ControlGUI.hpp
   include/al/util/scene/al_SynthSequencer.hpp
   include/al/util/scene/al_SynthRecorder.hpp
+  include/al/util/scene/al_SynthSequenceFile.hpp
   include/al/util/scene/al_DynamicScene.hpp
   include/al/util/scene/al_DistributedScene.hpp
   include/al/util/scene/al_PolySynth.hpp
@@ -158,12 +173,14 @@ set(util_sources
   ${al_path}/src/util/ui/al_Preset.cpp
   ${al_path}/src/util/ui/al_HtmlInterfaceServer.cpp
   ${al_path}/src/util/ui/al_PresetMapper.cpp
+  ${al_path}/src/util/ui/al_PresetMorpher.cpp
   ${al_path}/src/util/ui/al_PresetMIDI.cpp
   ${al_path}/src/util/ui/al_PresetSequencer.cpp
   ${al_path}/src/util/ui/al_SequenceRecorder.cpp
   ${al_path}/src/util/ui/al_ControlGUI.cpp
   ${al_path}/src/util/scene/al_SynthSequencer.cpp
   ${al_path}/src/util/scene/al_SynthRecorder.cpp
+  ${al_path}/src/util/scene/al_SynthSequenceFile.cpp
   ${al_path}/src/util/scene/al_DynamicScene.cpp
   ${al_path}/src/util/scene/al_PolySynth.cpp
   ${al_path}/src/util/al_Toml.cpp
@@ -0,0 +1,139 @@
+/*
+Allolib Benchmark: Higher order Ambisonics render cost
+
+Description:
+Renders 1, 16 and 64 sources to 64 speakers with 3D ACN/SN3D Ambisonics at
+orders 1, 3, 5 and 7, with a listener that turns a little every block.
+Reports microseconds per 256 frame block for:
+
+- the previous path, reproduced here: each source's direction rotated by the
+  listener's orientation, a scalar multiply-add per channel to encode and a
+  scalar decode looping over speakers, then channels, and
+- AmbisonicsSpatializer, which encodes without rotating, rotates the sound
+  field once per block and decodes with the blocked matrix multiply.
+
+The decode columns time the decoding alone. The finalize column is the
+sound field rotation and the decode, with the rotation matrices recomputed
+and interpolated every block.
+
+Run a release build for meaningful numbers. Build with -mavx to use the AVX
+kernels instead of SSE.
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "al/core/sound/al_Ambisonics.hpp"
+
+using namespace al;
+
+static const int fpb = 256;
+static const int numSpeakers = 64;
+static const int numBlocks = 100;
+
+// AmbiDecode::decode() before the blocked matrix multiply
+static void previousDecode(const AmbiDecode &decoder, float *dec, const float *ambi, int numFrames) {
+  for (int s = 0; s < numSpeakers; ++s) {
+    float *out = dec + s * numFrames;
+    for (int c = 0; c < decoder.channels(); ++c) {
+      const float *in = ambi + c * numFrames;
+      float w = decoder.decodeWeight(s, c);
+      for (int i = 0; i < numFrames; ++i) out[i] += in[i] * w;
+    }
+  }
+}
+
+static Vec3d sourcePosition(int source) {
+  return Vec3d(std::sin(source * 0.7), std::cos(source * 1.3) * 0.5, -std::cos(source * 0.7));
+}
+
+static Quatd listenerOrientation(int block) {
+  return Quatd().fromAxisAngle(block * 0.01, Vec3d(0.1, 1, 0).normalize());
+}
+
+int main() {
+  SpeakerLayout layout;
+  for (int s = 0; s < numSpeakers; s++) {
+    float elevation = std::asin(1 - 2 * (s + 0.5f) / numSpeakers) * 180 / float(M_PI);
+    layout.addSpeaker(Speaker(s, 360.0f * s * 0.618034f, elevation));
+  }
+  AudioIOData io;
+  io.framesPerBuffer(fpb);
+  io.framesPerSecond(48000);
+  io.channelsIn(0);
+  io.channelsOut(numSpeakers);
+
+  std::vector<float> samples(fpb);
+  for (int i = 0; i < fpb; i++) {
+    samples[i] = std::sin(i * 0.1f);
+  }
+
+  printf("%6s %8s %12s %12s %12s %12s %12s\n", "order", "sources", "previous us", "current us",
+         "prev decode", "cur decode", "cur finalize");
+  for (int order : {1, 3, 5, 7}) {
+    AmbisonicsSpatializer spatializer(layout, 3, order, 3, AmbiBase::ACN_SN3D);
+    spatializer.compile();
+    spatializer.prepare(io);
+    AmbiDecode decoder(3, order, numSpeakers, 3, AmbiBase::ACN_SN3D);
+    Speakers speakers = layout.speakers();
+    decoder.setSpeakers(speakers);
+    for (int s = 0; s < numSpeakers; s++) {
+      decoder.setSpeaker(s, s, speakers[s].azimuth, speakers[s].elevation);
+    }
+    AmbiEncode encoder(3, order, AmbiBase::ACN_SN3D);
+    std::vector<float> ambi(decoder.channels() * fpb);
+
+    for (int numSources : {1, 16, 64}) {
+      double decodeUs[2] = {0, 0};
+      double finalizeUs = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (int block = 0; block < numBlocks; block++) {
+        Quatd q = listenerOrientation(block);
+        std::fill(ambi.begin(), ambi.end(), 0.0f);
+        io.zeroOut();
+        for (int source = 0; source < numSources; source++) {
+          Vec3d d = q.rotate(sourcePosition(source));
+          encoder.direction(Vec3f(Vec3d(-d.z, -d.x, d.y).normalize()));
+          for (int c = 0; c < encoder.channels(); ++c) {
+            float *out = ambi.data() + c * fpb;
+            float weight = encoder.weights()[c];
+            for (int i = 0; i < fpb; ++i) out[i] += weight * samples[i];
+          }
+        }
+        auto decodeStart = std::chrono::steady_clock::now();
+        previousDecode(decoder, io.outBuffer(0), ambi.data(), fpb);
+        decodeUs[0] += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - decodeStart).count();
+      }
+      double previousUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+      start = std::chrono::steady_clock::now();
+      for (int block = 0; block < numBlocks; block++) {
+        io.zeroOut();
+        spatializer.listenerOrientation(listenerOrientation(block));
+        spatializer.prepare(io);
+        for (int source = 0; source < numSources; source++) {
+          spatializer.renderBuffer(io, Pose(sourcePosition(source)), samples.data(), fpb);
+        }
+        // Rotation and decode
+        auto finalizeStart = std::chrono::steady_clock::now();
+        spatializer.finalize(io);
+        finalizeUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - finalizeStart).count();
+      }
+      double currentUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+      // The decode alone for the current path
+      auto decodeStart = std::chrono::steady_clock::now();
+      for (int block = 0; block < numBlocks; block++) {
+        decoder.decode(io.outBuffer(0), ambi.data(), fpb);
+      }
+      decodeUs[1] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - decodeStart).count();
+
+      printf("%6d %8d %12.1f %12.1f %12.1f %12.1f %12.1f\n", order, numSources, previousUs / numBlocks,
+             currentUs / numBlocks, decodeUs[0] / numBlocks, decodeUs[1] / numBlocks,
+             finalizeUs / numBlocks);
+    }
+  }
+  return 0;
+}
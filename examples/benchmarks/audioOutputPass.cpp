@@ -0,0 +1,123 @@
+/*
+Allolib Benchmark: Device buffer transposes and output processing
+
+Description:
+Times what the RtAudio callback does around the user callbacks for 2 to 128
+channels and 64 to 1024 frame blocks, in microseconds per block:
+
+- the previous path, reproduced here: a scalar deinterleave of the input,
+  then the gain ramp, the NaN zeroing and the clipping of the output as
+  separate passes, and a scalar interleave into the device buffer, and
+- the current path: deinterleave(), then processOutput() applying the gain
+  ramp, NaN zeroing and clipping while interleaving, in one pass.
+
+The planar columns time the output processing alone without interleaving,
+as for PortAudio, the dummy backend and OfflineAudioRenderer.
+
+Run a release build for meaningful numbers. Build with -mavx to use the AVX
+kernels instead of SSE.
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "al/core/io/al_AudioIOData.hpp"
+
+using namespace al;
+
+static const int numSamplesPerRun = 1 << 22;
+
+// AudioIO::processAudioBlock() before the fused pass
+static void previousOutput(float *buffer, int numFrames, int numChannels, float gainPrev,
+                           float gainNext) {
+  float dgain = (gainNext - gainPrev) / numFrames;
+  for (int j = 0; j < numChannels; ++j) {
+    float *out = buffer + j * numFrames;
+    float gain = gainPrev;
+    for (int i = 0; i < numFrames; ++i) {
+      out[i] *= gain;
+      gain += dgain;
+    }
+  }
+  for (int i = 0; i < numFrames * numChannels; ++i) {
+    float &s = buffer[i];
+    if (s != s) s = 0.f;
+  }
+  for (int i = 0; i < numFrames * numChannels; ++i) {
+    float &s = buffer[i];
+    if (s < -1.f)
+      s = -1.f;
+    else if (s > 1.f)
+      s = 1.f;
+  }
+}
+
+template <class Function>
+static double microsecondsPerBlock(int numBlocks, Function f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int block = 0; block < numBlocks; block++) {
+    f(block);
+  }
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+             .count() / numBlocks;
+}
+
+int main() {
+  printf("%8s %6s %12s %12s %12s %12s\n", "channels", "frames", "previous us", "current us",
+         "prev planar", "cur planar");
+  for (int numChannels : {2, 8, 32, 128}) {
+    for (int numFrames : {64, 256, 1024}) {
+      const int numSamples = numChannels * numFrames;
+      const int numBlocks = numSamplesPerRun / numSamples;
+      std::vector<float> deviceIn(numSamples), deviceOut(numSamples);
+      std::vector<float> in(numSamples), out(numSamples), signal(numSamples);
+      for (int i = 0; i < numSamples; i++) {
+        deviceIn[i] = std::sin(i * 0.01f);
+        signal[i] = 1.5f * std::sin(i * 0.013f);
+      }
+
+      double previousUs = microsecondsPerBlock(numBlocks, [&](int block) {
+        const float *inBuffers = deviceIn.data();
+        for (int frame = 0; frame < numFrames; frame++) {
+          for (int i = 0; i < numChannels; i++) {
+            in[i * numFrames + frame] = *inBuffers++;
+          }
+        }
+        std::copy(signal.begin(), signal.end(), out.begin());
+        previousOutput(out.data(), numFrames, numChannels, 0.5f, block % 2 ? 0.5f : 0.6f);
+        float *outBuffers = deviceOut.data();
+        for (int frame = 0; frame < numFrames; frame++) {
+          for (int i = 0; i < numChannels; i++) {
+            *outBuffers++ = out[i * numFrames + frame];
+          }
+        }
+      });
+
+      double currentUs = microsecondsPerBlock(numBlocks, [&](int block) {
+        deinterleave(in.data(), deviceIn.data(), numFrames, numChannels);
+        std::copy(signal.begin(), signal.end(), out.begin());
+        float gainNext = block % 2 ? 0.5f : 0.6f;
+        processOutput(deviceOut.data(), out.data(), numFrames, numChannels, 0.5f,
+                      (gainNext - 0.5f) / numFrames, true, true, true);
+      });
+
+      double previousPlanarUs = microsecondsPerBlock(numBlocks, [&](int block) {
+        std::copy(signal.begin(), signal.end(), out.begin());
+        previousOutput(out.data(), numFrames, numChannels, 0.5f, block % 2 ? 0.5f : 0.6f);
+      });
+
+      double currentPlanarUs = microsecondsPerBlock(numBlocks, [&](int block) {
+        std::copy(signal.begin(), signal.end(), out.begin());
+        float gainNext = block % 2 ? 0.5f : 0.6f;
+        processOutput(out.data(), out.data(), numFrames, numChannels, 0.5f,
+                      (gainNext - 0.5f) / numFrames, true, true, false);
+      });
+
+      printf("%8d %6d %12.2f %12.2f %12.2f %12.2f\n", numChannels, numFrames, previousUs,
+             currentUs, previousPlanarUs, currentPlanarUs);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,82 @@
+/*
+Allolib Benchmark: CSVReader throughput
+
+Description:
+Writes a comma separated file of sensor log style rows (a timestamp, an
+integer id, six real values and a boolean) and reads it with CSVReader
+using an increasing number of threads. Reports the time to read the file
+and the throughput in MB/s, and the time to read a column through a view
+and as a copy with getColumn().
+
+The file will usually be in the page cache after writing, so this
+measures parsing rather than the disk. Pass a number of megabytes as the
+first argument to change the file size (default 200).
+
+Run a release build for meaningful numbers.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <thread>
+
+#include "al/core/io/al_CSVReader.hpp"
+
+int main(int argc, char *argv[]) {
+  const double megabytes = argc > 1 ? std::atof(argv[1]) : 200.0;
+  const char *name = "benchmark_csvreader.csv";
+  size_t fileBytes = 0;
+  {
+    std::ofstream f(name, std::ios::binary);
+    f << "time,id,x,y,z,pressure,temperature,humidity,valid\n";
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(-100.0, 100.0);
+    char line[256];
+    double time = 0;
+    while (fileBytes < megabytes * 1e6) {
+      int length = snprintf(line, sizeof(line), "%.4f,%d,%.6f,%.6f,%.6f,%.3f,%.2f,%.2f,%s\n",
+                            time, int(rng() % 64), uniform(rng), uniform(rng), uniform(rng),
+                            1013 + uniform(rng) * 0.1, 20 + uniform(rng) * 0.1,
+                            50 + uniform(rng) * 0.4, rng() % 2 ? "true" : "false");
+      f.write(line, length);
+      fileBytes += size_t(length);
+      time += 0.001;
+    }
+  }
+
+  CSVReader reader;
+  reader.addType(CSVReader::REAL);
+  reader.addType(CSVReader::INTEGER);
+  for (int i = 0; i < 6; i++) {
+    reader.addType(CSVReader::REAL);
+  }
+  reader.addType(CSVReader::BOOLEAN);
+
+  printf("File: %.1f MB\n", fileBytes / 1e6);
+  printf("%8s %10s %10s %10s\n", "threads", "rows", "seconds", "MB/s");
+  unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+    reader.setNumThreads(threads);
+    auto start = std::chrono::steady_clock::now();
+    reader.readFile(name);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%8u %10zu %10.3f %10.1f\n", threads, reader.numRows(), seconds, fileBytes / 1e6 / seconds);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  double sum = 0;
+  for (double value : reader.getRealColumn(2)) {
+    sum += value;
+  }
+  double viewSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  start = std::chrono::steady_clock::now();
+  std::vector<double> column = reader.getColumn(2);
+  double copySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("Column sum through view: %.3f ms, getColumn() copy: %.3f ms (%g %zu)\n",
+         viewSeconds * 1e3, copySeconds * 1e3, sum, column.size());
+
+  std::remove(name);
+  return 0;
+}
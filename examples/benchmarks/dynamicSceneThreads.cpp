@@ -0,0 +1,85 @@
+/*
+Allolib Benchmark: DynamicScene threaded audio rendering
+
+Description:
+Measures the cost of DynamicScene::render() for a block while sweeping the
+number of voices, the number of audio worker threads and the block size.
+Each voice runs a small oscillator bank so there is work to spread across
+threads. 0 threads is the serial render path.
+
+Run a release build for meaningful numbers.
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#include "al/util/scene/al_DynamicScene.hpp"
+#include "al/core/sound/al_Speaker.hpp"
+#include "al/core/sound/al_StereoPanner.hpp"
+
+using namespace al;
+
+class SineBankVoice : public PositionedVoice {
+public:
+  void onProcess(AudioIOData &io) override {
+    while (io()) {
+      float sum = 0.0f;
+      for (int i = 0; i < 16; i++) {
+        sum += std::sin(mPhase * (i + 1));
+      }
+      mPhase += 0.01f;
+      io.out(0) += sum * 0.01f;
+    }
+  }
+
+private:
+  float mPhase {0.0f};
+};
+
+int main() {
+  const int numBlocks = 200;
+  SpeakerLayout layout = StereoSpeakerLayout();
+
+  printf("%8s %8s %8s %14s %10s\n", "voices", "threads", "fpb", "us/block", "speedup");
+  for (int numVoices : {16, 64, 256}) {
+    for (int fpb : {64, 256, 1024}) {
+      double serialUs = 0;
+      for (int numThreads : {0, 1, 3, 7}) {
+        AudioIOData io;
+        io.framesPerBuffer(fpb);
+        io.framesPerSecond(48000);
+        io.channelsIn(0);
+        io.channelsOut(2);
+
+        DynamicScene scene(numThreads);
+        scene.setAudioThreaded(numThreads > 0);
+        scene.setSpatializer<StereoPanner>(layout);
+        scene.prepare(io);
+        for (int i = 0; i < numVoices; i++) {
+          auto *voice = scene.getVoice<SineBankVoice>();
+          voice->setPose(Pose(Vec3d(std::sin(i), 0, -4)));
+          voice->useDistanceAttenuation(false);
+          scene.triggerOn(voice);
+        }
+        io.zeroOut();
+        scene.render(io);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int block = 0; block < numBlocks; block++) {
+          io.zeroOut();
+          scene.render(io);
+        }
+        auto end = std::chrono::steady_clock::now();
+        double us = std::chrono::duration<double, std::micro>(end - start).count() / numBlocks;
+        if (numThreads == 0) {
+          serialUs = us;
+        }
+        printf("%8d %8d %8d %14.2f %10.2f\n", numVoices, numThreads + (numThreads > 0 ? 1 : 0),
+               fpb, us, serialUs / us);
+        scene.stopAudioThreads();
+      }
+    }
+  }
+  return 0;
+}
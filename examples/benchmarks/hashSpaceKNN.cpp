@@ -0,0 +1,102 @@
+/*
+Allolib Benchmark: HashSpace k nearest neighbour queries
+
+Description:
+Simulates one frame of a flocking simulation with 50000 agents: every
+agent is moved and then queries its k nearest neighbours within a radius.
+Compares the per object move() and Query loop, with the results sorted by
+distance afterwards, against moveAll() and the batch queryKNN() with an
+increasing number of threads.
+
+Run a release build for meaningful numbers.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "al/core/spatial/al_HashSpace.hpp"
+
+using namespace al;
+
+int main() {
+  const uint32_t numAgents = 50000;
+  const uint32_t k = 8;
+  const double radius = 3.0;
+  const int numFrames = 10;
+
+  HashSpace space(6, numAgents);
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> uniform(0.0, space.dim());
+  std::vector<Vec3d> positions(numAgents);
+  for (auto &p : positions) {
+    p = Vec3d(uniform(rng), uniform(rng), uniform(rng));
+  }
+
+  auto jiggle = [&]() {
+    std::uniform_real_distribution<double> step(-0.1, 0.1);
+    for (auto &p : positions) {
+      p += Vec3d(step(rng), step(rng), step(rng));
+    }
+  };
+
+  printf("%24s %12s %12s\n", "method", "move ms", "query ms");
+
+  // Single object loop
+  {
+    HashSpace::Query query(128);
+    double moveMs = 0, queryMs = 0;
+    size_t found = 0;
+    for (int frame = 0; frame < numFrames; frame++) {
+      jiggle();
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < numAgents; i++) {
+        space.move(i, positions[i]);
+      }
+      auto moved = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < numAgents; i++) {
+        query.clear();
+        int n = query(space, &space.object(i), radius);
+        auto &results = query.results();
+        std::partial_sort(results.begin(), results.begin() + std::min<int>(n, k),
+                          results.begin() + n,
+                          [](const HashSpace::Query::Result &a, const HashSpace::Query::Result &b) {
+                            return a.distanceSquared < b.distanceSquared;
+                          });
+        found += std::min<int>(n, k);
+      }
+      auto end = std::chrono::steady_clock::now();
+      moveMs += std::chrono::duration<double, std::milli>(moved - start).count();
+      queryMs += std::chrono::duration<double, std::milli>(end - moved).count();
+    }
+    printf("%24s %12.2f %12.2f   (%zu results)\n", "move() + Query", moveMs / numFrames,
+           queryMs / numFrames, found / numFrames);
+  }
+
+  // Batch
+  unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+    HashSpace::KNNResults results;
+    double moveMs = 0, queryMs = 0;
+    size_t found = 0;
+    for (int frame = 0; frame < numFrames; frame++) {
+      jiggle();
+      auto start = std::chrono::steady_clock::now();
+      space.moveAll(positions.data(), threads);
+      auto moved = std::chrono::steady_clock::now();
+      space.queryKNN(k, radius, results, threads);
+      auto end = std::chrono::steady_clock::now();
+      moveMs += std::chrono::duration<double, std::milli>(moved - start).count();
+      queryMs += std::chrono::duration<double, std::milli>(end - moved).count();
+      for (auto count : results.counts) found += count;
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "moveAll + queryKNN x%u", threads);
+    printf("%24s %12.2f %12.2f   (%zu results)\n", name, moveMs / numFrames,
+           queryMs / numFrames, found / numFrames);
+  }
+  return 0;
+}
@@ -0,0 +1,59 @@
+/*
+Allolib Benchmark: Isosurface extraction
+
+Description:
+Generates a volume of the given size (default 256^3) with a few blobs of
+varying density, like a scan of an object surrounded by empty space, and
+extracts an isosurface with Isosurface::generate() using an increasing
+number of threads, with and without skipping empty blocks of cells.
+Reports the time per extraction and the size of the surface.
+
+Run a release build for meaningful numbers.
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "al/core/graphics/al_Isosurface.hpp"
+
+using namespace al;
+
+int main(int argc, char *argv[]) {
+  const int n = argc > 1 ? std::atoi(argv[1]) : 256;
+  std::vector<float> field(size_t(n) * n * n);
+  for (int z = 0; z < n; z++) {
+    for (int y = 0; y < n; y++) {
+      for (int x = 0; x < n; x++) {
+        float px = float(x) / n - 0.5f, py = float(y) / n - 0.5f, pz = float(z) / n - 0.5f;
+        float r2 = px * px + py * py + pz * pz;
+        float v = std::exp(-r2 * 20.0f);
+        v += 0.1f * std::sin(px * 40.0f) * std::sin(py * 35.0f) * std::sin(pz * 30.0f);
+        field[x + size_t(n) * (y + size_t(n) * z)] = r2 < 0.16f ? v : 0.0f;
+      }
+    }
+  }
+
+  printf("Field: %d^3\n", n);
+  printf("%8s %8s %12s %12s %12s\n", "threads", "skip", "ms", "vertices", "triangles");
+  unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+    for (bool skip : {false, true}) {
+      Isosurface iso;
+      iso.level(0.5f).numThreads(threads).skipEmptyBlocks(skip);
+      const int runs = 3;
+      double ms = 0;
+      for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        iso.generate(field.data(), n, 1.0f / n);
+        ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      }
+      printf("%8u %8s %12.1f %12zu %12zu\n", threads, skip ? "yes" : "no", ms / runs,
+             iso.vertices().size(), iso.indices().size() / 3);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,75 @@
+/*
+Allolib Benchmark: Mesh compress and vertex cache optimization
+
+Description:
+Builds height field meshes of increasing size as unindexed triangle soups,
+so every interior vertex is repeated six times. Measures the time taken by
+Mesh::compress() to weld them into indexed meshes, then the time taken by
+Mesh::optimizeVertexCache() and the average number of post-transform cache
+misses per triangle (ACMR) for a 16 entry FIFO cache before and after it.
+
+Run a release build for meaningful numbers.
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+#include "al/core/graphics/al_Mesh.hpp"
+
+using namespace al;
+
+// Average cache misses per triangle for a FIFO cache of cacheSize vertices
+double acmr(const Mesh &mesh, int cacheSize) {
+  std::vector<int> cacheTime(mesh.vertices().size(), -1);
+  int misses = 0;
+  for (auto index : mesh.indices()) {
+    if (cacheTime[index] < 0 || misses - cacheTime[index] >= cacheSize) {
+      cacheTime[index] = misses++;
+    }
+  }
+  return double(misses) / (mesh.indices().size() / 3);
+}
+
+void heightField(Mesh &mesh, int n) {
+  mesh.reset();
+  mesh.primitive(Mesh::TRIANGLES);
+  auto vertex = [&](int x, int y) {
+    float u = float(x) / n, v = float(y) / n;
+    mesh.vertex(u, std::sin(u * 10.0f) * std::cos(v * 10.0f), v);
+    mesh.texCoord(u, v);
+  };
+  // Column major, as scanners and simple generators tend to emit them
+  for (int x = 0; x < n; x++) {
+    for (int y = 0; y < n; y++) {
+      vertex(x, y); vertex(x + 1, y); vertex(x, y + 1);
+      vertex(x + 1, y); vertex(x + 1, y + 1); vertex(x, y + 1);
+    }
+  }
+}
+
+int main() {
+  printf("%12s %12s %12s %12s %10s %10s\n",
+         "vertices in", "vertices out", "compress ms", "optimize ms", "ACMR in", "ACMR out");
+  for (int n : {64, 256, 1024}) {
+    Mesh mesh;
+    heightField(mesh, n);
+    size_t verticesIn = mesh.vertices().size();
+
+    auto start = std::chrono::steady_clock::now();
+    mesh.compress();
+    auto compressed = std::chrono::steady_clock::now();
+    double acmrIn = acmr(mesh, 16);
+    auto optimizeStart = std::chrono::steady_clock::now();
+    mesh.optimizeVertexCache();
+    auto end = std::chrono::steady_clock::now();
+
+    printf("%12zu %12zu %12.1f %12.1f %10.3f %10.3f\n", verticesIn, mesh.vertices().size(),
+           std::chrono::duration<double, std::milli>(compressed - start).count(),
+           std::chrono::duration<double, std::milli>(end - optimizeStart).count(),
+           acmrIn, acmr(mesh, 16));
+  }
+  return 0;
+}
@@ -0,0 +1,147 @@
+/*
+Allolib Benchmark: OutputMaster cost per channel count
+
+Description:
+Runs OutputMaster on 8, 64 and 128 channels with the meter on, without bass
+management and with full bass management (cross-over filters on every
+channel). Reports microseconds per 256 frame block for:
+
+- the previous onAudioCB, reproduced here: frame by frame in double
+  precision, with the bass management switch and the gain lookups for every
+  sample of every channel, and direct form biquads per channel. Its meter
+  printed to the console from the audio thread, which is left out, and
+- the current block based OutputMaster, with the cross-over filters running
+  on four channels at a time. The loudness column adds the loudness meter.
+
+Run a release build for meaningful numbers. Build with -mavx to use the AVX
+kernels for gain and metering.
+*/
+
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "al/util/sound/al_OutputMaster.hpp"
+
+using namespace al;
+
+static const int fpb = 256;
+static const int numBlocks = 400;
+
+// Direct form II biquad like the Gamma filters the previous version used
+struct PreviousBiquad {
+  double a[3] = {1, 0, 0}, b[3] = {0, 0, 0};
+  double d1 = 0, d2 = 0;
+  double operator()(double i0) {
+    double w = i0 - d1 * b[1] - d2 * b[2];
+    double o = w * a[0] + d1 * a[1] + d2 * a[2];
+    d2 = d1;
+    d1 = w;
+    return o;
+  }
+};
+
+struct PreviousOutputMaster {
+  int numChnls;
+  int mode;
+  std::vector<double> gains;
+  std::vector<PreviousBiquad> lopass, hipass;
+  std::vector<float> meterMax, meterMin;
+  int meterCounter = 0, meterUpdateSamples = 4800;
+
+  PreviousOutputMaster(int n, int mode)
+      : numChnls(n), mode(mode), gains(n, 1.0), lopass(n), hipass(n), meterMax(n), meterMin(n) {}
+
+  void onAudioCB(AudioIOData &io) {
+    double master_gain = 1.0;
+    double filt_low = 0.0;
+    io.frame(0);
+    while (io()) {
+      double bassbuf = 0.0;
+      for (int chan = 0; chan < numChnls; chan++) {
+        double gain = master_gain * gains[chan];
+        double filt_temp;
+        switch (mode) {
+          case BASSMODE_NONE:
+            break;
+          case BASSMODE_FULL:
+            filt_temp = lopass[chan](io.out(chan));
+            filt_low = lopass[chan](filt_temp);
+            filt_temp = hipass[chan](io.out(chan));
+            io.out(chan) = hipass[chan](filt_temp);
+            break;
+          default:
+            filt_low = 0.0;
+            break;
+        }
+        bassbuf += filt_low;
+        io.out(chan) *= gain;
+        if (io.out(chan) > master_gain) {
+          io.out(chan) = master_gain;
+        }
+      }
+      if (mode != BASSMODE_NONE) {
+        io.out(numChnls - 1) = bassbuf * gains[numChnls - 1];
+      }
+      for (int chan = 0; chan < numChnls; chan++) {
+        float out = io.out(chan);
+        if (meterMax[chan] < out) meterMax[chan] = out;
+        if (meterMin[chan] > out) meterMin[chan] = out;
+      }
+      if (++meterCounter >= meterUpdateSamples) {
+        meterCounter -= meterUpdateSamples;
+        for (int chan = 0; chan < numChnls; chan++) {
+          meterMax[chan] = FLT_MIN;
+          meterMin[chan] = FLT_MAX;
+        }
+      }
+    }
+  }
+};
+
+static void fill(AudioIOData &io, int block) {
+  for (unsigned int chan = 0; chan < io.channelsOut(); chan++) {
+    float *out = io.outBuffer(chan);
+    for (int i = 0; i < fpb; i++) {
+      out[i] = 0.5f * std::sin(0.01f * (block * fpb + i) * (chan + 1));
+    }
+  }
+}
+
+template <class Master>
+static double run(Master &master, AudioIOData &io) {
+  double us = 0;
+  for (int block = 0; block < numBlocks; block++) {
+    fill(io, block);
+    auto start = std::chrono::steady_clock::now();
+    master.onAudioCB(io);
+    us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  }
+  return us / numBlocks;
+}
+
+int main() {
+  printf("%9s %10s %12s %12s %12s\n", "channels", "bass mode", "previous us", "current us", "loudness us");
+  for (int numChannels : {8, 64, 128}) {
+    AudioIOData io;
+    io.framesPerBuffer(fpb);
+    io.framesPerSecond(48000);
+    io.channelsIn(0);
+    io.channelsOut(numChannels);
+    for (int mode : {BASSMODE_NONE, BASSMODE_FULL}) {
+      PreviousOutputMaster previous(numChannels, mode);
+      OutputMaster current(numChannels, 48000);
+      current.setMeterOn(true);
+      current.setBassManagementMode(bass_mgmt_mode_t(mode));
+      double previousUs = run(previous, io);
+      double currentUs = run(current, io);
+      current.setLoudnessOn(true);
+      double loudnessUs = run(current, io);
+      printf("%9d %10s %12.1f %12.1f %12.1f\n", numChannels, mode == BASSMODE_NONE ? "none" : "full",
+             previousUs, currentUs, loudnessUs);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+/*
+Allolib Benchmark: Parameter read contention
+
+Description:
+Several reader threads read 16 parameters in a loop, as voices do once
+per block, while a writer thread keeps setting them to increasing values.
+Reports the time per read and the number of reads that went back to an
+older value than the reader had already seen, for:
+
+- the previous ParameterWrapper mechanism (try_lock on a mutex to refresh
+  a cached copy, reproduced here), used by ParameterVec3, ParameterMenu,
+  Trigger and the other wrapped types, and
+- the current Parameter and ParameterVec3, which read from an AtomicValue
+  without locking.
+
+Use a machine with several cores, the contention is between cores.
+
+Run a release build for meaningful numbers.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "al/util/ui/al_Parameter.hpp"
+
+using namespace al;
+
+// The get() and set() of ParameterWrapper before it used AtomicValue
+template <class T>
+struct TryLockValue {
+  std::mutex mutex;
+  T value{};
+  T cache{};
+  void set(T v) {
+    mutex.lock();
+    value = v;
+    mutex.unlock();
+  }
+  T get() {
+    if (mutex.try_lock()) {
+      cache = value;
+      mutex.unlock();
+    }
+    return cache;
+  }
+};
+
+static float first(float v) { return v; }
+static float first(const Vec3f &v) { return v.x; }
+
+template <class Param, class T>
+static void run(const char *name, std::vector<std::unique_ptr<Param>> &params, int numReaders) {
+  const double seconds = 0.5;
+  std::atomic<bool> running(true);
+  std::atomic<unsigned long long> reads(0), backwards(0);
+  std::thread writer([&]() {
+    float v = 0;
+    while (running) {
+      v += 1;
+      for (auto &p : params) {
+        p->set(T(v));
+      }
+    }
+  });
+  std::vector<std::thread> readers;
+  for (int r = 0; r < numReaders; r++) {
+    readers.emplace_back([&]() {
+      std::vector<float> last(params.size(), 0.0f);
+      unsigned long long n = 0, b = 0;
+      while (running) {
+        for (size_t i = 0; i < params.size(); i++) {
+          float v = first(params[i]->get());
+          if (v < last[i]) {
+            b++;
+          }
+          last[i] = v;
+        }
+        n += params.size();
+      }
+      reads += n;
+      backwards += b;
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  running = false;
+  writer.join();
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  printf("%8d %28s %12.1f %12llu\n", numReaders, name,
+         1e9 * seconds * numReaders / double(reads), (unsigned long long)backwards);
+}
+
+int main() {
+  const int numParams = 16;
+  std::vector<std::unique_ptr<TryLockValue<float>>> oldFloats;
+  std::vector<std::unique_ptr<TryLockValue<Vec3f>>> oldVecs;
+  std::vector<std::unique_ptr<Parameter>> floats;
+  std::vector<std::unique_ptr<ParameterVec3>> vecs;
+  for (int i = 0; i < numParams; i++) {
+    oldFloats.emplace_back(new TryLockValue<float>);
+    oldVecs.emplace_back(new TryLockValue<Vec3f>);
+    floats.emplace_back(new Parameter("f" + std::to_string(i), "", 0.0f, "", 0.0f, 1e9f));
+    vecs.emplace_back(new ParameterVec3("v" + std::to_string(i)));
+  }
+
+  printf("%8s %28s %12s %12s\n", "readers", "", "ns/read", "backwards");
+  for (int numReaders : {1, 2, 4, 8}) {
+    run<TryLockValue<float>, float>("float try_lock (previous)", oldFloats, numReaders);
+    run<Parameter, float>("Parameter", floats, numReaders);
+    run<TryLockValue<Vec3f>, Vec3f>("Vec3f try_lock (previous)", oldVecs, numReaders);
+    run<ParameterVec3, Vec3f>("ParameterVec3", vecs, numReaders);
+  }
+  return 0;
+}
@@ -0,0 +1,54 @@
+/*
+Allolib Benchmark: ParameterServer OSC dispatch
+
+Description:
+Measures the time ParameterServer::onMessage() takes to dispatch a float
+message to one parameter while sweeping the number of registered
+parameters. The server is not started, messages are passed to onMessage()
+directly so only the dispatch cost is measured.
+
+Run a release build for meaningful numbers.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "al/util/ui/al_ParameterServer.hpp"
+
+using namespace al;
+
+int main() {
+  const int numMessages = 20000;
+
+  printf("%12s %14s\n", "parameters", "us/message");
+  for (int numParameters : {10, 100, 1000, 3000}) {
+    ParameterServer server("", 9010, false);
+    std::vector<std::unique_ptr<Parameter>> params;
+    for (int i = 0; i < numParameters; i++) {
+      params.emplace_back(new Parameter("param" + std::to_string(i), "group", 0.0f));
+      server.registerParameter(*params.back());
+    }
+
+    // Messages addressed to parameters spread across the registration order
+    std::vector<std::unique_ptr<osc::Packet>> packets;
+    for (int i = 0; i < 16; i++) {
+      packets.emplace_back(new osc::Packet());
+      packets.back()->addMessage(params[(i * 7919) % numParameters]->getFullAddress(),
+                                 float(i) * 0.01f);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numMessages; i++) {
+      osc::Packet &packet = *packets[i % packets.size()];
+      osc::Message m(packet.data(), packet.size());
+      server.onMessage(m);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double us = std::chrono::duration<double, std::micro>(end - start).count();
+    printf("%12d %14.3f\n", numParameters, us / numMessages);
+  }
+  return 0;
+}
@@ -0,0 +1,64 @@
+/*
+Allolib Benchmark: PolySynth trigger off cost
+
+Description:
+Measures the cost of PolySynth::render() for a block in which a burst of
+trigger off messages arrives, for increasing polyphony. Voices do no audio
+processing so the time reported is the voice management overhead.
+
+Run a release build for meaningful numbers.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+
+#include "al/util/scene/al_PolySynth.hpp"
+
+using namespace al;
+
+class EmptyVoice : public SynthVoice {
+public:
+  void onProcess(AudioIOData &io) override {}
+  void onTriggerOff() override { free(); }
+};
+
+int main() {
+  const int numBlocks = 2000;
+
+  AudioIOData io;
+  io.framesPerBuffer(64);
+  io.framesPerSecond(48000);
+  io.channelsIn(0);
+  io.channelsOut(2);
+
+  printf("%10s %14s %16s\n", "voices", "offs/block", "us/block");
+  for (int polyphony : {64, 256, 1024, 2048, 4096}) {
+    PolySynth synth;
+    synth.allocatePolyphony<EmptyVoice>(polyphony);
+    std::deque<int> ids;
+    for (int i = 0; i < polyphony; i++) {
+      ids.push_back(synth.triggerOn(synth.getVoice<EmptyVoice>()));
+    }
+    synth.render(io);
+
+    const int offsPerBlock = polyphony / 8;
+    double totalUs = 0;
+    for (int block = 0; block < numBlocks; block++) {
+      for (int i = 0; i < offsPerBlock; i++) {
+        synth.triggerOff(ids.front());
+        ids.pop_front();
+      }
+      auto start = std::chrono::steady_clock::now();
+      synth.render(io);
+      auto end = std::chrono::steady_clock::now();
+      totalUs += std::chrono::duration<double, std::micro>(end - start).count();
+      // Replace the voices that were turned off
+      for (int i = 0; i < offsPerBlock; i++) {
+        ids.push_back(synth.triggerOn(synth.getVoice<EmptyVoice>()));
+      }
+    }
+    printf("%10d %14d %16.3f\n", polyphony, offsPerBlock, totalUs / numBlocks);
+  }
+  return 0;
+}
@@ -0,0 +1,83 @@
+/*
+Allolib Benchmark: Preset morph cost vs. parameter count
+
+Description:
+Registers an increasing number of parameters, each with a change callback,
+with a PresetHandler and morphs them to a new preset. Reports the time
+taken by one step of PresetHandler's morphing thread, which sets every
+parameter through setParameterValues() and runs every 50 ms, and the time
+PresetMorpher takes to advance a 64 frame block at 48 kHz once per block
+and per sample. The CPU columns are the share of one core each method
+needs: the thread steps 20 times per second and PresetMorpher runs for
+every audio block.
+
+Run a release build for meaningful numbers.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "al/core/io/al_File.hpp"
+#include "al/util/ui/al_PresetMorpher.hpp"
+
+using namespace al;
+
+int main() {
+  const unsigned int framesPerBuffer = 64;
+  const double framesPerSecond = 48000;
+  const double blockUs = 1e6 * framesPerBuffer / framesPerSecond;
+
+  printf("%10s %16s %10s %16s %16s %10s\n", "parameters", "thread us/step",
+         "thread %", "block us/block", "sample us/block", "sample %");
+  for (int numParameters : {100, 1000, 10000, 100000}) {
+    PresetHandler presets("presetMorphBenchmark");
+    std::vector<std::unique_ptr<Parameter>> parameters;
+    unsigned long long changes = 0;
+    PresetHandler::ParameterStates target;
+    for (int i = 0; i < numParameters; i++) {
+      parameters.emplace_back(new Parameter("p" + std::to_string(i), "", 0.0f, "", -1e6f, 1e6f));
+      parameters.back()->registerChangeCallback([&](float) { changes++; });
+      presets << *parameters.back();
+      target[parameters.back()->getFullAddress()] = {float(i + 1)};
+    }
+
+    // What PresetHandler's morphing thread does on each step
+    const int numSteps = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < numSteps; step++) {
+      for (auto &p : parameters) {
+        PresetHandler::setParameterValues(p.get(), target[p->getFullAddress()], 1.0 / (numSteps - step));
+      }
+    }
+    double threadUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / numSteps;
+
+    PresetMorpher morpher(presets);
+    morpher.compile();
+    double rateUs[2];
+    for (auto rate : {PresetMorpher::MORPH_BLOCK, PresetMorpher::MORPH_SAMPLE}) {
+      morpher.rate(rate);
+      // Long enough that every block is morphing
+      morpher.morphTo(target, 100.0f);
+      const int numBlocks = 2000;
+      float sum = 0;
+      start = std::chrono::steady_clock::now();
+      for (int block = 0; block < numBlocks; block++) {
+        morpher.process(framesPerBuffer, framesPerSecond);
+        sum += morpher.value(block % numParameters, framesPerBuffer - 1);
+      }
+      rateUs[rate] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / numBlocks;
+      if (sum == 0.12345f) {
+        printf("\n");
+      }
+    }
+
+    printf("%10d %16.1f %10.2f %16.2f %16.2f %10.2f\n", numParameters, threadUs,
+           100.0 * threadUs * 20 / 1e6, rateUs[0], rateUs[1],
+           100.0 * rateUs[1] / blockUs);
+  }
+  Dir::removeRecursively("presetMorphBenchmark");
+  return 0;
+}
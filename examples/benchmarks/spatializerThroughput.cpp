@@ -0,0 +1,91 @@
+/*
+Allolib Benchmark: Spatializer render throughput
+
+Description:
+Renders a number of sources through each spatializer with renderBuffer() for
+static sources and renderBufferRamp() for moving sources. Throughput is
+reported as sources x speakers per millisecond of processing time.
+
+Run a release build for meaningful numbers. Build with -mavx to use the AVX
+gain kernels instead of SSE.
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "al/core/sound/al_Dbap.hpp"
+#include "al/core/sound/al_Lbap.hpp"
+#include "al/core/sound/al_Speaker.hpp"
+#include "al/core/sound/al_StereoPanner.hpp"
+#include "al/core/sound/al_Vbap.hpp"
+#include "al/util/al_AlloSphereSpeakerLayout.hpp"
+
+using namespace al;
+
+void measure(const char *name, Spatializer &spatializer, int numSpeakers) {
+  const int fpb = 256;
+  const int numSources = 64;
+  const int numBlocks = 200;
+
+  AudioIOData io;
+  io.framesPerBuffer(fpb);
+  io.framesPerSecond(48000);
+  io.channelsIn(0);
+  io.channelsOut(60);
+  spatializer.prepare(io);
+
+  std::vector<float> samples(fpb);
+  for (int i = 0; i < fpb; i++) {
+    samples[i] = std::sin(i * 0.1f);
+  }
+
+  for (bool moving : {false, true}) {
+    auto start = std::chrono::steady_clock::now();
+    for (int block = 0; block < numBlocks; block++) {
+      io.zeroOut();
+      for (int source = 0; source < numSources; source++) {
+        double angle = source * 0.7 + (moving ? block * 0.01 : 0.0);
+        Pose previousPose(Vec3d(std::sin(angle - 0.01), 0.2, -std::cos(angle - 0.01)));
+        Pose pose(Vec3d(std::sin(angle), 0.2, -std::cos(angle)));
+        if (moving) {
+          spatializer.renderBufferRamp(io, previousPose, pose, samples.data(), fpb);
+        } else {
+          spatializer.renderBuffer(io, pose, samples.data(), fpb);
+        }
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    printf("%14s %8s %10d %20.1f\n", name, moving ? "ramp" : "static", numSpeakers,
+           double(numSources) * numSpeakers * numBlocks / ms);
+  }
+}
+
+int main() {
+  printf("%14s %8s %10s %20s\n", "spatializer", "mode", "speakers", "src*spk/ms");
+
+  SpeakerLayout stereo = StereoSpeakerLayout();
+  StereoPanner stereoPanner(stereo);
+  measure("StereoPanner", stereoPanner, stereo.numSpeakers());
+
+  SpeakerLayout octal = OctalSpeakerLayout();
+  Vbap vbap2D(octal);
+  vbap2D.compile();
+  measure("Vbap 2D", vbap2D, octal.numSpeakers());
+
+  SpeakerLayout allosphere = AlloSphereSpeakerLayout();
+  Vbap vbap3D(allosphere, true);
+  vbap3D.compile();
+  measure("Vbap 3D", vbap3D, allosphere.numSpeakers());
+
+  Dbap dbap(allosphere);
+  measure("Dbap", dbap, allosphere.numSpeakers());
+
+  Lbap lbap(allosphere);
+  lbap.compile();
+  measure("Lbap", lbap, allosphere.numSpeakers());
+  return 0;
+}
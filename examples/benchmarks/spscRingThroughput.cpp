@@ -0,0 +1,142 @@
+/*
+Allolib Benchmark: Single producer single consumer ring throughput and latency
+
+Description:
+Streams blocks of 64 stereo float frames from one thread to another
+through a ring of 4096 frames, as a disk or recording thread would with
+the audio thread:
+- through SingleRWRingBuffer as bytes
+- through SPSCFrameRing with write() and read() copies
+- through SPSCFrameRing with reserveWrite()/commitWrite() and
+  reserveRead()/commitRead(), generating and consuming in place
+Reports the throughput in millions of frames per second.
+
+Then sends a single value back and forth between two threads through a
+pair of SPSCRing<uint64_t> and reports the median and 99th percentile
+round trip time.
+
+Build with -fsanitize=thread to check the rings for data races (the
+numbers are then not meaningful). Otherwise run a release build for
+meaningful numbers. With a single core the numbers depend mostly on
+scheduling.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "al/core/types/al_SPSCRing.hpp"
+#include "al/core/types/al_SingleRWRingBuffer.hpp"
+
+using namespace al;
+
+static const size_t blockFrames = 64;
+static const unsigned channels = 2;
+static const size_t totalFrames = 20000000;
+
+template <class Write, class Read>
+static void measure(const char *name, Write write, Read read) {
+  auto start = std::chrono::steady_clock::now();
+  float checksum = 0;
+  std::thread reader([&]() {
+    size_t frames = 0;
+    while (frames < totalFrames) {
+      size_t n = read(checksum);
+      if (n == 0) std::this_thread::yield();
+      frames += n;
+    }
+  });
+  size_t frames = 0;
+  float value = 0;
+  while (frames < totalFrames) {
+    size_t n = write(value, std::min(blockFrames, totalFrames - frames));
+    if (n == 0) std::this_thread::yield();
+    frames += n;
+  }
+  reader.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("%-36s %10.1f Mframes/s (%g)\n", name, totalFrames / seconds / 1e6, double(checksum));
+}
+
+int main() {
+  std::vector<float> source(blockFrames * channels), dest(blockFrames * channels);
+  auto fill = [&](float *samples, size_t frames, float &value) {
+    for (size_t i = 0; i < frames * channels; i++) samples[i] = value += 1.0f;
+  };
+  auto consume = [&](const float *samples, size_t frames, float &checksum) {
+    for (size_t i = 0; i < frames * channels; i++) checksum += samples[i];
+  };
+
+  {
+    SingleRWRingBuffer ring(4096 * channels * sizeof(float));
+    const size_t frameBytes = channels * sizeof(float);
+    measure("SingleRWRingBuffer bytes",
+      [&](float &value, size_t frames) {
+        size_t space = std::min(frames, ring.writeSpace() / frameBytes);
+        fill(source.data(), space, value);
+        return ring.write((const char *)source.data(), space * frameBytes) / frameBytes;
+      },
+      [&](float &checksum) {
+        size_t space = std::min(blockFrames, ring.readSpace() / frameBytes);
+        size_t n = ring.read((char *)dest.data(), space * frameBytes) / frameBytes;
+        consume(dest.data(), n, checksum);
+        return n;
+      });
+  }
+  {
+    SPSCFrameRing<float> ring(4096, channels);
+    measure("SPSCFrameRing write()/read()",
+      [&](float &value, size_t frames) {
+        size_t space = std::min(frames, ring.writeSpace());
+        fill(source.data(), space, value);
+        return ring.write(source.data(), space);
+      },
+      [&](float &checksum) {
+        size_t n = ring.read(dest.data(), blockFrames);
+        consume(dest.data(), n, checksum);
+        return n;
+      });
+  }
+  {
+    SPSCFrameRing<float> ring(4096, channels);
+    measure("SPSCFrameRing reserve/commit",
+      [&](float &value, size_t frames) {
+        auto span = ring.reserveWrite(frames);
+        fill(span.data, span.size, value);
+        ring.commitWrite(span.size);
+        return span.size;
+      },
+      [&](float &checksum) {
+        auto span = ring.reserveRead(blockFrames);
+        consume(span.data, span.size, checksum);
+        ring.commitRead(span.size);
+        return span.size;
+      });
+  }
+
+  // Round trip latency
+  SPSCRing<uint64_t> ping(16), pong(16);
+  const int trips = 20000;
+  std::thread echo([&]() {
+    uint64_t value;
+    for (int i = 0; i < trips; i++) {
+      while (!ping.pop(value)) std::this_thread::yield();
+      pong.push(value);
+    }
+  });
+  std::vector<double> times;
+  for (int i = 0; i < trips; i++) {
+    auto start = std::chrono::steady_clock::now();
+    ping.push(uint64_t(i));
+    uint64_t value;
+    while (!pong.pop(value)) std::this_thread::yield();
+    times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+  }
+  echo.join();
+  std::sort(times.begin(), times.end());
+  printf("SPSCRing round trip: median %.2f us, 99%% %.2f us\n",
+         times[times.size() / 2], times[times.size() * 99 / 100]);
+  return 0;
+}
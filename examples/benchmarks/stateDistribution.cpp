@@ -0,0 +1,86 @@
+/*
+Allolib Benchmark: State distribution over loopback
+
+Description:
+Sends a state block of 1 MB from a StateSender to a StateReceiver on
+localhost at 60 frames per second. A small fraction of the state changes
+every frame. Reports bytes sent per frame for keyframes and deltas, the
+latency from send() to the state being available, and dropped frames.
+
+Latency is measured by polling get(), so it includes up to one polling
+period of 0.1 ms.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "al/core/protocol/al_StateDistribution.hpp"
+#include "al/core/system/al_Time.hpp"
+
+using namespace al;
+
+int main() {
+  const size_t stateSize = 1 << 20;
+  const int numFrames = 300;
+  const int changedBytesPerFrame = 1000;
+
+  std::vector<char> state(stateSize, 0);
+  std::vector<char> received(stateSize, 0);
+
+  StateReceiver receiver(stateSize);
+  if (!receiver.open(10840, "localhost")) {
+    printf("Could not open receiver\n");
+    return 1;
+  }
+  StateSender sender(stateSize);
+  sender.keyframeInterval(60);
+  sender.addListener("localhost", 10840);
+
+  size_t keyframeBytes = 0, deltaBytes = 0;
+  int numKeyframes = 0, numDeltas = 0, numReceived = 0;
+  double totalLatencyUs = 0.0, maxLatencyUs = 0.0;
+  for (int frame = 0; frame < numFrames; frame++) {
+    memcpy(state.data(), &frame, sizeof(int));
+    for (int i = 0; i < changedBytesPerFrame; i++) {
+      state[(frame * 7919 + i * 1031) % stateSize]++;
+    }
+    bool keyframe = frame % 60 == 0;
+    auto start = std::chrono::steady_clock::now();
+    size_t bytes = sender.send(state.data());
+    if (keyframe) {
+      keyframeBytes += bytes;
+      numKeyframes++;
+    } else {
+      deltaBytes += bytes;
+      numDeltas++;
+    }
+    // Wait for this frame until the next one is due
+    while (std::chrono::steady_clock::now() - start < std::chrono::microseconds(16666)) {
+      if (receiver.get(received.data()) > 0) {
+        int receivedFrame;
+        memcpy(&receivedFrame, received.data(), sizeof(int));
+        if (receivedFrame == frame) {
+          double us = std::chrono::duration<double, std::micro>(
+                        std::chrono::steady_clock::now() - start).count();
+          totalLatencyUs += us;
+          maxLatencyUs = us > maxLatencyUs ? us : maxLatencyUs;
+          numReceived++;
+          al_sleep(0.016666 - us * 1e-6);
+          break;
+        }
+      }
+      al_sleep(0.0001);
+    }
+  }
+
+  printf("state size      %10zu bytes\n", stateSize);
+  printf("keyframe        %10zu bytes/frame\n", numKeyframes ? keyframeBytes / numKeyframes : 0);
+  printf("delta           %10zu bytes/frame\n", numDeltas ? deltaBytes / numDeltas : 0);
+  printf("received        %10d / %d frames\n", numReceived, numFrames);
+  printf("dropped         %10u frames\n", receiver.droppedFrames());
+  printf("mean latency    %10.1f us\n", numReceived ? totalLatencyUs / numReceived : 0.0);
+  printf("max latency     %10.1f us\n", maxLatencyUs);
+  return 0;
+}
@@ -0,0 +1,103 @@
+/*
+Allolib Benchmark: SynthRecorder trigger overhead
+
+Description:
+Triggers voices with four pfields at 10000 events per second and measures
+the time spent in PolySynth::triggerOn() and PolySynth::triggerOff() with
+no recorder attached and while a SynthRecorder is recording in each of its
+formats. Reports the average and worst time per trigger. With the recorder
+attached, the trigger callbacks only copy the event into a ring buffer;
+formatting and file writes happen on the recorder's writer thread.
+
+Run a release build for meaningful numbers.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "al/util/scene/al_SynthRecorder.hpp"
+
+using namespace al;
+
+class EmptyVoice : public SynthVoice {
+public:
+  EmptyVoice() {
+    createInternalTriggerParameter("amplitude");
+    createInternalTriggerParameter("frequency");
+    createInternalTriggerParameter("attack");
+    createInternalTriggerParameter("release");
+  }
+  void onProcess(AudioIOData &io) override {}
+  void onTriggerOff() override { free(); }
+};
+
+struct Timing {
+  double avgNs = 0;
+  double maxNs = 0;
+};
+
+static Timing triggerEvents(PolySynth &synth, AudioIOData &io, int numEvents) {
+  const auto period = std::chrono::microseconds(100); // 10000 events/s
+  Timing timing;
+  auto next = std::chrono::steady_clock::now();
+  for (int i = 0; i < numEvents; i++) {
+    auto *voice = synth.getVoice<EmptyVoice>();
+    auto start = std::chrono::steady_clock::now();
+    int id = synth.triggerOn(voice);
+    synth.triggerOff(id);
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / 2;
+    timing.avgNs += ns;
+    timing.maxNs = std::max(timing.maxNs, ns);
+    if (i % 16 == 15) {
+      // Let voices be triggered and freed
+      io.zeroOut();
+      synth.render(io);
+    }
+    next += period;
+    std::this_thread::sleep_until(next);
+  }
+  timing.avgNs /= numEvents;
+  return timing;
+}
+
+int main() {
+  const int numEvents = 20000;
+
+  AudioIOData io;
+  io.framesPerBuffer(64);
+  io.framesPerSecond(48000);
+  io.channelsIn(0);
+  io.channelsOut(2);
+
+  printf("%20s %12s %12s %10s\n", "recorder", "avg ns", "max ns", "dropped");
+  {
+    PolySynth synth;
+    synth.registerSynthClass<EmptyVoice>("EmptyVoice");
+    synth.allocatePolyphony("EmptyVoice", 64);
+    Timing timing = triggerEvents(synth, io, numEvents);
+    printf("%20s %12.0f %12.0f %10d\n", "none", timing.avgNs, timing.maxNs, 0);
+  }
+
+  const char *names[] = {"SEQUENCER_EVENT", "SEQUENCER_TRIGGERS", "CPP_FORMAT",
+                         "BINARY"};
+  for (auto format : {SynthRecorder::SEQUENCER_EVENT, SynthRecorder::SEQUENCER_TRIGGERS,
+                      SynthRecorder::CPP_FORMAT, SynthRecorder::BINARY}) {
+    PolySynth synth;
+    synth.registerSynthClass<EmptyVoice>("EmptyVoice");
+    synth.allocatePolyphony("EmptyVoice", 64);
+    SynthRecorder recorder(format);
+    recorder.setDirectory(".");
+    recorder << synth;
+    recorder.startRecord("benchmark", true);
+    Timing timing = triggerEvents(synth, io, numEvents);
+    recorder.stopRecord();
+    printf("%20s %12.0f %12.0f %10llu\n", names[format], timing.avgNs, timing.maxNs,
+           (unsigned long long)recorder.droppedEvents());
+  }
+  std::remove("benchmark.synthSequence");
+  std::remove("benchmark.synthSequenceBin");
+  return 0;
+}
@@ -0,0 +1,96 @@
+/*
+Allolib Benchmark: SynthSequencer text and binary sequence loading
+
+Description:
+Writes text sequences of increasing length, with four pfields per event,
+and converts them to binary sequence files. Compares the time taken by
+SynthSequencer::loadSequence() to parse the text file against the time
+taken to map the binary file with SynthSequenceFile::open(), and reports
+the size of both files. The binary file is then played for a few seconds
+to check that it is usable straight from the mapping.
+
+Run a release build for meaningful numbers.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+#include "al/util/scene/al_SynthSequenceFile.hpp"
+#include "al/util/scene/al_SynthSequencer.hpp"
+
+using namespace al;
+
+class EmptyVoice : public SynthVoice {
+public:
+  EmptyVoice() {
+    createInternalTriggerParameter("amplitude");
+    createInternalTriggerParameter("frequency");
+    createInternalTriggerParameter("attack");
+    createInternalTriggerParameter("release");
+  }
+  void onProcess(AudioIOData &io) override {}
+  void onTriggerOff() override { free(); }
+};
+
+static long fileSize(const char *name) {
+  std::ifstream f(name, std::ios::binary | std::ios::ate);
+  return long(f.tellg());
+}
+
+int main() {
+  const char *textName = "benchmark.synthSequence";
+  const char *binaryName = "benchmark.synthSequenceBin";
+
+  AudioIOData io;
+  io.framesPerBuffer(64);
+  io.framesPerSecond(48000);
+  io.channelsIn(0);
+  io.channelsOut(2);
+
+  printf("%10s %12s %12s %12s %12s %14s\n", "events", "text MB", "binary MB", "parse ms",
+         "map ms", "us/block");
+  for (int numEvents : {100000, 1000000}) {
+    {
+      std::ofstream f(textName);
+      for (int i = 0; i < numEvents; i++) {
+        f << "@ " << i / 1000.0 << " 0.5 EmptyVoice 0.2 " << 220 + i % 440 << " 0.01 0.3\n";
+      }
+    }
+
+    SynthSequencer seq(PolySynth::TIME_MASTER_AUDIO);
+    seq.synth().registerSynthClass<EmptyVoice>("EmptyVoice");
+    seq.synth().allocatePolyphony("EmptyVoice", 1024);
+    seq.convertToBinary("benchmark");
+
+    auto start = std::chrono::steady_clock::now();
+    auto events = seq.loadSequence("benchmark");
+    auto parsed = std::chrono::steady_clock::now();
+    SynthSequenceFile sequence;
+    sequence.open(binaryName);
+    auto mapped = std::chrono::steady_clock::now();
+    if (events.size() != sequence.numEvents()) {
+      printf("Event count mismatch: %zu text, %llu binary\n", events.size(),
+             (unsigned long long)sequence.numEvents());
+    }
+
+    // Play the binary file
+    seq.playSequence(binaryName);
+    const int numBlocks = 2000;
+    auto playStart = std::chrono::steady_clock::now();
+    for (int block = 0; block < numBlocks; block++) {
+      seq.render(io);
+    }
+    auto playEnd = std::chrono::steady_clock::now();
+    seq.stopSequence();
+
+    printf("%10d %12.1f %12.1f %12.1f %12.3f %14.2f\n", numEvents,
+           fileSize(textName) / 1.0e6, fileSize(binaryName) / 1.0e6,
+           std::chrono::duration<double, std::milli>(parsed - start).count(),
+           std::chrono::duration<double, std::milli>(mapped - parsed).count(),
+           std::chrono::duration<double, std::micro>(playEnd - playStart).count() / numBlocks);
+  }
+  std::remove(textName);
+  std::remove(binaryName);
+  return 0;
+}
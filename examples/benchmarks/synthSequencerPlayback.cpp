@@ -0,0 +1,75 @@
+/*
+Allolib Benchmark: SynthSequencer playback cost
+
+Description:
+Writes text sequences of increasing length with the same event density
+(1000 events per second, each lasting half a second) and plays them through
+a SynthSequencer driven by the audio callback. Reports the time taken to
+load the sequence and the average and worst time per audio block for the
+first seconds of playback, which should not depend on the sequence length.
+Voices do no audio processing so the time reported is the sequencing and
+voice management overhead.
+
+Run a release build for meaningful numbers.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+#include "al/util/scene/al_SynthSequencer.hpp"
+
+using namespace al;
+
+class EmptyVoice : public SynthVoice {
+public:
+  void onProcess(AudioIOData &io) override {}
+  void onTriggerOff() override { free(); }
+};
+
+int main() {
+  const char *name = "benchmark.synthSequence";
+  const double eventsPerSecond = 1000;
+  const int numBlocks = 5000;
+
+  AudioIOData io;
+  io.framesPerBuffer(64);
+  io.framesPerSecond(48000);
+  io.channelsIn(0);
+  io.channelsOut(2);
+
+  printf("%10s %10s %14s %14s\n", "events", "load ms", "avg us/block", "max us/block");
+  for (int numEvents : {10000, 100000, 1000000}) {
+    {
+      std::ofstream f(name);
+      for (int i = 0; i < numEvents; i++) {
+        f << "@ " << i / eventsPerSecond << " 0.5 EmptyVoice " << i % 128 << "\n";
+      }
+    }
+
+    SynthSequencer seq(PolySynth::TIME_MASTER_AUDIO);
+    seq.synth().registerSynthClass<EmptyVoice>("EmptyVoice");
+    seq.synth().allocatePolyphony("EmptyVoice", 1024);
+
+    auto start = std::chrono::steady_clock::now();
+    seq.playSequence(name);
+    auto loaded = std::chrono::steady_clock::now();
+
+    double totalUs = 0, maxUs = 0;
+    for (int block = 0; block < numBlocks; block++) {
+      auto blockStart = std::chrono::steady_clock::now();
+      seq.render(io);
+      auto blockEnd = std::chrono::steady_clock::now();
+      double us = std::chrono::duration<double, std::micro>(blockEnd - blockStart).count();
+      totalUs += us;
+      maxUs = std::max(maxUs, us);
+    }
+    printf("%10d %10.1f %14.2f %14.2f\n", numEvents,
+           std::chrono::duration<double, std::milli>(loaded - start).count(),
+           totalUs / numBlocks, maxUs);
+    seq.stopSequence();
+  }
+  std::remove(name);
+  return 0;
+}
@@ -21,7 +21,7 @@
 #ifdef AL_USE_CUTTLEBONE
 #include "Cuttlebone/Cuttlebone.hpp"
 #else
-#include "al/core/protocol/al_OSC.hpp"
+#include "al/core/protocol/al_StateDistribution.hpp"
 #endif
 
 namespace al {
@@ -62,12 +62,12 @@ public:
     mQueuedStates = mTaker->get(mState);
     return true;
 #else
+    assert(mReceiver);
+    // The network thread hands complete states over through the receiver's
+    // triple buffer, so this is the only copy and it never waits for the
+    // network. mRecvLock only guards mState against lockState() users.
     mRecvLock.lock();
-    if (newMessages > 0) {
-      mQueuedStates = newMessages;
-      std::memcpy(mState.get(), buf.get(), sizeof(TSharedState));
-      newMessages = 0;
-    }
+    mQueuedStates = mReceiver->get(mState.get());
     mRecvLock.unlock();
     tickSubdomains(false);
     return true;
@@ -82,7 +82,7 @@ public:
     cleanupSubdomains(false);
     return true;
 #else
-    mRecv = nullptr;
+    mReceiver = nullptr;
     mState = nullptr;
 
 //    std::cerr << "Not using Cuttlebone. Ignoring" << std::endl;
@@ -107,6 +107,14 @@ public:
   void unlockState() {mRecvLock.unlock();}
   int newStates() { return mQueuedStates; }
 
+#ifndef AL_USE_CUTTLEBONE
+  /// Number of states that were lost or incomplete
+  uint32_t droppedStates() const { return mReceiver ? mReceiver->droppedFrames() : 0; }
+
+  /// Number of complete states replaced by a newer one before tick()
+  uint32_t staleStates() const { return mReceiver ? mReceiver->staleFrames() : 0; }
+#endif
+
   std::string id() const
   {
     return mId;
@@ -129,35 +137,9 @@ private:
 #ifdef AL_USE_CUTTLEBONE
   std::unique_ptr<cuttlebone::Taker<TSharedState>> mTaker;
 #else
-  class Handler: public osc::PacketHandler {
-  public:
-    StateReceiveDomain *mOscDomain;
-    void onMessage(osc::Message &m) override {
-//      m.print();
-      if (m.addressPattern() == "/_state" && m.typeTags() == "sb") {
-        std::string id;
-        m >> id;
-        if (id == mOscDomain->mId) {
-          osc::Blob inBlob;
-          m >> inBlob;
-          if (sizeof(TSharedState) == inBlob.size) {
-            mOscDomain->mRecvLock.lock();
-            memcpy(mOscDomain->buf.get(), inBlob.data, sizeof(TSharedState));
-            mOscDomain->newMessages++;
-            mOscDomain->mRecvLock.unlock();
-          } else {
-            std::cerr << "ERROR: received state size mismatch" << std::endl;
-          }
-        }
-      }
-    }
-  } mHandler;
-
-  std::unique_ptr<unsigned char []> buf;
-
-  uint16_t newMessages = 0;
+  // Reassembles fragmented and delta encoded frames from StateSendDomain
+  std::unique_ptr<StateReceiver> mReceiver;
   std::mutex mRecvLock;
-  std::unique_ptr<osc::Recv> mRecv;
 #endif
 
 };
@@ -173,16 +155,10 @@ bool StateReceiveDomain<TSharedState>::initialize(ComputationDomain *parent) {
   initializeSubdomains(false);
   return true;
 #else
-  buf = std::make_unique<unsigned char []>(sizeof(TSharedState));
-  mRecv = std::make_unique<osc::Recv>();
-  if (!mRecv || !mRecv->open(mPort, mAddress.c_str())) {
-    std::cerr << "Error opening server" << std::endl;
-    return false;
-  }
-  mHandler.mOscDomain = this;
-  mRecv->handler(mHandler);
-  if (!mRecv->start()) {
-    std::cerr << "Failed to start receiver. " << std::endl;
+  mReceiver = std::make_unique<StateReceiver>(sizeof(TSharedState), mId);
+  if (!mReceiver->open(mPort, mAddress.c_str())) {
+    std::cerr << "Error opening state receiver" << std::endl;
+    mReceiver = nullptr;
     return false;
   }
 
@@ -205,11 +181,14 @@ public:
     initializeSubdomains(false);
     return true;
 #else
-    //    mSend = std::make_unique<osc::Send>(mPort, mAddress.c_str());
-    ////    std::cout << "StateSendDomain not using Cuttlebone" << std::endl;
-    //    if (!mSend) {
-    //      std::cerr << "Can't create sender for StateSendDomain address:" << mAddress << " port:" << mPort <<std::endl;
-    //    }
+    // The socket is opened once here, not on every tick
+    mSender = std::make_unique<StateSender>(sizeof(TSharedState), mId);
+    mSender->fragmentSize(mPacketSize);
+    if (!mSender->addListener(mAddress, mPort)) {
+      std::cerr << "Can't create sender for StateSendDomain address:" << mAddress << " port:" << mPort <<std::endl;
+      mSender = nullptr;
+      return false;
+    }
     initializeSubdomains(false);
     return true;
 #endif
@@ -225,17 +204,9 @@ public:
     tickSubdomains(false);
     return true;
 #else
-//    assert(mSend);
-
-//    osc::Blob b(&mState, sizeof(mState));
-//    mSend->send("/_state", b);
-
+    assert(mSender);
     mStateLock.lock();
-    osc::Blob b(mState.get(), sizeof(TSharedState));
-    osc::Send s(mPort, mAddress.c_str());
-//    std::cout << mAddress << ":" << mPort << std::endl;
-    s.send("/_state", mId, b);
-
+    mSender->send(mState.get());
     mStateLock.unlock();
 
     tickSubdomains(false);
@@ -252,6 +223,7 @@ public:
       cleanupSubdomains(false);
       return true;
 #else
+    mSender = nullptr;
     mState = nullptr;
 //    std::cerr << "Not using Cuttlebone. Ignoring" << std::endl;
     cleanupSubdomains(false);
@@ -288,7 +260,8 @@ private:
 #ifdef AL_USE_CUTTLEBONE
   std::unique_ptr<cuttlebone::Maker<TSharedState>> mMaker;
 #else
-  std::unique_ptr<osc::Send> mSend;
+  // Splits each state in fragments and sends deltas between keyframes
+  std::unique_ptr<StateSender> mSender;
 #endif
 
 #ifdef AL_USE_CUTTLEBONE
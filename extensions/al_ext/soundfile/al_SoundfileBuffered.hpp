@@ -2,15 +2,11 @@
 #define SOUNDFILEBUFFERED_H
 
 
-#include <mutex>
-#include <thread>
-#include <condition_variable>
 #include <memory>
-#include <atomic>
 #include <functional>
 
 #include "Gamma/SoundFile.h"
-#include "al/core/types/al_SingleRWRingBuffer.hpp"
+#include "al_ext/soundfile/al_SoundfileStream.hpp"
 
 
 namespace al
@@ -20,10 +16,12 @@ namespace al
 /// \brief Read a soundfile with buffering on a low priority thread
 ///
 /// The SoundFileBuffered class is a wrapper around Gamma's SoundFile class.
-/// It reads the soundfile in a separate thread and reading is done from a
-/// lock-free ring buffer. This is the ideal way of reading a soundfile
-/// within an audio callback as it will provide the most efficient mechanism
-/// for low latency, high efficiency and drop-out free soundfile access.
+/// The soundfile is read by the reader threads of
+/// SoundFileStreamPool::defaultPool(), which are shared by all
+/// SoundFileBuffered objects, and reading is done from a lock-free ring
+/// buffer. This is the ideal way of reading a soundfile within an audio
+/// callback as it will provide the most efficient mechanism for low
+/// latency, high efficiency and drop-out free soundfile access.
 ///
 ///
 class SoundFileBuffered
@@ -32,7 +30,7 @@ public:
   ///
   /// \param fullPath The full path to the audio file
   /// \param loop set to true if you want the sound file to start over when finished
-  /// \param bufferFrames the size of the ring buffer. Set to larger if experiencing dropouts or if planning to read more samples, e.g. the audio buffer size is large.
+  /// \param bufferFrames the size of the ring buffer. Set to larger if experiencing dropouts (see underruns()) or if planning to read more samples, e.g. the audio buffer size is large.
   ///
   SoundFileBuffered(std::string fullPath = std::string(), bool loop = false, int bufferFrames = 1024);
   ~SoundFileBuffered();
@@ -43,7 +41,8 @@ public:
   /// \brief Read samples from the audio file to an interleaved buffer
   /// \param buffer pre-allocated buffer of at least numFrames*channels() size
   /// \param numFrames number of frames to read
-  /// \return the number of frames actually read.
+  /// \return the number of frames actually read. The rest of the buffer is
+  /// filled with zeros.
   ///
   size_t read(float *buffer, int numFrames);
 
@@ -64,6 +63,12 @@ public:
   ///
   int repeats();
 
+  ///
+  /// \brief Number of reads that found fewer frames in the ring buffer
+  /// than requested before the end of the file
+  ///
+  int underruns();
+
   typedef std::function<void(float *buffer, int numChannels,
                              int numFrames, void * userData)> CallbackFunc;
 
@@ -78,7 +83,8 @@ public:
   /// the process taking place in the callback function is too intensive it
   /// might produce an underrun in the ring buffer resulting in audio dropouts.
   /// If this is the case, use the callback to copy the data to a separate
-  /// thread for processing.
+  /// thread for processing. The callback gets all the samples if it is set
+  /// before open().
   ///
   /// \param func the callback function
   /// \param userData the data to be passed to the callback
@@ -90,24 +96,15 @@ public:
   int currentPosition();
 
 private:
-  bool mRunning;
+  SoundFileStream::ReadCallback streamCallback();
+
   bool mLoop;
-  std::atomic<int> mRepeats;
-  std::atomic<int> mSeek;
-  std::atomic<int> mCurPos; // Updated once per read buffer
-  std::mutex mLock;
-  std::condition_variable mCondVar;
-  std::thread *mReaderThread;
-  SingleRWRingBuffer *mRingBuffer;
   int mBufferFrames;
+  std::shared_ptr<SoundFileStreamPool> mPool;
+  std::shared_ptr<SoundFileStream> mStream;
 
-  gam::SoundFile mSf;
   CallbackFunc mReadCallback;
   void *mCallbackData;
-
-  float *mFileBuffer; // Buffer to copy file samples to (in the reader thread before passing to ring buffer)
-
-  static void readFunction(SoundFileBuffered *obj);
 };
 
 } // namespace al
@@ -11,7 +11,7 @@
 #include <algorithm>
 
 #include "Gamma/SoundFile.h"
-#include "al/core/types/al_SingleRWRingBuffer.hpp"
+#include "al/core/types/al_SPSCRing.hpp"
 #include "al/core/io/al_AudioIOData.hpp"
 
 
@@ -93,7 +93,7 @@ protected:
   std::mutex mLock;
   std::condition_variable mCondVar;
   std::thread *mReaderThread {nullptr};
-  SingleRWRingBuffer *mRingBuffer {nullptr};
+  SPSCFrameRing<float> *mRingBuffer {nullptr};
   uint32_t mBufferFrames;
 
   gam::SoundFile mSf;
@@ -101,8 +101,6 @@ protected:
 //  void *mCallbackData;
 
 private:
-  std::unique_ptr<float []> mFileBuffer; // Interleaved Buffer to copy file samples to (in the write thread before passing to ring buffer)
-
   static void writeFunction(SoundFileBufferedRecord *obj, std::condition_variable *cond, std::mutex *condMutex);
 };
 
@@ -0,0 +1,247 @@
+#ifndef SOUNDFILESTREAM_H
+#define SOUNDFILESTREAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Gamma/SoundFile.h"
+
+namespace al
+{
+
+class SoundFileStreamPool;
+class SoundFileReadQueue;
+
+///
+/// \brief A sound file played from disk through a SoundFileStreamPool
+///
+/// Streams are created with SoundFileStreamPool::open(). The pool's reader
+/// threads keep a buffer of interleaved float frames full, reading the file
+/// with Gamma's SoundFile, and read() takes frames from it without locking
+/// or allocating, so it can be called from the audio thread. Only one
+/// thread should call read() and seek().
+///
+/// If read() finds fewer frames in the buffer than requested before the
+/// end of the file, the missing frames are output as silence and the
+/// underrun is counted in underruns().
+///
+/// seek() and setLoop() don't block. After a seek, read() outputs silence
+/// until a reader thread has refilled the buffer from the new position.
+///
+class SoundFileStream
+{
+public:
+  typedef std::function<void(float *buffer, int numChannels, int numFrames)> ReadCallback;
+
+  ~SoundFileStream();
+
+  SoundFileStream(const SoundFileStream &) = delete;
+  SoundFileStream &operator=(const SoundFileStream &) = delete;
+
+  ///
+  /// \brief Read interleaved frames
+  /// \param buffer destination for numFrames * channels() samples
+  /// \param numFrames number of frames to read
+  /// \return number of frames read from the file. The rest of buffer is
+  /// filled with zeros.
+  ///
+  uint64_t read(float *buffer, uint64_t numFrames);
+
+  /// Continue reading from frame. Can be called from the audio thread.
+  void seek(uint64_t frame);
+
+  /// Continue from the start of the file when its end is reached
+  void setLoop(bool loop) { mLoop.store(loop); }
+  bool loop() const { return mLoop.load(); }
+
+  /// true if all frames up to the end of the file have been read
+  bool finished() const;
+
+  /// Position in the file of the next frame read()
+  uint64_t position() const { return mPosition.load(std::memory_order_relaxed); }
+
+  /// Number of times the reader has gone back to the start of the file
+  int repeats() const { return mRepeats.load(); }
+
+  /// Number of read() calls that found fewer frames in the buffer than
+  /// they needed before the end of the file.
+  uint64_t underruns() const { return mUnderruns.load(); }
+
+  /// Frames waiting in the buffer
+  uint64_t bufferedFrames() const {
+    return mFramesWritten.load(std::memory_order_acquire) - readPosition();
+  }
+  uint64_t bufferFrames() const { return mBufferFrames; }
+
+  ///
+  /// \brief Set a function that is called on a reader thread with the
+  /// frames just read from the file, before read() can get them
+  ///
+  /// Once this returns, the previous function is no longer being called.
+  /// Don't call from the audio thread.
+  ///
+  void setReadCallback(ReadCallback callback);
+
+  std::string fileName() const { return mFileName; }
+  int channels() const { return mChannels; }
+  double frameRate() const { return mFrameRate; }
+  uint64_t frames() const { return mFrames; }
+  gam::SoundFile::EncodingType encoding() const { return mEncoding; }
+  gam::SoundFile::Format format() const { return mFormat; }
+
+private:
+  friend class SoundFileStreamPool;
+
+  SoundFileStream() {}
+
+  bool openFile(std::string fileName, uint64_t bufferFrames, double bufferSeconds, uint64_t readFrames);
+  bool needsRead() const;
+  /// Seconds until read() runs out of buffered frames, 0 during a seek
+  double secondsBuffered() const;
+  /// Queue the stream for a reader thread, unless it is queued already
+  void requestRead();
+  /// Move in the file if needed and read into the buffer. Called by one
+  /// reader thread at a time
+  void fill();
+  void readFile();
+  /// Frames before this are no longer needed, including those skipped by
+  /// a seek that read() has not seen yet
+  uint64_t readPosition() const {
+    uint64_t framesRead = mFramesRead.load(std::memory_order_acquire);
+    uint64_t seekStart = mSeekStartFrame.load(std::memory_order_relaxed);
+    return framesRead > seekStart ? framesRead : seekStart;
+  }
+
+  gam::SoundFile mSf;
+  std::string mFileName;
+  int mChannels {0};
+  double mFrameRate {0};
+  uint64_t mFrames {0};
+  gam::SoundFile::EncodingType mEncoding {};
+  gam::SoundFile::Format mFormat {};
+  uint64_t mReadFrames {0};
+
+  // Interleaved frames, power of two size. The frame counters only grow
+  std::vector<float> mBuffer;
+  uint64_t mBufferFrames {0};
+  std::atomic<uint64_t> mFramesWritten {0};
+  std::atomic<uint64_t> mFramesRead {0};
+  std::atomic<uint64_t> mEndFrame {UINT64_MAX}; // Value of mFramesWritten at end of file
+
+  std::atomic<bool> mLoop {false};
+  std::atomic<uint64_t> mUnderruns {0};
+  std::atomic<int> mRepeats {0};
+  std::atomic<uint64_t> mPosition {0};
+
+  // Seeks are requested by incrementing mSeekRequest. The reader thread
+  // sets mSeekStartFrame to the value of mFramesWritten when it moved in
+  // the file and then acknowledges with mSeekDone. read() skips frames
+  // written before that point.
+  std::atomic<uint64_t> mSeekFrame {0};
+  std::atomic<uint32_t> mSeekRequest {0};
+  std::atomic<uint32_t> mSeekDone {0};
+  std::atomic<uint64_t> mSeekStartFrame {0};
+  uint32_t mSeekRequested {0}; // read() side copy of mSeekRequest
+  uint32_t mSeekSkipped {0};   // Last seek whose stale frames were skipped
+  uint64_t mSeekTarget {0};    // read() side copy of mSeekFrame
+
+  // Set while the stream is in the pool's queue or being filled, so it is
+  // only queued once and only one reader thread fills it
+  uint64_t mId {0};
+  std::shared_ptr<SoundFileReadQueue> mQueue;
+  std::atomic<bool> mQueued {false};
+
+  // Reader side
+  uint32_t mSeekHandled {0};
+  uint64_t mFilePosition {0};
+  std::mutex mCallbackLock;
+  ReadCallback mReadCallback;
+};
+
+///
+/// \brief Streams many sound files with a fixed number of reader threads
+///
+/// A stream is queued for the reader threads when read() has made room for
+/// a file read in its buffer, or when it is seeked. Reader threads sleep
+/// until a stream is queued. Of the queued streams they fill the one with
+/// the fewest seconds buffered first, so streams with short buffers or high
+/// sample rates are not starved by the order in which they were queued.
+///
+/// Each file read is readFrames long, and reads start at multiples of
+/// readFrames in the file, also after a seek.
+///
+/// \code
+/// SoundFileStreamPool pool(2);
+/// auto stream = pool.open("stem1.wav");
+/// // In the audio callback
+/// stream->read(buffer, io.framesPerBuffer());
+/// \endcode
+///
+class SoundFileStreamPool
+{
+public:
+  ///
+  /// \param numThreads reader threads
+  /// \param bufferSeconds length of each stream's buffer, unless given in open()
+  /// \param readFrames size of each file read, rounded down to a power of
+  /// two. Buffers hold at least two reads
+  /// \param maxStreams maximum number of open streams
+  ///
+  SoundFileStreamPool(int numThreads = 2, double bufferSeconds = 1.0,
+                      int readFrames = 8192, int maxStreams = 4096);
+  ~SoundFileStreamPool();
+
+  ///
+  /// \brief Open a sound file and fill its buffer
+  /// \param fileName the sound file
+  /// \param bufferFrames buffer size in frames, or 0 to use the pool's
+  /// buffer length. Reads are made smaller to fit two in the buffer.
+  /// \param callback passed to SoundFileStream::setReadCallback()
+  /// \return the stream, or nullptr if the file can't be read or
+  /// maxStreams are open
+  ///
+  /// Don't call from the audio thread.
+  ///
+  std::shared_ptr<SoundFileStream> open(std::string fileName, int bufferFrames = 0,
+                                        SoundFileStream::ReadCallback callback = nullptr);
+
+  /// Stop refilling stream. When this returns its read callback is no
+  /// longer called. The stream is deleted when the last reference to it
+  /// is released, so release it outside the audio thread.
+  void close(std::shared_ptr<SoundFileStream> stream);
+
+  size_t numStreams();
+
+  /// Total underruns of all streams
+  uint64_t underruns();
+
+  /// Pool shared by all SoundFileBuffered objects
+  static std::shared_ptr<SoundFileStreamPool> defaultPool();
+
+private:
+  void readerFunction();
+  /// Take the pending stream that runs out first. Returns nullptr for a
+  /// closed stream. Call with mStreamsLock held
+  std::shared_ptr<SoundFileStream> nextStream();
+
+  double mBufferSeconds;
+  uint64_t mReadFrames;
+  size_t mMaxStreams;
+  std::shared_ptr<SoundFileReadQueue> mQueue;
+  uint64_t mNextId {1};
+  std::unordered_map<uint64_t, std::shared_ptr<SoundFileStream>> mStreams;
+  std::vector<uint64_t> mPendingIds; // Taken from mQueue, not yet filled
+  std::mutex mStreamsLock;
+  std::vector<std::thread> mThreads;
+};
+
+} // namespace al
+
+#endif // SOUNDFILESTREAM_H
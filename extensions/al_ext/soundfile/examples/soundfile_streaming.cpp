@@ -0,0 +1,103 @@
+/*
+Allolib Example: Streaming many sound files with SoundFileStreamPool
+
+Description:
+Writes a few stereo 16 bit WAV files at 48 kHz and plays an increasing
+number of looping streams from them for a few seconds, reading a 64 frame
+block from every stream each audio period in real time. Streams start at
+different positions in the files. Reports the underruns per stream count
+for a shared pool of reader threads and for one reader thread per stream,
+and the average time taken to read all streams in an audio period.
+
+The files will usually be in the page cache, so this measures the
+scheduling and decoding overhead rather than the disk. Copy the files to
+a cold disk (or drop the page cache) to measure the disk.
+
+Run a release build for meaningful numbers.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "al_ext/soundfile/al_SoundfileStream.hpp"
+
+#include "Gamma/SoundFile.h"
+
+using namespace al;
+
+static void writeFile(std::string name, int frames) {
+  gam::SoundFile sf;
+  sf.format(gam::SoundFile::WAV);
+  sf.encoding(gam::SoundFile::PCM_16);
+  sf.channels(2);
+  sf.frameRate(48000);
+  sf.openWrite(name);
+  std::vector<float> samples(frames * 2);
+  for (int i = 0; i < frames * 2; i++) {
+    samples[i] = int16_t(i * 31) / 32768.0f;
+  }
+  sf.write<float>(samples.data(), frames);
+  sf.close();
+}
+
+int main() {
+  const int numFiles = 8;
+  const int fileFrames = 48000 * 20;
+  const int framesPerBuffer = 64;
+  const double seconds = 5.0;
+  std::vector<std::string> files;
+  for (int i = 0; i < numFiles; i++) {
+    files.push_back("benchmark_stream" + std::to_string(i) + ".wav");
+    writeFile(files.back(), fileFrames);
+  }
+
+  printf("%8s %20s %12s %14s\n", "streams", "readers", "underruns", "us/period");
+  for (int numStreams : {100, 200, 400, 800, 1600}) {
+    for (bool shared : {true, false}) {
+      std::vector<std::unique_ptr<SoundFileStreamPool>> pools;
+      std::vector<std::shared_ptr<SoundFileStream>> streams;
+      if (shared) {
+        pools.emplace_back(new SoundFileStreamPool(4, 0.25, 4096));
+      }
+      for (int i = 0; i < numStreams; i++) {
+        if (!shared) {
+          pools.emplace_back(new SoundFileStreamPool(1, 0.25, 4096));
+        }
+        streams.push_back(pools.back()->open(files[i % numFiles]));
+        streams.back()->setLoop(true);
+        streams.back()->seek(uint64_t(i) * 7919 * framesPerBuffer % fileFrames);
+      }
+
+      std::vector<float> block(framesPerBuffer * 2);
+      const auto period = std::chrono::microseconds(1000000 * framesPerBuffer / 48000);
+      const int numPeriods = int(seconds * 48000 / framesPerBuffer);
+      double totalUs = 0;
+      auto next = std::chrono::steady_clock::now();
+      for (int p = 0; p < numPeriods; p++) {
+        auto start = std::chrono::steady_clock::now();
+        for (auto &stream : streams) {
+          stream->read(block.data(), framesPerBuffer);
+        }
+        totalUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        next += period;
+        std::this_thread::sleep_until(next);
+      }
+      uint64_t underruns = 0;
+      for (auto &stream : streams) {
+        underruns += stream->underruns();
+      }
+      printf("%8d %20s %12llu %14.1f\n", numStreams,
+             shared ? "shared pool (4)" : "thread per stream",
+             (unsigned long long)underruns, totalUs / numPeriods);
+      streams.clear();
+    }
+  }
+  for (auto &file : files) {
+    std::remove(file.c_str());
+  }
+  return 0;
+}
@@ -10,12 +10,14 @@ else()
   set(THIS_EXTENSION_SRC
     ${CMAKE_CURRENT_LIST_DIR}/src/al_SoundfileBuffered.cpp
     ${CMAKE_CURRENT_LIST_DIR}/src/al_SoundfileBufferedRecord.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/src/al_SoundfileStream.cpp
   #  ${CMAKE_CURRENT_LIST_DIR}/src/al_AmbiFilePlayer.cpp
   )
 
   set(THIS_EXTENSION_HEADERS
     ${CMAKE_CURRENT_LIST_DIR}/al_SoundfileBuffered.hpp
     ${CMAKE_CURRENT_LIST_DIR}/al_SoundfileBufferedRecord.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/al_SoundfileStream.hpp
     ${CMAKE_CURRENT_LIST_DIR}/al_OutputRecorder.hpp
   #  ${CMAKE_CURRENT_LIST_DIR}/al_AmbiFilePlayer.hpp
   )
@@ -51,4 +53,14 @@ else()
   add_test(NAME soundfileBufferedRecordTests
     COMMAND $<TARGET_FILE:soundfileBufferedRecordTests> ${TEST_ARGS})
 
+  add_executable(soundfileStreamTests ${CMAKE_CURRENT_LIST_DIR}/unitTests/utSoundfileStream.cpp)
+  target_link_libraries(soundfileStreamTests ${THIS_EXTENSION_LIBRARY_NAME} al ${THIS_EXTENSION_LIBRARIES})
+  target_include_directories(soundfileStreamTests PUBLIC "${CMAKE_CURRENT_SOURCE_DIR}/external/catch")
+  set_target_properties(soundfileStreamTests PROPERTIES
+    CXX_STANDARD 14
+    CXX_STANDARD_REQUIRED ON
+    )
+  add_test(NAME soundfileStreamTests
+    COMMAND $<TARGET_FILE:soundfileStreamTests> ${TEST_ARGS})
+
 endif(NOT SNDFILE_LIBRARY)
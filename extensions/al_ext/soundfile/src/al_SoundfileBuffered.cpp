@@ -3,15 +3,14 @@
 using namespace al;
 
 SoundFileBuffered::SoundFileBuffered(std::string fullPath, bool loop, int bufferFrames) :
-  mRunning(true),
   mLoop(loop),
-  mRepeats(0),
-  mSeek(-1),
-  mCurPos(0),
   mBufferFrames(bufferFrames),
-  mReadCallback(nullptr)
+  mReadCallback(nullptr),
+  mCallbackData(nullptr)
 {
-  open(fullPath);
+  if (fullPath.size() > 0) {
+    open(fullPath);
+  }
 }
 
 SoundFileBuffered::~SoundFileBuffered()
@@ -22,12 +21,11 @@ SoundFileBuffered::~SoundFileBuffered()
 bool SoundFileBuffered::open(std::string fullPath)
 {
   close();
-  mSf.path(fullPath);
-  mSf.openRead();
-  if (mSf.opened()) {
-    mRingBuffer = new SingleRWRingBuffer(mBufferFrames * channels() * sizeof(float));
-    mReaderThread = new std::thread(readFunction, this);
-    mFileBuffer = new float[mBufferFrames * channels()];
+  // Hold on to the pool, so it outlives static players
+  mPool = SoundFileStreamPool::defaultPool();
+  mStream = mPool->open(fullPath, mBufferFrames, streamCallback());
+  if (mStream) {
+    mStream->setLoop(mLoop);
     return true;
   }
   return false;
@@ -35,69 +33,42 @@ bool SoundFileBuffered::open(std::string fullPath)
 
 bool SoundFileBuffered::close()
 {
-
-  if (mSf.opened()) {
-    mRunning = false;
-    mCondVar.notify_one();
-    mReaderThread->join();
-    delete mReaderThread;
-    delete mRingBuffer;
-    delete[] mFileBuffer;
-    mSf.close();
+  if (mStream) {
+    mPool->close(mStream);
+    mStream = nullptr;
   }
   return true;
 }
 
 size_t SoundFileBuffered::read(float *buffer, int numFrames)
 {
-  size_t bytesRead = mRingBuffer->read((char *) buffer, numFrames * channels() * sizeof(float));
-  if (bytesRead != numFrames * channels() * sizeof(float)) {
-    // TODO: handle underrun
+  if (!mStream) {
+    return 0;
   }
-  mCondVar.notify_one();
-  return bytesRead / (channels() * sizeof(float));
+  return size_t(mStream->read(buffer, uint64_t(numFrames)));
 }
 
 bool SoundFileBuffered::opened() const
 {
-  return mSf.opened();
-}
-
-void SoundFileBuffered::readFunction(SoundFileBuffered  *obj)
-{
-  while (obj->mRunning) {
-    std::unique_lock<std::mutex> lk(obj->mLock);
-    obj->mCondVar.wait(lk);
-    int framesToRead = obj->mRingBuffer->writeSpace() / (obj->channels() * sizeof(float));
-    int framesRead = obj->mSf.read(obj->mFileBuffer, framesToRead);
-    std::atomic_fetch_add(&(obj->mCurPos), framesRead);
-    int seek = obj->mSeek.load();
-    if (seek >= 0) { // Process seek request
-      obj->mSf.seek(seek, SEEK_SET);
-      obj->mSeek.store(-1);
-    }
-    if (framesRead != framesToRead) { // Final incomplete buffer in the file
-      framesRead += obj->mSf.read(obj->mFileBuffer + framesRead, framesToRead - framesRead);
-      if (obj->mLoop) {
-        obj->mSf.seek(0, SEEK_SET);
-        std::atomic_fetch_add(&(obj->mRepeats), 1);
-      }
-    }
-    size_t written = obj->mRingBuffer->write((const char*) obj->mFileBuffer, framesRead * sizeof(float) * obj->channels());
-    //		if (written != framesRead * sizeof(float) * obj->channels()) {
-    //			// TODO handle overrun
-    //		}
-    if (obj->mReadCallback) {
-      obj->mReadCallback(obj->mFileBuffer, obj->mSf.channels(), framesRead, obj->mCallbackData);
-    }
-    lk.unlock();
+  return mStream != nullptr;
+}
+
+SoundFileStream::ReadCallback SoundFileBuffered::streamCallback()
+{
+  if (!mReadCallback) {
+    return nullptr;
   }
+  CallbackFunc func = mReadCallback;
+  void *userData = mCallbackData;
+  return [func, userData](float *buffer, int numChannels, int numFrames) {
+    func(buffer, numChannels, numFrames, userData);
+  };
 }
 
 gam::SoundFile::EncodingType SoundFileBuffered::encoding() const
 {
   if (opened()) {
-    return mSf.encoding();
+    return mStream->encoding();
   } else {
     return (gam::SoundFile::EncodingType) 0;
   }
@@ -106,7 +77,7 @@ gam::SoundFile::EncodingType SoundFileBuffered::encoding() const
 gam::SoundFile::Format SoundFileBuffered::format() const
 {
   if (opened()) {
-    return mSf.format();
+    return mStream->format();
   } else {
     return (gam::SoundFile::Format) 0;
   }
@@ -115,7 +86,7 @@ gam::SoundFile::Format SoundFileBuffered::format() const
 double SoundFileBuffered::frameRate() const
 {
   if (opened()) {
-    return mSf.frameRate();
+    return mStream->frameRate();
   } else {
     return 0.0;
   }
@@ -124,7 +95,7 @@ double SoundFileBuffered::frameRate() const
 int SoundFileBuffered::frames() const
 {
   if (opened()) {
-    return mSf.frames();
+    return int(mStream->frames());
   } else {
     return 0;
   }
@@ -133,7 +104,7 @@ int SoundFileBuffered::frames() const
 int SoundFileBuffered::channels() const
 {
   if (opened()) {
-    return mSf.channels();
+    return mStream->channels();
   } else {
     return 0;
   }
@@ -142,7 +113,7 @@ int SoundFileBuffered::channels() const
 int SoundFileBuffered::samples() const
 {
   if (opened()) {
-    return mSf.samples();
+    return int(mStream->frames()) * mStream->channels();
   } else {
     return 0;
   }
@@ -150,28 +121,49 @@ int SoundFileBuffered::samples() const
 
 int SoundFileBuffered::repeats()
 {
-  return mRepeats.load();
+  if (opened()) {
+    return mStream->repeats();
+  } else {
+    return 0;
+  }
+}
+
+int SoundFileBuffered::underruns()
+{
+  if (opened()) {
+    return int(mStream->underruns());
+  } else {
+    return 0;
+  }
 }
 
 void SoundFileBuffered::setReadCallback(SoundFileBuffered::CallbackFunc func, void *userData)
 {
   mReadCallback = func;
   mCallbackData = userData;
+  if (opened()) {
+    mStream->setReadCallback(streamCallback());
+  }
 }
 
 void SoundFileBuffered::seek(int frame)
 {
+  if (frame >= frames()) {
+    frame = frames() - 1;
+  }
   if (frame < 0) {
     frame = 0;
   }
-  if (frame >= frames()) {
-    frame = frames() - 1;
+  if (opened()) {
+    mStream->seek(uint64_t(frame));
   }
-  mSeek.store(frame);
-  mCurPos.store(frame);
 }
 
 int SoundFileBuffered::currentPosition()
 {
-  return mCurPos.load();
+  if (opened()) {
+    return int(mStream->position());
+  } else {
+    return 0;
+  }
 }
@@ -26,8 +26,7 @@ bool SoundFileBufferedRecord::open(std::string fullPath, double frameRate, uint3
   mSf.encoding(encoding);
   mBufferFrames = bufferFrames;
 
-  mRingBuffer = new SingleRWRingBuffer(mBufferFrames * numChannels * sizeof(float));
-  mFileBuffer = std::make_unique<float []>(mBufferFrames * numChannels);
+  mRingBuffer = new SPSCFrameRing<float>(mBufferFrames, numChannels);
   std::condition_variable cond;
   std::mutex condMutex;
   {
@@ -69,18 +68,10 @@ bool SoundFileBufferedRecord::close()
 
 void SoundFileBufferedRecord::write(std::vector<float *> buffers, size_t numFrames)
 {
-  size_t channel = 0;
-  // FIXME we should do the interleaving in the writing thread
   assert(buffers.size() == mSf.channels());
-  for(auto *buf: buffers) {
-    float *destBuf = mFileBuffer.get() + channel++;
-    for (size_t i = 0; i < numFrames; i++) {
-      *destBuf = *buf++;
-      destBuf += mSf.channels();
-    }
-  }
-  size_t bytesWritten = mRingBuffer->write((char *) mFileBuffer.get(), numFrames * mSf.channels() * sizeof(float));
-  if (bytesWritten != numFrames * mSf.channels() * sizeof(float)) {
+  // Interleaved directly into the ring
+  size_t framesWritten = mRingBuffer->writeChannels(buffers.data(), numFrames);
+  if (framesWritten != numFrames) {
     std::cerr << "Recording buffer overrun. Increase buffer size" << std::endl;
   }
   mCondVar.notify_one();
@@ -95,16 +86,23 @@ bool SoundFileBufferedRecord::opened() const
 void SoundFileBufferedRecord::writeFunction(SoundFileBufferedRecord  *obj, std::condition_variable *cond, std::mutex *condMutex)
 {
   obj->mRunning = true;
-  float *writeBuffer = new float[size_t(obj->mBufferFrames * obj->mSf.channels())];
   condMutex->lock();
   cond->notify_all(); // Signal thread is processing;
   condMutex->unlock();
   while (obj->mRunning) {
     std::unique_lock<std::mutex> lk(obj->mLock);
     obj->mCondVar.wait(lk);
-    int bytesToWrite = obj->mRingBuffer->read((char *) writeBuffer, obj->mSf.frameRate() * obj->mSf.channels() * sizeof(float));
-    int framesToWrite = bytesToWrite/(obj->mSf.channels() * sizeof(float));
-    int framesWritten = obj->mSf.write<float>(obj->mFileBuffer.get(), framesToWrite);
+    // Write straight from the ring, in two parts if the data wraps around
+    // the end
+    int framesWritten = 0;
+    for (int part = 0; part < 2; part++) {
+      auto span = obj->mRingBuffer->reserveRead(obj->mRingBuffer->capacity());
+      if (span.size == 0) {
+        break;
+      }
+      framesWritten += obj->mSf.write<float>(span.data, int(span.size));
+      obj->mRingBuffer->commitRead(span.size);
+    }
 //    std::cout << "Wrote " << framesWritten << std::endl;
     std::atomic_fetch_add(&(obj->mCurPos), framesWritten);
 
@@ -121,7 +119,6 @@ void SoundFileBufferedRecord::writeFunction(SoundFileBufferedRecord  *obj, std::
 //    }
     lk.unlock();
   }
-  delete[] writeBuffer;
 }
 
 //void SoundFileBufferedRecord::setWriteCallback(SoundFileBufferedRecord::CallbackFunc func, void *userData)
@@ -0,0 +1,500 @@
+#include "al_ext/soundfile/al_SoundfileStream.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+#if defined(AL_WINDOWS)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(AL_OSX)
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+
+using namespace al;
+
+namespace {
+
+uint64_t nextPowerOfTwo(uint64_t value) {
+  uint64_t power = 1;
+  while (power < value) {
+    power <<= 1;
+  }
+  return power;
+}
+
+// Counting semaphore. post() doesn't lock, so it can be called from the
+// audio thread.
+class Semaphore {
+public:
+#if defined(AL_WINDOWS)
+  Semaphore() { mSemaphore = CreateSemaphore(nullptr, 0, LONG_MAX, nullptr); }
+  ~Semaphore() { CloseHandle(mSemaphore); }
+  void post() { ReleaseSemaphore(mSemaphore, 1, nullptr); }
+  void wait() { WaitForSingleObject(mSemaphore, INFINITE); }
+private:
+  HANDLE mSemaphore;
+#elif defined(AL_OSX)
+  Semaphore() { mSemaphore = dispatch_semaphore_create(0); }
+  ~Semaphore() { dispatch_release(mSemaphore); }
+  void post() { dispatch_semaphore_signal(mSemaphore); }
+  void wait() { dispatch_semaphore_wait(mSemaphore, DISPATCH_TIME_FOREVER); }
+private:
+  dispatch_semaphore_t mSemaphore;
+#else
+  Semaphore() { sem_init(&mSemaphore, 0, 0); }
+  ~Semaphore() { sem_destroy(&mSemaphore); }
+  void post() { sem_post(&mSemaphore); }
+  void wait() {
+    while (sem_wait(&mSemaphore) != 0) {} // Interrupted by a signal
+  }
+private:
+  sem_t mSemaphore;
+#endif
+};
+
+}
+
+namespace al {
+
+// Ids of streams waiting for a reader thread. A bounded multi producer,
+// multi consumer queue that doesn't lock on push, and a semaphore counting
+// the queued ids that the reader threads sleep on. Reader threads move the
+// ids to SoundFileStreamPool's pending list, so an id can already have been
+// taken out of the queue when the semaphore wakes a thread for it.
+class SoundFileReadQueue {
+public:
+  explicit SoundFileReadQueue(size_t capacity) :
+    mCapacity(nextPowerOfTwo(std::max<size_t>(capacity, 2))),
+    mCells(new Cell[mCapacity])
+  {
+    for (size_t i = 0; i < mCapacity; i++) {
+      mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns false if the queue is full
+  bool push(uint64_t id) {
+    size_t position = mPushPosition.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell = &mCells[position & (mCapacity - 1)];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      if (sequence == position) {
+        if (mPushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (sequence < position) {
+        return false;
+      } else {
+        position = mPushPosition.load(std::memory_order_relaxed);
+      }
+    }
+    cell->id = id;
+    cell->sequence.store(position + 1, std::memory_order_release);
+    mQueued.post();
+    return true;
+  }
+
+  // Waits for an id to be pushed. Returns false when the queue is stopped
+  bool wait() {
+    mQueued.wait();
+    return mRunning.load();
+  }
+
+  void stop(size_t numThreads) {
+    mRunning.store(false);
+    for (size_t i = 0; i < numThreads; i++) {
+      mQueued.post();
+    }
+  }
+
+  // Returns false if the queue is empty or the next id is still being pushed
+  bool tryPop(uint64_t &id) {
+    size_t position = mPopPosition.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell = &mCells[position & (mCapacity - 1)];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      if (sequence == position + 1) {
+        if (mPopPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (sequence < position + 1) {
+        return false;
+      } else {
+        position = mPopPosition.load(std::memory_order_relaxed);
+      }
+    }
+    id = cell->id;
+    cell->sequence.store(position + mCapacity, std::memory_order_release);
+    return true;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    uint64_t id;
+  };
+
+  const size_t mCapacity;
+  std::unique_ptr<Cell[]> mCells;
+  char mPad0[64];
+  std::atomic<size_t> mPushPosition {0};
+  char mPad1[64];
+  std::atomic<size_t> mPopPosition {0};
+  char mPad2[64];
+  std::atomic<bool> mRunning {true};
+  Semaphore mQueued;
+};
+
+}
+
+SoundFileStream::~SoundFileStream()
+{
+  if (mSf.opened()) {
+    mSf.close();
+  }
+}
+
+bool SoundFileStream::openFile(std::string fileName, uint64_t bufferFrames, double bufferSeconds,
+                               uint64_t readFrames)
+{
+  mFileName = fileName;
+  mSf.path(fileName);
+  mSf.openRead();
+  if (!mSf.opened() || mSf.channels() <= 0) {
+    std::cerr << "SoundFileStream: Can't open " << fileName << std::endl;
+    return false;
+  }
+  mChannels = mSf.channels();
+  mFrameRate = mSf.frameRate();
+  mFrames = uint64_t(std::max(mSf.frames(), 0));
+  mEncoding = mSf.encoding();
+  mFormat = mSf.format();
+
+  if (bufferFrames == 0) {
+    // Leave room for at least two reads
+    bufferFrames = std::max(uint64_t(bufferSeconds * mFrameRate), 2 * readFrames);
+  }
+  mBufferFrames = nextPowerOfTwo(std::max<uint64_t>(bufferFrames, 2));
+  // A power of two, like the buffer, so reads at multiples of it are
+  // aligned to large blocks of the file's data
+  mReadFrames = std::min(nextPowerOfTwo(readFrames + 1) / 2, mBufferFrames / 2);
+  mBuffer.resize(mBufferFrames * mChannels);
+  mFilePosition = 0;
+  return true;
+}
+
+uint64_t SoundFileStream::read(float *buffer, uint64_t numFrames)
+{
+  if (mSeekDone.load(std::memory_order_acquire) != mSeekRequested) {
+    memset(buffer, 0, numFrames * mChannels * sizeof(float));
+    requestRead();
+    return 0;
+  }
+  uint64_t position = mPosition.load(std::memory_order_relaxed);
+  if (mSeekSkipped != mSeekRequested) {
+    // Drop frames from before the seek
+    mFramesRead.store(mSeekStartFrame.load(std::memory_order_relaxed), std::memory_order_release);
+    mSeekSkipped = mSeekRequested;
+    position = std::min(mSeekTarget, mFrames);
+  }
+  uint64_t readFrame = mFramesRead.load(std::memory_order_relaxed);
+  uint64_t available = mFramesWritten.load(std::memory_order_acquire) - readFrame;
+  uint64_t framesCopied = std::min(available, numFrames);
+
+  uint64_t start = readFrame & (mBufferFrames - 1);
+  uint64_t firstPart = std::min(framesCopied, mBufferFrames - start);
+  memcpy(buffer, mBuffer.data() + start * mChannels, firstPart * mChannels * sizeof(float));
+  memcpy(buffer + firstPart * mChannels, mBuffer.data(),
+         (framesCopied - firstPart) * mChannels * sizeof(float));
+  mFramesRead.store(readFrame + framesCopied, std::memory_order_release);
+
+  position += framesCopied;
+  if (position >= mFrames && mFrames > 0 && mLoop.load()) {
+    position %= mFrames;
+  }
+  mPosition.store(position, std::memory_order_relaxed);
+
+  if (framesCopied < numFrames) {
+    memset(buffer + framesCopied * mChannels, 0, (numFrames - framesCopied) * mChannels * sizeof(float));
+    if (readFrame + framesCopied != mEndFrame.load(std::memory_order_acquire)) {
+      mUnderruns++;
+    }
+  }
+  if (needsRead()) {
+    requestRead();
+  }
+  return framesCopied;
+}
+
+void SoundFileStream::seek(uint64_t frame)
+{
+  mSeekTarget = frame;
+  mSeekFrame.store(frame, std::memory_order_relaxed);
+  mSeekRequested++;
+  mSeekRequest.store(mSeekRequested, std::memory_order_release);
+  requestRead();
+}
+
+bool SoundFileStream::finished() const
+{
+  return mSeekDone.load(std::memory_order_acquire) == mSeekRequested
+      && mFramesRead.load(std::memory_order_relaxed) == mEndFrame.load(std::memory_order_acquire);
+}
+
+void SoundFileStream::setReadCallback(ReadCallback callback)
+{
+  std::unique_lock<std::mutex> lk(mCallbackLock);
+  mReadCallback = callback;
+}
+
+bool SoundFileStream::needsRead() const
+{
+  if (mSeekRequest.load(std::memory_order_acquire) != mSeekDone.load(std::memory_order_acquire)) {
+    return true;
+  }
+  if (mEndFrame.load(std::memory_order_acquire) != UINT64_MAX && !mLoop.load()) {
+    return false;
+  }
+  return mBufferFrames - bufferedFrames() >= mReadFrames;
+}
+
+double SoundFileStream::secondsBuffered() const
+{
+  if (mSeekRequest.load(std::memory_order_acquire) != mSeekDone.load(std::memory_order_acquire)
+      || mFrameRate <= 0) {
+    return 0;
+  }
+  return bufferedFrames() / mFrameRate;
+}
+
+void SoundFileStream::requestRead()
+{
+  if (!mQueue || mQueued.exchange(true)) {
+    return;
+  }
+  if (!mQueue->push(mId)) {
+    // Try again on the next read()
+    mQueued.store(false);
+  }
+}
+
+void SoundFileStream::fill()
+{
+  uint32_t seekRequest = mSeekRequest.load(std::memory_order_acquire);
+  if (seekRequest != mSeekHandled) {
+    uint64_t frame = std::min(mSeekFrame.load(std::memory_order_relaxed), mFrames);
+    mFilePosition = frame;
+    mEndFrame.store(UINT64_MAX, std::memory_order_relaxed);
+    // Frames before this point will be skipped, so their space is free
+    mSeekStartFrame.store(mFramesWritten.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    mSeekHandled = seekRequest;
+    mSf.seek(int(frame), SEEK_SET);
+    readFile();
+    // Only now, so read() finds data as soon as it leaves the seek
+    mSeekDone.store(seekRequest, std::memory_order_release);
+    return;
+  }
+  if (mFilePosition >= mFrames) {
+    if (!mLoop.load() || mFrames == 0) {
+      return;
+    }
+    mFilePosition = 0;
+    mEndFrame.store(UINT64_MAX, std::memory_order_relaxed);
+    mSf.seek(0, SEEK_SET);
+    mRepeats++;
+  }
+  readFile();
+}
+
+void SoundFileStream::readFile()
+{
+  uint64_t writeFrame = mFramesWritten.load(std::memory_order_relaxed);
+  uint64_t freeFrames = mBufferFrames - (writeFrame - readPosition());
+  // After a seek, read up to the next multiple of mReadFrames, so the
+  // following reads start aligned
+  uint64_t alignedFrames = mReadFrames - (mFilePosition & (mReadFrames - 1));
+  uint64_t framesToRead = std::min(std::min(alignedFrames, freeFrames), mFrames - mFilePosition);
+  uint64_t framesRead = 0;
+  // The file is read directly into the buffer, in two parts if the free
+  // space wraps around its end
+  while (framesRead < framesToRead) {
+    uint64_t index = (writeFrame + framesRead) & (mBufferFrames - 1);
+    int count = int(std::min(framesToRead - framesRead, mBufferFrames - index));
+    float *data = mBuffer.data() + index * mChannels;
+    int countRead = std::max(mSf.read(data, count), 0);
+    if (countRead > 0) {
+      std::unique_lock<std::mutex> lk(mCallbackLock);
+      if (mReadCallback) {
+        mReadCallback(data, mChannels, countRead);
+      }
+    }
+    framesRead += countRead;
+    mFilePosition += countRead;
+    if (countRead < count) {
+      // Treat read errors as the end of the file
+      mFilePosition = mFrames;
+      break;
+    }
+  }
+  mFramesWritten.store(writeFrame + framesRead, std::memory_order_release);
+
+  if (mFilePosition >= mFrames && !mLoop.load()) {
+    mEndFrame.store(writeFrame + framesRead, std::memory_order_release);
+  }
+}
+
+SoundFileStreamPool::SoundFileStreamPool(int numThreads, double bufferSeconds,
+                                         int readFrames, int maxStreams) :
+  mBufferSeconds(bufferSeconds),
+  mReadFrames(uint64_t(std::max(readFrames, 1))),
+  mMaxStreams(size_t(std::max(maxStreams, 1))),
+  // Closed streams can leave an id in the queue
+  mQueue(std::make_shared<SoundFileReadQueue>(2 * mMaxStreams))
+{
+  mPendingIds.reserve(2 * mMaxStreams);
+  for (int i = 0; i < std::max(numThreads, 1); i++) {
+    mThreads.emplace_back(&SoundFileStreamPool::readerFunction, this);
+  }
+}
+
+SoundFileStreamPool::~SoundFileStreamPool()
+{
+  mQueue->stop(mThreads.size());
+  for (auto &thread : mThreads) {
+    thread.join();
+  }
+  std::unique_lock<std::mutex> lk(mStreamsLock);
+  for (auto &entry : mStreams) {
+    entry.second->setReadCallback(nullptr);
+  }
+}
+
+std::shared_ptr<SoundFileStream> SoundFileStreamPool::open(std::string fileName, int bufferFrames,
+                                                           SoundFileStream::ReadCallback callback)
+{
+  std::shared_ptr<SoundFileStream> stream(new SoundFileStream);
+  if (!stream->openFile(fileName, uint64_t(std::max(bufferFrames, 0)), mBufferSeconds, mReadFrames)) {
+    return nullptr;
+  }
+  stream->mReadCallback = callback;
+  // Fill the buffer here so the stream can be played straight away
+  while (stream->needsRead() && stream->mFilePosition < stream->mFrames) {
+    stream->fill();
+  }
+  {
+    std::unique_lock<std::mutex> lk(mStreamsLock);
+    if (mStreams.size() >= mMaxStreams) {
+      std::cerr << "SoundFileStreamPool: Can't open more than " << mMaxStreams << " streams" << std::endl;
+      return nullptr;
+    }
+    stream->mId = mNextId++;
+    stream->mQueue = mQueue;
+    mStreams[stream->mId] = stream;
+  }
+  return stream;
+}
+
+void SoundFileStreamPool::close(std::shared_ptr<SoundFileStream> stream)
+{
+  if (!stream) {
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lk(mStreamsLock);
+    mStreams.erase(stream->mId);
+  }
+  // Waits for a callback in progress
+  stream->setReadCallback(nullptr);
+}
+
+size_t SoundFileStreamPool::numStreams()
+{
+  std::unique_lock<std::mutex> lk(mStreamsLock);
+  return mStreams.size();
+}
+
+uint64_t SoundFileStreamPool::underruns()
+{
+  std::unique_lock<std::mutex> lk(mStreamsLock);
+  uint64_t total = 0;
+  for (auto &entry : mStreams) {
+    total += entry.second->underruns();
+  }
+  return total;
+}
+
+std::shared_ptr<SoundFileStreamPool> SoundFileStreamPool::defaultPool()
+{
+  // Players hold a reference, so the pool outlives static players
+  static std::shared_ptr<SoundFileStreamPool> pool = std::make_shared<SoundFileStreamPool>(2);
+  return pool;
+}
+
+void SoundFileStreamPool::readerFunction()
+{
+  while (mQueue->wait()) {
+    std::shared_ptr<SoundFileStream> stream;
+    {
+      std::unique_lock<std::mutex> lk(mStreamsLock);
+      // Each wake up takes one id from mPendingIds. The id it was woken for
+      // may still be in the queue, behind one that is being pushed
+      uint64_t id;
+      while (true) {
+        while (mQueue->tryPop(id)) {
+          mPendingIds.push_back(id);
+        }
+        if (!mPendingIds.empty()) {
+          break;
+        }
+        lk.unlock();
+        std::this_thread::yield();
+        lk.lock();
+      }
+      stream = nextStream();
+    }
+    if (!stream) {
+      continue; // Closed
+    }
+    stream->fill();
+    // An exchange, so changes made by read() before it found the stream
+    // queued are seen below
+    stream->mQueued.exchange(false);
+    // read() may have made more room while the stream was being filled
+    if (stream->needsRead()) {
+      stream->requestRead();
+    }
+  }
+}
+
+std::shared_ptr<SoundFileStream> SoundFileStreamPool::nextStream()
+{
+  size_t next = 0;
+  double nextSeconds = 0;
+  std::shared_ptr<SoundFileStream> stream;
+  for (size_t i = 0; i < mPendingIds.size(); i++) {
+    auto entry = mStreams.find(mPendingIds[i]);
+    if (entry == mStreams.end()) {
+      // Closed, drop the id instead of filling a stream
+      next = i;
+      stream = nullptr;
+      break;
+    }
+    double seconds = entry->second->secondsBuffered();
+    if (!stream || seconds < nextSeconds) {
+      next = i;
+      nextSeconds = seconds;
+      stream = entry->second;
+    }
+  }
+  mPendingIds[next] = mPendingIds.back();
+  mPendingIds.pop_back();
+  return stream;
+}
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "al_ext/soundfile/al_SoundfileBuffered.hpp"
+#include "al_ext/soundfile/al_SoundfileStream.hpp"
+
+#include "Gamma/SoundFile.h"
+
+#define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
+#include "catch.hpp"
+
+using namespace std;
+
+// 16 bit WAV where sample i of channel c is (i % 16384) * (c ? -2 : 2)
+static void writeTestFile(const char *name, int frames, int channels) {
+  gam::SoundFile sf;
+  sf.format(gam::SoundFile::WAV);
+  sf.encoding(gam::SoundFile::PCM_16);
+  sf.channels(channels);
+  sf.frameRate(48000);
+  sf.openWrite(name);
+  vector<float> samples(frames * channels);
+  for (int i = 0; i < frames; i++) {
+    for (int c = 0; c < channels; c++) {
+      samples[i * channels + c] = int(i % 16384) * (c ? -2 : 2) / 32768.0f;
+    }
+  }
+  sf.write<float>(samples.data(), frames);
+  sf.close();
+}
+
+static float expectedSample(uint64_t frame, int channel) {
+  return int(frame % 16384) * (channel ? -2 : 2) / 32768.0f;
+}
+
+TEST_CASE( "Reading, seeking and looping", "[SoundFileStream]" ) {
+  const char *name = "test_soundfileStream.wav";
+  const uint64_t numFrames = 100000;
+  writeTestFile(name, int(numFrames), 2);
+
+  // Small buffers, so the stream is queued for the reader threads often
+  al::SoundFileStreamPool pool(2, 0.1, 1000);
+  REQUIRE(pool.open("missing.wav") == nullptr);
+  auto stream = pool.open(name);
+  REQUIRE(stream);
+  REQUIRE(stream->channels() == 2);
+  REQUIRE(stream->frameRate() == 48000);
+  REQUIRE(stream->frames() == numFrames);
+  REQUIRE(stream->bufferedFrames() > 0);
+
+  vector<float> buffer(256 * 2);
+  // Read from the stream, waiting for data like a slow audio callback
+  auto readBlock = [&](uint64_t framesNeeded) {
+    while (stream->bufferedFrames() < framesNeeded) {
+      this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return stream->read(buffer.data(), 256);
+  };
+
+  uint64_t frame = 0;
+  bool samplesMatch = true;
+  while (frame < numFrames) {
+    uint64_t framesRead = readBlock(std::min<uint64_t>(256, numFrames - frame));
+    for (uint64_t i = 0; i < framesRead; i++) {
+      samplesMatch &= buffer[2 * i] == expectedSample(frame + i, 0);
+      samplesMatch &= buffer[2 * i + 1] == expectedSample(frame + i, 1);
+    }
+    frame += framesRead;
+    if (framesRead == 0) {
+      break;
+    }
+  }
+  REQUIRE(samplesMatch);
+  REQUIRE(frame == numFrames);
+  REQUIRE(stream->position() == numFrames);
+  REQUIRE(stream->finished());
+  REQUIRE(stream->read(buffer.data(), 256) == 0);
+  REQUIRE(stream->underruns() == 0);
+
+  // Seek back. Nothing is read until the stream has moved
+  stream->seek(5000);
+  REQUIRE_FALSE(stream->finished());
+  uint64_t framesRead = 0;
+  while ((framesRead = stream->read(buffer.data(), 256)) == 0) {
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+  REQUIRE(buffer[0] == expectedSample(5000, 0));
+  REQUIRE(buffer[2 * (framesRead - 1) + 1] == expectedSample(5000 + framesRead - 1, 1));
+  REQUIRE(stream->position() == 5000 + framesRead);
+
+  // Loop across the end of the file
+  stream->setLoop(true);
+  stream->seek(numFrames - 100);
+  while (stream->read(buffer.data(), 50) == 0) {
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+  REQUIRE(buffer[0] == expectedSample(numFrames - 100, 0));
+  REQUIRE(readBlock(256) == 256);
+  REQUIRE(buffer[0] == expectedSample(numFrames - 50, 0));
+  REQUIRE(buffer[2 * 50] == expectedSample(0, 0));
+  REQUIRE(buffer[2 * 255 + 1] == expectedSample(205, 1));
+  REQUIRE(stream->position() == 206);
+  REQUIRE(stream->repeats() == 1);
+  REQUIRE_FALSE(stream->finished());
+
+  // Reading faster than the pool refills is an underrun
+  stream->setLoop(false);
+  uint64_t underruns = stream->underruns();
+  vector<float> large(stream->bufferFrames() * 4);
+  stream->read(large.data(), stream->bufferFrames() * 2);
+  REQUIRE(stream->underruns() == underruns + 1);
+
+  pool.close(stream);
+  REQUIRE(pool.numStreams() == 0);
+  stream = nullptr;
+  std::remove(name);
+}
+
+TEST_CASE( "Many streams share the reader threads", "[SoundFileStream]" ) {
+  const char *name = "test_soundfileStreams.wav";
+  const uint64_t numFrames = 20000;
+  writeTestFile(name, int(numFrames), 1);
+
+  al::SoundFileStreamPool pool(2, 0.05, 512, 64);
+  vector<shared_ptr<al::SoundFileStream>> streams;
+  for (int i = 0; i < 64; i++) {
+    streams.push_back(pool.open(name));
+    REQUIRE(streams.back());
+    streams.back()->seek(uint64_t(i) * 300);
+  }
+  REQUIRE_FALSE(pool.open(name)); // maxStreams reached
+
+  vector<float> buffer(64);
+  vector<uint64_t> positions(streams.size(), 0);
+  bool samplesMatch = true;
+  for (int block = 0; block < 200; block++) {
+    for (size_t i = 0; i < streams.size(); i++) {
+      uint64_t framesRead = streams[i]->read(buffer.data(), 64);
+      if (framesRead > 0 && positions[i] == 0) {
+        positions[i] = i * 300;
+      }
+      for (uint64_t f = 0; f < framesRead; f++) {
+        samplesMatch &= buffer[f] == expectedSample(positions[i] + f, 0);
+      }
+      positions[i] += framesRead;
+    }
+    this_thread::sleep_for(chrono::microseconds(500));
+  }
+  REQUIRE(samplesMatch);
+  for (size_t i = 0; i < streams.size(); i++) {
+    REQUIRE(streams[i]->position() == positions[i]);
+    pool.close(streams[i]);
+  }
+  std::remove(name);
+}
+
+TEST_CASE( "Streams closest to running out are read first", "[SoundFileStream]" ) {
+  const char *name = "test_soundfilePriority.wav";
+  writeTestFile(name, 48000, 1);
+
+  mutex lock;
+  condition_variable released;
+  bool blocking = false;
+  vector<char> fillOrder;
+  auto recordFill = [&](char streamName) {
+    return [&, streamName](float *, int, int) {
+      unique_lock<mutex> lk(lock);
+      fillOrder.push_back(streamName);
+      released.wait(lk, [&]() { return !blocking; });
+    };
+  };
+
+  // One reader thread, kept busy by the blocker while the others are queued
+  al::SoundFileStreamPool pool(1, 0, 1024);
+  auto blocker = pool.open(name, 4096, recordFill('x'));
+  auto full = pool.open(name, 4096, recordFill('a'));
+  auto low = pool.open(name, 4096, recordFill('b'));
+  REQUIRE(blocker);
+  REQUIRE(full);
+  REQUIRE(low);
+  {
+    unique_lock<mutex> lk(lock);
+    blocking = true;
+    fillOrder.clear();
+  }
+  blocker->seek(0);
+  while (true) {
+    unique_lock<mutex> lk(lock);
+    if (!fillOrder.empty()) {
+      break;
+    }
+    lk.unlock();
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+
+  // full is queued first, but low has fewer frames left
+  vector<float> buffer(4096);
+  REQUIRE(full->read(buffer.data(), 1024) == 1024);
+  REQUIRE(low->read(buffer.data(), 3072) == 3072);
+  {
+    unique_lock<mutex> lk(lock);
+    blocking = false;
+  }
+  released.notify_all();
+  while (full->bufferedFrames() < 4096 || low->bufferedFrames() < 4096) {
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+  {
+    unique_lock<mutex> lk(lock);
+    auto firstLow = find(fillOrder.begin(), fillOrder.end(), 'b');
+    auto firstFull = find(fillOrder.begin(), fillOrder.end(), 'a');
+    REQUIRE(firstLow < firstFull);
+  }
+  pool.close(blocker);
+  pool.close(full);
+  pool.close(low);
+  std::remove(name);
+}
+
+TEST_CASE( "SoundFileBuffered plays through the shared pool", "[SoundFileBuffered]" ) {
+  const char *name = "test_soundfileBuffered.wav";
+  const int numFrames = 3000;
+  writeTestFile(name, numFrames, 2);
+
+  std::atomic<int> callbackFrames(0);
+  al::SoundFileBuffered soundFile(std::string(), true, 1024);
+  soundFile.setReadCallback([](float *, int numChannels, int numFrames, void *userData) {
+    *static_cast<std::atomic<int> *>(userData) += numFrames * numChannels / 2;
+  }, &callbackFrames);
+  REQUIRE(soundFile.open(name));
+  REQUIRE(soundFile.channels() == 2);
+  REQUIRE(soundFile.frames() == numFrames);
+  REQUIRE(soundFile.samples() == numFrames * 2);
+
+  vector<float> buffer(128 * 2);
+  int frame = 0;
+  bool samplesMatch = true;
+  while (soundFile.repeats() < 2) {
+    size_t framesRead = soundFile.read(buffer.data(), 128);
+    for (size_t i = 0; i < framesRead; i++) {
+      samplesMatch &= buffer[2 * i + 1] == expectedSample((frame + i) % numFrames, 1);
+    }
+    frame += int(framesRead);
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+  REQUIRE(samplesMatch);
+  REQUIRE(soundFile.currentPosition() == frame % numFrames);
+  REQUIRE(callbackFrames.load() >= frame);
+  REQUIRE(soundFile.underruns() == 0);
+  soundFile.close();
+  REQUIRE_FALSE(soundFile.opened());
+  std::remove(name);
+}
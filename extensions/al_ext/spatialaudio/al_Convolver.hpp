@@ -1,9 +1,12 @@
 #ifndef AL_CONVOLVER_H
 #define AL_CONVOLVER_H
 
+#include <atomic>
 #include <vector>
 #include <map>
 
+#include "al/core/types/al_AtomicHandoff.hpp"
+
 #define MAXSIZE 0x00100000
 
 class Convproc;
@@ -17,6 +20,11 @@ using namespace std;
   *
   * Built on zita convolver, which implements a realtime multithreaded multichannel convolution algorithm using non-uniform partitioning.
   *
+  * IRs and routing can be replaced while processing with swapIRs(). A second
+  * zita engine is prepared with the new IRs outside the audio thread, and
+  * processBuffer() crossfades from the current engine to it. The audio thread
+  * never reconfigures or allocates.
+  *
   */
 
 class Convolver
@@ -24,6 +32,10 @@ class Convolver
 
 public:
   Convolver();
+  ~Convolver();
+
+  Convolver(const Convolver &) = delete;
+  Convolver &operator=(const Convolver &) = delete;
 
   /// @brief Sets up convolver. Must be called prior to processing.
   ///
@@ -51,6 +63,32 @@ public:
                  uint32_t basePartitionSize = 64, float density = 0.0f,
                  uint32_t options = 0);
 
+  /// @brief Replace the IRs and routing, crossfading from the current ones
+  ///
+  /// A second convolution engine is set up and started on the calling thread,
+  /// with the buffer size, partition size, density and options given to
+  /// configure(). The next processBuffer() starts a linear crossfade to it
+  /// over crossfadeFrames, running both engines until it ends. The new engine
+  /// only gets input from the start of the crossfade, so the tails of the new
+  /// IRs build up during it.
+  ///
+  /// Don't call from the audio thread. If called again before processBuffer()
+  /// has started the crossfade, the previous IRs are dropped without being
+  /// heard. The replaced engine is deleted by the next call or the destructor.
+  ///
+  /// @param[in] IRs The deinterleaved IR channels. Must be as many as in configure()
+  /// @param[in] IRlength The size of IRs
+  /// @param[in] channelRoutingMap Map of input to output channels. Must have as many inputs as in configure()
+  /// @param[in] crossfadeFrames Length of the crossfade
+  /// @return Returns true upon success
+  bool swapIRs(vector<float *> IRs, uint32_t IRlength,
+               map<uint32_t, vector<uint32_t> > channelRoutingMap,
+               uint32_t crossfadeFrames = 1024);
+
+  /// @brief true while crossfading to new IRs, or new IRs are waiting
+  bool crossfading() const { return mCrossfading.load() || mEngines.pending(); }
+
+  /// @brief Input buffer of ioBufferSize samples, filled before processBuffer()
   float *getInputBuffer(unsigned int index);
 
   float *getOutputBuffer(unsigned int index);
@@ -62,6 +100,12 @@ public:
   bool shutdown(void);
 
 private:
+  struct Engine;
+
+  /// Set up and start a zita engine. Returns nullptr on error
+  Engine *createEngine(vector<float *> &IRs, uint32_t IRlength,
+                       map<uint32_t, vector<uint32_t>> &channelRoutingMap);
+
   vector<unsigned int> m_activeChannels;
   vector<unsigned int> m_disabledChannels;
   int m_inputChannel;
@@ -73,7 +117,22 @@ private:
   uint32_t mIRlength;
   map<uint32_t, vector<uint32_t>> mChannelMap;
 
-  Convproc *m_Convproc;
+  uint32_t mBasePartitionSize;
+  float mDensity;
+  uint32_t mOptions;
+
+  // Copied to and from the engines by processBuffer(), so the pointers stay
+  // the same across a swap
+  vector<vector<float>> mInputBuffers;
+  vector<vector<float>> mOutputBuffers;
+
+  // Audio thread
+  Engine *mEngine;
+  Engine *mNextEngine;
+  uint32_t mCrossfadePosition;
+
+  AtomicHandoff<Engine> mEngines; // New engines and the ones replaced
+  std::atomic<bool> mCrossfading;
 };
 
 }
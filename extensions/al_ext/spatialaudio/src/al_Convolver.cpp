@@ -16,9 +16,25 @@
 
 using namespace al;
 
+struct Convolver::Engine {
+  Convproc convproc;
+  uint32_t crossfadeFrames {0};
+  Engine *next {nullptr}; // For AtomicHandoff
+};
+
 Convolver::Convolver() :
-  m_Convproc(nullptr)
+  mEngine(nullptr),
+  mNextEngine(nullptr),
+  mCrossfadePosition(0),
+  mCrossfading(false)
+{
+}
+
+Convolver::~Convolver()
 {
+  delete mEngine;
+  delete mNextEngine;
+  mEngines.clear();
 }
 
 bool Convolver::configure(unsigned int ioBufferSize,
@@ -36,76 +52,170 @@ bool Convolver::configure(unsigned int ioBufferSize,
     std::cerr << "ERROR Convolver not properly configured" << std::endl;
     return false;
   }
-  for (auto mapEntry: mChannelMap) {
+  if (basePartitionSize < ioBufferSize) {
+    basePartitionSize = ioBufferSize;
+    std::cout << "setting base partition size to ioBufferSize" <<std::endl;
+  }
+  mBasePartitionSize = basePartitionSize;
+  mDensity = density;
+  mOptions = options;
+
+  delete mEngine;
+  delete mNextEngine;
+  mNextEngine = nullptr;
+  mCrossfading = false;
+  mEngines.clear();
+  mEngine = createEngine(mIRs, mIRlength, mChannelMap);
+  if (!mEngine) {
+    return false;
+  }
+  mInputBuffers.assign(mNumInputs, vector<float>(mBufferSize, 0.0f));
+  mOutputBuffers.assign(mIRs.size(), vector<float>(mBufferSize, 0.0f));
+  return true;
+}
+
+bool Convolver::swapIRs(vector<float *> IRs, uint32_t IRlength,
+                        map<uint32_t, vector<uint32_t>> channelRoutingMap,
+                        uint32_t crossfadeFrames)
+{
+  if (!mEngine) {
+    std::cerr << "ERROR Convolver: configure() must be called before swapIRs()" << std::endl;
+    return false;
+  }
+  if (IRs.size() != mIRs.size() || channelRoutingMap.size() != mNumInputs) {
+    std::cerr << "ERROR Convolver: swapIRs() needs as many IRs and inputs as configure()" << std::endl;
+    return false;
+  }
+  Engine *engine = createEngine(IRs, IRlength, channelRoutingMap);
+  if (!engine) {
+    return false;
+  }
+  engine->crossfadeFrames = crossfadeFrames;
+  mEngines.publish(engine);
+  return true;
+}
+
+Convolver::Engine *Convolver::createEngine(vector<float *> &IRs, uint32_t IRlength,
+                                           map<uint32_t, vector<uint32_t>> &channelRoutingMap)
+{
+  for (auto mapEntry: channelRoutingMap) {
     for (auto outputIndex: mapEntry.second) {
       if (outputIndex >= IRlength) {
         std::cerr << "ERROR Convolver: invalid IR index " << outputIndex << std::endl;
-        return false;
+        return nullptr;
       }
     }
   }
-  if (basePartitionSize < ioBufferSize) {
-    basePartitionSize = ioBufferSize;
-    std::cout << "setting base partition size to ioBufferSize" <<std::endl;
-  }
 
-  if(m_Convproc != nullptr) {
-    delete m_Convproc;
-  }
-  m_Convproc = new Convproc;
-  m_Convproc->set_options(options);
+  Engine *engine = new Engine;
+  Convproc &convproc = engine->convproc;
+  convproc.set_options(mOptions);
 
-  int configResult = m_Convproc->configure(channelRoutingMap.size(), mIRs.size(),
-                                           mIRlength, mBufferSize,
-                                           basePartitionSize, (mIRlength/2 < Convproc::MAXPART)?mIRlength:Convproc::MAXPART,
-                                           density);
+  int configResult = convproc.configure(channelRoutingMap.size(), IRs.size(),
+                                        IRlength, mBufferSize,
+                                        mBasePartitionSize, (IRlength/2 < Convproc::MAXPART)?IRlength:Convproc::MAXPART,
+                                        mDensity);
   if(configResult != 0){
     std::cerr << "ERROR convolution config failed" << std::endl;
-    m_Convproc->cleanup();
-    return false;
+    delete engine;
+    return nullptr;
   }
-  for (auto &routing: mChannelMap) {
+  for (auto &routing: channelRoutingMap) {
     for (auto outputIndex: routing.second) {
-      if (m_Convproc->impdata_create(routing.first, outputIndex, 1, IRs[outputIndex], 0, IRlength) != 0) {
+      if (convproc.impdata_create(routing.first, outputIndex, 1, IRs[outputIndex], 0, IRlength) != 0) {
         std::cerr << "ERROR setting convolution engine routing" << std::endl;
-        m_Convproc->cleanup();
-        return false;
+        delete engine;
+        return nullptr;
       }
     }
   }
-  if (m_Convproc->start_process(0, 0) != 0) {
-    m_Convproc->cleanup();
+  if (convproc.start_process(0, 0) != 0) {
     std::cerr << "ERROR starting convolution engine" << std::endl;
-    return false;
+    delete engine;
+    return nullptr;
   }
-  return true;
+  return engine;
 }
 
 float *Convolver::getInputBuffer(unsigned int index) {
-  return m_Convproc->inpdata(index);
+  return mInputBuffers[index].data();
 }
 
 float *Convolver::getOutputBuffer(unsigned int index)
 {
-  return m_Convproc->outdata(index);
+  return mOutputBuffers[index].data();
 }
 
 bool Convolver::processBuffer()
 {
-  //process
-  // TODO to sync or not to sync...
-  return m_Convproc->process(true) == 0;
+  if (!mEngine) {
+    return false;
+  }
+  if (!mNextEngine) {
+    Engine *pending = mEngines.take();
+    if (pending) {
+      mNextEngine = pending;
+      mCrossfadePosition = 0;
+      mCrossfading = true;
+    }
+  }
+  size_t bytes = mBufferSize * sizeof(float);
+  bool ok = true;
+  for (Engine *engine: {mEngine, mNextEngine}) {
+    if (!engine) {
+      continue;
+    }
+    for (size_t i = 0; i < mNumInputs; i++) {
+      memcpy(engine->convproc.inpdata(i), mInputBuffers[i].data(), bytes);
+    }
+    //process
+    // TODO to sync or not to sync...
+    ok &= engine->convproc.process(true) == 0;
+  }
+
+  for (size_t o = 0; o < mOutputBuffers.size(); o++) {
+    float *out = mOutputBuffers[o].data();
+    const float *current = mEngine->convproc.outdata(o);
+    if (!mNextEngine) {
+      memcpy(out, current, bytes);
+      continue;
+    }
+    const float *next = mNextEngine->convproc.outdata(o);
+    uint32_t crossfadeFrames = mNextEngine->crossfadeFrames;
+    for (uint32_t n = 0; n < mBufferSize; n++) {
+      uint32_t position = mCrossfadePosition + n;
+      float gain = position < crossfadeFrames ? float(position) / crossfadeFrames : 1.0f;
+      out[n] = current[n] + gain * (next[n] - current[n]);
+    }
+  }
+
+  if (mNextEngine) {
+    mCrossfadePosition += mBufferSize;
+    if (mCrossfadePosition >= mNextEngine->crossfadeFrames) {
+      mEngines.retire(mEngine);
+      mEngine = mNextEngine;
+      mNextEngine = nullptr;
+      mCrossfading = false;
+    }
+  }
+  return ok;
 }
 
 bool Convolver::shutdown(void){
-  if(m_Convproc->stop_process() != 0){
+  delete mNextEngine;
+  mNextEngine = nullptr;
+  mCrossfading = false;
+  mEngines.clear();
+  if (!mEngine) {
+    return false;
+  }
+  if(mEngine->convproc.stop_process() != 0){
     cerr << "Warning: could not stop process" << endl;
     return false;
   }
-  if(m_Convproc->cleanup() != 0){
+  if(mEngine->convproc.cleanup() != 0){
     cerr << "Warning: cleanup failed" << endl;
     return false;
   }
   return true;
 }
-
@@ -121,6 +121,73 @@ TEST_CASE( "One to many", "[convolver]" ) {
   conv.shutdown();
 }
 
+TEST_CASE( "IR swap crossfade", "[convolver]" ) {
+  al::Convolver conv;
+  const int numBlocks = 24;
+  const int swapBlock = 8;
+  const uint32_t crossfadeFrames = 3 * BLOCK_SIZE + 10;
+
+  // Decaying noise IRs and input
+  unsigned int seed = 1;
+  auto noise = [&]() {
+    seed = seed * 1664525u + 1013904223u;
+    return float(seed >> 8) / float(1 << 24) - 0.5f;
+  };
+  vector<vector<float>> oldIRs(2, vector<float>(IR_SIZE, 0.0f));
+  vector<vector<float>> newIRs(2, vector<float>(IR_SIZE, 0.0f));
+  for (int i = 0; i < IR_SIZE; i++) {
+    for (int c = 0; c < 2; c++) {
+      oldIRs[c][i] = noise() * exp(-i / 100.0f);
+      newIRs[c][i] = noise() * exp(-i / 300.0f);
+    }
+  }
+  vector<float> input(numBlocks * BLOCK_SIZE);
+  for (auto &sample : input) {
+    sample = noise();
+  }
+
+  REQUIRE(conv.configure(BLOCK_SIZE, {oldIRs[0].data(), oldIRs[1].data()}, IR_SIZE, {{0,{0, 1}}}));
+  REQUIRE_FALSE(conv.swapIRs({newIRs[0].data()}, IR_SIZE, {{0,{0}}}));
+  vector<vector<float>> output(2, vector<float>(input.size()));
+  for (int block = 0; block < numBlocks; block++) {
+    if (block == swapBlock) {
+      REQUIRE(conv.swapIRs({newIRs[0].data(), newIRs[1].data()}, IR_SIZE, {{0,{0, 1}}},
+                           crossfadeFrames));
+      REQUIRE(conv.crossfading());
+    }
+    memcpy(conv.getInputBuffer(0), input.data() + block * BLOCK_SIZE, sizeof(float) * BLOCK_SIZE);
+    REQUIRE(conv.processBuffer());
+    for (int c = 0; c < 2; c++) {
+      memcpy(output[c].data() + block * BLOCK_SIZE, conv.getOutputBuffer(c), sizeof(float) * BLOCK_SIZE);
+    }
+  }
+  REQUIRE_FALSE(conv.crossfading());
+
+  // The new IRs only get the input from the start of the crossfade
+  int swapFrame = swapBlock * BLOCK_SIZE;
+  float maxError = 0.0f;
+  for (int c = 0; c < 2; c++) {
+    for (int n = 0; n < int(input.size()); n++) {
+      float oldOutput = 0.0f;
+      float newOutput = 0.0f;
+      for (int k = 0; k <= n && k < IR_SIZE; k++) {
+        oldOutput += oldIRs[c][k] * input[n - k];
+        if (n - k >= swapFrame) {
+          newOutput += newIRs[c][k] * input[n - k];
+        }
+      }
+      float expected = oldOutput;
+      if (n >= swapFrame) {
+        float gain = std::min(float(n - swapFrame) / crossfadeFrames, 1.0f);
+        expected = oldOutput + gain * (newOutput - oldOutput);
+      }
+      maxError = std::max(maxError, fabs(output[c][n] - expected));
+    }
+  }
+  REQUIRE(maxError < 1e-4f);
+  conv.shutdown();
+}
+
 //TEST_CASE( "Vector mode", "[convolver]" ) {
 //  al::Convolver conv;
 //  al::AudioIO io(BLOCK_SIZE, 44100.0, NULL, NULL, 2, 2, al::AudioIO::DUMMY);
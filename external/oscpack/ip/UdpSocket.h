@@ -113,6 +113,10 @@ public:
 	// Retrieve the local endpoint name when sending to 'to'
 	IpEndpointName LocalEndpointFor( const IpEndpointName& remoteEndpoint ) const;
 
+	// Retrieve the local endpoint the socket is bound to, which tells
+	// the port picked by the system after binding to port 0
+	IpEndpointName LocalEndpoint() const;
+
 	// Connect to a remote endpoint which is used as the target
 	// for calls to Send()
 	void Connect( const IpEndpointName& remoteEndpoint );	
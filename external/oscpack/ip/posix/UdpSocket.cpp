@@ -143,6 +143,20 @@ public:
 #endif
 	}
 
+	IpEndpointName LocalEndpoint() const
+	{
+		assert( isBound_ );
+
+        struct sockaddr_in sockAddr;
+        std::memset( (char *)&sockAddr, 0, sizeof(sockAddr ) );
+        socklen_t length = sizeof(sockAddr);
+        if (getsockname(socket_, (struct sockaddr *)&sockAddr, &length) < 0) {
+            throw std::runtime_error("unable to getsockname\n");
+        }
+
+		return IpEndpointNameFromSockaddr( sockAddr );
+	}
+
 	IpEndpointName LocalEndpointFor( const IpEndpointName& remoteEndpoint ) const
 	{
 		assert( isBound_ );
@@ -274,6 +288,11 @@ IpEndpointName UdpSocket::LocalEndpointFor( const IpEndpointName& remoteEndpoint
 	return impl_->LocalEndpointFor( remoteEndpoint );
 }
 
+IpEndpointName UdpSocket::LocalEndpoint() const
+{
+	return impl_->LocalEndpoint();
+}
+
 void UdpSocket::Connect( const IpEndpointName& remoteEndpoint )
 {
 	impl_->Connect( remoteEndpoint );
@@ -61,6 +61,7 @@
 			This code is public domain.
 */
 
+#include <functional>
 #include <map>
 #include <unordered_map>
 #include <vector>
@@ -158,6 +159,15 @@ public:
 	/// Set whether to normalize normals (if being computed)
 	Isosurface& normalize(bool v){ mNormalize=v; return *this; }
 
+	/// Set number of threads used by generate(). 0 uses one per hardware thread
+	Isosurface& numThreads(unsigned v){ mNumThreads=v; return *this; }
+
+	/// Get number of threads used by generate()
+	unsigned numThreads() const { return mNumThreads; }
+
+	/// Set whether generate() skips blocks of cells that are all inside or outside the surface
+	Isosurface& skipEmptyBlocks(bool v){ mSkipEmptyBlocks=v; return *this; }
+
 
 	/// Begin cell-at-a-time mode
 	void begin();
@@ -189,6 +199,12 @@ public:
 
 
 	/// Generate isosurface from scalar field
+
+	/// The field is split into slabs of cell layers along z that are
+	/// extracted in parallel. The result is the same for any number of
+	/// threads, and the same as adding all cells from the highest z layer to
+	/// the lowest between begin() and end(). The vertex action is called from
+	/// the calling thread once all slabs are done.
 	template <class T>
 	void generate(const T * scalarField);
 
@@ -239,6 +255,27 @@ protected:
 
 	typedef std::unordered_map<int, int, IsosurfaceHashInt> EdgeToVertex;
 
+	// Range of cell layers [z0, z1) extracted by one thread in generate()
+	struct Slab {
+		int z0, z1;
+		std::vector<Vertex> positions;
+		std::vector<EdgeVertex> edgeVertices;	// only kept if there is a vertex action
+		std::vector<Index> indices;				// slab vertex or seam edge indices
+		std::vector<int> seam;					// slab vertex indices of x and y edges at z0
+	};
+
+	// Slab vertex indices of the edges around the cell layer being extracted
+	struct EdgeCache {
+		std::vector<int> planes[2];				// x and y edges at z and z+1
+		std::vector<int> zEdges;				// z edges between them
+		std::vector<int> touched[3];			// entries set in the arrays above
+		int upper;								// index of plane at z+1
+		bool upperIsSeam;						// whether plane at z+1 belongs to the slab above
+	};
+
+	// Indices to edges on the lower plane of the slab above have this bit set
+	static const Index seamEdge = 0x80000000u;
+
 	EdgeToVertex mEdgeToVertex;					// map from edge ID to vertex
 	al::Buffer<EdgeTriangle> mEdgeTriangles;	// surface triangles in terms of edge IDs
 
@@ -254,11 +291,25 @@ protected:
 	bool mComputeNormals;		// whether to compute normals
 	bool mNormalize;			// whether to normalize normals
 	bool mInBox;
+	bool mSkipEmptyBlocks;		// whether generate() skips blocks of empty cells
+	unsigned mNumThreads;		// threads used by generate()
 
 	EdgeVertex calcIntersection(int nX, int nY, int nZ, int nEdgeNo, const float * vals) const;
 	void addEdgeVertex(int x, int y, int z, int cellID, int edge, const float * vals);
 
 	void compressTriangles();
+	void finish();
+
+	// Split the cell layers into slabs and call extract on each from numThreads() threads
+	void generateSlabs(const std::function<void(Slab&, EdgeCache&)>& extract);
+	void beginSlab(Slab& slab, EdgeCache& cache) const;
+	void nextLayer(EdgeCache& cache) const;
+	void endSlab(Slab& slab, EdgeCache& cache) const;
+	void addSlabCell(Slab& slab, EdgeCache& cache, int ix, int iy, int iz, int idx, const float * vals) const;
+	int slabEdgeVertex(Slab& slab, EdgeCache& cache, int ix, int iy, int iz, int edgeNo, const float * vals) const;
+
+	template <class T>
+	void generateSlab(Slab& slab, EdgeCache& cache, const T * vals) const;
 };
 
 
@@ -267,49 +318,100 @@ protected:
 
 template <class T>
 void Isosurface::generate(const T * vals){
-	inBox(true);
-	begin();
+	generateSlabs([this, vals](Slab& slab, EdgeCache& cache){
+		generateSlab(slab, cache, vals);
+	});
+}
+
+template <class T>
+void Isosurface::generateSlab(Slab& slab, EdgeCache& cache, const T * vals) const {
+	// Empty blocks are found by counting the field points inside the surface
+	static const int B = 8;		// block size in cells
 
 	int Nx = mNF[0];
 	int Nxy = Nx*mNF[1];
+	int nCx = mNF[0]-1;
+	int nCy = mNF[1]-1;
+	int nBx = (nCx + B-1)/B;
+	int nBy = (nCy + B-1)/B;
+	std::vector<char> activeBlocks(nBx*nBy, 1);
+
+	beginSlab(slab, cache);
 
 	// iterate through cubes (not field points)
-	//for(int z=0; z < mNF[2]-1; ++z){
 	// support transparency (assumes higher indices are farther away)
-	for(int z=mNF[2]-2; z>=0; --z){
-		int z0 = z   *Nxy;
-		int z1 =(z+1)*Nxy;
-		for(int y=0; y < mNF[1]-1; ++y){
-			int y0 = y   *Nx;
-			int y1 =(y+1)*Nx;
-
-			int z0y0 = z0+y0;
-			int z0y1 = z0+y1;
-			int z1y0 = z1+y0;
-			int z1y1 = z1+y1;
-
-			int z0y0_1 = z0y0+1;
-			int z0y1_1 = z0y1+1;
-			int z1y0_1 = z1y0+1;
-			int z1y1_1 = z1y1+1;
-
-			for(int x=0; x < mNF[0]-1; ++x){
-
-				float v8[] = {
-					float(vals[z0y0 + x]), float(vals[z0y0_1 + x]),
-					float(vals[z0y1 + x]), float(vals[z0y1_1 + x]),
-					float(vals[z1y0 + x]), float(vals[z1y0_1 + x]),
-					float(vals[z1y1 + x]), float(vals[z1y1_1 + x])
-				};
-
-				int i3[] = {x,y,z};
-
-				addCell(i3,	v8);
+	for(int zb=slab.z1; zb>slab.z0; zb-=B){
+		int zb0 = zb-B > slab.z0 ? zb-B : slab.z0;
+
+		if(mSkipEmptyBlocks){
+			for(int by=0; by<nBy; ++by){
+			for(int bx=0; bx<nBx; ++bx){
+				int x0 = bx*B, x1 = x0+B < nCx ? x0+B : nCx;
+				int y0 = by*B, y1 = y0+B < nCy ? y0+B : nCy;
+				int inside = 0;
+				for(int z=zb0; z<=zb; ++z){
+				for(int y=y0; y<=y1; ++y){
+					const T * row = vals + z*Nxy + y*Nx;
+					for(int x=x0; x<=x1; ++x) inside += float(row[x]) < level();
+				}}
+				int total = (zb-zb0+1)*(y1-y0+1)*(x1-x0+1);
+				activeBlocks[by*nBx + bx] = inside != 0 && inside != total;
+			}}
+		}
+
+		for(int z=zb-1; z>=zb0; --z){
+			int z0 = z   *Nxy;
+			int z1 =(z+1)*Nxy;
+			for(int y=0; y < nCy; ++y){
+				int y0 = y   *Nx;
+				int y1 =(y+1)*Nx;
+
+				int z0y0 = z0+y0;
+				int z0y1 = z0+y1;
+				int z1y0 = z1+y0;
+				int z1y1 = z1+y1;
+
+				int z0y0_1 = z0y0+1;
+				int z0y1_1 = z0y1+1;
+				int z1y0_1 = z1y0+1;
+				int z1y1_1 = z1y1+1;
+
+				const char * active = &activeBlocks[(y/B)*nBx];
+
+				for(int x=0; x < nCx; ++x){
+					if(!active[x/B]){
+						x += B-1;
+						continue;
+					}
+
+					float v8[] = {
+						float(vals[z0y0 + x]), float(vals[z0y0_1 + x]),
+						float(vals[z0y1 + x]), float(vals[z0y1_1 + x]),
+						float(vals[z1y0 + x]), float(vals[z1y0_1 + x]),
+						float(vals[z1y1 + x]), float(vals[z1y1_1 + x])
+					};
+
+					// Same cell index as in addCell()
+					int idx = 0;
+					if(v8[0] < level()) idx |=   1;
+					if(v8[2] < level()) idx |=   2;
+					if(v8[3] < level()) idx |=   4;
+					if(v8[1] < level()) idx |=   8;
+					if(v8[4] < level()) idx |=  16;
+					if(v8[6] < level()) idx |=  32;
+					if(v8[7] < level()) idx |=  64;
+					if(v8[5] < level()) idx |= 128;
+
+					if(idx != 0 && idx != 255){
+						addSlabCell(slab, cache, x,y,z, idx, v8);
+					}
+				}
 			}
+			nextLayer(cache);
 		}
 	}
 
-	end();
+	endSlab(slab, cache);
 }
 
 } // al::
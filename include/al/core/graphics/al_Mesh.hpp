@@ -112,8 +112,21 @@ public:
 
   // destructive edits to internal vertices:
 
-  /// Generates indices for a set of vertices
-  void compress();
+  /// Weld duplicate vertices and generate indices
+
+  /// Vertices are merged when all their coordinates are within epsilon of
+  /// each other, keeping the attributes of the first one. If
+  /// compareAttributes is true, their normals, colors and texture
+  /// coordinates must also be within epsilon. Existing indices are remapped
+  /// to the welded vertices.
+  void compress(float epsilon = 0.0f, bool compareAttributes = false);
+
+  /// Reorder triangles to reduce post-transform vertex cache misses
+
+  /// Only applies to indexed TRIANGLES meshes. Vertices are then renumbered
+  /// in the order the new index buffer first uses them.
+  /// @param[in] cacheSize  number of vertices in the simulated cache
+  void optimizeVertexCache(int cacheSize = 32);
 
   /// Convert indices (if any) to flat vertex buffers
   void decompress();
@@ -42,12 +42,14 @@
 	Andres Cabrera, 2017 mantaraya36@gmail.com
 */
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "al/core/io/al_AudioIOData.hpp"
+#include "al/core/io/al_AudioProfiler.hpp"
 
 namespace al {
 
@@ -198,6 +200,14 @@ class AudioIO : public AudioIOData {
   bool stop();   ///< Stops the audio IO.
   void processAudio();  ///< Call callback manually
 
+  /// Process one block as an audio device does: zero the output buffers if
+  /// autoZeroOut(), call processAudio(), then apply the gain ramp and the
+  /// zeroNANs() and clipOut() settings to the first numOutChannels output
+  /// channels. If interleavedOut is given, the processed channels are
+  /// written there interleaved and the output buffers keep the samples from
+  /// the callbacks
+  void processAudioBlock(int numOutChannels, float *interleavedOut = nullptr);
+
   bool isOpen(); ///< Returns true if device has been opened
   bool isRunning(); ///< Returns true if audio is running
 
@@ -205,7 +215,9 @@ class AudioIO : public AudioIOData {
   int channelsInDevice() const;  ///< Get number of channels opened on input device
   int channelsOutDevice() const;  ///< Get number of channels opened on output device
   bool clipOut() const { return mClipOut; }  ///< Returns clipOut setting
-  double cpu() const;  ///< Returns current CPU usage of audio thread
+  /// Returns current CPU usage of audio thread, from the backend when it
+  /// measures it, otherwise the block time over budget from profiler()
+  double cpu() const;
   bool supportsFPS(double fps);  ///< Return true if fps supported, otherwise false
   bool zeroNANs() const;  ///< Returns whether to zero NANs in output buffer going to DAC
 
@@ -234,14 +246,22 @@ class AudioIO : public AudioIOData {
   double time(int frame) const;  ///< Get current stream time in seconds of frame
 
   /// Add an AudioCallback handler (internal callback is always called first)
+  ///
+  /// The chain can be changed while the stream runs, from one thread at a
+  /// time. The audio thread picks up the change at its next block.
   AudioIO &append(AudioCallback &v);
   AudioIO &prepend(AudioCallback &v);
   AudioIO &insertBefore(AudioCallback &v, AudioCallback &beforeThis);
   AudioIO &insertAfter(AudioCallback &v, AudioCallback &afterThis);
 
-  /// Remove all input event handlers matching argument
+  /// Remove all input event handlers matching argument. A block that started
+  /// before this returned may still call it.
   AudioIO &remove(AudioCallback &v);
 
+  /// Times the callback, each AudioCallback and the output processing of
+  /// every block once enabled, and counts device xruns
+  AudioProfiler &profiler() { return mProfiler; }
+
   using AudioIOData::channelsIn;
   using AudioIOData::channelsOut;
   using AudioIOData::channelsBus;
@@ -256,10 +276,22 @@ class AudioIO : public AudioIOData {
   bool mClipOut;      // whether to clip output between -1 and 1
   bool mAutoZeroOut;  // whether to automatically zero output buffers each block
   std::vector<AudioCallback *> mAudioCallbacks;
+  // Callbacks run by processAudio(), with the profiler stage of each. A new
+  // chain is published when mAudioCallbacks changes. The old ones are only
+  // freed while the stream is stopped, as the audio thread may still be
+  // running the previous one
+  struct CallbackChain {
+    std::vector<AudioCallback *> callbacks;
+    std::vector<int> stages;
+  };
+  std::atomic<const CallbackChain *> mCallbackChain {nullptr};
+  std::vector<std::unique_ptr<const CallbackChain>> mCallbackChains;
+  AudioProfiler mProfiler;
 
   //	void init(int outChannels, int inChannels);			//
   void reopen();  // reopen stream (restarts stream if needed)
   void resizeBuffer(bool forOutput);
+  void updateCallbackChain();
   void operator=(const AudioIO &) = delete;  // Disallow copy
 
   std::unique_ptr<AudioBackend> mBackend;
@@ -89,6 +89,25 @@ static void interleave(T* dst, const T* src, int numFrames, int numChannels) {
   }
 }
 
+/// Deinterleave float samples, transposing blocks of frames and channels with
+/// SSE or AVX where available
+void deinterleave(float* dst, const float* src, int numFrames, int numChannels);
+
+/// Interleave float samples, transposing blocks of frames and channels with
+/// SSE or AVX where available
+void interleave(float* dst, const float* src, int numFrames, int numChannels);
+
+/// Output processing of an audio device block, in a single pass
+///
+/// Channel c of src starts at src + c * numFrames. Each sample is multiplied
+/// by a gain that starts at gain and changes by gainStep every frame, NaNs
+/// are zeroed if zeroNANs and samples are clipped to [-1, 1] if clip. The
+/// result is written interleaved to dst if interleaved, otherwise to the same
+/// non-interleaved layout as src (dst can be src).
+void processOutput(float* dst, const float* src, int numFrames, int numChannels,
+                   float gain, float gainStep, bool zeroNANs, bool clip,
+                   bool interleaved);
+
 /// Audio device information
 ///
 /// @ingroup allocore
@@ -233,6 +252,7 @@ class AudioIOData {
   void frame(unsigned int v) { assert(v >= 0); mFrame = v - 1; }  ///< Set frame count for next iteration
   void zeroBus();                        ///< Zeros all the bus buffers
   void zeroOut();  ///< Zeros all the internal output buffers
+  void zeroIn();  ///< Zeros all the internal input buffers
 
   /// Sets number of effective channels on input or output device depending on
   /// 'forOutput' flag.
@@ -0,0 +1,240 @@
+#ifndef INCLUDE_AL_AUDIO_PROFILER_HPP
+#define INCLUDE_AL_AUDIO_PROFILER_HPP
+
+/*	Allocore --
+	Multimedia / virtual environment application class library
+
+	Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+	Copyright (C) 2012-2018. The Regents of the University of California.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+		Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		Neither the name of the University of California nor the names of its
+		contributors may be used to endorse or promote products derived from
+		this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+	ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+	LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+	CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+	CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+
+	File description:
+	Timing the stages of the audio callback chain without locking the audio
+	thread
+*/
+
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "al/core/types/al_SPSCRing.hpp"
+
+namespace al {
+
+/// Measures how the audio thread spends its block budget
+///
+/// The audio thread takes a steady clock timestamp around each stage of a
+/// block (the callback function, each AudioCallback, the output processing
+/// in AudioIO, each PolySynth voice type, or any user defined stage) and
+/// pushes an event to a lock-free ring. Nothing on the audio thread locks or
+/// allocates; events are dropped and counted when the ring is full.
+///
+/// Another thread calls update() to drain the ring into the statistics:
+/// a histogram of block time over block budget, overruns (blocks that took
+/// longer than their budget), xruns reported by the device, and count,
+/// mean, percentiles and maximum of each stage. The statistics can be read
+/// with the accessors, as JSON with json(), and the most recent events as a
+/// Chrome trace (chrome://tracing or https://ui.perfetto.dev) with
+/// chromeTrace().
+///
+/// AudioIO has a profiler that is disabled by default:
+/// @code
+/// audioIO.profiler().enable(true);
+/// ...
+/// audioIO.profiler().update();  // E.g. once per graphics frame
+/// std::cout << audioIO.profiler().json() << std::endl;
+/// audioIO.profiler().writeChromeTrace("audio.trace.json");
+/// @endcode
+///
+/// Percentiles come from logarithmic histograms with 8 bins per octave, so
+/// they are within 5% of the measured times.
+///
+/// @ingroup allocore
+class AudioProfiler {
+ public:
+  /// Stages registered by every profiler
+  enum { BLOCK_STAGE = 0, CALLBACK_STAGE, OUTPUT_STAGE };
+
+  /// Bins of the load histogram, each 2% of the budget wide. The last bin
+  /// counts blocks of twice the budget or longer
+  enum { LOAD_BINS = 101 };
+
+  /// @param[in] ringSize Events the audio thread can push between updates
+  /// @param[in] traceSize Most recent events kept for chromeTrace()
+  AudioProfiler(size_t ringSize = 4096, size_t traceSize = 65536);
+
+  /// Start or stop recording events. The ring is allocated the first time
+  /// the profiler is enabled
+  void enable(bool v);
+  bool enabled() const { return mEnabled.load(std::memory_order_acquire); }
+
+  /// Get the id of a stage, registering it if needed. Locks and allocates,
+  /// so register stages before they run when possible
+  int stage(const std::string &name);
+  std::string stageName(int id);
+  int numStages();
+
+  // Audio thread ---------------------------------------------------------
+
+  /// Nanoseconds since the profiler was created, from the steady clock
+  uint64_t now() const {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - mEpoch)
+                        .count());
+  }
+
+  /// Record a stage that ran from start to end (from now())
+  void record(int stageId, uint64_t start, uint64_t end) {
+    if (enabled()) push(Event{stageId, start, end - start, 0});
+  }
+
+  /// Record a whole block and update load(). Call for every block, the
+  /// load is kept when the profiler is disabled
+  void recordBlock(uint64_t start, uint64_t end, double budgetSeconds);
+
+  /// Count an underflow or overflow reported by the device
+  void xrun() { mXruns.fetch_add(1, std::memory_order_relaxed); }
+
+  /// Times a scope as a stage
+  class Scope {
+   public:
+    Scope(AudioProfiler &profiler, int stageId)
+        : mProfiler(profiler), mStage(stageId),
+          mStart(profiler.enabled() ? profiler.now() : 0) {}
+    ~Scope() {
+      if (mStart) mProfiler.record(mStage, mStart, mProfiler.now());
+    }
+
+   private:
+    AudioProfiler &mProfiler;
+    int mStage;
+    uint64_t mStart;
+  };
+
+  // Any thread -----------------------------------------------------------
+
+  /// Block time over block budget, averaged over the last blocks
+  double load() const { return mLoad.load(std::memory_order_relaxed); }
+
+  /// Device underflows and overflows, counted when disabled too
+  uint64_t xruns() const { return mXruns.load(std::memory_order_relaxed); }
+
+  /// Events the audio thread could not push because the ring was full
+  uint64_t droppedEvents() const { return mDropped.load(std::memory_order_relaxed); }
+
+  // Reader threads -------------------------------------------------------
+
+  /// Move the events recorded since the last update into the statistics
+  void update();
+
+  /// Clear the statistics, the trace and the counters
+  void reset();
+
+  struct StageStatistics {
+    std::string name;
+    uint64_t count;
+    double total;  ///< Microseconds, as are all the times below
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+  };
+
+  /// Stages that have run since the last reset()
+  std::vector<StageStatistics> stageStatistics();
+
+  /// Blocks, and blocks that took longer than their budget
+  uint64_t blocks();
+  uint64_t overruns();
+
+  /// Blocks in each LOAD_BINS bin
+  std::vector<uint64_t> loadHistogram();
+
+  /// Load (block time over budget) below which fraction p of the blocks fall
+  double loadPercentile(double p);
+
+  /// Statistics as a JSON object
+  std::string json();
+
+  /// Recent events in the Chrome trace event format, one track per stage
+  std::string chromeTrace();
+
+  bool writeJSON(const std::string &fileName);
+  bool writeChromeTrace(const std::string &fileName);
+
+ private:
+  struct Event {
+    int32_t stage;
+    uint64_t start;
+    uint64_t duration;
+    uint64_t budget;  // Blocks only
+  };
+
+  struct Histogram {
+    std::vector<uint64_t> bins;
+    uint64_t count{0};
+    uint64_t total{0};
+    uint64_t max{0};
+  };
+
+  void push(const Event &event) {
+    if (!mRing->push(event)) mDropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  double percentile(const Histogram &histogram, double p) const;
+
+  const std::chrono::steady_clock::time_point mEpoch;
+  std::atomic<bool> mEnabled{false};
+  std::unique_ptr<SPSCRing<Event>> mRing;
+  size_t mRingSize;
+  std::atomic<double> mLoad{0};
+  std::atomic<uint64_t> mXruns{0};
+  std::atomic<uint64_t> mDropped{0};
+
+  std::mutex mLock;  // Never taken by the audio thread
+  std::vector<std::string> mStageNames;
+  std::vector<Histogram> mStages;
+  std::vector<uint64_t> mLoadBins;
+  uint64_t mBlocks{0};
+  uint64_t mOverruns{0};
+  std::vector<Event> mTrace;  // Circular
+  size_t mTraceSize;
+  size_t mTraceNext{0};
+  size_t mTraceCount{0};
+};
+
+}  // al::
+
+#endif
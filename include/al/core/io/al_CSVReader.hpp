@@ -49,6 +49,7 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
 
 /**
@@ -57,10 +58,14 @@
  * To use, first create a CSVReader object and call addType() to add the type of a
  * column. Then call readFile().
  *
- * Once the file is in memory it can be read as columns of floats using
- * getColumn(). Or the whole CSV data can be copied to memory by defining
- * a struct that will hold the values from each row from the csv file and calling
- * copyToStruct() to create a vector with the data from the CSV file.
+ * The file is memory mapped and split into chunks at line boundaries that
+ * are parsed in parallel. Each column is stored contiguously by type, and
+ * can be accessed without copying through getRealColumn(),
+ * getIntegerColumn() and getBooleanColumn(). getColumn() returns a copy of
+ * a numeric column as doubles. Or the whole CSV data can be copied to memory
+ * by defining a struct that will hold the values from each row from the csv
+ * file and calling copyToStruct() to create a vector with the data from the
+ * CSV file.
  *
  * This reader is currently very naive (but efficient) and might choke with
  * complex or malformed CSV files.
@@ -92,11 +97,10 @@ int main(int argc, char *argv[]) {
                   << std::endl;
     }
 
-    std::vector<double> column1 = reader.getColumn(1);
-    for(auto value: column1) {
+    for(double value: reader.getRealColumn(1)) {
         std::cout << value << std::endl;
     }
-    std::cout << " Num rows:" << rows.size() << std::endl;
+    std::cout << " Num rows:" << reader.numRows() << std::endl;
     return 0;
 }
     \endcode
@@ -111,12 +115,30 @@ public:
     IGNORE_COLUMN
   } DataType;
 
+  /**
+   * @brief Read only view of a column, valid until the next call to readFile()
+   */
+  template<class T>
+  class ColumnView {
+  public:
+    ColumnView(const T *data = nullptr, size_t size = 0) : mData(data), mSize(size) {}
+
+    const T *data() const {return mData;}
+    size_t size() const {return mSize;}
+    bool empty() const {return mSize == 0;}
+    const T *begin() const {return mData;}
+    const T *end() const {return mData + mSize;}
+    const T &operator[](size_t row) const {return mData[row];}
+
+  private:
+    const T *mData;
+    size_t mSize;
+  };
+
   CSVReader() {
     // TODO We could automatically add types by trying to parse the file
   }
 
-  ~CSVReader();
-
   /**
      * @brief readFile reads the CSV file into internal memory
      * @param fileName the csv file name
@@ -137,9 +159,21 @@ public:
   }
 
   /**
-     * @brief getColumn returns a column from the csv file
-     * @param index column index
-     * @return vector with the data
+     * @brief set the number of threads used to parse a file
+     * @param numThreads 0 uses one thread per hardware thread
+     *
+     * Files are split into chunks of at least 1 MB, so small files are
+     * parsed by fewer threads.
+     */
+  void setNumThreads(unsigned int numThreads) {mNumThreads = numThreads;}
+
+  /**
+     * @brief copy the data to a vector of structs, one per row
+     *
+     * Column values are packed in the struct in order with no padding:
+     * STRING as char[32], INTEGER as int64_t, REAL as double and BOOLEAN
+     * as bool. IGNORE_COLUMN takes no space. Returns an empty vector if the
+     * struct is too small.
      */
   template<class DataStruct>
   std::vector<DataStruct> copyToStruct() {
@@ -147,23 +181,41 @@ public:
     if (sizeof(DataStruct) < calculateRowLength()) {
       return output;
     }
-    for (auto row: mData) {
-      DataStruct newValues;
-      memset(&newValues, 0, sizeof(DataStruct));
-      memcpy(&newValues, row, sizeof(newValues));
-      output.push_back(newValues);
+    output.resize(mNumRows);
+    for (size_t row = 0; row < mNumRows; row++) {
+      memset(&output[row], 0, sizeof(DataStruct));
+      copyRow(row, reinterpret_cast<char *>(&output[row]));
     }
 
     return output;
   }
 
   /**
-     * @brief getColumn returns a column from the csv file
+     * @brief getColumn returns a copy of a REAL, INTEGER or BOOLEAN column
      * @param index column index
      * @return vector with the data
      */
   std::vector<double> getColumn(int index);
 
+  /**
+     * @brief views of the typed columns
+     * @param index column index
+     *
+     * An empty view is returned if the column is not of the type requested.
+     */
+  ColumnView<double> getRealColumn(int index) const;
+  ColumnView<int64_t> getIntegerColumn(int index) const;
+  ColumnView<bool> getBooleanColumn(int index) const;
+
+  /**
+     * @brief get a value from a STRING column
+     * @return null terminated string, or nullptr if the column is not of STRING type
+     */
+  const char *getString(int index, size_t row) const;
+
+  /// Number of data rows read by readFile()
+  size_t numRows() const {return mNumRows;}
+
   /**
          * @brief get names of the columns in CSV file
          * @return array with column names
@@ -175,14 +227,21 @@ public:
   void setBasePath(std::string basePath) {mBasePath = basePath;}
 
 private:
+  struct Chunk;
 
   size_t calculateRowLength();
+  void copyRow(size_t row, char *dest) const;
+  void parseChunk(const Chunk &chunk, bool commaSeparated);
+  const void *columnData(int index, DataType type) const;
 
-  const size_t maxStringSize = 32;
+  static const size_t maxStringSize = 32;
 
   std::vector<std::string> mColumnNames;
   std::vector<DataType> mDataTypes;
-  std::vector<char *> mData;
+  // One array per column of mNumRows values, aligned for double
+  std::vector<std::vector<double>> mColumns;
+  size_t mNumRows {0};
+  unsigned int mNumThreads {0};
 
   std::string mBasePath;
 };
@@ -0,0 +1,175 @@
+#ifndef INCLUDE_AL_OFFLINE_AUDIO_HPP
+#define INCLUDE_AL_OFFLINE_AUDIO_HPP
+
+/*	Allocore --
+	Multimedia / virtual environment application class library
+
+	Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+	Copyright (C) 2012-2018. The Regents of the University of California.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+		Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		Neither the name of the University of California nor the names of its
+		contributors may be used to endorse or promote products derived from
+		this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+	ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+	LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+	CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+	CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+
+	File description:
+	Rendering the AudioIO callbacks without an audio device, faster than
+	real time or paced like a device
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "al/core/io/al_AudioIO.hpp"
+
+namespace al {
+
+/// Destination of the blocks rendered by OfflineAudioRenderer
+///
+/// @ingroup allocore
+class AudioSink {
+ public:
+  virtual ~AudioSink() {}
+
+  /// Called before the first block of a render
+  virtual bool open(int numChannels, double framesPerSecond) { return true; }
+
+  /// Receive one block. Channel c starts at buffers + c * numFrames
+  virtual bool write(const float *buffers, int numChannels, int numFrames) = 0;
+
+  /// Called after the last block of a render
+  virtual bool close() { return true; }
+};
+
+/// Keeps rendered audio in memory, one buffer per channel
+///
+/// @ingroup allocore
+class MemoryAudioSink : public AudioSink {
+ public:
+  bool open(int numChannels, double framesPerSecond) override;
+  bool write(const float *buffers, int numChannels, int numFrames) override;
+
+  int channels() const { return int(mChannels.size()); }
+  uint64_t frames() const { return mChannels.empty() ? 0 : mChannels[0].size(); }
+  double framesPerSecond() const { return mFramesPerSecond; }
+  const std::vector<float> &channel(int c) const { return mChannels[c]; }
+
+  /// Frames are appended to those of previous renders unless cleared
+  void clear() { mChannels.clear(); }
+
+ private:
+  std::vector<std::vector<float>> mChannels;
+  double mFramesPerSecond{0};
+};
+
+/// Writes rendered audio to a 32 bit float WAV file
+///
+/// @ingroup allocore
+class SoundFileAudioSink : public AudioSink {
+ public:
+  SoundFileAudioSink(const std::string &fileName) : mFileName(fileName) {}
+  ~SoundFileAudioSink();
+
+  bool open(int numChannels, double framesPerSecond) override;
+  bool write(const float *buffers, int numChannels, int numFrames) override;
+  bool close() override;
+
+  std::string fileName() const { return mFileName; }
+  uint64_t frames() const { return mFrames; }
+
+ private:
+  bool writeHeader();
+
+  std::string mFileName;
+  std::FILE *mFile{nullptr};
+  int mChannels{0};
+  double mFramesPerSecond{0};
+  uint64_t mFrames{0};
+  std::vector<float> mInterleaved;
+};
+
+/// Runs the callbacks of an AudioIO without an audio device
+///
+/// Each block goes through AudioIO::processAudioBlock() like a device
+/// block, with silent input, and all output channels (including virtual
+/// channels) are passed to the sink. Blocks are always framesPerBuffer()
+/// frames long, so renders are repeatable. The callbacks run on the thread
+/// that calls render().
+///
+/// By default blocks are rendered as fast as the CPU allows. With pace()
+/// set, each block waits for its time on a clock that advances like a
+/// device's, to test code that depends on real time.
+///
+/// @code
+/// AudioIO io;
+/// io.init(callback, nullptr, 256, 48000, 2, 0);
+/// OfflineAudioRenderer renderer(io);
+/// SoundFileAudioSink sink("piece.wav");
+/// renderer.render(sink, 48000 * 600);
+/// printf("%.1fx real time\n", renderer.realTimeFactor());
+/// @endcode
+///
+/// @ingroup allocore
+class OfflineAudioRenderer {
+ public:
+  OfflineAudioRenderer(AudioIO &io) : mIO(io) {}
+
+  /// Render at least numFrames frames, rounded up to whole blocks
+  /// @return false if the sink failed or stop() was called
+  bool render(AudioSink &sink, uint64_t numFrames);
+
+  /// Stop a render from another thread after the current block
+  void stop() { mStop = true; }
+
+  /// Wait between blocks to keep the pace of a device clock
+  void pace(bool v) { mPace = v; }
+  bool pace() const { return mPace; }
+
+  /// Frames rendered by the last or current render
+  uint64_t framesRendered() const { return mFramesRendered.load(); }
+
+  /// Seconds of audio rendered per second of wall clock time in the last
+  /// render
+  double realTimeFactor() const { return mRealTimeFactor; }
+
+  /// Time spent in the callbacks over the duration of the audio rendered
+  /// in the last render, as AudioIO::cpu() for a device
+  double cpu() const { return mCpu; }
+
+ private:
+  AudioIO &mIO;
+  bool mPace{false};
+  std::atomic<bool> mStop{false};
+  std::atomic<uint64_t> mFramesRendered{0};
+  double mRealTimeFactor{0};
+  double mCpu{0};
+};
+
+}  // al::
+
+#endif
@@ -361,7 +361,8 @@ class Recv {
 public:
 	Recv();
 
-	/// @param[in] port		Port number (valid range is 0-65535)
+	/// @param[in] port		Port number (valid range is 0-65535). If 0, the system
+	///						picks a free port, see port().
 	/// @param[in] address	IP address. If empty, will bind all network interfaces to socket.
 	/// @param[in] timeout	< 0: block forever; = 0: no blocking; > 0 block with timeout
 	Recv(uint16_t port, const char * address = "", al_sec timeout=0);
@@ -0,0 +1,213 @@
+#ifndef INCLUDE_AL_STATEDISTRIBUTION_HPP
+#define INCLUDE_AL_STATEDISTRIBUTION_HPP
+
+/*	Allocore --
+	Multimedia / virtual environment application class library
+
+	Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+	Copyright (C) 2012-2019. The Regents of the University of California.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+		Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		Neither the name of the University of California nor the names of its
+		contributors may be used to endorse or promote products derived from
+		this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+	ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+	LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+	CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+	CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+
+	File description:
+	Distribution of a shared state block from a simulator to renderers over
+	OSC/UDP, split in fragments and delta encoded against keyframes.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "al/core/protocol/al_OSC.hpp"
+
+namespace al {
+
+/**
+ * @brief Sends a block of state to one or more StateReceivers
+ *
+ * Every call to send() is one state frame with its own sequence number.
+ * Every keyframeInterval() frames the whole state is sent as a keyframe.
+ * Other frames only carry the regions that differ from the last keyframe,
+ * XOR and run-length encoded, so frames can be lost without breaking the
+ * following ones. Frames are split in fragments that fit in a UDP packet,
+ * so the size of the state is not limited by the packet size.
+ *
+ * Sockets are opened once in addListener().
+ *
+ * @ingroup allocore
+ */
+class StateSender {
+public:
+  /// @param[in] stateSize size in bytes of the state block
+  /// @param[in] id only receivers with the same id accept the frames
+  StateSender(size_t stateSize, std::string id = "");
+
+  /// Send state frames to address:port
+  bool addListener(std::string address, uint16_t port);
+
+  /// Send a full keyframe every this number of frames
+  void keyframeInterval(unsigned int frames) { mKeyframeInterval = frames; }
+
+  /// Maximum number of bytes of state data in each UDP packet
+  void fragmentSize(size_t bytes) { mFragmentSize = bytes; }
+
+  /// Pause for interval seconds after every burstSize fragments, so that large
+  /// frames don't overflow the socket buffers of the receivers. 0 disables
+  void pacing(unsigned int burstSize, double interval) {
+    mBurstSize = burstSize;
+    mBurstInterval = interval;
+  }
+
+  /// Send a new state frame. state must point to stateSize bytes.
+  /// Returns the number of bytes sent to each listener.
+  size_t send(const void *state);
+
+  /// Sequence number of the next frame
+  uint32_t sequence() const { return mSequence; }
+
+  /// Encode the bytes that differ between state and reference
+  static void encodeDelta(const char *state, const char *reference, size_t size,
+                          std::vector<char> &encoded);
+
+  /// Apply a delta from encodeDelta() to reference and write the result to
+  /// state. Returns false if the encoded data is malformed
+  static bool decodeDelta(const char *encoded, size_t encodedSize,
+                          const char *reference, char *state, size_t size);
+
+  /// OSC address of the state messages for id
+  static std::string oscAddress(const std::string &id);
+
+private:
+  size_t mStateSize;
+  std::string mOscAddress;
+  size_t mFragmentSize {1400};
+  unsigned int mKeyframeInterval {60};
+  unsigned int mBurstSize {64};
+  double mBurstInterval {0.0002};
+  uint32_t mSequence {0};
+  uint32_t mKeyframeSequence {0};
+  bool mHaveKeyframe {false};
+  std::vector<char> mKeyframe;
+  std::vector<char> mEncoded;
+  std::vector<std::unique_ptr<osc::Send>> mSenders;
+};
+
+/**
+ * @brief Receives state frames from a StateSender
+ *
+ * Fragments are reassembled on a background network thread. Frames with
+ * missing fragments are dropped when a newer frame arrives, and deltas are
+ * only applied on top of the keyframe they were encoded against.
+ *
+ * Complete states are handed to the reading thread through a lock free
+ * triple buffer, so the reader never waits for the network thread. Call
+ * update() once per frame and read the state in place through state(), or
+ * use get() to copy it.
+ *
+ * @ingroup allocore
+ */
+class StateReceiver : public osc::PacketHandler {
+public:
+  /// @param[in] stateSize size in bytes of the state block
+  /// @param[in] id only frames from a sender with the same id are accepted
+  StateReceiver(size_t stateSize, std::string id = "");
+
+  ~StateReceiver();
+
+  /// Start listening for state frames on port. If port is 0, the system
+  /// picks a free port, see port()
+  bool open(uint16_t port, const char *address = "0.0.0.0");
+
+  void close();
+
+  /// Port the receiver is listening on, 0 if it is not open
+  uint16_t port() const { return mRecv ? mRecv->port() : 0; }
+
+  /// Make the latest complete state current if there is a new one.
+  /// Returns the number of states completed since the previous call.
+  int update();
+
+  /// Number of states completed since the last call to update(). This does
+  /// not change the current state
+  int pendingStates() const { return mCompleted.load(std::memory_order_relaxed); }
+
+  /// Current state, stateSize bytes. Valid until the next call to update()
+  const void *state() const { return mBuffers[mFront].data(); }
+
+  /// update() and copy the state to state if there is a new one.
+  /// Returns the number of states completed since the previous call.
+  int get(void *state);
+
+  /// Number of frames that could not be used, because fragments or their
+  /// keyframe were lost
+  uint32_t droppedFrames() const { return mDroppedFrames; }
+
+  /// Number of complete frames that were replaced by a newer frame before
+  /// update() was called
+  uint32_t staleFrames() const { return mStaleFrames; }
+
+  void onMessage(osc::Message &m) override;
+
+private:
+  void completeFrame();
+  void publish();
+
+  size_t mStateSize;
+  std::string mOscAddress;
+  std::unique_ptr<osc::Recv> mRecv;
+
+  // Reassembly, only accessed from the network thread
+  bool mAssembling {false};
+  uint32_t mAssemblySequence {0};
+  uint32_t mAssemblyKeyframe {0};
+  uint32_t mLastCompleted {0};
+  bool mHaveCompleted {false};
+  int mFragmentsLeft {0};
+  std::vector<bool> mFragmentReceived;
+  std::vector<char> mAssembly;
+  std::vector<char> mKeyframe;
+  uint32_t mKeyframeSequence {0};
+  bool mHaveKeyframe {false};
+  std::atomic<uint32_t> mDroppedFrames {0};
+
+  // Triple buffer. The network thread writes to mBuffers[mBack] and swaps it
+  // with mMiddle, the reader swaps mMiddle with mFront when kNewState is set.
+  static const int kNewState = 4;
+  std::vector<char> mBuffers[3];
+  int mBack {0};
+  std::atomic<int> mMiddle {1};
+  int mFront {2};
+  std::atomic<int> mCompleted {0};
+  std::atomic<uint32_t> mStaleFrames {0};
+};
+
+} // al::
+
+#endif
@@ -50,6 +50,7 @@
 #include <stdio.h>
 #include <iostream>
 
+#include "al/core/math/al_Mat.hpp"
 #include "al/core/math/al_Vec.hpp"
 #include "al/core/spatial/al_DistAtten.hpp"
 #include "al/core/spatial/al_Pose.hpp"
@@ -107,9 +108,16 @@ namespace al{
 class AmbiBase{
 public:
 
+	/// Channel ordering and normalization
+	enum Format {
+		FUMA,		///< Furse-Malham, up to 3rd order
+		ACN_SN3D	///< ACN ordering with SN3D normalization (AmbiX), up to 7th order
+	};
+
 	/// @param[in] dim		number of spatial dimensions (2 or 3)
 	/// @param[in] order	highest spherical harmonic order
-	AmbiBase(int dim, int order);
+	/// @param[in] format	channel ordering and normalization
+	AmbiBase(int dim, int order, Format format=FUMA);
 
 	virtual ~AmbiBase();
 
@@ -119,6 +127,9 @@ public:
 	/// Get order
 	int order() const { return mOrder; }
 
+	/// Get channel ordering and normalization
+	Format format() const { return mFormat; }
+
 	/// Get Ambisonic channel weights
 	const float * weights() const { return mWeights; }
 
@@ -131,6 +142,15 @@ public:
 	/// Set the order
 	void order(int order);
 
+	/// Set the channel ordering and normalization
+
+	/// The order is reduced to 3 when switching to FuMa.
+	///
+	void format(Format format);
+
+	/// Highest order supported by a format
+	static int maxOrder(Format format){ return format == FUMA ? 3 : 7; }
+
 	/// Called whenever the number of Ambisonic channels changes
 	virtual void onChannelsChange(){}
 
@@ -149,6 +169,39 @@ public:
 	/// (x,y,z unit vector in the listener's coordinate frame)
 	static void encodeWeightsFuMa16(float * ws, float x, float y, float z);
 
+	/// Compute ACN/SN3D spherical harmonic weights, up to 7th order
+
+	/// Associated Legendre functions are evaluated with the three term
+	/// recurrence and the azimuthal terms cos(m az) cos^m(el),
+	/// sin(m az) cos^m(el) as powers of (x + iy), so no trigonometric
+	/// function is called. In 2D only the sectoral harmonics (|m| = l) are
+	/// computed, in ACN order: W, Y, X, V, U, ...
+	/// (x,y,z unit vector in the listener's coordinate frame)
+	static void encodeWeightsACN(float * ws, int dim, int order, float x, float y, float z);
+
+	/// Compute ACN/SN3D weights from azimuth and elevation in radians
+	static void encodeWeightsACN(float * ws, int dim, int order, float azimuth, float elevation);
+
+	/// Compute weights in a format
+	static void encodeWeights(float * ws, Format format, int dim, int order, float x, float y, float z){
+		if(format == FUMA) encodeWeightsFuMa(ws, dim, order, x,y,z);
+		else encodeWeightsACN(ws, dim, order, x,y,z);
+	}
+
+	/// Number of floats in the rotation matrices of a 3D ACN sound field
+	static int rotationSize(int order){ return (order+1) * (2*order+1) * (2*order+3) / 3; }
+
+	/// Compute the matrices that rotate a 3D ACN/SN3D sound field
+
+	/// There is one (2l+1)x(2l+1) row major matrix per order l, stored one
+	/// after the other, computed from the order 1 matrix with the recurrence
+	/// of Ivanic and Ruedenberg. If d are the weights of a direction v,
+	/// the matrices applied to d give the weights of rot * v.
+	/// @param[out] matrices	rotationSize(order) floats
+	/// @param[in] order		highest order
+	/// @param[in] rot			rotation in Ambisonic coordinates (+x forward, +y left, +z up)
+	static void rotationMatrices(float * matrices, int order, const Mat3d& rot);
+
 	static int orderToChannels(int dim, int order);
 	static int orderToChannelsH(int orderH);
 	static int orderToChannelsV(int orderV);
@@ -158,7 +211,8 @@ public:
 
 protected:
 	int mDim;			// dimensions - 2d or 3d
-	int mOrder;			// order - 0th, 1st, 2nd, or 3rd
+	int mOrder;			// order - 0th to 3rd (FuMa) or 7th (ACN)
+	Format mFormat;
 	int mChannels;		// cached for efficiency
 	float * mWeights;	// weights for each ambi channel
 
@@ -178,11 +232,18 @@ public:
 	/// @param[in] order		highest spherical harmonic order
 	/// @param[in] numSpeakers	number of speakers
 	/// @param[in] flavor		decoding algorithm
-	AmbiDecode(int dim, int order, int numSpeakers, int flavor=1);
+	/// @param[in] format		channel ordering and normalization
+	AmbiDecode(int dim, int order, int numSpeakers, int flavor=1, Format format=FUMA);
 
 	virtual ~AmbiDecode();
 
 
+	/// Decode and add to the speaker outputs
+
+	/// This is a matrix multiply, speakers x channels by channels x frames.
+	/// Speakers are decoded in groups of 4, keeping their accumulators for
+	/// 8 (AVX) or 4 (SSE) frames in registers, so each Ambisonic channel is
+	/// read once per group and each output written once.
 	/// @param[out] dec				output time domain buffers (non-interleaved)
 	/// @param[in ] enc				input Ambisonic domain buffers (non-interleaved)
 	/// @param[in ] numDecFrames	number of frames in time domain buffers
@@ -202,6 +263,12 @@ public:
 
 
 	/// Set decoding algorithm
+
+	/// 0 is basic, 1 the default, 2 in-phase and 3 max-rE. For ACN the order
+	/// weights are computed for any order and the default is max-rE.
+	/// ACN decoding adds the (2l+1) (3D) or 2 / N_l^2 (2D) factors of a
+	/// projection decoder, normalized so that a speaker gets a gain of 1
+	/// from a source in its direction.
 	void flavor(int type);
 
 	/// Set number of speakers. Positions are zeroed upon resize.
@@ -229,7 +296,7 @@ protected:
 	int mFlavor;				// decode flavor
 	float * mDecodeMatrix;		// deccoding matrix for each ambi channel & speaker
 								// cols are channels and rows are speakers
-	float mWOrder[5];			// weights for each order
+	float mWOrder[8];			// weights for each order
     Speakers mSpeakers;
     //float * mPositions;		// speakers' azimuths + elevations
 	//float * mFrame;			// an ambisonic channel frame used for decode(int)
@@ -240,6 +307,7 @@ protected:
 	float decode(float * encFrame, int encNumChannels, int speakerNum);	// is this useful?
 
 	static float flavorWeights[4][5][5];
+	static void orderWeightsACN(float * weights, int flavor, int dim, int order);
 };
 
 
@@ -252,7 +320,8 @@ public:
 
 	/// @param[in] dim			number of spatial dimensions (2 or 3)
 	/// @param[in] order		highest spherical harmonic order
-	AmbiEncode(int dim, int order) : AmbiBase(dim, order) {}
+	/// @param[in] format		channel ordering and normalization
+	AmbiEncode(int dim, int order, Format format=FUMA) : AmbiBase(dim, order, format) {}
 
 //	/// Encode input sample and set decoder frame.
 //	void encode   (const AmbiDecode &dec, float input);
@@ -301,16 +370,31 @@ public:
 
 /// Ambisonic coder
 ///
+/// With the ACN_SN3D format in 3D the listener's orientation is applied to
+/// the encoded sound field once per block in finalize(), instead of to each
+/// source's direction, see listenerOrientation().
+///
 /// @ingroup allocore
 class AmbisonicsSpatializer : public Spatializer {
 public:
 
-	AmbisonicsSpatializer(SpeakerLayout &sl, int dim = 2, int order = 1, int flavor=1);
+	AmbisonicsSpatializer(SpeakerLayout &sl, int dim = 2, int order = 1, int flavor=1,
+	                      AmbiBase::Format format=AmbiBase::FUMA);
 
 	void zeroAmbi();
 
     void configure(int dim, int order, int flavor);
 
+	/// Set the channel ordering and normalization
+	void format(AmbiBase::Format format);
+
+	/// Rotate the sound field by the listener's orientation
+
+	/// Only done for ACN_SN3D in 3D, other configurations return false and
+	/// the caller must rotate each source's direction. When the orientation
+	/// changes the rotation matrices are interpolated across the block.
+	virtual bool listenerOrientation(const Quatd& orientation) override;
+
 	float * ambiChans(unsigned channel=0);
 
 	virtual void compile() override;
@@ -341,7 +425,16 @@ private:
 	AmbiDecode mDecoder;
 	AmbiEncode mEncoder;
 	std::vector<float> mAmbiDomainChannels;
+	std::vector<float> mRotatedChannels;
+	// Sound field rotation, for this block and the previous one
+	Quatd mOrientation;
+	bool mRotate {false};
+	bool mRotationChanged {false};
+	std::vector<float> mRotation;
+	std::vector<float> mPreviousRotation;
 //	Listener* mListener;
+
+	void rotateAmbi();
 };
 
 
@@ -373,6 +466,18 @@ inline int AmbiBase::channelsToOrder(int channels)
 	case 16:
 		order = 3;
 		break;
+	case 25:
+		order = 4;
+		break;
+	case 36:
+		order = 5;
+		break;
+	case 49:
+		order = 6;
+		break;
+	case 64:
+		order = 7;
+		break;
 	default:
 		order = -1;
 	}
@@ -389,6 +494,10 @@ inline int AmbiBase::channelsToDimensions(int channels)
 	case 4:
 	case 9:
 	case 16:
+	case 25:
+	case 36:
+	case 49:
+	case 64:
 		dim = 3;
 		break;
 	default:
@@ -435,17 +544,18 @@ inline float AmbiDecode::decode(float * encFrame, int encNumChannels, int speake
 //}
 
 inline void AmbiEncode::direction(float az, float el){
-	AmbiBase::encodeWeightsFuMa(mWeights, mDim, mOrder, az, el);
+	if(mFormat == FUMA) AmbiBase::encodeWeightsFuMa(mWeights, mDim, mOrder, az, el);
+	else AmbiBase::encodeWeightsACN(mWeights, mDim, mOrder, az, el);
 }
 
 inline void AmbiEncode::direction(Vec3f vector)
 {
-	AmbiBase::encodeWeightsFuMa(mWeights, mDim, mOrder, vector.x,vector.y,vector.z);
+	AmbiBase::encodeWeights(mWeights, mFormat, mDim, mOrder, vector.x,vector.y,vector.z);
 }
 
 inline void AmbiEncode::direction(float x, float y, float z){
 
-	AmbiBase::encodeWeightsFuMa(mWeights, mDim, mOrder, x,y,z);
+	AmbiBase::encodeWeights(mWeights, mFormat, mDim, mOrder, x,y,z);
 }
 
 inline void AmbiEncode::encode(float * ambiChans, int numFrames, int timeIndex, float timeSample) const {
@@ -454,6 +564,9 @@ inline void AmbiEncode::encode(float * ambiChans, int numFrames, int timeIndex,
 	// This requires only a simple jump per time sample.
 	#define CS(chanindex) case chanindex: ambiChans[chanindex*numFrames+timeIndex] += weights()[chanindex] * timeSample;
 	int ch = channels()-1;
+	for(; ch > 15; --ch){
+		ambiChans[ch*numFrames+timeIndex] += weights()[ch] * timeSample;
+	}
 	switch(ch){
 		CS(15) CS(14) CS(13) CS(12) CS(11) CS(10) CS( 9) CS( 8)
 		CS( 7) CS( 6) CS( 5) CS( 4) CS( 3) CS( 2) CS( 1) CS( 0)
@@ -464,14 +577,9 @@ inline void AmbiEncode::encode(float * ambiChans, int numFrames, int timeIndex,
 
 inline void AmbiEncode::encode(float * ambiChans, const float * input, int numFrames)
 {
-	float * pAmbi = ambiChans; // non-interleaved ambi buffers, we can use fast pointer arithmetic
-
+	// non-interleaved ambi buffers, one vectorized multiply-add per channel
 	for(int c=0; c<channels(); ++c){
-		const float * pInput = input;
-		float weight = weights()[c];
-		for(int i=0; i<numFrames; ++i){
-			*pAmbi++ += weight * *pInput++;
-		}
+		Spatializer::applyGain(ambiChans + c * numFrames, input, weights()[c], numFrames);
 	}
 }
 
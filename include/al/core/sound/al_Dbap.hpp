@@ -69,6 +69,9 @@ public:
 
 	virtual void renderSample(AudioIOData& io, const Pose& listeningPose, const float& sample, const int& frameIndex) override;
 	virtual void renderBuffer(AudioIOData& io, const Pose& listeningPose, const float *samples, const int& numFrames) override;
+	virtual void renderBufferRamp(AudioIOData& io, const Pose& previousPose, const Pose& listeningPose, const float *samples, const int& numFrames) override;
+
+	virtual bool concurrentRender() const override { return true; }
 
 	/// focus is an exponent determining the amplitude focus to nearby speakers.
 
@@ -84,6 +87,9 @@ private:
 	unsigned int mDeviceChannels[DBAP_MAX_NUM_SPEAKERS];
 	unsigned int mNumSpeakers;
 	float mFocus;
+
+	Vec3d sourcePosition(const Pose& listeningPose);
+	float speakerGain(const Vec3d& relpos, unsigned int speaker);
 };
 
 
@@ -42,6 +42,7 @@
 	Andres Cabrera 2018 mantaraya36@gmail.com
 */
 
+#include <algorithm>
 #include <map>
 
 #include "al/core/math/al_Vec.hpp"
@@ -86,12 +87,6 @@ public:
     {
     }
 
-    virtual ~Lbap() override {
-        if (buffer) {
-            free(buffer);
-        }
-    }
-
     virtual void compile() override {
         std::map<int, SpeakerLayout> speakerRingMap;
         for (auto &speaker: mSpeakers) {
@@ -111,15 +106,6 @@ public:
         });
     }
 
-    virtual void prepare(AudioIOData &io) override {
-        if (buffer) {
-            free(buffer);
-        }
-        buffer = (float *) malloc(2 * io.framesPerBuffer() * sizeof(float)); // Allocate 2 buffers
-        bufferSize = io.framesPerBuffer();
-    }
-
-
 	virtual void renderSample(AudioIOData& io, const Pose& reldir, const float& sample, const int& frameIndex) override
     {
 
@@ -127,6 +113,49 @@ public:
 
 	virtual void renderBuffer(AudioIOData& io, const Pose& listeningPose, const float *samples, const int& numFrames) override
     {
+        int upperRing, lowerRing;
+        float upperGain, lowerGain;
+        ringGains(listeningPose, upperRing, upperGain, lowerRing, lowerGain);
+        mRings[upperRing].vbap->renderBufferGain(io, listeningPose, upperGain,
+                                                 listeningPose, upperGain, samples, numFrames);
+        if (lowerRing >= 0) {
+            mRings[lowerRing].vbap->renderBufferGain(io, listeningPose, lowerGain,
+                                                     listeningPose, lowerGain, samples, numFrames);
+        }
+    }
+
+    virtual void renderBufferRamp(AudioIOData& io, const Pose& previousPose, const Pose& listeningPose, const float *samples, const int& numFrames) override
+    {
+        int previousUpper, previousLower, upperRing, lowerRing;
+        float previousUpperGain, previousLowerGain, upperGain, lowerGain;
+        ringGains(previousPose, previousUpper, previousUpperGain, previousLower, previousLowerGain);
+        ringGains(listeningPose, upperRing, upperGain, lowerRing, lowerGain);
+        for (int ring = 0; ring < (int) mRings.size(); ring++) {
+            float startGain = ring == previousUpper ? previousUpperGain : (ring == previousLower ? previousLowerGain : 0.0f);
+            float endGain = ring == upperRing ? upperGain : (ring == lowerRing ? lowerGain : 0.0f);
+            if (startGain != 0.0f || endGain != 0.0f) {
+                mRings[ring].vbap->renderBufferGain(io, previousPose, startGain,
+                                                    listeningPose, endGain, samples, numFrames);
+            }
+        }
+    }
+
+    virtual bool concurrentRender() const override { return true; }
+
+    virtual void print(std::ostream &stream = std::cout) override {
+        for (auto ring: mRings) {
+            stream << " ---- Ring at elevation:" << ring.elevation << std::endl;
+            ring.vbap->print(stream);
+        }
+    }
+
+private:
+	std::vector<LdapRing> mRings;
+
+    // Find the rings above and below the source and their gains.
+    // lowerRing is -1 if the source is above the top or below the bottom ring
+    void ringGains(const Pose& listeningPose, int &upperRing, float &upperGain,
+                   int &lowerRing, float &lowerGain) {
         Vec3d vec = listeningPose.vec();
 
         //Rotate vector according to listener-rotation
@@ -140,37 +169,23 @@ public:
         while (it != mRings.end() && it->elevation > elev) {
             it++;
         }
+        lowerRing = -1;
+        upperGain = 1.0f;
+        lowerGain = 0.0f;
         if (it == mRings.begin()) { // Top ring
-            it->vbap->renderBuffer(io, listeningPose, samples, numFrames);
+            upperRing = 0;
         } else if (it == mRings.end()) { // Bottom ring
-            mRings.back().vbap->renderBuffer(io, listeningPose, samples, numFrames);
+            upperRing = (int) mRings.size() - 1;
         } else { // Between inner rings
             auto topRingIt = it - 1; // top ring is previous ring
             float fraction = (elev - it->elevation)/(topRingIt->elevation - it->elevation); // elevation angle between layers
-            float gainTop = sin(M_PI_2 * fraction);
-            float gainBottom = cos(M_PI_2 *fraction);
-            for (int i = 0; i < bufferSize; i++) {
-                buffer[i] = samples [i] * gainTop;
-                buffer[i + bufferSize] = samples [i] * gainBottom;
-            }
-
-            topRingIt->vbap->renderBuffer(io, listeningPose, buffer, bufferSize);
-            it->vbap->renderBuffer(io, listeningPose, buffer + bufferSize, bufferSize);
+            upperRing = (int) (topRingIt - mRings.begin());
+            lowerRing = (int) (it - mRings.begin());
+            upperGain = sin(M_PI_2 * fraction);
+            lowerGain = cos(M_PI_2 *fraction);
         }
     }
 
-    virtual void print(std::ostream &stream = std::cout) override {
-        for (auto ring: mRings) {
-            stream << " ---- Ring at elevation:" << ring.elevation << std::endl;
-            ring.vbap->print(stream);
-        }
-    }
-
-private:
-	std::vector<LdapRing> mRings;
-    float *buffer {nullptr}; // Two consecutive buffers (non-interleaved)
-    int bufferSize {0};
-
 
 };
 
@@ -0,0 +1,216 @@
+#ifndef INCLUDE_AL_PARTITIONEDCONVOLVER_HPP
+#define INCLUDE_AL_PARTITIONEDCONVOLVER_HPP
+
+/*	Allocore --
+	Multimedia / virtual environment application class library
+
+	Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+	Copyright (C) 2012-2018. The Regents of the University of California.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+		Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		Neither the name of the University of California nor the names of its
+		contributors may be used to endorse or promote products derived from
+		this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+	ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+	LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+	CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+	CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+
+
+	File description:
+	Multichannel partitioned convolution with impulse response hot-swapping
+*/
+
+#include <atomic>
+#include <complex>
+#include <vector>
+
+#include "al/core/io/al_AudioIOData.hpp"
+#include "al/core/types/al_AtomicHandoff.hpp"
+
+namespace al {
+
+/**
+ * @brief Multichannel convolution with impulse responses that can be
+ * replaced while running
+ *
+ * Each output channel is the convolution of one input channel with its
+ * own impulse response (IR). The convolution is uniformly partitioned in
+ * the frequency domain. When the block size given to configure() is a
+ * power of two it is the partition size and there is no added latency.
+ * Other block sizes are buffered into whole partitions across process()
+ * calls, which delays the output by latency() frames.
+ *
+ * This is a self-contained engine that doesn't need the spatialaudio
+ * extension. The extension's Convolver (built on zita-convolver) uses
+ * non-uniform partitions, which is cheaper for long IRs, and can also swap
+ * IRs with swapIRs(). Its new engine starts without input history, while
+ * here both sets of IRs share it.
+ *
+ * New IRs and routing are set with setImpulseResponses() from any
+ * thread except the audio thread. Their spectra are computed there, and
+ * the audio thread starts crossfading from the current IRs to the new ones
+ * at the start of the next block it processes. The output during the
+ * crossfade is the exact mix of the convolution with both sets of IRs,
+ * because both use the same history of input spectra. The audio thread
+ * never allocates or reconfigures; replaced IRs are freed by the next
+ * call to setImpulseResponses() or by the destructor.
+ *
+ * @code
+ * PartitionedConvolver conv;
+ * conv.configure(2, 2, io.framesPerBuffer(), 48000);
+ * conv.setImpulseResponses({leftIR, rightIR}, {0, 1});
+ * // In the audio callback, after synthesis
+ * conv.processBlock(io);
+ * // Later, from another thread
+ * conv.setImpulseResponses({leftIR2, rightIR2}, {0, 1}, 1024);
+ * @endcode
+ *
+ * @ingroup allocore
+ */
+class PartitionedConvolver
+{
+public:
+    PartitionedConvolver();
+    ~PartitionedConvolver();
+
+    PartitionedConvolver(const PartitionedConvolver &) = delete;
+    PartitionedConvolver &operator=(const PartitionedConvolver &) = delete;
+
+    /**
+     * @brief Allocate the convolution engine. Not real-time safe.
+     * @param numInputs number of input channels
+     * @param numOutputs number of output channels
+     * @param blockSize frames per process() call. The partition size is
+     * the next power of two
+     * @param maxIRLength longest IR in frames. Longer IRs are truncated
+     * @return false if the parameters are not valid
+     *
+     * Removes any IRs set before.
+     */
+    bool configure(unsigned int numInputs, unsigned int numOutputs,
+                   unsigned int blockSize, unsigned int maxIRLength);
+
+    /**
+     * @brief Replace the impulse responses and routing
+     * @param irs one IR per output channel. Outputs with no IR are silent
+     * @param inputChannels input channel for each output. If empty, output
+     * i takes input i
+     * @param crossfadeFrames length of the crossfade from the current IRs
+     * @return false if there are more IRs than outputs or an input channel
+     * is out of range
+     *
+     * Don't call from the audio thread. If called again before the audio
+     * thread has started using the IRs, they are replaced without being
+     * heard.
+     */
+    bool setImpulseResponses(const std::vector<std::vector<float>> &irs,
+                             std::vector<unsigned int> inputChannels = {},
+                             unsigned int crossfadeFrames = 0);
+
+    /**
+     * @brief Convolve a block
+     * @param inputs numInputs() channels of numFrames samples
+     * @param outputs numOutputs() channels of numFrames samples. Can be the
+     * same buffers as inputs
+     * @param numFrames any number of frames if latency() is not 0.
+     * Otherwise a multiple of partitionSize(), and frames after the last
+     * whole partition are set to 0.
+     */
+    void process(const float *const *inputs, float *const *outputs, unsigned int numFrames);
+
+    /**
+     * @brief Convolve the output channels (or buses) of io
+     *
+     * Inputs are taken from the first numInputs() output channels (or
+     * buses) and the result is written to the first numOutputs() output
+     * channels. io must have enough channels and buses.
+     */
+    void processBlock(AudioIOData &io, bool buses = false);
+
+    unsigned int numInputs() const { return mNumInputs; }
+    unsigned int numOutputs() const { return mNumOutputs; }
+    unsigned int partitionSize() const { return mPartitionSize; }
+    /// Frames the output is delayed by. 0 when configured with a power of
+    /// two block size, partitionSize() otherwise
+    unsigned int latency() const { return mBuffered ? mPartitionSize : 0; }
+
+    /// true while the audio thread is crossfading to new IRs, or has new
+    /// IRs waiting
+    bool crossfading() const { return mCrossfading.load() || mHandoff.pending(); }
+
+private:
+    struct ImpulseResponses;
+    typedef std::complex<float> Complex;
+
+    void clear();
+    void fft(Complex *data, bool inverse) const;
+    /// Start using new IRs if there are any waiting
+    void update();
+    /// Convolve one partition for all outputs
+    void processPartition(const float *const *inputs, float *const *outputs, unsigned int offset);
+    /// Multiply-accumulate the input spectra with an IR and write the time
+    /// domain result to mOutputBlock
+    void convolve(const ImpulseResponses &irs, unsigned int output);
+
+    unsigned int mNumInputs {0};
+    unsigned int mNumOutputs {0};
+    unsigned int mPartitionSize {0};
+    unsigned int mNumPartitions {0};
+
+    // FFT of twice the partition size
+    std::vector<Complex> mTwiddles;
+    std::vector<unsigned int> mBitReverse;
+
+    // Per input: the last two partitions of samples and the spectra of the
+    // last mNumPartitions blocks, as a ring of partitionSize + 1 bins each
+    std::vector<std::vector<float>> mInputHistory;
+    std::vector<std::vector<Complex>> mInputSpectra;
+    unsigned int mCurrentSpectrum {0};
+
+    std::vector<Complex> mScratch;
+    std::vector<Complex> mAccumulator;
+    std::vector<float> mOutputBlock;
+    std::vector<float> mFadeBlock;
+    std::vector<const float *> mInputPointers;
+    std::vector<float *> mOutputPointers;
+
+    // Partitions being collected and output when the block size is not a
+    // power of two
+    bool mBuffered {false};
+    std::vector<std::vector<float>> mInputFifo;
+    std::vector<std::vector<float>> mOutputFifo;
+    std::vector<const float *> mInputFifoPointers;
+    std::vector<float *> mOutputFifoPointers;
+    unsigned int mFifoPosition {0};
+
+    // Audio thread
+    ImpulseResponses *mCurrent {nullptr};
+    ImpulseResponses *mNext {nullptr};
+    unsigned int mCrossfadePosition {0};
+
+    AtomicHandoff<ImpulseResponses> mHandoff;
+    std::atomic<bool> mCrossfading {false};
+};
+
+}
+
+#endif
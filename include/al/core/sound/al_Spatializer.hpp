@@ -80,6 +80,20 @@ public:
                             const int& numFrames
                             ) = 0;
 
+  /// Render audio buffer moving from previousPose to listeningPose
+  ///
+  /// Gains are ramped linearly across the buffer from those for previousPose
+  /// to those for listeningPose, avoiding zipper noise for moving sources.
+  /// The default implementation does not ramp.
+  virtual void renderBufferRamp(AudioIOData& io,
+                                const Pose& previousPose,
+                                const Pose& listeningPose,
+                                const float *samples,
+                                const int& numFrames
+                                ) {
+    renderBuffer(io, listeningPose, samples, numFrames);
+  }
+
   /// Render audio sample in position
   virtual void renderSample(AudioIOData& io, const Pose& listeningPose,
                             const float& sample,
@@ -88,6 +102,19 @@ public:
   /// Called once per listener, after sources are rendered. ex. ambisonics decode
   virtual void finalize(AudioIOData& io){}
 
+  /// Set the listener's orientation for the next block
+
+  /// Called before prepare(). Spatializers that can rotate their whole
+  /// output once per block (Ambisonics) return true, and the directions
+  /// passed to renderBuffer() and renderSample() must then not be rotated
+  /// by the listener's orientation. By default returns false.
+  virtual bool listenerOrientation(const Quatd& orientation) { return false; }
+
+  /// Returns true if renderBuffer() can be called from several threads at
+  /// once, each thread rendering into its own AudioIOData. Spatializers that
+  /// accumulate into internal buffers must return false.
+  virtual bool concurrentRender() const { return false; }
+
   /// Print out information about spatializer
   virtual void print(std::ostream& stream = std::cout){}
 
@@ -97,6 +124,14 @@ public:
   /// Set number of frames
   virtual void numFrames(unsigned int v){ mNumFrames = v;}
 
+  /// out[i] += in[i] * gain
+  static void applyGain(float *out, const float *in, float gain, int numFrames);
+
+  /// out[i] += in[i] * gain, with gain moving linearly from startGain and
+  /// reaching endGain on the last frame
+  static void applyGainRamp(float *out, const float *in,
+                            float startGain, float endGain, int numFrames);
+
 protected:
 #ifdef AL_DEPRECATED
   /// Render each source per sample
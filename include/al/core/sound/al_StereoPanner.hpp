@@ -32,6 +32,11 @@ public:
 	/// Per Buffer Processing
     virtual void renderBuffer(AudioIOData& io, const Pose& listeningPose, const float *samples, const int& numFrames) override;
 
+	/// Per Buffer Processing with gains ramping from previousPose to listeningPose
+	virtual void renderBufferRamp(AudioIOData& io, const Pose& previousPose, const Pose& listeningPose, const float *samples, const int& numFrames) override;
+
+	virtual bool concurrentRender() const override { return true; }
+
 
 private:
 	int numSpeakers;
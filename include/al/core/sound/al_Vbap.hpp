@@ -118,6 +118,15 @@ public:
 
 	virtual void renderSample(AudioIOData& io, const Pose& reldir, const float& sample, const int& frameIndex) override;
 	virtual void renderBuffer(AudioIOData& io, const Pose& reldir, const float *samples, const int& numFrames) override;
+	virtual void renderBufferRamp(AudioIOData& io, const Pose& previousPose, const Pose& listeningPose, const float *samples, const int& numFrames) override;
+
+	/// Render buffer ramping from the gains for previousPose scaled by
+	/// previousGain to the gains for listeningPose scaled by gain
+	void renderBufferGain(AudioIOData& io, const Pose& previousPose, float previousGain,
+	                      const Pose& listeningPose, float gain,
+	                      const float *samples, int numFrames);
+
+	virtual bool concurrentRender() const override { return true; }
 
 	virtual void print(std::ostream &stream = std::cout) override;
 
@@ -130,6 +139,13 @@ public:
 
 private:
 	std::vector<SpeakerTriple> mTriplets;
+
+	// Direction to triplet lookup built by compile(). A cube map with
+	// mLookupSize x mLookupSize bins per face, each listing the triplets that
+	// may contain directions in the bin, in triplet order
+	static const int mLookupSize = 16;
+	std::vector<unsigned int> mBinOffsets; // Start of each bin in mBinTriplets
+	std::vector<unsigned int> mBinTriplets;
 	std::map<int, std::vector<int> > mPhantomChannels;
 //	Listener* mListener;
 	bool mIs3D;
@@ -137,6 +153,18 @@ private:
 
 	Vec3d computeGains(const Vec3d& vecA, const SpeakerTriple& speak);
 
+	/// Source direction in the coordinates used for the triplets
+	Vec3d sourceVector(const Pose& listeningPose);
+
+	/// Find the triplet containing vec. Returns false if there is none.
+	/// tripletIndex is tested first if it is not -1 and is set to the triplet found
+	bool findTriplet(const Vec3d& vec, int& tripletIndex, Vec3d& gains);
+
+	/// Add samples to the triplet's speakers ramping from startGains to endGains
+	void renderTriplet(AudioIOData& io, int tripletIndex,
+	                   const Vec3d& startGains, const Vec3d& endGains,
+	                   const float *samples, int numFrames);
+
 	/// 2D VBAP, Build internal list of speaker pairs
 	void findSpeakerPairs(const Speakers& spkrs);
 
@@ -148,6 +176,11 @@ private:
 	/// Manually add triplet of speakers, in case not set automatically
 	void addTriple(const SpeakerTriple& st);
 
+	void buildLookup();
+
+	/// Cube map bin for direction vec, -1 for a zero vector
+	int lookupBin(const Vec3d& vec);
+
 };
 
 } // al::
@@ -5,6 +5,9 @@
 
 #include <vector>
 #include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 /*  Allocore --
   Multimedia / virtual environment application class library
@@ -47,9 +50,10 @@
   It is optimized for densely packed points and querying for nearest neighbors
   within given radii (results will be roughly sorted by distance).
 
+  For exact, distance sorted results use the batch k nearest neighbour
+  queries, which can also run across several threads.
+
   TODO: non-toroidal options
-  TODO: have query() automatically (insertion) sort results by distance
-    (perhaps use std::set instead of vector?)
 
   File author(s):
   Wesley Smith, 2010, wesley.hoke@gmail.com
@@ -205,6 +209,30 @@ public:
     Results mObjects;
   };
 
+  /**
+    Results of a batch k nearest neighbour query, as a structure of arrays.
+    Each query has k slots. The results of query i are in
+    [i * k, i * k + counts[i]), sorted by increasing distance.
+
+    Reuse the same KNNResults every frame to avoid reallocating.
+  */
+  struct KNNResults {
+    uint32_t k {0};
+    std::vector<uint32_t> counts;            ///< number of results per query
+    std::vector<uint32_t> objects;           ///< object indices
+    std::vector<double> distancesSquared;    ///< squared (wrapped) distances
+
+    /// number of queries
+    uint32_t size() const { return counts.size(); }
+    /// number of results found for a query
+    uint32_t count(uint32_t query) const { return counts[query]; }
+    /// index of the n-th nearest object to a query
+    uint32_t object(uint32_t query, uint32_t n) const { return objects[query * k + n]; }
+    double distanceSquared(uint32_t query, uint32_t n) const {
+      return distancesSquared[query * k + n];
+    }
+  };
+
   /**
     Construct a HashSpace
     locations will range from [0..2^resolution)
@@ -238,10 +266,41 @@ public:
   template<typename T>
   HashSpace& move(uint32_t objectId, Vec<3,T> pos);
 
+  /// set the positions of all objects at once
+  /// positions must hold numObjects() positions. The voxels are rebuilt
+  /// across numThreads threads (0 uses all hardware threads)
+  ///
+  /// moveAll() and queryKNN() run on threads kept by the HashSpace between
+  /// calls. Calls from different threads take turns using them.
+  HashSpace& moveAll(const Vec3d * positions, unsigned numThreads = 0);
+
   /// this removes the object from voxels/queries, but does not destroy it
   /// the objectId can be reused later via move()
   HashSpace& remove(uint32_t objectId);
 
+  /**
+    Find the k nearest objects to each of numQueries points
+
+    @param centers array of numQueries query points
+    @param numQueries number of query points
+    @param k maximum number of results per query
+    @param maxRadius only find objects nearer than this distance
+      (at most maxRadius())
+    @param results receives the results, indexed by query
+    @param numThreads number of threads to split the queries across
+      (0 uses all hardware threads)
+  */
+  void queryKNN(const Vec3d * centers, uint32_t numQueries, uint32_t k,
+                double maxRadius, KNNResults& results, unsigned numThreads = 0) const;
+
+  /**
+    Find the k nearest neighbours of every object, excluding the object
+    itself. Results are indexed by object index, objects that are not in the
+    space get no results.
+  */
+  void queryKNN(uint32_t k, double maxRadius, KNNResults& results,
+                unsigned numThreads = 0) const;
+
   /// wrap an absolute position within the space:
   double wrap(double x) const { return wrap(x, dim()); }
   template<typename T>
@@ -262,6 +321,19 @@ public:
   static uint32_t invalidHash() { return UINT_MAX; }
 
 protected:
+  struct Workers;
+
+  // number of ranges to split n items in for numThreads (0 for all hardware threads)
+  unsigned numRanges(uint32_t n, unsigned numThreads) const;
+  // run func(range, begin, end) for ranges contiguous ranges of [0, n), in
+  // parallel on mWorkers. The calling thread takes range 0.
+  void parallelRanges(uint32_t n, unsigned ranges,
+                      const std::function<void(unsigned, uint32_t, uint32_t)>& func) const;
+
+  // k nearest objects to center, sorted by distance. exclude is skipped
+  uint32_t nearestNeighbors(const Vec3d& center, const Object * exclude,
+                            uint32_t k, double maxRadius,
+                            uint32_t * objects, double * distancesSquared) const;
 
   // integer distance squared
   uint32_t distanceSquared(double a1, double a2, double a3) const;
@@ -314,9 +386,18 @@ protected:
 
   /// a baked array of voxel indices sorted by distance
   std::vector<uint32_t> mVoxelIndices;
+  /// the voxel offset (x, y, z) of each entry of mVoxelIndices
+  std::vector<Vec<3,int16_t>> mVoxelOffsets;
+  /// for each shell, the smallest squared distance between points in voxels
+  /// of this or any further shell
+  std::vector<uint32_t> mShellGap2;
   /// a baked array mapping distance to mVoxelIndices offsets
   std::vector<uint32_t> mDistanceToVoxelIndices;
   std::vector<uint32_t> mVoxelIndicesToDistance;
+
+  /// threads for moveAll() and queryKNN(), started on first use
+  mutable std::unique_ptr<Workers> mWorkers;
+  mutable std::mutex mWorkersLock;
 };
 
 
@@ -0,0 +1,122 @@
+#ifndef INCLUDE_AL_ATOMIC_HANDOFF_HPP
+#define INCLUDE_AL_ATOMIC_HANDOFF_HPP
+
+/*  Allolib --
+    Multimedia / virtual environment application class library
+
+    Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+    Copyright (C) 2012-2018. The Regents of the University of California.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the University of California nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    File description:
+    Hands objects built on one thread to a real-time thread and back
+*/
+
+#include <atomic>
+
+namespace al {
+
+/**
+ * @brief Passes objects from a writer thread to a real-time reader thread
+ * without the reader ever allocating or freeing.
+ *
+ * The writer builds an object (e.g. a new set of IRs or a morph) and hands
+ * it over with publish(). The reader picks it up with take(), and when it
+ * is done with an object it gives it back with retire(). Retired objects
+ * are deleted on the writer thread by the next publish() or by clear().
+ * If a published object is replaced before the reader took it, it is
+ * deleted right away.
+ *
+ * T must have a `T *next` member, which links the retired objects. T only
+ * needs to be complete where the AtomicHandoff is destroyed or publish()
+ * and clear() are called, so it can be a type private to a .cpp file as
+ * long as the owner's constructor and destructor are defined there too.
+ *
+ * Only one thread may publish and one thread may take at a time.
+ *
+ * @ingroup allocore
+ */
+template<typename T>
+class AtomicHandoff {
+public:
+  AtomicHandoff() {}
+  ~AtomicHandoff() { clear(); }
+
+  AtomicHandoff(const AtomicHandoff &) = delete;
+  AtomicHandoff &operator=(const AtomicHandoff &) = delete;
+
+  /// Hand an object to the reader. Writer thread
+  void publish(T *object) {
+    freeRetired();
+    destroy(mPending.exchange(object, std::memory_order_acq_rel));
+  }
+
+  /// The object published since the last call, or nullptr. Reader thread
+  T *take() { return mPending.exchange(nullptr, std::memory_order_acq_rel); }
+
+  /// Give back an object the reader no longer uses. Reader thread
+  void retire(T *object) {
+    object->next = mRetired.load(std::memory_order_relaxed);
+    while (!mRetired.compare_exchange_weak(object->next, object, std::memory_order_release,
+                                           std::memory_order_relaxed)) {}
+  }
+
+  /// true if an object was published and not taken yet. Any thread
+  bool pending() const { return mPending.load() != nullptr; }
+
+  /// Delete the retired objects. Writer thread
+  void freeRetired() {
+    T *object = mRetired.exchange(nullptr, std::memory_order_acquire);
+    while (object) {
+      T *next = object->next;
+      destroy(object);
+      object = next;
+    }
+  }
+
+  /// Delete the waiting and the retired objects. Only call when the reader
+  /// is not running
+  void clear() {
+    destroy(mPending.exchange(nullptr));
+    freeRetired();
+  }
+
+private:
+  static void destroy(T *object) {
+    static_assert(sizeof(T) > 0, "AtomicHandoff needs T to be complete here");
+    delete object;
+  }
+
+  std::atomic<T *> mPending {nullptr};
+  std::atomic<T *> mRetired {nullptr}; // Linked list
+};
+
+} // al::
+
+#endif /* include guard */
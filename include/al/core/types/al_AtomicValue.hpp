@@ -0,0 +1,284 @@
+#ifndef INCLUDE_AL_ATOMIC_VALUE_HPP
+#define INCLUDE_AL_ATOMIC_VALUE_HPP
+
+/*  Allolib --
+    Multimedia / virtual environment application class library
+
+    Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+    Copyright (C) 2012-2018. The Regents of the University of California.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the University of California nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    File description:
+    A value that can be read from any thread without locking
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace al {
+
+/**
+ * @brief How AtomicValue stores a type
+ *
+ * 0: std::atomic, for trivially copyable types of up to 8 bytes.
+ * 1: Seqlock with two copies, for larger trivially copyable types
+ *    (e.g. Color, Quatd).
+ * 2: Read-copy-update with two nodes, for everything else (e.g. Vec3f and
+ *    Pose, which have their own copy operations, and std::string).
+ */
+template<typename T>
+struct atomic_value_kind : std::integral_constant<int,
+    !std::is_trivially_copyable<T>::value ? 2
+    : sizeof(T) <= sizeof(uint64_t) ? 0 : 1> {};
+
+/**
+ * @brief The sequence number of a seqlock with two copies of a value
+ *
+ * The writer updates one copy while readers read the other, so a reader
+ * only reads again if a write finished while it was copying, and never
+ * waits for a writer that has been preempted. The copies are kept by the
+ * user, as arrays of std::atomic so that reading while they are written is
+ * defined. AtomicValue uses this for larger trivially copyable types, and
+ * it can be used directly for values whose size is only known at run time.
+ *
+ * Only one thread may write at a time.
+ *
+ * @ingroup allocore
+ */
+class AtomicSequence {
+public:
+  AtomicSequence() {}
+
+  AtomicSequence(const AtomicSequence &) = delete;
+  AtomicSequence &operator=(const AtomicSequence &) = delete;
+
+  /// Call copy(c) with the index (0 or 1) of the copy to read, again until
+  /// it was not rewritten meanwhile. Returns the sequence number read,
+  /// which changes on every write.
+  template<class Function>
+  uint32_t read(Function copy) const {
+    uint32_t sequence = mSequence.load(std::memory_order_acquire);
+    for (;;) {
+      // Copy 0 is written while the sequence is odd, and copy 1 while it
+      // is even
+      // If a word written after the writer moved on to this copy is seen,
+      // so is the new sequence
+      copy(int(sequence & 1));
+      uint32_t check = mSequence.load(std::memory_order_acquire);
+      if (check == sequence) {
+        return sequence;
+      }
+      sequence = check;
+    }
+  }
+
+  /// Call write(c) for copy 0 and then copy 1, moving readers to the other
+  /// copy first. write must store with std::memory_order_release.
+  template<class Function>
+  void write(Function write) {
+    uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+    for (int c = 0; c < 2; c++) {
+      // Readers move to the other copy
+      mSequence.store(++sequence, std::memory_order_release);
+      write(c);
+    }
+  }
+
+  /// Start again from 0. Must not be called while another thread reads or
+  /// writes.
+  void reset() { mSequence.store(0, std::memory_order_release); }
+
+private:
+  std::atomic<uint32_t> mSequence {0};
+};
+
+/**
+ * @brief A value that any number of threads can read and write, where
+ * reading never locks or waits for a writer.
+ *
+ * load() returns a copy of the last value stored. How the value is kept
+ * depends on the type (see atomic_value_kind):
+ *
+ * - Small trivially copyable types are a std::atomic.
+ * - Larger trivially copyable types use a seqlock (see AtomicSequence)
+ *   with two copies of the value, copied as atomic words. Writers are
+ *   serialized with a spin lock.
+ * - Other types can only be copied with their own copy operations, which
+ *   must not run while the value is being written, so there are two nodes
+ *   and a pointer to the current one.
+ *   Readers count themselves in while they copy the current node. A writer
+ *   fills the spare node, makes it current and waits until the readers that
+ *   could still be reading the old node are done before keeping it as the
+ *   spare. Readers don't wait, but writers do and are serialized with a
+ *   mutex.
+ *
+ * @ingroup allocore
+ */
+template<typename T, int Kind = atomic_value_kind<T>::value>
+class AtomicValue;
+
+template<typename T>
+class AtomicValue<T, 0> {
+public:
+  explicit AtomicValue(const T &value = T()) : mValue(value) {}
+
+  AtomicValue(const AtomicValue &) = delete;
+  AtomicValue &operator=(const AtomicValue &) = delete;
+
+  T load() const { return mValue.load(std::memory_order_acquire); }
+  void store(const T &value) { mValue.store(value, std::memory_order_release); }
+
+  /// Call f with the current value
+  template<class Function>
+  void read(Function f) const { f(load()); }
+
+private:
+  std::atomic<T> mValue;
+};
+
+template<typename T>
+class AtomicValue<T, 1> {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "AtomicValue<T, 1> copies values as words, so T must be trivially copyable");
+public:
+  explicit AtomicValue(const T &value = T()) {
+    Word words[numWords];
+    toWords(value, words);
+    for (int c = 0; c < 2; c++) {
+      for (size_t i = 0; i < numWords; i++) {
+        mCopies[c][i].store(words[i], std::memory_order_relaxed);
+      }
+    }
+  }
+
+  AtomicValue(const AtomicValue &) = delete;
+  AtomicValue &operator=(const AtomicValue &) = delete;
+
+  T load() const {
+    Word words[numWords];
+    mSequence.read([&](int c) {
+      for (size_t i = 0; i < numWords; i++) {
+        words[i] = mCopies[c][i].load(std::memory_order_acquire);
+      }
+    });
+    T value;
+    memcpy(static_cast<void *>(&value), words, sizeof(T));
+    return value;
+  }
+
+  /// Call f with the current value
+  template<class Function>
+  void read(Function f) const { f(load()); }
+
+  void store(const T &value) {
+    Word words[numWords];
+    toWords(value, words);
+    while (mWriting.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    mSequence.write([&](int c) {
+      for (size_t i = 0; i < numWords; i++) {
+        mCopies[c][i].store(words[i], std::memory_order_release);
+      }
+    });
+    mWriting.clear(std::memory_order_release);
+  }
+
+private:
+  typedef typename std::conditional<sizeof(T) % sizeof(uint64_t) == 0, uint64_t,
+          typename std::conditional<sizeof(T) % sizeof(uint32_t) == 0, uint32_t,
+          uint8_t>::type>::type Word;
+  static const size_t numWords = sizeof(T) / sizeof(Word);
+
+  static void toWords(const T &value, Word *words) {
+    memcpy(words, static_cast<const void *>(&value), sizeof(T));
+  }
+
+  AtomicSequence mSequence;
+  std::atomic<Word> mCopies[2][numWords];
+  std::atomic_flag mWriting = ATOMIC_FLAG_INIT;
+};
+
+template<typename T>
+class AtomicValue<T, 2> {
+public:
+  explicit AtomicValue(const T &value = T()) : mNodes{value, value} {}
+
+  AtomicValue(const AtomicValue &) = delete;
+  AtomicValue &operator=(const AtomicValue &) = delete;
+
+  T load() const {
+    unsigned int epoch = mEpoch.load() & 1;
+    mReaders[epoch].fetch_add(1);
+    T value = *mCurrent.load();
+    mReaders[epoch].fetch_sub(1);
+    return value;
+  }
+
+  /// Call f with a const reference to the current value, without copying
+  /// it. Writers wait for f to return, so f must be short and not store.
+  template<class Function>
+  void read(Function f) const {
+    unsigned int epoch = mEpoch.load() & 1;
+    mReaders[epoch].fetch_add(1);
+    f(static_cast<const T &>(*mCurrent.load()));
+    mReaders[epoch].fetch_sub(1);
+  }
+
+  void store(const T &value) {
+    std::lock_guard<std::mutex> lock(mWriteLock);
+    *mSpare = value;
+    mSpare = mCurrent.exchange(mSpare);
+    // Readers of the old node counted themselves in before the exchange,
+    // under either epoch. Flip the epoch twice so that each counter only
+    // has readers that started before the flip when it is waited on.
+    for (int i = 0; i < 2; i++) {
+      unsigned int epoch = mEpoch.fetch_add(1) & 1;
+      while (mReaders[epoch].load() != 0) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+private:
+  T mNodes[2];
+  std::atomic<T *> mCurrent {&mNodes[0]};
+  T *mSpare {&mNodes[1]};
+  std::atomic<unsigned int> mEpoch {0};
+  mutable std::atomic<int> mReaders[2] {{0}, {0}};
+  std::mutex mWriteLock;
+};
+
+} // al::
+
+#endif /* include guard */
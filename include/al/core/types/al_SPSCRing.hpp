@@ -0,0 +1,292 @@
+#ifndef INCLUDE_AL_SPSC_RING_HPP
+#define INCLUDE_AL_SPSC_RING_HPP
+
+/*  Allolib --
+    Multimedia / virtual environment application class library
+
+    Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+    Copyright (C) 2012-2018. The Regents of the University of California.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the University of California nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    File description:
+    Typed single-producer single-consumer ring with in-place access
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace al {
+
+inline uint32_t next_power_of_two(uint32_t v){
+  --v;
+  v |= v >> 1;
+  v |= v >> 2;
+  v |= v >> 4;
+  v |= v >> 8;
+  v |= v >>16;
+  return v+1;
+}
+
+/**
+ * @brief Contiguous range of a ring returned by reserveWrite() and reserveRead()
+ */
+template<typename T>
+struct SPSCSpan {
+  T *data;
+  size_t size; ///< In items of the ring (values, or frames for SPSCFrameRing)
+};
+
+/**
+ * @brief Lock-free ring shared by one writer thread and one reader thread.
+ *
+ * The write and read positions are atomic and only ever increase. The
+ * writer publishes a position with a release store after the items before
+ * it have been written, and the reader publishes its position the same way
+ * after it is done with the items, so neither side can see an item that is
+ * half written or overwrite one still being read. Each side keeps the last
+ * position it saw from the other and only loads it again when that is not
+ * enough, and the positions are on separate cache lines.
+ *
+ * Items can be copied in and out with write() and read(), or accessed in
+ * place: reserveWrite() returns the contiguous free space, which is then
+ * filled and published with commitWrite(), and reserveRead() returns the
+ * contiguous readable items, which are released with commitRead(). A span
+ * may be shorter than requested at the end of the storage, so call again
+ * for the rest.
+ *
+ * All storage is allocated in the constructor. No member function locks,
+ * allocates or blocks.
+ *
+ * @code
+ * SPSCRing<float> ring(1024);
+ * // Writer thread
+ * auto span = ring.reserveWrite(n);
+ * generate(span.data, span.size);
+ * ring.commitWrite(span.size);
+ * // Reader thread
+ * while ((span = ring.reserveRead(1024)).size > 0) {
+ *   consume(span.data, span.size);
+ *   ring.commitRead(span.size);
+ * }
+ * @endcode
+ *
+ * @ingroup allocore
+ */
+template<typename T>
+class SPSCRing {
+public:
+  typedef SPSCSpan<T> Span;
+  typedef SPSCSpan<const T> ConstSpan;
+
+  /** Allocate the ring. Capacity rounded up to next power of 2. */
+  explicit SPSCRing(size_t capacity = 256) : SPSCRing(capacity, 1) {}
+
+  SPSCRing(const SPSCRing &) = delete;
+  SPSCRing &operator=(const SPSCRing &) = delete;
+
+  /** Maximum number of items the ring can hold. */
+  size_t capacity() const { return mCapacity; }
+
+  /** Number of items that can be written. Call from the writer thread. */
+  size_t writeSpace() const {
+    return mCapacity - (mWrite.load(std::memory_order_relaxed) - mRead.load(std::memory_order_acquire));
+  }
+
+  /** Number of items that can be read. Call from the reader thread. */
+  size_t readSpace() const {
+    return mWrite.load(std::memory_order_acquire) - mRead.load(std::memory_order_relaxed);
+  }
+
+  /** Get up to count contiguous free items to write to. Writer thread only. */
+  Span reserveWrite(size_t count) {
+    size_t w = mWrite.load(std::memory_order_relaxed);
+    if (mCapacity - (w - mReadCache) < count) {
+      mReadCache = mRead.load(std::memory_order_acquire);
+    }
+    size_t index = w & mWrap;
+    count = std::min(count, std::min(mCapacity - (w - mReadCache), mCapacity - index));
+    return Span {mData.get() + index * mStride, count};
+  }
+
+  /** Publish count items written after reserveWrite(). Writer thread only. */
+  void commitWrite(size_t count) {
+    mWrite.store(mWrite.load(std::memory_order_relaxed) + count, std::memory_order_release);
+  }
+
+  /** Get up to count contiguous items to read. Reader thread only. */
+  ConstSpan reserveRead(size_t count) {
+    size_t r = mRead.load(std::memory_order_relaxed);
+    if (mWriteCache - r < count) {
+      mWriteCache = mWrite.load(std::memory_order_acquire);
+    }
+    size_t index = r & mWrap;
+    count = std::min(count, std::min(mWriteCache - r, mCapacity - index));
+    return ConstSpan {mData.get() + index * mStride, count};
+  }
+
+  /** Release count items read after reserveRead(). Reader thread only. */
+  void commitRead(size_t count) {
+    mRead.store(mRead.load(std::memory_order_relaxed) + count, std::memory_order_release);
+  }
+
+  /** Push a value. Returns false if the ring is full. Writer thread only. */
+  bool push(const T &value) {
+    Span span = reserveWrite(1);
+    if (span.size == 0) {
+      return false;
+    }
+    span.data[0] = value;
+    commitWrite(1);
+    return true;
+  }
+
+  /** Pop a value. Returns false if the ring is empty. Reader thread only. */
+  bool pop(T &value) {
+    ConstSpan span = reserveRead(1);
+    if (span.size == 0) {
+      return false;
+    }
+    value = span.data[0];
+    commitRead(1);
+    return true;
+  }
+
+  /** Copy up to count items in. Returns items written. Writer thread only. */
+  size_t write(const T *src, size_t count) {
+    size_t written = 0;
+    while (written < count) {
+      Span span = reserveWrite(count - written);
+      if (span.size == 0) {
+        break;
+      }
+      std::copy(src + written * mStride, src + (written + span.size) * mStride, span.data);
+      commitWrite(span.size);
+      written += span.size;
+    }
+    return written;
+  }
+
+  /** Copy up to count items out. Returns items read. Reader thread only. */
+  size_t read(T *dst, size_t count) {
+    size_t done = peek(dst, count);
+    commitRead(done);
+    return done;
+  }
+
+  /** Copy up to count items out without releasing them. Reader thread only. */
+  size_t peek(T *dst, size_t count) {
+    size_t r = mRead.load(std::memory_order_relaxed);
+    mWriteCache = mWrite.load(std::memory_order_acquire);
+    count = std::min(count, mWriteCache - r);
+    size_t index = r & mWrap;
+    size_t first = std::min(count, mCapacity - index);
+    const T *data = mData.get();
+    std::copy(data + index * mStride, data + (index + first) * mStride, dst);
+    std::copy(data, data + (count - first) * mStride, dst + first * mStride);
+    return count;
+  }
+
+  /** Discard all items that can be read. Reader thread only. */
+  void clear() {
+    mWriteCache = mWrite.load(std::memory_order_acquire);
+    mRead.store(mWriteCache, std::memory_order_release);
+  }
+
+protected:
+  // Items of stride values each
+  SPSCRing(size_t capacity, size_t stride)
+    : mCapacity(next_power_of_two(uint32_t(std::max<size_t>(capacity, 2)))),
+      mWrap(mCapacity - 1),
+      mStride(stride),
+      mData(new T[mCapacity * stride]())
+  {}
+
+  const size_t mCapacity;
+  const size_t mWrap;
+  const size_t mStride;
+  std::unique_ptr<T[]> mData;
+
+private:
+  // Writer and reader state on separate cache lines
+  char mPad0[64];
+  std::atomic<size_t> mWrite {0};
+  size_t mReadCache {0};    // Last read position seen by the writer
+  char mPad1[64];
+  std::atomic<size_t> mRead {0};
+  size_t mWriteCache {0};   // Last write position seen by the reader
+  char mPad2[64];
+};
+
+/**
+ * @brief SPSCRing of interleaved audio frames
+ *
+ * Positions and sizes are in frames of channels() samples, and spans point
+ * to whole interleaved frames, so a span can be passed directly to code
+ * that reads or writes interleaved audio.
+ *
+ * @ingroup allocore
+ */
+template<typename T = float>
+class SPSCFrameRing : public SPSCRing<T> {
+public:
+  /** Allocate the ring. Frames rounded up to next power of 2. */
+  SPSCFrameRing(size_t frames, unsigned int channels)
+    : SPSCRing<T>(frames, std::max(1u, channels)) {}
+
+  unsigned int channels() const { return unsigned(this->mStride); }
+
+  /** Interleave and write up to numFrames frames from one buffer per
+      channel. Returns frames written. Writer thread only. */
+  size_t writeChannels(const T *const *buffers, size_t numFrames) {
+    size_t written = 0;
+    while (written < numFrames) {
+      auto span = this->reserveWrite(numFrames - written);
+      if (span.size == 0) {
+        break;
+      }
+      for (size_t c = 0; c < this->mStride; c++) {
+        const T *src = buffers[c] + written;
+        T *dst = span.data + c;
+        for (size_t i = 0; i < span.size; i++) {
+          dst[i * this->mStride] = src[i];
+        }
+      }
+      this->commitWrite(span.size);
+      written += span.size;
+    }
+    return written;
+  }
+};
+
+} // al::
+
+#endif /* include guard */
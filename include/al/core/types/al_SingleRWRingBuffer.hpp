@@ -45,7 +45,7 @@
 #include <cstring>
 #include <inttypes.h>
 
-//#include "allocore/system/pstdint.h"
+#include "al/core/types/al_SPSCRing.hpp"
 
 namespace al {
 
@@ -54,156 +54,53 @@ namespace al {
  * a reader, one a writer. There is no locking in this ring buffer,
  * so it is ideal to pass data to and from a high priority thread
  * like an audio thread.
+ *
+ * This is a byte interface to SPSCRing, which should be preferred for
+ * new code as it is typed and can be accessed in place.
  */
 
 /// @ingroup allocore
 class SingleRWRingBuffer {
 public:
 
-    /** Allocate ringbuffer.
-        Actual size rounded up to next power of 2. */
-	SingleRWRingBuffer(size_t sz=256);
+	/** Allocate ringbuffer.
+		Actual size rounded up to next power of 2. */
+	SingleRWRingBuffer(size_t sz=256) : mRing(sz) {}
 
-	~SingleRWRingBuffer();
-
-    /** The number of bytes available for writing.
+	/** The number of bytes available for writing.
 	*/
-	size_t writeSpace() const;
+	size_t writeSpace() const { return mRing.writeSpace(); }
 
 
-    /** The number of bytes available for reading.
+	/** The number of bytes available for reading.
 	*/
-	size_t readSpace() const;
+	size_t readSpace() const { return mRing.readSpace(); }
 
 
-    /** Copy sz bytes from src into the ringbuffer.
-        Returns bytes actually copied.
+	/** Copy sz bytes from src into the ringbuffer.
+		Returns bytes actually copied.
 	*/
-	size_t write(const char * src, size_t sz);
+	size_t write(const char * src, size_t sz) { return mRing.write(src, sz); }
 
-    /** Read sz bytes of data from the ring buffer and advance the read pointer.
-		Returns bytes actually copied
+	/** Read sz bytes of data from the ring buffer and advance the read pointer.
+	Returns bytes actually copied
 	*/
-	size_t read(char * dst, size_t sz);
+	size_t read(char * dst, size_t sz) { return mRing.read(dst, sz); }
 
-    /** Read data without advancing the read pointer
-        Returns bytes actually copied
+	/** Read data without advancing the read pointer
+		Returns bytes actually copied
 	*/
-	size_t peek(char * dst, size_t sz);
+	size_t peek(char * dst, size_t sz) { return mRing.peek(dst, sz); }
 
-    /** Clear any data in the ringbuffer
+	/** Clear any data in the ringbuffer. Call from the reader thread.
 	*/
-    void clear()
-    {
-        mRead = mWrite;
-    }
+	void clear() { mRing.clear(); }
 
 protected:
 
-	size_t mSize, mWrap;
-	size_t mRead, mWrite;
-	char * mData;
+	SPSCRing<char> mRing;
 };
 
-
-inline uint32_t next_power_of_two(uint32_t v){
-	--v;
-	v |= v >> 1;
-	v |= v >> 2;
-	v |= v >> 4;
-	v |= v >> 8;
-	v |= v >>16;
-	return v+1;
-}
-
-inline SingleRWRingBuffer :: SingleRWRingBuffer(size_t sz)
-:	mSize(next_power_of_two(sz)),
-	mWrap(mSize-1),
-	mRead(0),
-	mWrite(0)
-{
-	mData = new char[mSize];
-}
-
-inline SingleRWRingBuffer :: ~SingleRWRingBuffer() {
-	delete[] mData;
-}
-
-inline size_t SingleRWRingBuffer :: writeSpace() const {
-	const size_t r = mRead;
-	const size_t w = mWrite;
-	if (r==w) return mWrap;
-	return ((mSize + (r - w)) & mWrap) - 1;
-}
-
-inline size_t SingleRWRingBuffer :: readSpace() const {
-	const size_t r = mRead;
-	const size_t w = mWrite;
-	return (mSize + (w - r)) & mWrap;
-}
-
-inline size_t SingleRWRingBuffer :: write(const char * src, size_t sz) {
-	size_t space = writeSpace();
-	sz = sz > space ? space : sz;
-	if (sz == 0) return 0;
-
-	size_t w = mWrite;
-	size_t end = w + sz;
-
-	if (end < mSize) {
-		memcpy(mData+w, src, sz);
-	} else {
-		size_t split = mSize-w;
-		end &= mWrap;
-		memcpy(mData+w, src, split);
-		memcpy(mData, src+split, end);
-	}
-
-	mWrite = end;
-	return sz;
-}
-
-inline size_t SingleRWRingBuffer :: read(char * dst, size_t sz) {
-	size_t space = readSpace();
-	sz = sz > space ? space : sz;
-	if (sz == 0) return 0;
-
-	size_t r = mRead;
-	size_t end = r + sz;
-
-	if (end < mSize) {
-		memcpy(dst, mData+r, sz);
-	} else {
-		size_t split = mSize-r;
-		end &= mWrap;
-		memcpy(dst, mData+r, split);
-		memcpy(dst+split, mData, end);
-	}
-
-	mRead = end;
-	return sz;
-}
-
-inline size_t SingleRWRingBuffer :: peek(char * dst, size_t sz) {
-	size_t space = readSpace();
-	sz = sz > space ? space : sz;
-	if (sz == 0) return 0;
-
-	size_t r = mRead;
-	size_t end = r + sz;
-
-	if (end < mSize) {
-		memcpy(dst, mData+r, sz);
-	} else {
-		size_t split = mSize-r;
-		end &= mWrap;
-		memcpy(dst, mData+r, split);
-		memcpy(dst+split, mData, end);
-	}
-    return sz;
-}
-
-
 } // al::
 
 #endif /* include guard */
@@ -0,0 +1,141 @@
+#ifndef INCLUDE_AL_MPSC_RING_BUFFER_HPP
+#define INCLUDE_AL_MPSC_RING_BUFFER_HPP
+
+/*  Allolib --
+    Multimedia / virtual environment application class library
+
+    Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+    Copyright (C) 2012-2018. The Regents of the University of California.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the University of California nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    File description:
+    Passing values from many threads to a single reader without locking
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "al/util/al_SingleRWRingBuffer.hpp"
+
+namespace al {
+
+/**
+ * @brief Bounded lock-free multiple-writer-single-reader queue.
+ *
+ * Any number of threads can push() concurrently while a single thread pops.
+ * All storage is allocated in the constructor, so neither push() nor pop()
+ * allocate, lock or block: push() returns false when the queue is full and
+ * pop() returns false when it is empty. This makes it suitable to pass
+ * messages from UI, MIDI or network threads into the audio thread.
+ *
+ * Each slot carries a sequence number that tells writers when the slot is
+ * free and the reader when the value in it has been published.
+ *
+ * @ingroup allocore
+ */
+template<typename T>
+class MPSCRingBuffer {
+public:
+  /** Allocate the queue. Actual size rounded up to next power of 2. */
+  MPSCRingBuffer(size_t size = 256)
+    : mSize(next_power_of_two(uint32_t(size < 2 ? 2 : size))),
+      mWrap(mSize - 1),
+      mSlots(new Slot[mSize])
+  {
+    for (size_t i = 0; i < mSize; i++) {
+      mSlots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /** Maximum number of values the queue can hold. */
+  size_t capacity() const { return mSize; }
+
+  /** Push a value. Can be called from any thread.
+      Returns false if the queue is full. */
+  bool push(const T &value) {
+    size_t pos = mWrite.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &slot = mSlots[pos & mWrap];
+      size_t seq = slot.sequence.load(std::memory_order_acquire);
+      intptr_t diff = intptr_t(seq) - intptr_t(pos);
+      if (diff == 0) {
+        if (mWrite.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          slot.value = value;
+          slot.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // full
+      } else {
+        pos = mWrite.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /** Pop a value. Must only be called from the single reader thread.
+      Returns false if the queue is empty. */
+  bool pop(T &value) {
+    Slot &slot = mSlots[mRead & mWrap];
+    size_t seq = slot.sequence.load(std::memory_order_acquire);
+    if (intptr_t(seq) - intptr_t(mRead + 1) < 0) {
+      return false; // empty or write still in progress
+    }
+    value = slot.value;
+    slot.sequence.store(mRead + mSize, std::memory_order_release);
+    mRead++;
+    return true;
+  }
+
+  /** Number of values waiting to be read. Call from the reader thread. */
+  size_t readSpace() const {
+    size_t w = mWrite.load(std::memory_order_relaxed);
+    return w - mRead;
+  }
+
+private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  const size_t mSize;
+  const size_t mWrap;
+  std::unique_ptr<Slot[]> mSlots;
+  // Keep writer and reader indices on separate cache lines
+  char mPad0[64];
+  std::atomic<size_t> mWrite {0};
+  char mPad1[64];
+  size_t mRead {0};
+};
+
+} // al::
+
+#endif /* include guard */
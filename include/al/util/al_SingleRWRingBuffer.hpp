@@ -1,5 +1,5 @@
-#ifndef INCLUDE_AL_SINGLE_READER_WRITER_RING_BUFFER_HPP
-#define INCLUDE_AL_SINGLE_READER_WRITER_RING_BUFFER_HPP
+#ifndef INCLUDE_AL_UTIL_SINGLE_READER_WRITER_RING_BUFFER_HPP
+#define INCLUDE_AL_UTIL_SINGLE_READER_WRITER_RING_BUFFER_HPP
 
 /*  Allocore --
   Multimedia / virtual environment application class library
@@ -36,165 +36,13 @@
 
 
   File description:
-  Passing data between a pair of threads without locking
+  Passing data between a pair of threads without locking. Moved to
+  al/core/types/al_SingleRWRingBuffer.hpp
 
   File author(s):
   Graham Wakefield, 2010, grrrwaaa@gmail.com
 */
 
-#include <cstring>
-#include <cstdint>
-
-namespace al {
-
-/** Lock free single-reader-single-writer ring buffer.
- * Can be used to stream data safely between two threads, one being
- * a reader, one a writer. There is no locking in this ring buffer,
- * so it is ideal to pass data to and from a high priority thread
- * like an audio thread.
- */
-
-/// @ingroup allocore
-class SingleRWRingBuffer {
-public:
-
-    /** Allocate ringbuffer.
-        Actual size rounded up to next power of 2. */
-  SingleRWRingBuffer(size_t sz=256);
-
-  ~SingleRWRingBuffer();
-
-    /** The number of bytes available for writing.
-  */
-  size_t writeSpace() const;
-
-
-    /** The number of bytes available for reading.
-  */
-  size_t readSpace() const;
-
-
-    /** Copy sz bytes from src into the ringbuffer.
-        Returns bytes actually copied.
-  */
-  size_t write(const char * src, size_t sz);
-
-    /** Read sz bytes of data from the ring buffer and advance the read pointer.
-    Returns bytes actually copied
-  */
-  size_t read(char * dst, size_t sz);
-
-    /** Read data without advancing the read pointer
-        Returns bytes actually copied
-  */
-  size_t peek(char * dst, size_t sz);
-
-protected:
-
-  size_t mSize, mWrap;
-  size_t mRead, mWrite;
-  char * mData;
-};
-
-
-inline uint32_t next_power_of_two(uint32_t v){
-  --v;
-  v |= v >> 1;
-  v |= v >> 2;
-  v |= v >> 4;
-  v |= v >> 8;
-  v |= v >>16;
-  return v+1;
-}
-
-inline SingleRWRingBuffer :: SingleRWRingBuffer(size_t sz)
-:  mSize(next_power_of_two(sz)),
-  mWrap(mSize-1),
-  mRead(0),
-  mWrite(0)
-{
-  mData = new char[mSize];
-}
-
-inline SingleRWRingBuffer :: ~SingleRWRingBuffer() {
-  delete[] mData;
-}
-
-inline size_t SingleRWRingBuffer :: writeSpace() const {
-  const size_t r = mRead;
-  const size_t w = mWrite;
-  if (r==w) return mWrap;
-  return ((mSize + (r - w)) & mWrap) - 1;
-}
-
-inline size_t SingleRWRingBuffer :: readSpace() const {
-  const size_t r = mRead;
-  const size_t w = mWrite;
-  return (mSize + (w - r)) & mWrap;
-}
-
-inline size_t SingleRWRingBuffer :: write(const char * src, size_t sz) {
-  size_t space = writeSpace();
-  sz = sz > space ? space : sz;
-  if (sz == 0) return 0;
-
-  size_t w = mWrite;
-  size_t end = w + sz;
-
-  if (end < mSize) {
-    memcpy(mData+w, src, sz);
-  } else {
-    size_t split = mSize-w;
-    end &= mWrap;
-    memcpy(mData+w, src, split);
-    memcpy(mData, src+split, end);
-  }
-
-  mWrite = end;
-  return sz;
-}
-
-inline size_t SingleRWRingBuffer :: read(char * dst, size_t sz) {
-  size_t space = readSpace();
-  sz = sz > space ? space : sz;
-  if (sz == 0) return 0;
-
-  size_t r = mRead;
-  size_t end = r + sz;
-
-  if (end < mSize) {
-    memcpy(dst, mData+r, sz);
-  } else {
-    size_t split = mSize-r;
-    end &= mWrap;
-    memcpy(dst, mData+r, split);
-    memcpy(dst+split, mData, end);
-  }
-
-  mRead = end;
-  return sz;
-}
-
-inline size_t SingleRWRingBuffer :: peek(char * dst, size_t sz) {
-  size_t space = readSpace();
-  sz = sz > space ? space : sz;
-  if (sz == 0) return 0;
-
-  size_t r = mRead;
-  size_t end = r + sz;
-
-  if (end < mSize) {
-    memcpy(dst, mData+r, sz);
-  } else {
-    size_t split = mSize-r;
-    end &= mWrap;
-    memcpy(dst, mData+r, split);
-    memcpy(dst+split, mData, end);
-  }
-  return sz;
-}
-
-
-} // al::
+#include "al/core/types/al_SingleRWRingBuffer.hpp"
 
 #endif /* include guard */
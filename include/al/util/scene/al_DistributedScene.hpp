@@ -245,7 +245,7 @@ bool DistributedScene::consumeMessage(osc::Message &m, std::string rootOSCPath)
       if (m.typeTags() == "i") {
           int id;
           m >> id;
-          mVoiceIdsToFree.write((const char*) &id, sizeof (int));
+          mVoiceIdsToFree.push(id);
           if (verbose()) {
             std::cout << "FREE received " << id << std::endl;
           }
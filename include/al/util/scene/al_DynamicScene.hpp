@@ -42,9 +42,11 @@
 	Andrés Cabrera mantaraya36@gmail.com
 */
 
+#include <cstdint>
 #include <memory>
 #include <thread>
 #include <queue>
+#include <atomic>
 #include <condition_variable>
 
 #include "al/core/spatial/al_Pose.hpp"
@@ -63,6 +65,7 @@ namespace al
  * @brief The PositionedVoice class
  */
 class PositionedVoice : public SynthVoice {
+    friend class DynamicScene;
 public:
     const Pose pose() {return mPose.get();}
 
@@ -132,6 +135,22 @@ public:
         return pFields;
     }
 
+    virtual int getTriggerParams(float *pFields, int maxParams = -1) override {
+        if (!triggerParamsDirect()) {
+            return copyTriggerParams(pFields, maxParams);
+        }
+        int count = SynthVoice::getTriggerParams(pFields, maxParams);
+        Pose currentPose = pose();
+        auto *comps = currentPose.quat().components;
+        float poseFields[8] = {float(currentPose.x()), float(currentPose.y()), float(currentPose.z()),
+                               float(comps[0]), float(comps[1]), float(comps[2]), float(comps[3]),
+                               mSize.get()};
+        for (int i = 0; i < 8 && count != maxParams; i++) {
+            pFields[count++] = poseFields[i];
+        }
+        return count;
+    }
+
 protected:
     /**
      * @brief Set voice as part of a replica distributed scene
@@ -146,6 +165,13 @@ protected:
 
     bool mUseDistAtten {true};
     bool mIsReplica {false}; // If voice is replica, it should not send its internal state but listen for changes.
+
+private:
+    // Direction rendered in the previous audio block. Spatializer gains are
+    // ramped from it when the voice keeps playing in the next block.
+    Vec3d mLastListeningDir;
+    uint64_t mLastRenderBlock {0};
+    int mLastRenderId {-1};
 };
 
 
@@ -188,6 +214,81 @@ void ThreadPool::enqueue(F&& f, UpdateThreadFuncData &data)
     cv_task.notify_one();
 }
 
+/**
+ * @brief Fork/join executor for work that must finish within an audio block
+ *
+ * run() splits a number of tasks among the calling thread and the worker
+ * threads, and returns when all tasks are done. Each participant starts on
+ * its own contiguous range of tasks and steals from the ranges of the others
+ * once its own range is exhausted, so uneven task costs don't leave threads
+ * idle. Workers spin between calls to avoid wake up latency and only block
+ * after being idle for longer than the spin time. Nothing is allocated and no
+ * locks are taken in run() while the workers are spinning.
+ */
+class ForkJoinPool
+{
+public:
+    /**
+     * @param numWorkers number of threads to create. The thread calling run()
+     * also processes tasks, so run() uses numWorkers + 1 threads.
+     */
+    ForkJoinPool(unsigned int numWorkers);
+
+    ~ForkJoinPool();
+
+    /// Number of threads that process tasks, including the caller of run()
+    unsigned int size() { return mNumThreads; }
+
+    /**
+     * @brief Call func(taskIndex, threadIndex) for every task in [0, numTasks)
+     *
+     * threadIndex is in [0, size()) and identifies the thread running the
+     * task, so it can be used to index per-thread scratch data. Only one
+     * thread may call run() at a time.
+     */
+    template<class F>
+    void run(unsigned int numTasks, F &func) {
+        mTask = &func;
+        mTaskFunction = [](void *task, unsigned int taskIndex, unsigned int threadIndex) {
+            (*static_cast<F *>(task))(taskIndex, threadIndex);
+        };
+        runTasks(numTasks);
+    }
+
+    /// Time workers spin waiting for work before blocking
+    void spinTime(double seconds) { mSpinTimeSec = seconds; }
+
+    void stopThreads();
+
+private:
+    struct TaskRange {
+        std::atomic<unsigned int> next {0};
+        unsigned int end {0};
+        char pad[64 - sizeof(std::atomic<unsigned int>) - sizeof(unsigned int)]; // Avoid false sharing between ranges
+    };
+
+    void runTasks(unsigned int numTasks);
+    void processTasks(unsigned int threadIndex);
+    void workerLoop(unsigned int threadIndex);
+
+    std::vector<std::thread> mWorkers;
+    std::unique_ptr<TaskRange[]> mRanges; // One per thread, index 0 is the caller of run()
+    unsigned int mNumThreads;
+
+    void *mTask {nullptr};
+    void (*mTaskFunction)(void *, unsigned int, unsigned int) {nullptr};
+
+    std::atomic<unsigned int> mGeneration {0};
+    std::atomic<unsigned int> mBusyWorkers {0};
+    std::atomic<bool> mRunning {true};
+    double mSpinTimeSec {0.01};
+
+    // Used only to wake workers that stopped spinning
+    std::atomic<unsigned int> mSleepingWorkers {0};
+    std::mutex mSleepLock;
+    std::condition_variable mWakeUp;
+};
+
 /**
  * @brief The DynamicScene class
  */
@@ -244,6 +345,16 @@ public:
     virtual void update(double dt = 0) final;
 
     void setUpdateThreaded(bool threaded) { mThreadedUpdate = threaded; }
+
+    /**
+     * @brief Render voices in parallel using the thread pool
+     *
+     * Voices are split into chunks, and each chunk is rendered into its own
+     * buffers, which are then added to the output in chunk order. The output
+     * therefore doesn't depend on which thread rendered each voice. Voices
+     * must not share state that is modified in onProcess(). Has no effect if
+     * the scene was created with a thread pool size of 0.
+     */
     void setAudioThreaded(bool threaded) { mThreadedAudio = threaded; }
 
     DistAtten<> &distanceAttenuation() {return mDistAtten;}
@@ -259,12 +370,10 @@ public:
      * only have effect if threading is enabled for simulation or audio
      */
     void stopAudioThreads() {
-      mSynthRunning = false;
-      mThreadTrigger.notify_all();
-      for (auto &thr : mAudioThreads) {
-          thr.join();
+      if (mAudioWorkers) {
+        mAudioWorkers->stopThreads();
+        mAudioWorkers = nullptr;
       }
-      mAudioThreads.clear();
     }
 
 protected:
@@ -276,6 +385,7 @@ private:
     std::shared_ptr<Spatializer> mSpatializer;
 
     Pose mListenerPose;
+    bool mSpatializerRotates {false}; // Listener orientation applied by the spatializer
     DistAtten<> mDistAtten;
 
     // For threaded simulation
@@ -284,20 +394,19 @@ private:
 
     // For threaded audio
     bool mThreadedAudio {false};
-    std::vector<std::thread> mAudioThreads;
-    std::vector<AudioIOData> mThreadedAudioData;
-    std::map<int, std::vector<int>> mThreadMap; // Defines which threads run which voices. Key is thread id, value is voice ids.
-    std::condition_variable mThreadTrigger;
-    std::condition_variable mAudioThreadDone;
-    std::mutex mSpatializerLock;
-    AudioIOData *externalAudioIO; // This is captured by the audio callback and passed to the audio threads. Protected by mSpatializerLock
-    std::mutex mThreadTriggerLock;
-    bool mSynthRunning {true};
-    unsigned int mAudioBusy = 0;
+    std::unique_ptr<ForkJoinPool> mAudioWorkers;
+    std::vector<AudioIOData> mThreadedAudioData; // Voice output buffers, one per thread
+    std::vector<AudioIOData> mChunkAudioData; // Spatialized output, one per chunk of voices
+    std::vector<SynthVoice *> mVoicesToRender;
+    std::mutex mSpatializerLock; // Used when the spatializer can't render concurrently
+    static const unsigned int mChunksPerThread = 4;
+    uint64_t mRenderBlock {0}; // Audio blocks rendered
 
     static void updateThreadFunc(UpdateThreadFuncData data);
 
-    static void audioThreadFunc(DynamicScene *scene, int id);
+    // Render voice into internalIO and spatialize its output into io.
+    // threaded is true when called concurrently from the audio worker threads
+    void renderVoice(SynthVoice *voice, AudioIOData &internalIO, AudioIOData &io, bool threaded);
 
     // World marker
     bool mDrawWorldMarker {false};
@@ -45,14 +45,18 @@
 #include <vector>
 #include <string>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
 #include <thread>
 #include <chrono>
 #include <typeindex>
+#include <type_traits>
 
 #include "al/core/graphics/al_Graphics.hpp"
 #include "al/core/io/al_AudioIOData.hpp"
+#include "al/core/io/al_AudioProfiler.hpp"
 #include "al/util/ui/al_Parameter.hpp"
-#include "al/util/al_SingleRWRingBuffer.hpp"
+#include "al/util/al_MPSCRingBuffer.hpp"
 
 namespace al
 {
@@ -109,7 +113,7 @@ public:
     }
   }
 
-  ParameterDataType type() {return mType;}
+  ParameterDataType type() const {return mType;}
 
   //    float get() {
   //        assert(mType == FLOAT);
@@ -117,7 +121,7 @@ public:
   //    }
 
   template<typename type>
-  type get() {
+  type get() const {
     //        assert(mType == STRING);
     return *static_cast<type *>(mData);
   }
@@ -159,6 +163,23 @@ private:
   void *mData;
 };
 
+// Deduce the class that declares each getTriggerParams() overload found in a voice class.
+template<class TVoice>
+TVoice *triggerParamsVectorClass(std::vector<ParameterField> (TVoice::*)());
+
+template<class TVoice>
+TVoice *triggerParamsArrayClass(int (TVoice::*)(float *, int));
+
+// std::true_type if both overloads of getTriggerParams() are visible in TVoice
+// and declared by the same class. A voice that overrides only the std::vector
+// version hides the other one and gets std::false_type.
+template<class TVoice>
+auto triggerParamsPaired(int) -> std::is_same<decltype(triggerParamsVectorClass(&TVoice::getTriggerParams)),
+                                              decltype(triggerParamsArrayClass(&TVoice::getTriggerParams))>;
+
+template<class TVoice>
+std::false_type triggerParamsPaired(...);
+
 /**
  * @brief The SynthVoice class
  *
@@ -296,26 +317,34 @@ public:
      * @param maxParams the maximum number of parameters to process (i.e. the allocated size of pFields)
      * @return the number of parameters written
      *
-     * Copy the values from the internal parameters that have been
-     * registered using registerParameterAsField or the << operator.
+     * By default this copies the float values from the std::vector version of
+     * getTriggerParams(), so it allocates. String and menu parameters are
+     * written as 0.
+     *
+     * Voices allocated by PolySynth whose class declares both overloads of
+     * getTriggerParams() in the same place (e.g. voices that override neither)
+     * copy their internal parameters directly instead, without allocating,
+     * so this can be called from the audio thread. If you override both,
+     * make them write the same fields.
      */
-  int getTriggerParams(float *pFields, int maxParams = -1) {
-    std::vector<ParameterField> pFieldsVector = getTriggerParams();
-    if (maxParams == -1) {
-      assert(pFieldsVector.size() < INT_MAX);
-      maxParams = int(pFieldsVector.size());
+  virtual int getTriggerParams(float *pFields, int maxParams = -1) {
+    if (!mDirectTriggerParams) {
+      return copyTriggerParams(pFields, maxParams);
     }
     int count = 0;
-    for (auto param: pFieldsVector) {
+    for (auto *param: mTriggerParams) {
       if (count == maxParams) {
         break;
       }
-      if (param.type() == ParameterField::FLOAT) {
-        *pFields++ = param.get<float>();
-      } else {
-        *pFields++ = 0.0f; // Ignore strings...
+      if (param) {
+        if (strcmp(typeid(*param).name(), typeid(ParameterString).name() ) == 0
+            || strcmp(typeid(*param).name(), typeid(ParameterMenu).name() ) == 0) {
+          *pFields++ = 0.0f; // Ignore strings...
+        } else {
+          *pFields++ = param->toFloat();
+        }
+        count++;
       }
-      count++;
     }
     return count;
   }
@@ -521,7 +550,7 @@ public:
 
   SynthVoice& operator<<(ParameterMeta &param) {return registerTriggerParameter(param);}
 
-  std::vector<ParameterMeta *> triggerParameters() {return mTriggerParams;}
+  const std::vector<ParameterMeta *> &triggerParameters() {return mTriggerParams;}
 
   /**
    * @brief registerParameter
@@ -580,6 +609,37 @@ protected:
      */
   void setNumOutChannels(unsigned int numOutputs) {mNumOutChannels = numOutputs;}
 
+  /**
+   * @brief Copy the float fields returned by the std::vector version of getTriggerParams()
+   *
+   * This is what getTriggerParams(float *, int) does for voices that don't
+   * take the allocation free path. See triggerParamsDirect().
+   */
+  int copyTriggerParams(float *pFields, int maxParams = -1) {
+    std::vector<ParameterField> pFieldsVector = getTriggerParams();
+    if (maxParams == -1) {
+      maxParams = int(pFieldsVector.size());
+    }
+    int count = 0;
+    for (auto &param: pFieldsVector) {
+      if (count == maxParams) {
+        break;
+      }
+      if (param.type() == ParameterField::FLOAT) {
+        *pFields++ = param.get<float>();
+      } else {
+        *pFields++ = 0.0f;
+      }
+      count++;
+    }
+    return count;
+  }
+
+  /**
+   * @brief true if getTriggerParams(float *, int) can skip the std::vector version
+   */
+  bool triggerParamsDirect() const { return mDirectTriggerParams; }
+
   std::vector<ParameterMeta *> mTriggerParams;
 
   std::vector<ParameterMeta *> mContinuousParameters;
@@ -590,12 +650,119 @@ private:
 
   int mId {-1};
   bool mActive {false};
+  bool mDirectTriggerParams {false}; // Set by PolySynth::allocateVoice()
   int mOnOffsetFrames {0};
   int mOffOffsetFrames {0};
   void *mUserData;
   unsigned int mNumOutChannels {1};
 };
 
+/**
+ * @brief Open addressing table mapping voice ids to active voices
+ *
+ * Used by PolySynth to resolve trigger off and free requests without walking
+ * the active voice list. Only resize() allocates, every other function is
+ * constant time on average and safe to call from the audio thread. Several
+ * voices can share an id; find() returns them all through a callback.
+ */
+class SynthVoiceIndex {
+public:
+  SynthVoiceIndex(size_t capacity = 64) { resize(capacity); }
+
+  /**
+   * @brief Allocate room for capacity entries, discarding current contents.
+   *
+   * The actual number of slots is rounded up to a power of two with room to
+   * keep probe sequences short.
+   */
+  void resize(size_t capacity) {
+    size_t slots = 2;
+    while (slots < capacity + capacity / 2) {
+      slots <<= 1;
+    }
+    mSlots.assign(slots, nullptr);
+    mMask = slots - 1;
+    mCount = 0;
+  }
+
+  /// Number of voices the table accepts before insert() fails.
+  size_t capacity() const { return mSlots.size() - mSlots.size() / 4; }
+
+  size_t size() const { return mCount; }
+
+  void clear() {
+    std::fill(mSlots.begin(), mSlots.end(), nullptr);
+    mCount = 0;
+  }
+
+  /// Returns false if the table is full.
+  bool insert(SynthVoice *voice) {
+    if (mCount >= capacity()) {
+      return false;
+    }
+    size_t slot = hash(voice->id());
+    while (mSlots[slot]) {
+      slot = (slot + 1) & mMask;
+    }
+    mSlots[slot] = voice;
+    mCount++;
+    return true;
+  }
+
+  /// Remove voice, which must not have changed its id since insert().
+  bool remove(SynthVoice *voice) {
+    size_t slot = hash(voice->id());
+    while (mSlots[slot] && mSlots[slot] != voice) {
+      slot = (slot + 1) & mMask;
+    }
+    if (!mSlots[slot]) {
+      return false;
+    }
+    mSlots[slot] = nullptr;
+    mCount--;
+    // Shift back following entries so that lookups never stop early
+    size_t hole = slot;
+    slot = (slot + 1) & mMask;
+    while (mSlots[slot]) {
+      size_t home = hash(mSlots[slot]->id());
+      if (((slot - home) & mMask) >= ((slot - hole) & mMask)) {
+        mSlots[hole] = mSlots[slot];
+        mSlots[slot] = nullptr;
+        hole = slot;
+      }
+      slot = (slot + 1) & mMask;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Call func for every voice with the given id
+   * @return number of voices found
+   */
+  template<class Func>
+  int find(int id, Func func) {
+    int count = 0;
+    size_t slot = hash(id);
+    while (mSlots[slot]) {
+      if (mSlots[slot]->id() == id) {
+        func(mSlots[slot]);
+        count++;
+      }
+      slot = (slot + 1) & mMask;
+    }
+    return count;
+  }
+
+private:
+  size_t hash(int id) const {
+    return (uint32_t(id) * 2654435761u) & mMask;
+  }
+
+  std::vector<SynthVoice *> mSlots;
+  size_t mMask {0};
+  size_t mCount {0};
+};
+
 class PolySynth {
 public:
   typedef enum {
@@ -625,6 +792,10 @@ public:
   /// trigger release of voice with id
   void triggerOff(int id);
 
+  /// Trigger offs dropped because the queue to the audio thread was full.
+  /// Not printed by triggerOff(), which may run on the audio thread
+  uint64_t droppedTriggerOffs() const { return mDroppedTriggerOffs.load(); }
+
 
   /**
      * @brief Turn off all notes immediately (without calling triggerOff() )
@@ -655,6 +826,25 @@ public:
      */
   SynthVoice *getVoice(std::string name, bool forceAlloc = false);
 
+  /**
+     * @brief Find the voice class for a voice type name
+     * @return the type registered as name with registerSynthClass(), or the
+     * type of a free voice with that class name. nullptr if there is none.
+     *
+     * Resolve names once with this function and then use
+     * getVoice(const std::type_info &, const std::string &), which does not
+     * compare names for every free voice.
+     */
+  const std::type_info *voiceType(const std::string &name);
+
+  /**
+     * @brief Get a free voice of a type returned by voiceType()
+     * @param type voice class
+     * @param name name the voice class was registered as, used only if a
+     * voice needs to be allocated
+     */
+  SynthVoice *getVoice(const std::type_info &type, const std::string &name);
+
   /**
    * @brief Get the first available voice with minimal checks
    * @param forceAlloc
@@ -873,6 +1063,7 @@ public:
       TSynthVoice *voice = allocateVoice<TSynthVoice>();
       return voice;
     };
+    mCreatorTypes[name] = &typeid(TSynthVoice);
   }
 
   SynthVoice *allocateVoice(std::string name);
@@ -880,6 +1071,9 @@ public:
   template<class TSynthVoice>
   TSynthVoice *allocateVoice() {
     TSynthVoice *voice = new TSynthVoice;
+    mAllocatedVoices++;
+    registerVoiceType(typeid(TSynthVoice));
+    voice->mDirectTriggerParams = decltype(triggerParamsPaired<TSynthVoice>(0))::value;
     voice->next = nullptr;
     if(mDefaultUserData) {
       voice->userData(mDefaultUserData);
@@ -946,126 +1140,251 @@ public:
     mCpuGranularitySec = timeSecs;
   }
 
+  /**
+   * @brief Time the voices of each type in render(AudioIOData &)
+   * @param profiler usually AudioIO::profiler(). nullptr stops timing
+   *
+   * While the profiler is enabled, each block records one "voice <type name>"
+   * stage per voice type, with the time spent rendering all its active voices.
+   * The stages of the voice types allocated or inserted so far are registered
+   * here, and those of new types when their first voice is allocated or
+   * inserted, so the audio thread never registers stages. Voices of other
+   * types are not timed. Don't call from the audio thread.
+   */
+  void setProfiler(AudioProfiler *profiler);
+
 protected:
 
   void startCpuClockThread();
 
-  inline void processVoices() {
-    if (mVoiceToInsertLock.try_lock()) {
-      if (mVoicesToInsert) {
-        // If lock acquired insert queued voices
-        auto *voices = mActiveVoices;
-        if (voices) {
-          auto voice = mVoicesToInsert;
-          while (voice->next) { // Find last voice to insert
-            voice = voice->next;
-          }
-          voice->next = voices; // Connect last inserted to previously active
-        }
-        mActiveVoices = mVoicesToInsert;
-        if (verbose()) {
-          std::cout << "Voice inserted "<<  mVoicesToInsert->id() << std::endl;
+  // Profiler stages of the voice types. Filled off the audio thread and
+  // read by render()
+  struct VoiceTypeStages {
+    static const int maxTypes = 64;
+    AudioProfiler *profiler;
+    const std::type_info *types[maxTypes];
+    int stages[maxTypes];
+    std::atomic<int> size {0};
+  };
+
+  /// Register the profiler stage of a voice type. Not on the audio thread
+  void registerVoiceType(const std::type_info &type);
+  void addVoiceTypeStage(VoiceTypeStages &stages, const std::type_info &type);
+  void addVoiceTime(AudioProfiler &profiler, SynthVoice *voice, uint64_t start);
+  void recordVoiceTimes(AudioProfiler &profiler);
+
+  /**
+   * @brief Push a chain of voices onto an intrusive lock-free list
+   * @param list the list head
+   * @param first first voice in the chain
+   * @param last last voice in the chain (its next pointer is overwritten)
+   *
+   * Can be called from any thread. Voices are linked through SynthVoice::next,
+   * so no memory is allocated.
+   */
+  static inline void pushVoices(std::atomic<SynthVoice *> &list, SynthVoice *first, SynthVoice *last) {
+    SynthVoice *head = list.load(std::memory_order_relaxed);
+    do {
+      last->next = head;
+    } while (!list.compare_exchange_weak(head, first,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed));
+  }
+
+  // Add voice to the id index, falling back to list walks if it is full.
+  // Master domain only.
+  inline void indexVoice(SynthVoice *voice) {
+    if (!mVoiceIndex->insert(voice)) {
+      mVoiceIndexComplete = false;
+      mVoiceIndexOverflow = true; // Request a larger index from getVoice()
+    }
+  }
+
+  // Swap in an index prepared by updateVoiceIndexCapacity(). Master domain only.
+  inline void swapVoiceIndex() {
+    SynthVoiceIndex *newIndex = mPendingVoiceIndex.exchange(nullptr, std::memory_order_acquire);
+    if (newIndex) {
+      mVoiceIndexComplete = true;
+      auto *voice = mActiveVoices;
+      while (voice) {
+        if (!newIndex->insert(voice)) {
+          mVoiceIndexComplete = false;
+          mVoiceIndexOverflow = true;
         }
+        voice = voice->next;
+      }
+      // The previous index is deleted outside the master domain
+      mRetiredVoiceIndex.store(mVoiceIndex.release(), std::memory_order_relaxed);
+      mVoiceIndex.reset(newIndex);
+      mVoiceIndexSwaps.fetch_add(1, std::memory_order_release);
+    }
+  }
 
-        mVoicesToInsert = nullptr;
+  /**
+   * @brief Call func for every active voice with the given id
+   * @return number of voices found
+   *
+   * Constant time while all active voices fit in the id index.
+   */
+  template<class Func>
+  inline int forEachActiveVoice(int id, Func func) {
+    if (mVoiceIndexComplete) {
+      return mVoiceIndex->find(id, func);
+    }
+    int count = 0;
+    auto *voice = mActiveVoices;
+    while (voice) {
+      if (voice->id() == id) {
+        func(voice);
+        count++;
       }
-      mVoiceToInsertLock.unlock();
+      voice = voice->next;
     }
-    if (mAllNotesOff) {
-      if (mFreeVoiceLock.try_lock()) {
-        mAllNotesOff = false;
-        auto *voices = mActiveVoices;
-        if (voices) {
-          auto voice = voices->next;
-          SynthVoice *previousVoice = voices;
-          previousVoice->id(-1);
-          while(voice) {
-            voice->id(-1);
-            voice->mActive = false;
-            previousVoice = voice;
-            voice = voice->next;
-          }
-          previousVoice->next = mFreeVoices; // Connect last active voice to first free voice
-          mFreeVoices = voices; // Move all voices to free voices
-          mActiveVoices = nullptr; // No active voices left
-        }
-        mFreeVoiceLock.unlock();
+    return count;
+  }
+
+  // Move voices queued by triggerOn() to the active list. Master domain only.
+  inline void insertQueuedVoices() {
+    SynthVoice *voicesToInsert = mVoicesToInsert.exchange(nullptr, std::memory_order_acquire);
+    if (voicesToInsert) {
+      auto voice = voicesToInsert;
+      indexVoice(voice);
+      while (voice->next) { // Find last voice to insert
+        voice = voice->next;
+        indexVoice(voice);
+      }
+      voice->next = mActiveVoices; // Connect last inserted to previously active
+      mActiveVoices = voicesToInsert;
+      if (verbose()) {
+        std::cout << "Voice inserted "<<  voicesToInsert->id() << std::endl;
       }
     }
   }
 
-  inline void processVoiceTurnOff() {
-    int voicesToTurnOff[16];
-    size_t numVoicesToTurnOff;
-    while ( (numVoicesToTurnOff = mVoiceIdsToTurnOff.read((char *) voicesToTurnOff, 16 * sizeof (int))) ) {
-      for (size_t i = 0; i < numVoicesToTurnOff/int(sizeof (int)); i++) {
-        auto *voice = mActiveVoices;
-        while (voice) {
-          if (voice->id() == voicesToTurnOff[i]) {
-
-            if (mVerbose) {
-              std::cout << "Voice trigger off "<<  voice->id() << std::endl;
-            }
-            voice->triggerOff(); // TODO use offset for turn off
-          }
-          voice = voice->next;
-        }
+  // Move voices removed from the active list to the free pool. Called with
+  // mFreeVoiceLock held, never from the master domain.
+  inline void collectFreedVoices() {
+    SynthVoice *freedVoices = mVoicesFreed.exchange(nullptr, std::memory_order_acquire);
+    if (freedVoices) {
+      auto voice = freedVoices;
+      while (voice->next) {
+        voice = voice->next;
       }
+      voice->next = mFreeVoices;
+      mFreeVoices = freedVoices;
     }
-    size_t numVoicesToFree;
-    int voicesToFree[16];
-    while ( (numVoicesToFree = mVoiceIdsToFree.read((char *) voicesToFree, 16 * sizeof (int))) ) {
-      for (size_t i = 0; i < numVoicesToFree/int(sizeof (int)); i++) {
-        if (mVerbose) {
-          std::cout << "Voice free "<<  voicesToFree[i] << std::endl;
-        }
-        auto *voice = mActiveVoices;
-        while (voice) {
-          if (voice->id() == voicesToFree[i]) {
-            voice->mActive = false;
-          }
+  }
+
+  /**
+   * @brief Grow the id index if more voices have been allocated than it holds
+   *
+   * Called with mFreeVoiceLock held. The new index is built by the master
+   * domain on its next pass, so this never blocks audio.
+   */
+  inline void updateVoiceIndexCapacity() {
+    size_t allocated = mAllocatedVoices.load(std::memory_order_relaxed);
+    if (allocated <= mVoiceIndexCapacity && !mVoiceIndexOverflow.load(std::memory_order_relaxed)) {
+      return;
+    }
+    if (mVoiceIndexSwaps.load(std::memory_order_acquire) != mVoiceIndexRequests) {
+      return; // Previous request not taken yet
+    }
+    delete mRetiredVoiceIndex.exchange(nullptr, std::memory_order_relaxed);
+    mVoiceIndexOverflow = false;
+    mVoiceIndexCapacity = std::max(allocated, mVoiceIndexCapacity) * 2;
+    mPendingVoiceIndex.store(new SynthVoiceIndex(mVoiceIndexCapacity), std::memory_order_release);
+    mVoiceIndexRequests++;
+  }
+
+  inline void processVoices() {
+    swapVoiceIndex();
+    insertQueuedVoices();
+    if (mAllNotesOff.exchange(false)) {
+      auto *voices = mActiveVoices;
+      if (voices) {
+        auto *voice = voices;
+        SynthVoice *lastVoice = voices;
+        while(voice) {
+          voice->id(-1);
+          voice->mActive = false;
+          lastVoice = voice;
           voice = voice->next;
         }
+        mActiveVoices = nullptr; // No active voices left
+        mVoiceIndex->clear();
+        mVoiceIndexComplete = true;
+        pushVoices(mVoicesFreed, voices, lastVoice); // Move all voices to free voices
       }
     }
   }
 
-  inline void processInactiveVoices() {
-    // Move inactive voices to free queue
-    if (mFreeVoiceLock.try_lock()) { // Attempt to remove inactive voices without waiting.
-      auto *voice = mActiveVoices;
-      SynthVoice *previousVoice = nullptr;
-      while(voice) {
-        if (!voice->active()) {
-          int id = voice->id();
-          std::cout << " ****((((())))) **** Remove inactive voice: " << voice << std::endl;
-          if (previousVoice) {
-            previousVoice->next = voice->next; // Remove from active list
-            voice->next = mFreeVoices;
-            mFreeVoices = voice; // Insert as head in free voices
-            voice->id(-1); // Reset voice id
-            voice->onFree();
-            voice = previousVoice; // prepare next iteration
-          } else { // Inactive is head of the list
-            auto *nextVoice = voice->next;
-            mActiveVoices = nextVoice; // Remove voice from list
-            voice->next = mFreeVoices;
-            mFreeVoices = voice; // Insert as head in free voices
-            voice->id(-1); // Reset voice id
-            voice->onFree();
-            voice = voice->next; // prepare next iteration
-          }
-          for (auto cbNode: mFreeCallbacks) {
-            cbNode.first(id, cbNode.second);
+  inline void processVoiceTurnOff() {
+    int id;
+    auto turnOff = [this](SynthVoice *voice) {
+      if (mVerbose) {
+        std::cout << "Voice trigger off "<<  voice->id() << std::endl;
+      }
+      voice->triggerOff(); // TODO use offset for turn off
+    };
+    while (mVoiceIdsToTurnOff.pop(id)) {
+      if (forEachActiveVoice(id, turnOff) == 0) {
+        // The voice might have been queued after the last insertion but
+        // before this trigger off was posted.
+        insertQueuedVoices();
+        forEachActiveVoice(id, turnOff);
+      }
+    }
+    auto markFree = [](SynthVoice *voice) { voice->mActive = false; };
+    while (mVoiceIdsToFree.pop(id)) {
+      if (mVerbose) {
+        std::cout << "Voice free "<<  id << std::endl;
+      }
+      if (forEachActiveVoice(id, markFree) == 0) {
+        insertQueuedVoices();
+        forEachActiveVoice(id, markFree);
+      }
+    }
+  }
 
-          }
+  inline void processInactiveVoices() {
+    // Move inactive voices to free queue. The voices are collected into a
+    // chain and handed to the free pool in one step, so this never waits for
+    // threads calling getVoice().
+    SynthVoice *freedFirst = nullptr;
+    SynthVoice *freedLast = nullptr;
+    auto *voice = mActiveVoices;
+    SynthVoice *previousVoice = nullptr;
+    while(voice) {
+      auto *nextVoice = voice->next;
+      if (!voice->active()) {
+        int id = voice->id();
+        if (previousVoice) {
+          previousVoice->next = nextVoice; // Remove from active list
+        } else { // Inactive is head of the list
+          mActiveVoices = nextVoice;
         }
-        previousVoice = voice;
-        if (voice) {
-          voice = voice->next;
+        mVoiceIndex->remove(voice);
+        voice->id(-1); // Reset voice id
+        voice->onFree();
+        voice->next = freedFirst;
+        freedFirst = voice;
+        if (!freedLast) {
+          freedLast = voice;
+        }
+        for (auto cbNode: mFreeCallbacks) {
+          cbNode.first(id, cbNode.second);
         }
+      } else {
+        previousVoice = voice;
       }
-      mFreeVoiceLock.unlock();
+      voice = nextVoice;
+    }
+    if (freedFirst) {
+      pushVoices(mVoicesFreed, freedFirst, freedLast);
+    }
+    if (!mVoiceIndexComplete && !mActiveVoices) {
+      mVoiceIndex->clear();
+      mVoiceIndexComplete = true;
     }
   }
 
@@ -1101,11 +1420,27 @@ protected:
   }
 
   // Internal voices are allocated in PolySynth and shared with the outside.
-  SynthVoice *mVoicesToInsert {nullptr}; //Voices to be inserted in the realtime context
-  SynthVoice *mFreeVoices {nullptr}; // Allocated voices available for reuse
+  // Voices move between these lists through their next pointer. The master
+  // domain (set by mMasterMode) only touches the lock-free lists, so it never
+  // waits on the threads that trigger or request voices.
+  std::atomic<SynthVoice *> mVoicesToInsert {nullptr}; //Voices to be inserted in the realtime context
+  std::atomic<SynthVoice *> mVoicesFreed {nullptr}; // Voices removed by the master domain, not yet in mFreeVoices
+  SynthVoice *mFreeVoices {nullptr}; // Allocated voices available for reuse. Protected by mFreeVoiceLock
   SynthVoice * mActiveVoices {nullptr}; // Dynamic voices that are currently active. Only modified within the master domain (set by mMasterMode)
-  std::mutex mVoiceToInsertLock;
-  std::mutex mFreeVoiceLock;
+  std::mutex mFreeVoiceLock; // Serializes getVoice() and other free pool access. Never taken by the master domain
+
+  // Index from voice id to active voices, owned by the master domain. A larger
+  // index is prepared by updateVoiceIndexCapacity() and swapped in by the
+  // master domain, which hands the old one back for deletion.
+  std::unique_ptr<SynthVoiceIndex> mVoiceIndex {new SynthVoiceIndex};
+  bool mVoiceIndexComplete {true}; // false if some active voices didn't fit in mVoiceIndex
+  std::atomic<bool> mVoiceIndexOverflow {false};
+  std::atomic<SynthVoiceIndex *> mPendingVoiceIndex {nullptr};
+  std::atomic<SynthVoiceIndex *> mRetiredVoiceIndex {nullptr};
+  std::atomic<unsigned int> mVoiceIndexSwaps {0};
+  unsigned int mVoiceIndexRequests {0}; // Protected by mFreeVoiceLock
+  size_t mVoiceIndexCapacity {64}; // Protected by mFreeVoiceLock
+  std::atomic<size_t> mAllocatedVoices {0};
   std::mutex mGraphicsLock;
 
   bool m_useInternalAudioIO = true;
@@ -1117,8 +1452,9 @@ protected:
   std::shared_ptr<BusRoutingCallback> mBusRoutingCallback;
   AudioIOData internalAudioIO;
 
-  SingleRWRingBuffer mVoiceIdsToTurnOff {64 * sizeof(int)};
-  SingleRWRingBuffer mVoiceIdsToFree {64 * sizeof(int)};
+  MPSCRingBuffer<int> mVoiceIdsToTurnOff {1024};
+  MPSCRingBuffer<int> mVoiceIdsToFree {1024};
+  std::atomic<uint64_t> mDroppedTriggerOffs {0};
 
   TimeMasterMode mMasterMode;
 
@@ -1139,9 +1475,9 @@ protected:
 
   float mAudioGain {1.0f};
 
-  int mIdCounter {1000};
+  std::atomic<int> mIdCounter {1000};
 
-  bool mAllNotesOff {false}; // Flag used to notify processing to turn off all voices
+  std::atomic<bool> mAllNotesOff {false}; // Flag used to notify processing to turn off all voices
 
   typedef std::function<SynthVoice *()> VoiceCreatorFunc;
   typedef std::map<std::string, VoiceCreatorFunc> Creators;
@@ -1149,6 +1485,7 @@ protected:
   void *mDefaultUserData {nullptr};
 
   Creators mCreators;
+  std::map<std::string, const std::type_info *> mCreatorTypes; // Class of the voices made by mCreators
   std::vector<std::string> mNoAllocationList; // Disallow auto allocation for class name. Set in allocateVoice()
 
   bool mRunCPUClock {true};
@@ -1156,6 +1493,21 @@ protected:
   std::unique_ptr<std::thread> mCpuClockThread;
 
   bool mVerbose {false};
+
+  // A table of stages is made for each profiler set. Tables are kept until
+  // the synth is destroyed, as render() may still be using the previous one
+  std::atomic<VoiceTypeStages *> mVoiceTypeStages {nullptr};
+  std::vector<std::unique_ptr<VoiceTypeStages>> mVoiceTypeStageTables;
+  std::vector<const std::type_info *> mVoiceTypes; // Types allocated or inserted
+  std::mutex mVoiceTypesLock;
+  // Time spent on each voice type of mTimedStages in the current block.
+  // Audio thread only
+  struct VoiceTypeTime {
+    uint64_t start;
+    uint64_t total;
+  };
+  VoiceTypeTime mVoiceTypeTimes[VoiceTypeStages::maxTypes] {};
+  VoiceTypeStages *mTimedStages {nullptr};
 };
 
 template<class TSynthVoice>
@@ -1168,6 +1520,7 @@ void PolySynth::disableAllocation()
 template<class TSynthVoice>
 TSynthVoice *PolySynth::getVoice(bool forceAlloc) {
     std::unique_lock<std::mutex> lk(mFreeVoiceLock); // Only one getVoice() call at a time
+    collectFreedVoices();
     SynthVoice *freeVoice = mFreeVoices;
     SynthVoice *previousVoice = nullptr;
     if (forceAlloc) {
@@ -1201,12 +1554,14 @@ TSynthVoice *PolySynth::getVoice(bool forceAlloc) {
         std::cout << "Automatic allocation disabled for voice:" << name << std::endl;
       }
     }
+    updateVoiceIndexCapacity();
     return static_cast<TSynthVoice *>(freeVoice);
 }
 
 template<class TSynthVoice>
 void PolySynth::allocatePolyphony(int number) {
     std::unique_lock<std::mutex> lk(mFreeVoiceLock);
+    collectFreedVoices();
     SynthVoice *lastVoice = mFreeVoices;
     if (lastVoice) {
         while (lastVoice->next) { lastVoice = lastVoice->next; }
@@ -1218,6 +1573,7 @@ void PolySynth::allocatePolyphony(int number) {
         lastVoice->next = allocateVoice<TSynthVoice>();
         lastVoice = lastVoice->next;
     }
+    updateVoiceIndexCapacity();
 }
 
 } // namespace al
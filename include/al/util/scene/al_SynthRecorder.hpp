@@ -42,10 +42,15 @@
 */
 
 
+#include <atomic>
 #include <chrono>
 #include <fstream>
+#include <map>
+#include <thread>
+#include <typeinfo>
 
 #include "al/core/io/al_File.hpp"
+#include "al/util/al_MPSCRingBuffer.hpp"
 #include "al/util/scene/al_SynthSequencer.hpp"
 
 /**
@@ -69,7 +74,16 @@
  * connect the 'trigger off' to a previous 'trigger on'.
  *
  * Alternatively, the sequence can be recorded in CPP_FORMAT that produces C++
- * code that can be pasted to deliver the sequence.
+ * code that can be pasted to deliver the sequence, or in BINARY format that
+ * SynthSequencer loads without parsing, for long recordings.
+ *
+ * Recording is safe when voices are triggered from the audio thread. The
+ * trigger callbacks copy each event into a preallocated lock-free buffer and
+ * a writer thread streams them to the file while recording. Events with more
+ * than 32 pfields are truncated, and so are string pfields that don't fit in
+ * 64 characters per event. If the writer falls behind by more than the buffer
+ * size given to the constructor, events are dropped and counted in
+ * droppedEvents().
  *
  * The sequences stored in the text file can be played back using SynthSequencer
  * You must make sre that the synthesizers referenced in the sequence have
@@ -95,10 +109,20 @@ public:
         SEQUENCER_EVENT, // Events have duration (uses '@' command only)
         SEQUENCER_TRIGGERS, // Store events as they were received trigger on and trigger off can be separate entries (uses '+' and '-' text commands)
         CPP_FORMAT, // Saves code that can be copy-pasted into C++
+        BINARY, // Events with duration in a binary sequence file (see SynthSequenceFile)
         NONE
     } TextFormat;
 
-    SynthRecorder(TextFormat format = SEQUENCER_EVENT) { mFormat = format;}
+    /**
+     * @param format file format
+     * @param bufferSize number of events that can be waiting to be written.
+     * Events that arrive when the buffer is full are dropped.
+     */
+    SynthRecorder(TextFormat format = SEQUENCER_EVENT, size_t bufferSize = 8192)
+      : mEvents(bufferSize)
+    { mFormat = format;}
+
+    ~SynthRecorder();
 
     void setDirectory(std::string path) {
       if (!File::exists(path)) {
@@ -115,9 +139,13 @@ public:
 
     void setMaxRecordTime(al_sec maxTime) { mMaxRecordTime = maxTime; }
 
-    void verbose(bool verbose) {mVerbose = true;}
+    void verbose(bool verbose) {mVerbose = verbose;}
     bool verbose() {return mVerbose;}
 
+    /// Number of events dropped in the current or last recording because the
+    /// event buffer was full
+    uint64_t droppedEvents() { return mDroppedEvents.load(); }
+
     //	std::string lastSequenceName();
     //	std::string lastSequenceSubDir();
 
@@ -133,87 +161,77 @@ public:
      * @param offsetFrames
      * @param id
      * @param userData
+     *
+     * Safe to call from the audio thread: the event is copied into a
+     * preallocated lock-free buffer and written to disk by a separate thread.
      */
-    static bool onTriggerOn(SynthVoice *voice, int offsetFrames, int id, void *userData)
-    {
-        std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
-        SynthRecorder *rec = static_cast<SynthRecorder *>(userData);
-        if (rec->mRecording) {
-            std::unique_lock<std::mutex> lk(rec->mSequenceLock);
-            if (rec->mStartOnEvent) {
-                rec->mSequenceStart = now;
-                rec->mStartOnEvent = false;
-            }
-            std::chrono::duration<double> diff = now - rec->mSequenceStart;
-            std::vector<ParameterField> pFields = voice->getTriggerParams();
-
-            SynthEvent event;
-            event.type = SynthEventType::TRIGGER_ON;
-            event.id = voice->id();
-            event.time = diff.count();
-            event.synthName = demangle(typeid (*voice).name() );
-            event.duration = -1;
-            event.pFields = pFields;
-            rec->mSequence.push_back(event);
-            if (rec->verbose()) {
-              std::cout << "trigger at " << event.time << ":" << event.synthName << ":" << voice->id() << std::endl;
-            }
-
-        }
-        return true;
-    }
+    static bool onTriggerOn(SynthVoice *voice, int offsetFrames, int id, void *userData);
 
     /**
      * @brief onTriggerOff callback for trigger off events
      * @param id
      * @param userData
      */
-    static bool onTriggerOff(int id, void *userData) {
-        std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
-        SynthRecorder *rec = static_cast<SynthRecorder *>(userData);
-        if (rec->mRecording) {
-            std::unique_lock<std::mutex> lk(rec->mSequenceLock);
-//            if (rec->mStartOnEvent) {
-//                rec->mSequenceStart = now;
-//                rec->mStartOnEvent = false;
-//            }
-            std::chrono::duration<double> diff = now - rec->mSequenceStart;
-
-            SynthEvent event;
-            event.type = SynthEventType::TRIGGER_OFF;
-            event.id = id;
-            event.time = diff.count();
-            //            event.synthName = demangle(typeid (*voice).name() );
-            event.duration = -1;
-            //            for (int i = 0; i < numFields; i++) {
-            //                event.pFields.push_back(pFields[i]);
-            //            }
-            rec->mSequence.push_back(event);
-            if (rec->verbose()) {
-              std::cout << "trigger OFF at " << event.time << ":" << event.synthName << ":" << id << std::endl;
-            }
-        }
-        return true;
-    }
+    static bool onTriggerOff(int id, void *userData);
 
 private:
+    static const int maxFields = 32;
+    static const int maxStringBytes = 64;
+    static const int maxClasses = 128;
+
+    // An event as captured in the trigger callbacks. It has a fixed size so
+    // it can go through the ring buffer without allocating. Voice classes are
+    // stored as an index into mClasses, and string pfields as consecutive
+    // null terminated strings, truncated to fit.
+    struct RecordedEvent {
+        double time;
+        int32_t id;
+        SynthEventType type;
+        uint16_t classIndex;
+        uint16_t numFields;
+        uint32_t stringFields; // Bit i is set if field i is in strings
+        float fields[maxFields];
+        char strings[maxStringBytes];
+    };
+
+    // Seconds since the start of the recording
+    double eventTime();
+
+    // Index of the voice's class in mClasses, adding it if needed. Lock-free.
+    // Returns maxClasses if the table is full.
+    uint16_t classIndex(SynthVoice *voice);
+
+    void writeEvents(); // Writer thread
+    void writeEvent(RecordedEvent &event);
+    void writeFields(RecordedEvent &event, const char *separator);
+    std::vector<ParameterField> eventFields(RecordedEvent &event);
 
     std::string mDirectory;
     PolySynth *mPolySynth {nullptr};
     TextFormat mFormat;
-    bool mVerbose;
+    bool mVerbose {false};
 
     bool mOverwrite;
     std::string mSequenceName;
 
-    std::mutex mSequenceLock;
-
-    bool mRecording {false};
-    bool mStartOnEvent {true};
+    std::atomic<bool> mRecording {false};
+    std::atomic<bool> mStartOnEvent {true};
 
     al_sec mMaxRecordTime;
-    std::chrono::high_resolution_clock::time_point mSequenceStart;
-    std::vector<SynthEvent> mSequence;
+    std::atomic<int64_t> mSequenceStart {0}; // high_resolution_clock ticks
+
+    MPSCRingBuffer<RecordedEvent> mEvents;
+    std::atomic<uint64_t> mDroppedEvents {0};
+    std::atomic<const std::type_info *> mClasses[maxClasses] {};
+
+    // Only used by the writer thread while recording
+    std::unique_ptr<std::thread> mWriterThread;
+    std::atomic<bool> mWriterRunning {false};
+    std::ofstream mFile;
+    std::string mFileName;
+    std::string mClassNames[maxClasses];
+    std::map<int, RecordedEvent> mPendingEvents; // Trigger ons waiting for their trigger off, by id
+    std::vector<SynthSequencerEvent> mBinaryEvents;
 };
 
 // Implementation
@@ -0,0 +1,188 @@
+#ifndef AL_SYNTHSEQUENCEFILE_HPP
+#define AL_SYNTHSEQUENCEFILE_HPP
+
+/*	Allocore --
+	Multimedia / virtual environment application class library
+
+	Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+	Copyright (C) 2012-2018. The Regents of the University of California.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+		Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		Neither the name of the University of California nor the names of its
+		contributors may be used to endorse or promote products derived from
+		this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+	ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+	LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+	CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+	CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+
+	File description:
+	Binary, memory mapped SynthSequencer sequence files
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "al/util/scene/al_SynthSequencer.hpp"
+
+namespace al {
+
+/**
+ * @brief A binary sequence file mapped into memory
+ *
+ * Binary sequences (extension ".synthSequenceBin") hold the same events as
+ * the "@" command of text sequences. They are written so they can be used
+ * straight from the mapped file with no parsing:
+ *
+ * - a header with the offset and size of every section, and the largest
+ *   number of events that overlap in time
+ * - a string table with every voice name and string pfield once. The voice
+ *   names come first
+ * - the events as fixed size records sorted by start time, with an index
+ *   into the string table for the voice name and a range of pfields
+ * - the pfields as two parallel arrays: float values, and the string table
+ *   index of string pfields (noString for float pfields)
+ * - the indices of the events that have string pfields
+ *
+ * The pfields of the events with string pfields are copied once on open()
+ * into a single array of ParameterField. Other events are only read from
+ * the mapped file.
+ *
+ * Numbers are stored in the byte order of the machine that wrote the file.
+ * open() rejects files written with a different byte order.
+ *
+ * SynthSequencer plays binary sequences from the mapped file, and
+ * SynthRecorder can write them with the BINARY format. Text sequences
+ * can be converted with SynthSequencer::convertToBinary() and back with
+ * SynthSequencer::convertToText().
+ */
+class SynthSequenceFile {
+public:
+  static const uint32_t noString = 0xFFFFFFFF;
+
+  struct Event {
+    double startTime;
+    double duration;    ///< -1 if the event has no end
+    uint32_t name;      ///< String table index of the voice name
+    uint32_t firstField;///< Index of the first pfield
+    uint32_t numFields;
+    int32_t id;         ///< Event id, -1 if not known
+  };
+
+  SynthSequenceFile() {}
+  ~SynthSequenceFile() { close(); }
+
+  SynthSequenceFile(const SynthSequenceFile &) = delete;
+  SynthSequenceFile &operator=(const SynthSequenceFile &) = delete;
+
+  /// Map a binary sequence file. Returns false if it can't be mapped or is
+  /// not a valid sequence file.
+  bool open(std::string fileName);
+
+  void close();
+
+  bool isOpen() const { return mData != nullptr; }
+
+  uint64_t numEvents() const { return mNumEvents; }
+  const Event *events() const { return mEvents; }
+  const Event &event(uint64_t index) const { return mEvents[index]; }
+
+  /// Index of the first event starting at or after time
+  uint64_t firstEventAt(double time) const;
+
+  /// Entry in the string table. Built once on open()
+  const std::string &string(uint32_t index) const { return mStrings[index]; }
+  uint32_t numStrings() const { return uint32_t(mStrings.size()); }
+  /// The string table entries below this are voice names
+  uint32_t numNames() const { return mNumNames; }
+
+  /// Largest number of events sounding at the same time. Events that end
+  /// exactly when another starts are counted as overlapping.
+  uint64_t maxOverlap() const { return mMaxOverlap; }
+
+  /// true if the string and pfield indices of event are within the file.
+  /// Events are not checked by open() so that nothing is read up front
+  bool validEvent(const Event &event) const {
+    return event.name < mStrings.size() && event.firstField <= mNumFields
+        && event.numFields <= mNumFields - event.firstField;
+  }
+
+  uint64_t numFields() const { return mNumFields; }
+  /// Float pfield values for all events. Entries for string pfields are 0
+  const float *fieldValues() const { return mFieldValues; }
+  /// String table index for all pfields, or noString for float pfields
+  const uint32_t *fieldStrings() const { return mFieldStrings; }
+
+  /// true if all pfields of event are floats, so fieldValues() can be used
+  /// directly
+  bool floatFieldsOnly(const Event &event) const;
+
+  /// The numFields pfields of the event at eventIndex if it has string
+  /// pfields, nullptr otherwise
+  const ParameterField *stringEventFields(uint64_t eventIndex) const;
+
+  /// Copy the pfields of an event
+  std::vector<ParameterField> fields(const Event &event) const;
+
+  /// Read all events as EVENT_PFIELDS sequencer events
+  std::vector<SynthSequencerEvent> toEvents(double timeOffset = 0.0) const;
+
+  /**
+   * @brief Write sequencer events to a binary sequence file
+   *
+   * EVENT_PFIELDS events store their name and pfields. EVENT_VOICE events
+   * store the class name and trigger parameters of their voice. Other
+   * events are skipped.
+   */
+  static bool write(std::string fileName, const std::vector<SynthSequencerEvent> &events);
+
+  /// Write the mapped events as a text sequence using the "@" command
+  bool writeText(std::string fileName) const;
+
+private:
+  struct Header;
+
+  void *mData {nullptr};
+  uint64_t mSize {0};
+#ifdef AL_WINDOWS
+  void *mFileHandle {nullptr};
+  void *mMappingHandle {nullptr};
+#endif
+
+  std::vector<std::string> mStrings;
+  uint32_t mNumNames {0};
+  uint64_t mMaxOverlap {0};
+  const Event *mEvents {nullptr};
+  uint64_t mNumEvents {0};
+  const float *mFieldValues {nullptr};
+  const uint32_t *mFieldStrings {nullptr};
+  uint64_t mNumFields {0};
+  // Events with string pfields, sorted, and their pfields one after the other
+  const uint64_t *mStringEvents {nullptr};
+  uint64_t mNumStringEvents {0};
+  std::vector<ParameterField> mStringEventFields;
+  std::vector<uint64_t> mStringEventFirstField; // Into mStringEventFields
+};
+
+}
+
+#endif // AL_SYNTHSEQUENCEFILE_HPP
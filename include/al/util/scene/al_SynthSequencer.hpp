@@ -67,10 +67,6 @@ class SynthSequencerEvent {
 public:
     SynthSequencerEvent () {}
 
-    ~SynthSequencerEvent() {
-
-    }
-
     typedef enum {
         EVENT_VOICE,
         EVENT_PFIELDS,
@@ -91,7 +87,7 @@ public:
     SynthVoice *voice {nullptr};
     ParamFields fields;
     float tempo;
-    int voiceId;
+    int voiceId {-1};
 };
 
 enum SynthEventType {
@@ -167,8 +163,16 @@ struct SynthEvent {
  *
  * All events following will have this offset added to their start time. Negative numbers are allowed.
  *
+ * Long sequences load much faster from binary sequence files (extension
+ * ".synthSequenceBin", see SynthSequenceFile), which are memory mapped and
+ * played without parsing. playSequence() uses the binary file when the name
+ * has the ".synthSequenceBin" extension or when there is no text sequence
+ * with that name. Text sequences can be converted with convertToBinary().
+ *
  */
 
+class SynthSequenceFile;
+
 class SynthSequencer {
 public:
 
@@ -253,12 +257,27 @@ public:
 
     std::string buildFullPath(std::string sequenceName);
 
+    /// Path of the binary sequence file for sequenceName
+    std::string buildBinaryPath(std::string sequenceName);
+
     std::list<SynthSequencerEvent> loadSequence(std::string sequenceName, double timeOffset = 0, double timeScale = 1.0);
 
     std::vector<std::string> getSequenceList();
 
     double getSequenceDuration(std::string sequenceName);
 
+    /**
+     * @brief Write a text sequence as a binary sequence file
+     * @return true if the binary file was written
+     *
+     * The voice classes used by "+" commands in the text sequence must be
+     * registered with the PolySynth.
+     */
+    bool convertToBinary(std::string sequenceName);
+
+    /// Write a binary sequence as a text sequence file
+    bool convertToText(std::string sequenceName);
+
     PolySynth &synth() {return *mPolySynth;}
 
     // Callbacks
@@ -281,6 +300,9 @@ public:
     void operator<<(PolySynth &synth) { return registerSynth(synth);}
 
 private:
+    /// Read a text sequence into events sorted by start time
+    std::vector<SynthSequencerEvent> loadSequenceEvents(std::string sequenceName, double timeOffset = 0, double timeScale = 1.0);
+
     PolySynth *mPolySynth;
     std::unique_ptr<PolySynth> mInternalSynth;
 
@@ -290,8 +312,28 @@ private:
 
     double mFps {30}; // graphics frames per second
 
-    unsigned int mNextEvent {0};
-    std::list<SynthSequencerEvent> mEvents; // List of events sorted by start time.
+    size_t mNextEvent {0}; // Index of the next event to trigger in mEvents
+    std::vector<SynthSequencerEvent> mEvents; // Events sorted by start time.
+
+    // Voices triggered by the sequencer that are still on, kept as a min heap
+    // on their end time so a block only looks at the voices it turns off.
+    struct ActiveVoice {
+        double endTime;
+        int voiceId;
+        // Heap ordering that keeps the voice that ends first at the front
+        static bool endsLater(const ActiveVoice &a, const ActiveVoice &b) { return a.endTime > b.endTime; }
+    };
+    std::vector<ActiveVoice> mActiveVoices;
+
+    // Binary sequence being played from its mapped file, alongside mEvents
+    std::shared_ptr<SynthSequenceFile> mMappedSequence;
+    size_t mMappedPolyphony {0}; // Most events of mMappedSequence sounding at once
+    // Resolved in playSequence() so the audio thread doesn't look voices up by
+    // name: the voice class for each string table entry of mMappedSequence
+    // (nullptr if it is not a voice name)
+    std::vector<const std::type_info *> mMappedVoiceTypes;
+    uint64_t mNextMappedEvent {0};
+    double mMappedTimeOffset {0.0};
     std::mutex mEventLock;
     std::mutex mLoadingLock;
     bool mPlaying {false};
@@ -315,6 +357,24 @@ private:
     std::shared_ptr<std::thread> mCpuThread;
 
     void processEvents(double blockStartTime, double fps);
+    // Returns true if voices were turned off
+    bool processMappedEvents(double blockStartTime, double fps);
+
+    // Grow mActiveVoices so that the pending events can be triggered on the
+    // audio thread without allocating. Must hold mEventLock.
+    void reserveActiveVoices();
+    // Push a triggered voice on mActiveVoices. Returns true if voices were
+    // turned off to make room.
+    bool pushActiveVoice(double endTime, int voiceId);
+    // Turn off the voices that end by mMasterTime. Returns true if any did.
+    bool turnOffEndedVoices();
+
+    // Map the binary file to play for sequenceName, or nullptr if the text
+    // sequence should be used
+    std::shared_ptr<SynthSequenceFile> openBinarySequence(std::string sequenceName);
+
+    // Insert a voice event keeping mEvents sorted. Must hold mEventLock.
+    void insertVoiceEvent(SynthVoice *voice, double startTime, double duration);
 
 };
 
@@ -322,34 +382,16 @@ private:
 
 template<class TSynthVoice>
 TSynthVoice &SynthSequencer::add(double startTime, double duration) {
-    std::list<SynthSequencerEvent>::iterator insertedEvent;
     TSynthVoice *newVoice = mPolySynth->getVoice<TSynthVoice>();
     std::unique_lock<std::mutex> lk(mEventLock);
-    // Insert into event list, sorted.
-    auto position = mEvents.begin();
-    while(position != mEvents.end() && position->startTime < startTime) {
-        position++;
-    }
-    insertedEvent = mEvents.insert(position, SynthSequencerEvent());
-    insertedEvent->startTime = startTime;
-    insertedEvent->duration = duration;
-    insertedEvent->voice = newVoice;
+    insertVoiceEvent(newVoice, startTime, duration);
     return *newVoice;
 }
 
 template<class TSynthVoice>
 void SynthSequencer::addVoice(TSynthVoice *voice, double startTime, double duration) {
-    std::list<SynthSequencerEvent>::iterator insertedEvent;
     std::unique_lock<std::mutex> lk(mEventLock);
-    // Insert into event list, sorted.
-    auto position = mEvents.begin();
-    while(position != mEvents.end() && position->startTime < startTime) {
-        position++;
-    }
-    insertedEvent = mEvents.insert(position, SynthSequencerEvent());
-    insertedEvent->startTime = startTime;
-    insertedEvent->duration = duration;
-    insertedEvent->voice = voice;
+    insertVoiceEvent(voice, startTime, duration);
 }
 
 template<class TSynthVoice>
@@ -44,17 +44,16 @@
 #ifndef INC_AL_OUTPUTMASTER_HPP
 #define INC_AL_OUTPUTMASTER_HPP
 
-#include <vector>
-#include <mutex>
-#include <condition_variable>
-#include <deque>
 #include <atomic>
+#include <cassert>
+#include <climits>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "al/core/io/al_AudioIO.hpp"
-#include "al/core/types/al_SingleRWRingBuffer.hpp"
 #include "al/core/system/al_Time.hpp"
-
-#include "Gamma/Filter.h"
+#include "al/core/types/al_AtomicValue.hpp"
 
 namespace al {
 
@@ -86,61 +85,112 @@ typedef enum {
  *  @{
  */
 
+/** Snapshot of values passed from one writer thread to any number of reader
+ * threads. Neither side locks or allocates. This is the seqlock of
+ * AtomicValue (see AtomicSequence) for a number of values set at run time.
+ *
+ * DataType must be lock free as a std::atomic (float, int32_t...).
+ */
 template<class DataType>
 class DoubleBuffering {
 public:
     DoubleBuffering() {
     }
 
+    DoubleBuffering(const DoubleBuffering &) = delete;
+    DoubleBuffering &operator=(const DoubleBuffering &) = delete;
+
+    /** Allocate size values, all zero. Must not be called while another
+     * thread reads or writes.
+     */
     void setSize(unsigned int size) {
-        std::unique_lock<std::mutex> lk(m_meterMutex);
-        if (m_bufferSize > 0) {
-            free(m_buffers[0]);
-            free(m_buffers[1]);
+        for (int c = 0; c < 2; c++) {
+            m_buffers[c].reset(new std::atomic<DataType>[size]);
+            for (unsigned int i = 0; i < size; i++) {
+                m_buffers[c][i].store(DataType(), std::memory_order_relaxed);
+            }
         }
         m_bufferSize = size;
-        m_buffers[0] = (DataType *) calloc(m_bufferSize, sizeof(DataType));
-        m_buffers[1] = (DataType *) calloc(m_bufferSize, sizeof(DataType));
+        m_sequence.reset();
     }
 
+    unsigned int size() const { return m_bufferSize; }
+
     /**
      * @brief read
-     * @param preallocated contiguous array to copy values to
-     * @return true if new values were copied
+     * @param output preallocated contiguous array to copy values to
+     * @param offset index of the first value to copy
+     * @param count number of values to copy, all values from offset by default
+     * @return the number of the write that was read, 0 before the first write.
+     * Each reader can keep the last one it read to tell if values changed.
      */
-    bool read(DataType *output) {
-        bool newValues = false;
-        std::unique_lock<std::mutex> lk(m_meterMutex);
-        if (m_newValues) {
-            memcpy(output, m_newValues, sizeof (DataType) * m_bufferSize);
-            m_newValues = nullptr;
-        } else {
-            memcpy(output, m_buffers[m_currentBuffer], sizeof (DataType) * m_bufferSize);
+    uint32_t read(DataType *output, unsigned int offset = 0, unsigned int count = UINT_MAX) {
+        if (offset >= m_bufferSize) {
+            return 0;
+        }
+        if (count > m_bufferSize - offset) {
+            count = m_bufferSize - offset;
         }
-        return newValues;
+        // The sequence is incremented twice per write, and whichever copy
+        // is read holds write sequence / 2
+        uint32_t sequence = m_sequence.read([&](int c) {
+            const std::atomic<DataType> *copy = m_buffers[c].get() + offset;
+            for (unsigned int i = 0; i < count; i++) {
+                output[i] = copy[i].load(std::memory_order_acquire);
+            }
+        });
+        return sequence / 2;
     }
 
-    void write(DataType *input) {
-        if (m_meterMutex.try_lock()) {
-            if (!m_newValues) { // The previous values have been consumed, so use free buffer
-                m_currentBuffer++;
-                if (! (m_currentBuffer & 0b10)) {
-                    m_currentBuffer = 0;
-                }
+    /** Publish size() values. Only one thread may write. */
+    void write(const DataType *input) {
+        m_sequence.write([&](int c) {
+            for (unsigned int i = 0; i < m_bufferSize; i++) {
+                m_buffers[c][i].store(input[i], std::memory_order_release);
             }
-            m_newValues = m_buffers[m_currentBuffer];
-            memcpy(m_newValues, input, sizeof (DataType) * m_bufferSize);
-            m_meterMutex.unlock();
-        }
+        });
     }
 
 private:
-    /* output data */
-    DataType *m_buffers[2]; // double buffering
-    DataType *m_newValues {nullptr};
-    int m_currentBuffer {0};
+    std::unique_ptr<std::atomic<DataType>[]> m_buffers[2];
     unsigned int m_bufferSize {0};
-    std::mutex m_meterMutex;
+    AtomicSequence m_sequence;
+};
+
+/** Cascaded biquad filters with the same coefficients on every channel.
+ *
+ * Channels are filtered in groups of four in lockstep, with SSE when
+ * available. The filters are transposed direct form II.
+ */
+class BiquadBank {
+public:
+    /** Set the number of channels and of cascaded stages. Coefficients are
+     * reset to pass through and the filter state is cleared.
+     */
+    void resize(unsigned int numChannels, unsigned int numStages);
+
+    /** Set the coefficients of a stage, normalized so that a0 is 1 */
+    void setStage(unsigned int stage, double b0, double b1, double b2, double a1, double a2);
+
+    /** Set a stage to a second order Butterworth low pass or high pass */
+    void setButterworth(unsigned int stage, double frequency, double sampleRate, bool lowpass);
+
+    /** Clear the filter state */
+    void reset();
+
+    /** Filter numChannels (4 at most) channels starting at firstChannel,
+     * which must be a multiple of 4. in and out may be the same buffers.
+     */
+    void process(float *const *out, const float *const *in, unsigned int firstChannel,
+                 unsigned int numChannels, unsigned int numFrames);
+
+    unsigned int numChannels() const { return m_numChannels; }
+
+private:
+    unsigned int m_numChannels {0};
+    unsigned int m_numStages {0};
+    std::vector<float> m_coefficients; // b0 b1 b2 a1 a2 per stage
+    std::vector<float> m_state; // s1[4] s2[4] per stage, per group of 4 channels
 };
 
 /** Control of audio output. This class is designed to be used as the last class in the
@@ -190,73 +240,79 @@ public:
      */
     void setMuteAll(bool muteAll);
 
-    /** If clipperOn is true, the output signal for a channel is clipped if it is greater
-     * than the global gain set with setGlobalGain(). If false, there is no clipping.
+    /** If clipperOn is true, the output signal for a channel is clipped if its magnitude is
+     * greater than the master gain set with setMasterGain(). If false, there is no clipping.
      * It is recommended that for systems with large numbers of channels you set this to
      * to avoid loud surprises.
      */
     void setClipperOn(bool clipperOn);
 
-    /** Set the frequency at which peak meter data is updated. During the update period,
-     * a single value (maximum sample peak) is stored, and will only be avialable once
-     * the period is completed, as this is passed to the non-audio context through a
-     * lock-free ring buffer.
+    /** Set the frequency at which meter data is updated. During the update period,
+     * the sample peaks and the RMS are accumulated, and they are only available
+     * once the period is completed, as a snapshot that can be read from any thread
+     * without locking.
      */
     void setMeterUpdateFreq(double freq);
 
-    /** Set bass management cross-over frequency. The signal from all channels will be run
-     * through a pair of linear-phase cross-over filters, and the signal from the low pass
-     * filters is sent to the subwoofers specified using setSwIndeces().
+    /** Set bass management cross-over frequency. The signal from all channels is run
+     * through 4th order Linkwitz-Riley cross-over filters, and the signal from the low
+     * pass filters is sent to the subwoofers specified using setSwIndeces().
     */
     void setBassManagementFreq(double frequency);
 
     void setBassManagementMode(bass_mgmt_mode_t mode);
 
     /** Specify which channel indeces are subwoofers for the purpose of bass management.
-     * Currently a maximum of 4 subwoofers are supported.
+     * Currently a maximum of 4 subwoofers are supported. Use -1 for unused slots.
      */
     void setSwIndeces(int i1, int i2, int i3, int i4);
 
-    /** Enable peak metering. If set to false, no meter values will be sent out via OSC,
-     * and no values will be provided by getMeterValues()
+    /** Enable metering. If set to false, meter values are not updated.
      */
     void setMeterOn(bool meterOn);
 
-//    /** Fill the values array with the peak meter values. Note that because the values
-//     * are stored in a ringbuffer, this function cannot be used together with OSC meters
-//     * as the OSC thread will empty the values before they are read here.
-//     *
-//     * @return returns the number of meter values read.
-//     */
-//    int getMeterValues(float *values);
+    /** Enable the loudness meter (momentary loudness as in ITU-R BS.1770, over
+     * 400 ms with every channel weighted 1). It is updated with the other meter
+     * values, so the meter must be on too.
+     */
+    void setLoudnessOn(bool loudnessOn);
 
+    /** Sample peak of a channel during the last meter period */
     float getCurrentChannelValue(unsigned int channel) {
         assert(channel < m_numChnls);
-        float values[2];
-        m_meterMaxBuffer.read(values);
-        return values[channel];
+        float value = 0.0f;
+        m_meterBuffer.read(&value, METER_PEAK * m_numChnls + channel, 1);
+        return value;
     }
 
-    void getCurrentValues(float *values) {
-      float * minValues = new float[m_numChnls];
-      m_meterMaxBuffer.read(values);
-      m_meterMinBuffer.read(minValues);
-      for (size_t i = 0; i < m_numChnls; i++) {
-        if (fabs(values[i]) > fabs(minValues[i])) {
-          values[i] = fabs(values[i]);
-        } else {
-          values[i] = fabs(minValues[i]);
-        }
-      }
-      delete[] minValues;
+    /** Copy the sample peak of each channel during the last meter period to values,
+     * which must hold getNumChnls() values.
+     * @return true if the meter was updated since the last call to this
+     * function. The other getters keep their own flag.
+     */
+    bool getCurrentValues(float *values) {
+        return readMeter(METER_PEAK, values);
     }
 
-    void getMinimumValues(float *values) {
-      m_meterMinBuffer.read(values);
+    bool getMinimumValues(float *values) {
+        return readMeter(METER_MIN, values);
     }
 
-    void getMaximumValues(float *values) {
-      m_meterMaxBuffer.read(values);
+    bool getMaximumValues(float *values) {
+        return readMeter(METER_MAX, values);
+    }
+
+    bool getRMSValues(float *values) {
+        return readMeter(METER_RMS, values);
+    }
+
+    /** Momentary loudness in LUFS at the end of the last meter period.
+     * Silence reads as -120 LUFS.
+     */
+    float getLoudness() {
+        float value = 0.0f;
+        m_meterBuffer.read(&value, METER_COUNT * m_numChnls, 1);
+        return value;
     }
 
     /** Get the number of channels processed by this OutputMaster object */
@@ -298,36 +354,61 @@ protected:
     void setBassManagementModeTimestamped(al_sec until, int mode);
 
 private:
-    unsigned int m_numChnls;
+    /* Meter snapshot layout, each for all channels, then the loudness */
+    enum { METER_PEAK = 0, METER_MAX, METER_MIN, METER_RMS, METER_COUNT };
+
+    unsigned int m_numChnls {0};
 
 	/* parameters */
 	std::string m_addressPrefix;
-	std::vector<double> m_gains;
-    bool m_muteAll {false};
-    double m_masterGain;
-    bool m_clipperOn;
-	bool m_meterOn;
+    std::unique_ptr<std::atomic<float>[]> m_gains;
+    std::atomic<bool> m_muteAll {false};
+    std::atomic<float> m_masterGain {1.0f};
+    std::atomic<bool> m_clipperOn {true};
+    std::atomic<bool> m_meterOn {false};
+    std::atomic<bool> m_loudnessOn {false};
 	bool m_meterAddrHasChannel;
-    int m_meterUpdateSamples; /* number of samples between level updates */
+    std::atomic<int> m_meterUpdateSamples {1}; /* number of samples between level updates */
 
-    bass_mgmt_mode_t m_BassManagementMode;
-    int swIndex[4]; /* support for 4 SW max */
+    std::atomic<int> m_BassManagementMode {BASSMODE_NONE};
+    std::atomic<float> m_bassManagementFreq {150.0f};
+    std::atomic<int> swIndex[4] {{-1}, {-1}, {-1}, {-1}}; /* support for 4 SW max */
 
-    std::vector<float> m_meterMax;
-    std::vector<float> m_meterMin;
-    DoubleBuffering<float> m_meterMaxBuffer;
-    DoubleBuffering<float> m_meterMinBuffer;
+    /* audio thread state */
+    std::vector<float> m_meterValues; /* accumulated peaks and the snapshot to publish */
+    std::vector<double> m_meterSquares;
+    DoubleBuffering<float> m_meterBuffer;
+    std::atomic<uint32_t> m_lastMeterRead[METER_COUNT]; /* last snapshot read by each getter */
     int m_meterCounter {0}; /* count samples for level updates */
+    bool m_meterWasOn {false};
+    bool m_loudnessWasOn {false};
+    int m_lastBassManagementMode {BASSMODE_NONE};
+    float m_filterFreq {0.0f}; /* cross-over frequency the filters are set to */
 
     /* bass management filters */
-    std::vector<gam::Biquad<double>> m_lopass1, m_lopass2, m_hipass1, m_hipass2;
+    BiquadBank m_lopass, m_hipass;
+
+    /* loudness: K-weighting filters and mean squares of the last four 100 ms blocks */
+    BiquadBank m_kWeighting;
+    double m_loudnessSquares[4];
+    double m_loudnessSum {0.0};
+    int m_loudnessCounter {0};
+    int m_loudnessBlock {0};
 
-    double m_framesPerSec; // Sample rate
+    double m_framesPerSec {44100.0}; // Sample rate
+
+    bool readMeter(int meter, float *values) {
+        uint32_t snapshot = m_meterBuffer.read(values, meter * m_numChnls, m_numChnls);
+        return m_lastMeterRead[meter].exchange(snapshot, std::memory_order_relaxed) != snapshot;
+    }
 
     int chanIsSubwoofer(int index);
     void initializeData();
     void allocateChannels(unsigned int numChnls);
-    static void *meterThreadFunc(void *arg);
+    void resetMeters();
+    void resetLoudness();
+    void processBassManagement(AudioIOData &io, unsigned int numChnls, int mode);
+    void processLoudness(AudioIOData &io, unsigned int numChnls);
 
 };
 
@@ -53,11 +53,15 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <thread>
+#include <unordered_set>
 
 #include "al/core/math/al_Vec.hpp"
 #include "al/core/spatial/al_Pose.hpp"
 #include "al/core/types/al_Color.hpp"
 #include "al/core/protocol/al_OSC.hpp"
+#include "al/core/types/al_AtomicValue.hpp"
+#include "al/util/al_MPSCRingBuffer.hpp"
 
 namespace al
 {
@@ -153,6 +157,11 @@ public:
     void set(ParameterMeta *p);
 
 protected:
+    friend class ParameterNotifier;
+
+    /// Called by a ParameterNotifier to run the change callbacks
+    virtual void runDeferredCallbacks() {}
+
 	std::string mFullAddress;
 	std::string mParameterName;
     std::string mDisplayName;
@@ -162,6 +171,66 @@ protected:
     std::map<std::string, float> mHints; // Provide hints for behavior
 };
 
+/**
+ * @brief Runs the change callbacks of parameters outside the thread that
+ * sets them
+ *
+ * Parameters given a notifier with setNotifier() don't call their change
+ * callbacks in set(). They store the value and queue themselves without
+ * locking or allocating, so they can be set from the audio thread. The
+ * notifier then calls the callbacks with the latest value from its own
+ * thread, or from processNotifications() if created without one. Several
+ * changes before the callbacks run are notified once.
+ *
+ * @code
+ * ParameterNotifier notifier;
+ * Parameter gain("gain");
+ * gain.setNotifier(&notifier);
+ * gain.registerChangeCallback([](float value) { updateWidget(value); });
+ * // In the audio callback
+ * gain.set(0.5); // The callback is called soon after from the notifier thread
+ * @endcode
+ */
+class ParameterNotifier {
+public:
+    /**
+     * @param runThread if true, a thread calls processNotifications() every
+     * period seconds. Otherwise it must be called by the application, e.g.
+     * from onAnimate().
+     * @param period seconds between checks for changes
+     * @param queueSize maximum number of parameters waiting to be notified
+     */
+    ParameterNotifier(bool runThread = true, double period = 0.005, size_t queueSize = 1024);
+    ~ParameterNotifier();
+
+    ParameterNotifier(const ParameterNotifier &) = delete;
+    ParameterNotifier &operator=(const ParameterNotifier &) = delete;
+
+    /**
+     * @brief Call the change callbacks of the parameters that changed
+     *
+     * Don't call from the audio thread.
+     */
+    void processNotifications();
+
+private:
+    template<class ParameterType> friend class ParameterWrapper;
+
+    /// Queue a parameter. Can be called from any thread
+    bool push(ParameterMeta *param) { return mQueue.push(param); }
+    /// A parameter is being destroyed. Waits for its callbacks to finish,
+    /// and skips it if it is still queued
+    void forget(ParameterMeta *param, const std::atomic<bool> &queued);
+
+    MPSCRingBuffer<ParameterMeta *> mQueue;
+    std::mutex mProcessLock; // Only one thread reads the queue
+    std::atomic<std::thread::id> mProcessingThread {std::thread::id()};
+    std::unordered_multiset<ParameterMeta *> mForgotten;
+    std::atomic<bool> mRunning {false};
+    double mPeriod;
+    std::thread mThread;
+};
+
 
 /**
  * @brief The ParameterWrapper class provides a generic thread safe Parameter class from the ParameterType template parameter
@@ -179,9 +248,8 @@ public:
    * @param min Minimum value for the parameter
    * @param max Maximum value for the parameter
    *
-   * The mechanism used to protect data is locking a mutex within the set() function
-   * and doing try_lock() on the mutex to update a cached value in the get()
-   * function. In the worst case this might incur some jitter when reading the value.
+   * The value is kept in an AtomicValue, so get() never locks or waits and
+   * always returns the last value set.
    */
     ParameterWrapper(std::string parameterName, std::string group = "",
               ParameterType defaultValue = ParameterType(),
@@ -202,7 +270,8 @@ public:
 	 * @brief set the parameter's value
 	 * 
      * This function is thread-safe and can be called from any number of threads.
-     * It blocks to lock a mutex so its use in critical contexts should be avoided.
+     * The change callbacks are called in this thread, unless a notifier has
+     * been set with setNotifier().
 	 */
     virtual void set(ParameterType value)
     {
@@ -211,17 +280,13 @@ public:
         if (mProcessCallback) {
             value = (*mProcessCallback)(value); //, mProcessUdata);
         }
-        for(auto cb:mCallbacks) {
-            (*cb)(value);
-        }
-        setLocking(value);
+        storeAndNotify(value);
     }
 
 	/**
 	 * @brief set the parameter's value without calling callbacks
 	 *
 	 * This function is thread-safe and can be called from any number of threads.
-     * It blocks to lock a mutex so its use in critical contexts should be avoided.
 	 * The processing callback is called, but the callbacks registered with
 	 * registerChangeCallback() are not called. This is useful to avoid infinite
 	 * recursion when a widget sets the parameter that then sets the widget.
@@ -235,27 +300,27 @@ public:
         }
 
         if (blockReceiver) {
-            for(auto cb:mCallbacks) {
-                (*cb)(value);
-            }
+            storeAndNotify(value);
+        } else {
+            setLocking(value);
         }
-        setLocking(value);
     }
 
 	/**
-	 * @brief set the parameter's value forcing a lock
+	 * @brief set the parameter's value without calling any callbacks
+	 *
+	 * Kept for compatibility. It no longer locks.
 	 */
 	inline void setLocking(ParameterType value)
 	{
-        mMutex->lock();
-		mValue = value;
-        mMutex->unlock();
+		mValue.store(value);
 	}
 
 	/**
 	 * @brief get the parameter's value
 	 * 
-	 * This function is thread-safe and can be called from any number of threads
+	 * This function is thread-safe and can be called from any number of
+	 * threads. It doesn't lock or wait for writers.
 	 * 
 	 * @return the parameter value
 	 */
@@ -313,6 +378,14 @@ public:
 	 */
     void registerChangeCallback(ParameterChangeCallback cb);
 
+	/**
+	 * @brief Run the change callbacks from a notifier's thread
+	 *
+	 * @param notifier the notifier, or nullptr to call them from set() again.
+	 * Must outlive the parameter.
+	 */
+    void setNotifier(ParameterNotifier *notifier) { mNotifier = notifier; }
+
 	std::vector<ParameterWrapper<ParameterType> *> operator<< (ParameterWrapper<ParameterType> &newParam)
 	{ std::vector<ParameterWrapper<ParameterType> *> paramList;
 		paramList.push_back(&newParam);
@@ -338,19 +411,49 @@ protected:
     std::vector<std::shared_ptr<ParameterChangeCallback>> mCallbacks;
 	// std::vector<void *> mCallbackUdata;
 
+    AtomicValue<ParameterType> mValue;
+
+    /// Call the change callbacks, or queue them with the notifier, and
+    /// store the value
+    void storeAndNotify(ParameterType value) {
+        if (mNotifier) {
+            mValue.store(value);
+            queueCallbacks();
+            return;
+        }
+        for(auto cb:mCallbacks) {
+            (*cb)(value);
+        }
+        mValue.store(value);
+    }
+
 private:
-    std::mutex *mMutex; // pointer to avoid having to explicitly declare copy/move
-	ParameterType mValue;
-    ParameterType mValueCache;
+    void queueCallbacks() {
+        // Only queued once until the notifier has run the callbacks
+        if (!mNotifyPending.exchange(true) && !mNotifier->push(this)) {
+            mNotifyPending = false;
+        }
+    }
+
+    virtual void runDeferredCallbacks() override {
+        mNotifyPending = false;
+        ParameterType value = get();
+        for(auto cb:mCallbacks) {
+            (*cb)(value);
+        }
+    }
+
+    ParameterNotifier *mNotifier {nullptr};
+    std::atomic<bool> mNotifyPending {false};
 };
 
 
 /**
  * @brief The Parameter class
  *
- * The Parameter class offers a simple way to encapsulate float values. It is
- * not inherently thread safe, but since floats are atomic on most platforms
- * it is safe in practice.
+ * The Parameter class offers a simple way to encapsulate float values. The
+ * value is a std::atomic<float>, so it can be set and read from any thread
+ * without locking.
  *
  * Parameters are created with:
  * @code
@@ -390,8 +493,7 @@ public:
    * @param max Maximum value for the parameter
    *
    * This Parameter class is designed for parameters that can be expressed as a
-   * single float. It realies on float being atomic on the platform so there
-   * is no locking. This is a safe assumption for most platforms today.
+   * single float. The value is atomic so there is no locking.
    */
     Parameter(std::string parameterName, std::string Group,
               float defaultValue = 0,
@@ -407,14 +509,13 @@ public:
 	Parameter(const al::Parameter& param) :
 	    ParameterWrapper<float>(param)
 	{
-		mFloatValue = param.mFloatValue;
 	}
 
 	/**
 	 * @brief set the parameter's value
 	 *
 	 * This function is thread-safe and can be called from any number of threads
-     * It does not block and relies on the atomicity of float.
+     * It does not block.
 	 */
 	virtual void set(float value) override;
 
@@ -438,7 +539,7 @@ public:
 	virtual float get() override;
 
 	virtual float toFloat() override {
-		return mFloatValue;
+		return get();
 	}
 
 	virtual void fromFloat(float value) override {
@@ -450,9 +551,6 @@ public:
     virtual void sendValue(osc::Send &sender, std::string prefix = "") override {
         sender.send(prefix + getFullAddress(), get());
     }
-
-private:
-	float mFloatValue;
 };
 
 
@@ -470,9 +568,7 @@ public:
    * @param max Maximum value for the parameter
    *
    * This Parameter class is designed for parameters that can be expressed as a
-   * single 32 bit integer number. It realies on float being atomic on the
-   * platform so there is no locking. This is a safe assumption for most
-   * desktop platforms today.
+   * single 32 bit integer number. The value is atomic so there is no locking.
    */
     ParameterInt(std::string parameterName, std::string Group = "",
               int32_t defaultValue = 0,
@@ -484,14 +580,13 @@ public:
 	ParameterInt(const al::ParameterInt& param) :
 	    ParameterWrapper<int32_t>(param)
 	{
-		mIntValue = param.mIntValue;
 	}
 
 	/**
 	 * @brief set the parameter's value
 	 *
 	 * This function is thread-safe and can be called from any number of threads
-     * It does not block and relies on the atomicity of float.
+     * It does not block.
 	 */
 	virtual void set(int32_t value) override;
 
@@ -515,7 +610,7 @@ public:
 	virtual int32_t get() override;
 
 	virtual float toFloat() override {
-        return float(mIntValue);
+        return float(get());
 	}
 
 	virtual void fromFloat(float value) override {
@@ -527,9 +622,6 @@ public:
     virtual void sendValue(osc::Send &sender, std::string prefix = "") override {
         sender.send(prefix + getFullAddress(), get());
     }
-
-private:
-	int32_t mIntValue;
 };
 
 class ParameterBool : public Parameter
@@ -546,8 +638,7 @@ public:
    * @param max Value when on/true
    *
    * This ParameterBool class is designed for boolean parameters that have
-   * float values for on or off states. It relies on floats being atomic on
-   * the platform.
+   * float values for on or off states.
    */
     ParameterBool(std::string parameterName, std::string Group = "",
               float defaultValue = 0,
@@ -595,8 +686,8 @@ public:
     }
 };
 
-// These three types are blocking, should not be used in time-critical contexts
-// like the audio callback. The classes were explicitly defined to overcome
+// Reading these types doesn't block, but setting ParameterString waits for
+// threads that are reading it. The classes were explicitly defined to overcome
 // the issues related to the > and < operators needed when validating minumum
 // and maximum values for the parameter
 class ParameterString: public ParameterWrapper<std::string>
@@ -626,6 +717,19 @@ public:
     virtual void sendValue(osc::Send &sender, std::string prefix = "") override {
         sender.send(prefix + getFullAddress(), get());
     }
+
+    /// Copy the value to buffer as a null terminated string of at most
+    /// size - 1 characters. Unlike get() it doesn't allocate, so it can be
+    /// used from the audio thread. Returns the number of characters copied.
+    size_t copyValue(char *buffer, size_t size) {
+        size_t length = 0;
+        mValue.read([&](const std::string &value) {
+            length = std::min(value.size(), size - 1);
+            memcpy(buffer, value.data(), length);
+        });
+        buffer[length] = '\0';
+        return length;
+    }
 };
 
 class ParameterVec3: public ParameterWrapper<al::Vec3f>
@@ -729,6 +833,24 @@ public:
       }
     }
 
+    /// Copy the current element to buffer as a null terminated string of at
+    /// most size - 1 characters, without allocating. Returns false without
+    /// waiting if the elements are being accessed by another thread.
+    bool copyCurrent(char *buffer, size_t size) {
+      int current = get();
+      if (!mElementsLock.try_lock()) {
+        return false;
+      }
+      size_t length = 0;
+      if (current >= 0 && current < int(mElements.size())) {
+        length = std::min(mElements[current].size(), size - 1);
+        memcpy(buffer, mElements[current].data(), length);
+      }
+      buffer[length] = '\0';
+      mElementsLock.unlock();
+      return true;
+    }
+
     void setCurrent(std::string element, bool noCalls = false) {
         mElementsLock.lock();
         auto position = std::find(mElements.begin(), mElements.end(), element);
@@ -866,18 +988,18 @@ public:
 template<class ParameterType>
 ParameterWrapper<ParameterType>::~ParameterWrapper()
 {
-    delete mMutex;
+    if (mNotifier) {
+        mNotifier->forget(this, mNotifyPending);
+    }
 }
 
 template<class ParameterType>
 ParameterWrapper<ParameterType>::ParameterWrapper(std::string parameterName, std::string group,
           ParameterType defaultValue,
           std::string prefix) :
-    ParameterMeta(parameterName, group, prefix), mProcessCallback(nullptr)
+    ParameterMeta(parameterName, group, prefix), mProcessCallback(nullptr),
+    mValue(defaultValue)
 {
-	mValue = defaultValue;
-	mValueCache = defaultValue;
-    mMutex = new std::mutex;
 }
 
 
@@ -889,30 +1011,26 @@ ParameterWrapper<ParameterType>::ParameterWrapper(std::string parameterName, std
 {
 	mMin = min;
 	mMax = max;
-    mMutex = new std::mutex;
 }
 
 template<class ParameterType>
 ParameterWrapper<ParameterType>::ParameterWrapper(const ParameterWrapper<ParameterType> &param)
-	: ParameterMeta(param.mParameterName, param.mGroup, param.mPrefix)
+	: ParameterMeta(param.mParameterName, param.mGroup, param.mPrefix),
+      mValue(param.mValue.load())
 {
 	mMin = param.mMin;
 	mMax = param.mMax;
 	mProcessCallback = param.mProcessCallback;
 	// mProcessUdata = param.mProcessUdata;
 	mCallbacks = param.mCallbacks;
-    mMutex = new std::mutex;
+	mNotifier = param.mNotifier;
 	// mCallbackUdata = param.mCallbackUdata;
 }
 
 template<class ParameterType>
 ParameterType ParameterWrapper<ParameterType>::get()
 {
-    if (mMutex->try_lock()) {
-		mValueCache = mValue;
-        mMutex->unlock();
-	}
-	return mValueCache;
+	return mValue.load();
 }
 
 template<class ParameterType>
@@ -41,6 +41,7 @@
 */
 
 #include <mutex>
+#include <unordered_map>
 
 #include "al/core/protocol/al_OSC.hpp"
 #include "al/util/ui/al_Parameter.hpp"
@@ -324,7 +325,7 @@ public:
     uint16_t serverPort() {return mServer->port();}
 
     void verbose(bool verbose= true) { mVerbose = verbose;}
-    static bool setParameterValueFromMessage(ParameterMeta *param, std::string address, osc::Message &m);
+    static bool setParameterValueFromMessage(ParameterMeta *param, const std::string &address, osc::Message &m);
 
 protected:
     static void changeCallback(float value, void *sender, void *userData, void *blockThis);
@@ -360,6 +361,7 @@ protected:
     std::mutex mServerLock;
 
     std::vector<ParameterMeta *> mParameters;
+    std::unordered_multimap<std::string, ParameterMeta *> mParameterIndex; // Parameters by full OSC address
     std::map<std::string, std::vector<ParameterBundle *>> mParameterBundles;
     std::map<std::string, int> mCurrentActiveBundle;
     std::mutex mParameterLock;
@@ -154,6 +154,11 @@ public:
     */
     static void setParameterValues(ParameterMeta *param, std::vector<float> &values, double factor = 1.0);
 
+    /**
+     * @brief Current values of a parameter as stored in preset files
+     */
+    static std::vector<float> getParameterValue(ParameterMeta *p);
+
 	void morphTo(ParameterStates &parameterStates, float morphTime);
 	void stopMorph();
 
@@ -232,6 +237,12 @@ public:
 
     std::vector<ParameterMeta *> parameters() { return  mParameters;}
 
+    /**
+     * @brief All registered parameters, including those in bundles, with
+     * the address used for them in preset files
+     */
+    std::vector<std::pair<std::string, ParameterMeta *>> presetParameters();
+
 	std::string buildMapPath(std::string mapName, bool useSubDirectory = false);
 
     std::vector<std::string> availablePresetMaps();
@@ -331,11 +342,11 @@ public:
 	                       bool overwrite = true);
 private:
 
-    std::vector<float> getParameterValue(ParameterMeta *p);
     void setParametersInBundle(ParameterBundle *bundle, std::string bundlePrefix, PresetHandler *handler, float factor = 1.0);
 	static void morphingFunction(PresetHandler *handler);
 
-    ParameterStates getBundleStates(ParameterBundle *bundle, std::string id);
+    void getBundleParameters(ParameterBundle *bundle, std::string prefix,
+                             std::vector<std::pair<std::string, ParameterMeta *>> &parameters);
 
     bool mVerbose {false};
 	bool mUseCallbacks {false};
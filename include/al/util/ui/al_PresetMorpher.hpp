@@ -0,0 +1,223 @@
+#ifndef AL_PRESETMORPHER_H
+#define AL_PRESETMORPHER_H
+
+/*	Allocore --
+	Multimedia / virtual environment application class library
+
+	Copyright (C) 2009. AlloSphere Research Group, Media Arts & Technology, UCSB.
+	Copyright (C) 2012-2018. The Regents of the University of California.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+		Redistributions of source code must retain the above copyright notice,
+		this list of conditions and the following disclaimer.
+
+		Redistributions in binary form must reproduce the above copyright
+		notice, this list of conditions and the following disclaimer in the
+		documentation and/or other materials provided with the distribution.
+
+		Neither the name of the University of California nor the names of its
+		contributors may be used to endorse or promote products derived from
+		this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+	ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+	LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+	CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+	SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+	INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+	CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+	ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+	POSSIBILITY OF SUCH DAMAGE.
+
+	File description:
+	Audio rate morphing between presets
+*/
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "al/core/io/al_AudioIOData.hpp"
+#include "al/core/types/al_AtomicHandoff.hpp"
+#include "al/util/ui/al_Preset.hpp"
+
+namespace al
+{
+
+/**
+ * @brief Morphs the parameters of a PresetHandler from the audio thread
+ *
+ * PresetHandler::morphTo() steps every 50 ms from its own thread and sets
+ * every parameter on each step. PresetMorpher instead lays out the values
+ * of all parameters registered with the handler as flat float arrays and
+ * ramps them linearly in process(), once per audio block or per sample.
+ * The parameters themselves are not touched while morphing. The morphed
+ * values are read from slots with value(), which doesn't lock and can be
+ * called from any thread, so voices read them directly in the audio
+ * callback.
+ *
+ * Call compile() after registering all parameters and before starting
+ * audio. Start morphs from any thread except the audio thread. When the
+ * parameters (e.g. in the GUI) should follow the morph, call
+ * updateParameters() from a non audio thread, e.g. in onAnimate().
+ *
+ * Continuous parameters (Parameter, ParameterVec3, ParameterVec4,
+ * ParameterPose and ParameterColor) are ramped. Other parameters jump to
+ * their target value at the start of the morph, as with morphTo().
+ *
+ * @code
+ * PresetMorpher morpher(presetHandler);
+ * morpher.compile();
+ * int cutoffSlot = morpher.slot("/cutoff");
+ * // From the GUI or a sequencer
+ * morpher.morphTo("bright", 2.0);
+ * // In the audio callback
+ * morpher.processBlock(io);
+ * while (io()) {
+ *   float cutoff = morpher.value(cutoffSlot, io.frame());
+ *   ...
+ * }
+ * @endcode
+ */
+class PresetMorpher
+{
+public:
+    typedef PresetHandler::ParameterStates ParameterStates;
+
+    typedef enum {
+        MORPH_BLOCK, // Values advance once per block, to the end of the block
+        MORPH_SAMPLE // Values ramp within the block, read with value(slot, frame)
+    } MorphRate;
+
+    PresetMorpher(PresetHandler &handler, MorphRate rate = MORPH_SAMPLE);
+    ~PresetMorpher();
+
+    PresetMorpher(const PresetMorpher &) = delete;
+    PresetMorpher &operator=(const PresetMorpher &) = delete;
+
+    /**
+     * @brief Lay out the slots for the parameters registered with the handler
+     *
+     * Slots start with the current parameter values. Not real-time safe,
+     * and the audio thread must not be running process(). Cancels any morph.
+     */
+    void compile();
+
+    /**
+     * @brief First slot for a parameter
+     * @param address address of the parameter in preset files, see
+     * PresetHandler::presetParameters()
+     * @return -1 if not found
+     *
+     * Parameters with several values (e.g. ParameterVec3) use consecutive
+     * slots.
+     */
+    int slot(std::string address) const;
+    unsigned int numSlots() const { return mNumSlots; }
+
+    void rate(MorphRate rate) { mRate = rate; }
+    MorphRate rate() const { return mRate; }
+
+    /**
+     * @brief Morph from the current values to a preset
+     * @return false if the preset could not be loaded
+     */
+    bool morphTo(std::string presetName, float morphTime);
+
+    /**
+     * @brief Morph from the current values to parameterStates
+     *
+     * Parameters not in parameterStates keep their current value.
+     */
+    void morphTo(const ParameterStates &parameterStates, float morphTime);
+
+    /**
+     * @brief Jump to from and morph to to
+     *
+     * Parameters not in from start from their current value.
+     */
+    void morph(const ParameterStates &from, const ParameterStates &to, float morphTime);
+
+    /// Stop the morph and hold the current values
+    void stopMorph();
+
+    /**
+     * @brief Advance the morph by a block. Call once per block from the
+     * audio thread, before reading the values.
+     */
+    void process(unsigned int numFrames, double framesPerSecond);
+
+    void processBlock(AudioIOData &io) { process(io.framesPerBuffer(), io.framesPerSecond()); }
+
+    /**
+     * @brief Value of a slot at the start of the block (or at the end with
+     * MORPH_BLOCK). Can be called from any thread.
+     */
+    float value(int slot) const { return mValues[slot].load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Value of a slot at a frame of the current block. Only call
+     * from the audio thread, after process().
+     */
+    float value(int slot, unsigned int frame) const {
+        return mValues[slot].load(std::memory_order_relaxed)
+                + mIncrements[slot] * float(frame < mRampFrames ? frame : mRampFrames);
+    }
+
+    /// true while a morph is in progress or waiting for the audio thread
+    bool morphing() const { return mMorphing.load() || mHandoff.pending(); }
+
+    /**
+     * @brief Set the parameters to the current slot values
+     *
+     * Takes the parameter locks and calls their callbacks, so don't call
+     * from the audio thread.
+     */
+    void updateParameters();
+
+private:
+    struct Morph;
+    struct Entry {
+        ParameterMeta *parameter;
+        unsigned int slot;
+        unsigned int size;
+    };
+
+    Morph *newMorph(float morphTime);
+    void fill(Morph *morph, const ParameterStates &states, bool start);
+    /// Start the morph waiting if there is one
+    void update(double framesPerSecond);
+    void clear();
+
+    PresetHandler &mHandler;
+    MorphRate mRate;
+
+    std::vector<Entry> mEntries;
+    std::map<std::string, unsigned int> mSlots; // Index in mEntries by address
+    std::vector<unsigned int> mSteppedSlots; // Slots of parameters that don't ramp
+    unsigned int mNumSlots {0};
+
+    // Audio thread
+    std::vector<float> mCurrent; // Value at the end of the last block
+    std::vector<float> mIncrements; // Per frame, in the current block
+    unsigned int mRampFrames {0};
+    bool mEndedInBlock {false};
+    Morph *mActive {nullptr};
+    double mElapsedFrames {0};
+    double mMorphFrames {0};
+
+    std::unique_ptr<std::atomic<float>[]> mValues;
+    AtomicHandoff<Morph> mHandoff;
+    std::atomic<bool> mMorphing {false};
+};
+
+}
+
+#endif // AL_PRESETMORPHER_H
@@ -1,4 +1,8 @@
 #include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <thread>
 #include "al/core/graphics/al_Isosurface.hpp"
 #include "al/core/graphics/al_Graphics.hpp"
 
@@ -327,10 +331,12 @@ static const char sTriTable[256][16] = {
 
 
 Isosurface::NoVertexAction Isosurface::noVertexAction;
+const Isosurface::Index Isosurface::seamEdge;
 
 Isosurface::Isosurface(float lev, VertexAction& va)
 :	mIsolevel(lev), mVertexAction(&va),
-	mValidSurface(false), mComputeNormals(true), mNormalize(true), mInBox(false)
+	mValidSurface(false), mComputeNormals(true), mNormalize(true), mInBox(false),
+	mSkipEmptyBlocks(true), mNumThreads(0)
 {
 	cellLengths(1);
 	fieldDims(0);
@@ -529,6 +535,11 @@ void Isosurface::begin(){
 
 void Isosurface::end(){
 	compressTriangles();
+	finish();
+}
+
+
+void Isosurface::finish(){
 	primitive(al::Mesh::TRIANGLES); // must be set for proper normal generation
 	if(mComputeNormals) generateNormals(mNormalize);
 	mValidSurface = true;
@@ -564,6 +575,193 @@ void Isosurface::compressTriangles(){
 }
 
 
+/*
+Parallel pass (generate):
+
+	The cell layers are split into slabs along z. Each slab is extracted by
+	one thread from the highest layer to the lowest, like the cell-by-cell
+	pass. Instead of a map over all edges, the edge vertices are kept in
+	arrays for the planes of x and y edges above and below the current layer
+	and for the z edges in between. The arrays are rotated after each layer.
+
+	The plane of edges at the top of a slab belongs to the slab above, which
+	adds its vertices first in the serial order. Triangles on that plane
+	refer to its edges with seamEdge set, and the slab above keeps the
+	vertex indices of its lowest plane in Slab::seam to resolve them.
+
+	The slabs are then appended in order, so vertices and triangles are the
+	same as with a single thread.
+*/
+
+void Isosurface::generateSlabs(const std::function<void(Slab&, EdgeCache&)>& extract){
+	begin();
+
+	int numLayers = mNF[2]-1;
+	if(numLayers > 0 && mNF[0] > 1 && mNF[1] > 1){
+		unsigned numThreads = mNumThreads ? mNumThreads : std::thread::hardware_concurrency();
+		numThreads = std::max(1u, std::min(numThreads, unsigned(numLayers)));
+
+		// More slabs than threads to balance the load when the surface is
+		// uneven along z
+		int numSlabs = numThreads == 1 ? 1 : std::min(numLayers, int(numThreads*4));
+		std::vector<Slab> slabs(numSlabs);
+		for(int i=0; i<numSlabs; ++i){
+			// Slab 0 is the top one
+			slabs[i].z1 = numLayers - int(long(numLayers) * i / numSlabs);
+			slabs[i].z0 = numLayers - int(long(numLayers) * (i+1) / numSlabs);
+		}
+
+		std::atomic<int> nextSlab(0);
+		auto work = [&](){
+			EdgeCache cache;
+			int i;
+			while((i = nextSlab++) < numSlabs){
+				extract(slabs[i], cache);
+			}
+		};
+		std::vector<std::thread> threads;
+		for(unsigned i=1; i<numThreads; ++i){
+			threads.emplace_back(work);
+		}
+		work();
+		for(auto& t : threads) t.join();
+
+		// Append slabs
+		size_t numVertices = 0, numIndices = 0;
+		for(auto& slab : slabs){
+			numVertices += slab.positions.size();
+			numIndices += slab.indices.size();
+		}
+		vertices().reserve(numVertices);
+		indices().reserve(numIndices);
+		Index offset = 0, aboveOffset = 0;
+		for(int s=0; s<numSlabs; ++s){
+			Slab& slab = slabs[s];
+			if(mVertexAction == &noVertexAction){
+				vertices().insert(vertices().end(), slab.positions.begin(), slab.positions.end());
+			}
+			else{
+				for(auto& ev : slab.edgeVertices){
+					Mesh::vertex(ev.x, ev.y, ev.z);
+					(*mVertexAction)(ev, *this);
+				}
+			}
+			const int * seam = s > 0 ? slabs[s-1].seam.data() : nullptr;
+			for(Index i : slab.indices){
+				if(i & seamEdge){
+					assert(seam && seam[i & ~seamEdge] >= 0);
+					index(aboveOffset + seam[i & ~seamEdge]);
+				}
+				else{
+					index(offset + i);
+				}
+			}
+			aboveOffset = offset;
+			offset += slab.positions.size();
+			// Free memory as we go
+			if(s > 0) std::vector<int>().swap(slabs[s-1].seam);
+			std::vector<Vertex>().swap(slab.positions);
+			std::vector<Index>().swap(slab.indices);
+			std::vector<EdgeVertex>().swap(slab.edgeVertices);
+		}
+	}
+
+	finish();
+}
+
+
+void Isosurface::beginSlab(Slab& slab, EdgeCache& cache) const{
+	size_t planeSize = size_t(mNF[0]) * mNF[1];
+	if(cache.zEdges.size() != planeSize){
+		cache.planes[0].assign(2*planeSize, -1);
+		cache.planes[1].assign(2*planeSize, -1);
+		cache.zEdges.assign(planeSize, -1);
+		for(auto& t : cache.touched) t.clear();
+	}
+	cache.upper = 1;
+	cache.upperIsSeam = slab.z1 < mNF[2]-1;
+	slab.positions.clear();
+	slab.edgeVertices.clear();
+	slab.indices.clear();
+}
+
+
+void Isosurface::nextLayer(EdgeCache& cache) const{
+	// The plane below becomes the plane above, and the old plane above is
+	// cleared for the next layer
+	int lower = 1 - cache.upper;
+	std::vector<int>& upper = cache.planes[cache.upper];
+	for(int i : cache.touched[cache.upper]) upper[i] = -1;
+	cache.touched[cache.upper].clear();
+	for(int i : cache.touched[2]) cache.zEdges[i] = -1;
+	cache.touched[2].clear();
+	cache.upper = lower;
+	cache.upperIsSeam = false;
+}
+
+
+void Isosurface::endSlab(Slab& slab, EdgeCache& cache) const{
+	// The plane above the last layer is the lowest plane of the slab
+	slab.seam = cache.planes[cache.upper];
+	for(int p=0; p<2; ++p){
+		for(int i : cache.touched[p]) cache.planes[p][i] = -1;
+		cache.touched[p].clear();
+	}
+}
+
+
+void Isosurface::addSlabCell(Slab& slab, EdgeCache& cache, int ix, int iy, int iz, int idx, const float * vals) const{
+	const int edgeCode = sEdgeTable[idx];
+	int verts[12];
+	for(int e=0; e<12; ++e){
+		if(edgeCode & (1<<e)) verts[e] = slabEdgeVertex(slab, cache, ix,iy,iz, e, vals);
+	}
+	for(int i=1; i <= sTriTable[idx][0]; i+=3){
+		slab.indices.push_back(verts[size_t(sTriTable[idx][i+2])]);
+		slab.indices.push_back(verts[size_t(sTriTable[idx][i+1])]);
+		slab.indices.push_back(verts[size_t(sTriTable[idx][i  ])]);
+	}
+}
+
+
+int Isosurface::slabEdgeVertex(Slab& slab, EdgeCache& cache, int ix, int iy, int iz, int edgeNo, const float * vals) const{
+	// Direction (x, y or z) and position offset from cell of each edge
+	static const char edges[12][4] = {
+		{1,0,0,0}, {0,0,1,0}, {1,1,0,0}, {0,0,0,0},
+		{1,0,0,1}, {0,0,1,1}, {1,1,0,1}, {0,0,0,1},
+		{2,0,0,0}, {2,0,1,0}, {2,1,1,0}, {2,1,0,0}
+	};
+	const char * e = edges[edgeNo];
+	int pos = (iy + e[2]) * mNF[0] + ix + e[1];
+
+	int * entry;
+	int touchedList;
+	if(e[0] == 2){
+		entry = &cache.zEdges[pos];
+		touchedList = 2;
+	}
+	else if(e[3] && cache.upperIsSeam){
+		return int(seamEdge | Index(2*pos + e[0]));
+	}
+	else{
+		touchedList = e[3] ? cache.upper : 1 - cache.upper;
+		entry = &cache.planes[touchedList][2*pos + e[0]];
+	}
+
+	if(*entry < 0){
+		EdgeVertex ev = calcIntersection(ix,iy,iz, edgeNo, vals);
+		ev.pos[0] = ix;
+		ev.pos[1] = iy;
+		ev.pos[2] = iz;
+		*entry = int(slab.positions.size());
+		cache.touched[touchedList].push_back(e[0] == 2 ? pos : 2*pos + e[0]);
+		slab.positions.emplace_back(ev.x, ev.y, ev.z);
+		if(mVertexAction != &noVertexAction) slab.edgeVertices.push_back(ev);
+	}
+	return *entry;
+}
+
+
 Isosurface& Isosurface::cellLengths(double dx, double dy, double dz){
 	mL[0]=dx; mL[1]=dy; mL[2]=dz;
 	return *this;
@@ -1,8 +1,11 @@
 #include <algorithm> // transform
 #include <cctype> // tolower
+#include <cmath>
+#include <cstring>
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <fstream>
 #include <cstdint>
@@ -169,72 +172,267 @@ void Mesh::invertNormals() {
   for(int i=0; i<Nv; ++i) normals()[i] = -normals()[i];
 }
 
-void Mesh::compress() {
+namespace {
 
-  int Ni = indices().size();
-  int Nv = vertices().size();
-  if (Ni) {
-    AL_WARN_ONCE("cannot compress Mesh with indices");
-    return;
+uint64_t hashCell(int64_t x, int64_t y, int64_t z) {
+  uint64_t h = uint64_t(x) * 0x9E3779B97F4A7C15ull;
+  h ^= uint64_t(y) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+  h ^= uint64_t(z) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+  return h;
+}
+
+int64_t floatBits(float v) {
+  v += 0.0f; // 0 and -0 are the same
+  uint32_t bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+bool withinEpsilon(float a, float b, float epsilon) {
+  return a == b || std::abs(a - b) <= epsilon;
+}
+
+template <int N>
+bool withinEpsilon(const Vec<N, float>& a, const Vec<N, float>& b, float epsilon) {
+  for (int i = 0; i < N; i++) {
+    if (!withinEpsilon(a[i], b[i], epsilon)) return false;
+  }
+  return true;
+}
+
+bool withinEpsilon(const Color& a, const Color& b, float epsilon) {
+  return withinEpsilon(a.r, b.r, epsilon) && withinEpsilon(a.g, b.g, epsilon)
+      && withinEpsilon(a.b, b.b, epsilon) && withinEpsilon(a.a, b.a, epsilon);
+}
+
+template <class T>
+bool sameAttribute(const std::vector<T>& buf, bool compare, int a, int b, float epsilon) {
+  return !compare || withinEpsilon(buf[a], buf[b], epsilon);
+}
+
+// Keep the elements of buf listed in order. Buffers that don't have one
+// element per vertex are left as they are
+template <class T>
+void gatherBuffer(std::vector<T>& buf, const std::vector<int>& order, size_t numVertices) {
+  if (buf.size() != numVertices) return;
+  std::vector<T> out(order.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    out[i] = buf[order[i]];
   }
+  buf.swap(out);
+}
+
+} // namespace
+
+void Mesh::compress(float epsilon, bool compareAttributes) {
+  const int Nv = vertices().size();
   if (Nv == 0) {
     AL_WARN_ONCE("cannot compress Mesh with no vertices");
     return;
   }
+  if (!(epsilon > 0.0f)) epsilon = 0.0f;
+
+  // Attributes are only compared when there is one for every vertex
+  const bool cmpN = compareAttributes && int(normals().size()) == Nv;
+  const bool cmpC = compareAttributes && int(colors().size()) == Nv;
+  const bool cmpT1 = compareAttributes && int(texCoord1s().size()) == Nv;
+  const bool cmpT2 = compareAttributes && int(texCoord2s().size()) == Nv;
+  const bool cmpT3 = compareAttributes && int(texCoord3s().size()) == Nv;
+  auto matches = [&](int a, int b) {
+    return withinEpsilon(vertices()[a], vertices()[b], epsilon)
+        && sameAttribute(normals(), cmpN, a, b, epsilon)
+        && sameAttribute(colors(), cmpC, a, b, epsilon)
+        && sameAttribute(texCoord1s(), cmpT1, a, b, epsilon)
+        && sameAttribute(texCoord2s(), cmpT2, a, b, epsilon)
+        && sameAttribute(texCoord3s(), cmpT3, a, b, epsilon);
+  };
 
-  int Nc = colors().size();
-  int Nn = normals().size();
-  int Nt1 = texCoord1s().size();
-  int Nt2 = texCoord2s().size();
-  int Nt3 = texCoord3s().size();
-
-  // map tree to uniquely ID vertices with same values:
-  typedef std::map<float, int> Zmap;
-  typedef std::map<float, Zmap> Ymap;
-  typedef std::map<float, Ymap> Xmap;
-  Xmap xmap;
-
-  // copy current values:
-  Mesh old(*this);
+  // Hash grid of welded vertices. Cells are epsilon wide, so matches can only
+  // be in the 27 cells around a vertex. With no epsilon, the cell is the
+  // exact position.
+  auto cellOf = [&](const Vertex& v, int64_t* cell) {
+    for (int i = 0; i < 3; i++) {
+      cell[i] = epsilon > 0.0f ? int64_t(std::floor(v[i] / epsilon)) : floatBits(v[i]);
+    }
+  };
+  const int range = epsilon > 0.0f ? 1 : 0;
+  std::unordered_map<uint64_t, int> cellHeads; // First welded vertex in cell
+  cellHeads.reserve(Nv);
+  std::vector<int> nextInCell; // Next welded vertex with the same cell hash
+  std::vector<int> kept;       // Original index of each welded vertex
+  std::vector<Index> remap(Nv);
+
+  for (int i = 0; i < Nv; i++) {
+    int64_t cell[3];
+    cellOf(vertices()[i], cell);
+    int found = -1;
+    for (int dx = -range; dx <= range && found < 0; dx++) {
+      for (int dy = -range; dy <= range && found < 0; dy++) {
+        for (int dz = -range; dz <= range && found < 0; dz++) {
+          auto it = cellHeads.find(hashCell(cell[0] + dx, cell[1] + dy, cell[2] + dz));
+          if (it == cellHeads.end()) continue;
+          for (int k = it->second; k >= 0; k = nextInCell[k]) {
+            if (matches(kept[k], i)) {
+              found = k;
+              break;
+            }
+          }
+        }
+      }
+    }
+    if (found < 0) {
+      found = kept.size();
+      kept.push_back(i);
+      auto head = cellHeads.emplace(hashCell(cell[0], cell[1], cell[2]), found);
+      nextInCell.push_back(head.second ? -1 : head.first->second);
+      head.first->second = found;
+    }
+    remap[i] = found;
+  }
 
-  // walk backward through the vertex list
-  // create a ID for each one
-  for (int i=vertices().size()-1; i>=0; i--) {
-    Vertex& v = vertices()[i];
-    xmap[v.x][v.y][v.z] = i;
+  if (indices().empty()) {
+    indices().swap(remap);
+  } else {
+    for (auto& index : indices()) {
+      if (int(index) < Nv) index = remap[index];
+    }
   }
+  gatherBuffer(normals(), kept, Nv);
+  gatherBuffer(colors(), kept, Nv);
+  gatherBuffer(texCoord1s(), kept, Nv);
+  gatherBuffer(texCoord2s(), kept, Nv);
+  gatherBuffer(texCoord3s(), kept, Nv);
+  gatherBuffer(vertices(), kept, Nv);
+}
 
-  // map of old vertex index to new vertex index:
-  typedef std::map<int, int> Imap;
-  Imap imap;
+void Mesh::optimizeVertexCache(int cacheSize) {
+  // Tom Forsyth's "Linear-Speed Vertex Cache Optimisation": greedily emit
+  // the triangle with the highest score, where vertices score higher if
+  // they were used recently and if they have few triangles left.
+  const int Nv = vertices().size();
+  const int Nt = indices().size() / 3;
+  if (primitive() != TRIANGLES || Nt == 0) {
+    AL_WARN_ONCE("optimizeVertexCache only valid for indexed triangle meshes");
+    return;
+  }
+  Indices& idx = indices();
+  for (int i = 0; i < Nt * 3; i++) {
+    if (int(idx[i]) >= Nv) {
+      AL_WARN_ONCE("optimizeVertexCache: mesh has indices out of range");
+      return;
+    }
+  }
+  cacheSize = std::max(cacheSize, 4);
 
+  std::vector<float> cacheScore(cacheSize);
+  for (int i = 0; i < cacheSize; i++) {
+    cacheScore[i] = i < 3 ? 0.75f // Last triangle, avoid reusing it directly
+                          : std::pow(1.0f - float(i - 3) / (cacheSize - 3), 1.5f);
+  }
+  std::vector<int> activeTris(Nv, 0);
+  std::vector<int> cachePos(Nv, -1);
+  std::vector<float> score(Nv);
+  auto vertexScore = [&](int v) {
+    if (activeTris[v] == 0) return -1.0f;
+    float s = cachePos[v] >= 0 ? cacheScore[cachePos[v]] : 0.0f;
+    return s + 2.0f / std::sqrt(float(activeTris[v]));
+  };
 
-  // reset current mesh:
-  reset();
+  // Triangles using each vertex. The first activeTris[v] entries of a vertex
+  // are the ones not emitted yet
+  for (int i = 0; i < Nt * 3; i++) activeTris[idx[i]]++;
+  std::vector<int> adjOffset(Nv + 1, 0);
+  for (int v = 0; v < Nv; v++) adjOffset[v + 1] = adjOffset[v] + activeTris[v];
+  std::vector<int> adjTris(Nt * 3);
+  {
+    std::vector<int> fill(adjOffset.begin(), adjOffset.end() - 1);
+    for (int t = 0; t < Nt; t++) {
+      for (int k = 0; k < 3; k++) adjTris[fill[idx[3 * t + k]]++] = t;
+    }
+  }
+  for (int v = 0; v < Nv; v++) score[v] = vertexScore(v);
+
+  std::vector<char> emitted(Nt, 0);
+  std::vector<int> cache, newCache;
+  cache.reserve(cacheSize + 3);
+  newCache.reserve(cacheSize + 3);
+  Indices out;
+  out.reserve(Nt * 3);
+  int best = -1;
+  int cursor = 0;
+  for (int n = 0; n < Nt; n++) {
+    if (best < 0) {
+      // Nothing left around the cache, continue with the next triangle
+      while (emitted[cursor]) cursor++;
+      best = cursor;
+    }
+    const Index* tri = &idx[3 * best];
+    emitted[best] = 1;
+    newCache.clear();
+    for (int k = 0; k < 3; k++) {
+      int v = tri[k];
+      out.push_back(v);
+      int* adj = &adjTris[adjOffset[v]];
+      for (int j = 0; j < activeTris[v]; j++) {
+        if (adj[j] == best) {
+          std::swap(adj[j], adj[activeTris[v] - 1]);
+          activeTris[v]--;
+          break;
+        }
+      }
+      if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+        newCache.push_back(v);
+      }
+    }
+    for (int v : cache) {
+      if (v != int(tri[0]) && v != int(tri[1]) && v != int(tri[2])) {
+        newCache.push_back(v);
+      }
+    }
+    for (size_t i = 0; i < newCache.size(); i++) {
+      int v = newCache[i];
+      cachePos[v] = int(i) < cacheSize ? int(i) : -1;
+      score[v] = vertexScore(v);
+    }
+    if (int(newCache.size()) > cacheSize) newCache.resize(cacheSize);
+    cache.swap(newCache);
+
+    best = -1;
+    float bestScore = -1.0f;
+    for (int v : cache) {
+      const int* adj = &adjTris[adjOffset[v]];
+      for (int j = 0; j < activeTris[v]; j++) {
+        const Index* t = &idx[3 * adj[j]];
+        float s = score[t[0]] + score[t[1]] + score[t[2]];
+        if (s > bestScore) {
+          bestScore = s;
+          best = adj[j];
+        }
+      }
+    }
+  }
 
-  // walk forward, inserting if
-  for (size_t i=0; i<old.vertices().size(); i++) {
-    Vertex& v = old.vertices()[i];
-    int idx = xmap[v.x][v.y][v.z];
-    Imap::iterator it = imap.find(idx);
-    if (it != imap.end()) {
-      // use existing
-      index(it->second);
-    } else {
-      // create new
-      int newidx = vertices().size();
-      vertex(v);
-      if (Nc) color(old.colors()[i]);
-      if (Nn) normal(old.normals()[i]);
-      if (Nt1) texCoord(old.texCoord1s()[i]);
-      if (Nt2) texCoord(old.texCoord2s()[i]);
-      if (Nt3) texCoord(old.texCoord3s()[i]);
-      // store new index:
-      imap[idx] = newidx;
-      // use new index:
-      index(newidx);
+  // Renumber vertices in order of first use, so they are fetched in order
+  std::vector<int> order;
+  order.reserve(Nv);
+  std::vector<int> newIndex(Nv, -1);
+  for (auto& index : out) {
+    if (newIndex[index] < 0) {
+      newIndex[index] = order.size();
+      order.push_back(index);
     }
+    index = newIndex[index];
+  }
+  for (int v = 0; v < Nv; v++) {
+    if (newIndex[v] < 0) order.push_back(v); // Keep unused vertices at the end
   }
+  indices().swap(out);
+  gatherBuffer(normals(), order, Nv);
+  gatherBuffer(colors(), order, Nv);
+  gatherBuffer(texCoord1s(), order, Nv);
+  gatherBuffer(texCoord2s(), order, Nv);
+  gatherBuffer(texCoord3s(), order, Nv);
+  gatherBuffer(vertices(), order, Nv);
 }
 
 void Mesh::generateNormals(bool normalize, bool equalWeightPerFace) {
@@ -1,5 +1,7 @@
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <cstdio>
@@ -8,9 +10,15 @@
 #include <cstring>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <typeinfo>
 
 #include "al/core/io/al_AudioIO.hpp"
 
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
 #ifdef AL_AUDIO_RTAUDIO
 #include "RtAudio.h"
 #endif
@@ -25,12 +33,59 @@ static void warn(const char * msg, const char * src){
   fprintf(stderr, "%s%swarning: %s\n", src, src[0]?" ":"", msg);
 }
 
+static std::string typeName(const std::type_info &type) {
+#ifdef __GNUG__
+  int status = -1;
+  char *name = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+  std::string result = status == 0 ? name : type.name();
+  std::free(name);
+  return result;
+#else
+  return type.name();
+#endif
+}
+
 #ifdef AL_AUDIO_DUMMY
 
+// Without a device, the callbacks run on a thread that keeps the pace of
+// the stream's clock
 struct AudioBackendData {
   int numOutChans, numInChans;
+  std::thread thread;
+  std::atomic<bool> running{false};
+  std::atomic<uint64_t> frames{0};  // Frames processed since start()
+  std::atomic<double> framesPerSecond{44100};
+  std::atomic<double> load{0};  // Processing time over block duration
 };
 
+static void dummyAudioThread(AudioBackendData *data, AudioIO *io) {
+  auto blockDuration = std::chrono::duration<double>(io->framesPerBuffer() /
+                                                     io->framesPerSecond());
+  auto start = std::chrono::steady_clock::now();
+  uint64_t blocks = 0;
+  while (data->running.load()) {
+    auto blockStart = std::chrono::steady_clock::now();
+    io->zeroIn();
+    io->processAudioBlock(io->channelsOut());
+    auto blockEnd = std::chrono::steady_clock::now();
+    data->load = std::chrono::duration<double>(blockEnd - blockStart) / blockDuration;
+    data->frames += io->framesPerBuffer();
+    blocks++;
+    auto next = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            blockDuration * double(blocks));
+    if (next < blockEnd) {
+      // Late by more than a block: don't try to catch up
+      if (blockEnd - next > blockDuration) {
+        io->profiler().xrun();
+        start = blockEnd - std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                               blockDuration * double(blocks));
+      }
+    } else {
+      std::this_thread::sleep_until(next);
+    }
+  }
+}
+
 AudioBackend::AudioBackend() {
   mBackendData = std::make_shared<AudioBackendData>();
   static_cast<AudioBackendData *>(mBackendData.get())->numOutChans = 2;
@@ -52,7 +107,7 @@ void AudioBackend::printError(const char *text) const {
 }
 
 void AudioBackend::printInfo() const {
-  printf("Using dummy backend (no audio).\n");
+  printf("Using dummy backend (no audio device, callbacks paced in real time).\n");
 }
 
 bool AudioBackend::supportsFPS(double fps) { return true; }
@@ -81,7 +136,10 @@ void AudioBackend::setOutDeviceChans(int num) {
   static_cast<AudioBackendData *>(mBackendData.get())->numOutChans = num;
 }
 
-double AudioBackend::time() { return 0.0; }
+double AudioBackend::time() {
+  AudioBackendData *data = static_cast<AudioBackendData *>(mBackendData.get());
+  return data->frames.load() / data->framesPerSecond.load();
+}
 
 bool AudioBackend::open(int framesPerSecond, int framesPerBuffer,
                         void *userdata) {
@@ -90,22 +148,40 @@ bool AudioBackend::open(int framesPerSecond, int framesPerBuffer,
 }
 
 bool AudioBackend::close() {
+  stop();
   mOpen = false;
   return true;
 }
 
 bool AudioBackend::start(int framesPerSecond, int framesPerBuffer,
                          void *userdata) {
+  AudioBackendData *data = static_cast<AudioBackendData *>(mBackendData.get());
+  if (mRunning) {
+    return true;
+  }
+  mOpen = true;
+  data->framesPerSecond = framesPerSecond;
+  data->frames = 0;
+  data->running = true;
+  data->thread = std::thread(dummyAudioThread, data, static_cast<AudioIO *>(userdata));
   mRunning = true;
   return true;
 }
 
 bool AudioBackend::stop() {
+  AudioBackendData *data = static_cast<AudioBackendData *>(mBackendData.get());
+  data->running = false;
+  if (data->thread.joinable()) {
+    data->thread.join();
+  }
   mRunning = false;
   return true;
 }
 
-double AudioBackend::cpu() { return 0.0; }
+double AudioBackend::cpu() {
+  AudioBackendData *data = static_cast<AudioBackendData *>(mBackendData.get());
+  return mRunning ? data->load.load() : 0.0;
+}
 
 AudioDevice AudioBackend::defaultInput() { return AudioDevice(0); }
 
@@ -401,6 +477,10 @@ static int paCallback(const void *input, void *output, unsigned long frameCount,
                       const PaStreamCallbackTimeInfo *timeInfo,
                       PaStreamCallbackFlags statusFlags, void *userData) {
   AudioIO &io = *(AudioIO *)userData;
+  if (statusFlags & (paInputUnderflow | paInputOverflow | paOutputUnderflow |
+                     paOutputOverflow)) {
+    io.profiler().xrun();
+  }
 
   assert(frameCount == (unsigned)io.framesPerBuffer());
   const float **inBuffers = (const float **)input;
@@ -409,47 +489,7 @@ static int paCallback(const void *input, void *output, unsigned long frameCount,
            frameCount * sizeof(float));
   }
 
-  if (io.autoZeroOut()) io.zeroOut();
-
-  io.processAudio();  // call callback
-
-  // apply smoothly-ramped gain to all output channels
-  if (io.usingGain()) {
-    float dgain = (io.mGain - io.mGainPrev) / frameCount;
-
-    for (int j = 0; j < io.channelsOutDevice(); ++j) {
-      float *out = io.outBuffer(j);
-      float gain = io.mGainPrev;
-
-      for (unsigned i = 0; i < frameCount; ++i) {
-        out[i] *= gain;
-        gain += dgain;
-      }
-    }
-
-    io.mGainPrev = io.mGain;
-  }
-
-  // kill pesky nans so we don't hurt anyone's ears
-  if (io.zeroNANs()) {
-    for (unsigned i = 0; i < unsigned(frameCount * io.channelsOutDevice());
-         ++i) {
-      float &s = (&io.out(0, 0))[i];
-      // if(isnan(s)) s = 0.f;
-      if (s != s) s = 0.f;  // portable isnan; only nans do not equal themselves
-    }
-  }
-
-  if (io.clipOut()) {
-    for (unsigned i = 0; i < unsigned(frameCount * io.channelsOutDevice());
-         ++i) {
-      float &s = (&io.out(0, 0))[i];
-      if (s < -1.f)
-        s = -1.f;
-      else if (s > 1.f)
-        s = 1.f;
-    }
-  }
+  io.processAudioBlock(io.channelsOutDevice());
 
   float **outBuffers = (float **)output;
   for (int i = 0; i < io.channelsOutDevice(); i++) {
@@ -662,73 +702,23 @@ int AudioBackend::numDevices() {
 static int rtaudioCallback(void *output, void *input, unsigned int frameCount,
                            double streamTime, RtAudioStreamStatus status,
                            void *userData) {
+  AudioIO &io = *(AudioIO *)userData;
+  // Don't print on the audio thread, count it for profiler().xruns()
   if (status) {
-    std::cout << "Stream underflow detected!" << std::endl;
+    io.profiler().xrun();
   }
 
-  AudioIO &io = *(AudioIO *)userData;
-
   assert(frameCount == (unsigned)io.framesPerBuffer());
 
   if (input != NULL) {
-	  const float *inBuffers = (const float *)input;
-	  float *hwInBuffer = const_cast<float *>(io.inBuffer(0));
-      for (unsigned int frame = 0; frame < io.framesPerBuffer(); frame++) {
-		  for (int i = 0; i < io.channelsInDevice(); i++) {
-			  hwInBuffer[i * frameCount + frame] = *inBuffers++;
-		  }
-	  }
-  }
-
-  if (io.autoZeroOut()) io.zeroOut();
-
-  io.processAudio();  // call callback
-
-  // apply smoothly-ramped gain to all output channels
-  if (io.usingGain()) {
-    float dgain = (io.mGain - io.mGainPrev) / frameCount;
-
-    for (int j = 0; j < io.channelsOutDevice(); ++j) {
-      float *out = io.outBuffer(j);
-      float gain = io.mGainPrev;
-
-      for (unsigned i = 0; i < frameCount; ++i) {
-        out[i] *= gain;
-        gain += dgain;
-      }
-    }
-
-    io.mGainPrev = io.mGain;
+    deinterleave(const_cast<float *>(io.inBuffer(0)), (const float *)input,
+                 frameCount, io.channelsInDevice());
   }
 
-  // kill pesky nans so we don't hurt anyone's ears
-  if (io.zeroNANs()) {
-    for (unsigned i = 0; i < unsigned(frameCount * io.channelsOutDevice());
-         ++i) {
-      float &s = (&io.out(0, 0))[i];
-      // if(isnan(s)) s = 0.f;
-      if (s != s) s = 0.f;  // portable isnan; only nans do not equal themselves
-    }
-  }
-
-  if (io.clipOut()) {
-    for (unsigned i = 0; i < unsigned(frameCount * io.channelsOutDevice());
-         ++i) {
-      float &s = (&io.out(0, 0))[i];
-      if (s < -1.f)
-        s = -1.f;
-      else if (s > 1.f)
-        s = 1.f;
-    }
-  }
-
-  float *outBuffers = (float *)output;
-
-  float *finalOutBuffer = const_cast<float *>(io.outBuffer(0));
-  for (unsigned int frame = 0; frame < io.framesPerBuffer(); frame++) {
-    for (int i = 0; i < io.channelsOutDevice(); i++) {
-      *outBuffers++ = finalOutBuffer[i * frameCount + frame];
-    }
+  if (output != NULL) {
+    io.processAudioBlock(io.channelsOutDevice(), (float *)output);
+  } else {
+    io.processAudioBlock(io.channelsOutDevice());
   }
 
   return 0;
@@ -1016,11 +1006,13 @@ void AudioIO::initWithDefaults(void (*callback)(AudioIOData &), void *userData,
 
 AudioIO &AudioIO::append(AudioCallback &v) {
   mAudioCallbacks.push_back(&v);
+  updateCallbackChain();
   return *this;
 }
 
 AudioIO &AudioIO::prepend(AudioCallback &v) {
   mAudioCallbacks.insert(mAudioCallbacks.begin(), &v);
+  updateCallbackChain();
   return *this;
 }
 
@@ -1031,6 +1023,7 @@ AudioIO &AudioIO::insertBefore(AudioCallback &v, AudioCallback &beforeThis) {
     prepend(v);
   } else {
     mAudioCallbacks.insert(--pos, 1, &v);
+    updateCallbackChain();
   }
   return *this;
 }
@@ -1042,6 +1035,7 @@ AudioIO &AudioIO::insertAfter(AudioCallback &v, AudioCallback &afterThis) {
     append(v);
   } else {
     mAudioCallbacks.insert(pos, 1, &v);
+    updateCallbackChain();
   }
   return *this;
 }
@@ -1051,9 +1045,42 @@ AudioIO &AudioIO::remove(AudioCallback &v) {
   mAudioCallbacks.erase(
       std::remove(mAudioCallbacks.begin(), mAudioCallbacks.end(), &v),
       mAudioCallbacks.end());
+  updateCallbackChain();
   return *this;
 }
 
+void AudioIO::updateCallbackChain() {
+  // Callbacks keep their stage while in the chain. Stages are named by type,
+  // numbered when the type is in the chain more than once
+  const CallbackChain *previous = mCallbackChain.load();
+  std::unique_ptr<CallbackChain> chain(new CallbackChain);
+  chain->callbacks = mAudioCallbacks;
+  std::vector<int> &stages = chain->stages;
+  stages.assign(mAudioCallbacks.size(), -1);
+  for (size_t i = 0; previous && i < mAudioCallbacks.size(); i++) {
+    auto found = std::find(previous->callbacks.begin(), previous->callbacks.end(),
+                           mAudioCallbacks[i]);
+    if (found != previous->callbacks.end()) {
+      stages[i] = previous->stages[found - previous->callbacks.begin()];
+    }
+  }
+  for (size_t i = 0; i < mAudioCallbacks.size(); i++) {
+    if (stages[i] >= 0) continue;
+    std::string name = typeName(typeid(*mAudioCallbacks[i]));
+    int stage = mProfiler.stage(name);
+    for (int n = 2; std::count(stages.begin(), stages.end(), stage) > 0; n++) {
+      stage = mProfiler.stage(name + " " + std::to_string(n));
+    }
+    stages[i] = stage;
+  }
+  mCallbackChain.store(chain.get(), std::memory_order_release);
+  if (!isRunning()) {
+    // The audio thread can't be running the previous chains
+    mCallbackChains.clear();
+  }
+  mCallbackChains.push_back(std::move(chain));
+}
+
 void AudioIO::deviceIn(const AudioDevice &v) {
   if (v.valid() && v.hasInput()) {
     //		printf("deviceIn: %s, %d\n", v.name(), v.id());
@@ -1183,16 +1210,60 @@ void AudioIO::print() const {
 
 // void AudioIO::processAudio(){ frame(0); if(callback) callback(*this); }
 void AudioIO::processAudio() {
+  const bool profiling = mProfiler.enabled();
+  uint64_t start = profiling ? mProfiler.now() : 0;
   frame(0);
-  if (callback) callback(*this);
+  if (callback) {
+    callback(*this);
+    if (profiling) {
+      uint64_t end = mProfiler.now();
+      mProfiler.record(AudioProfiler::CALLBACK_STAGE, start, end);
+      start = end;
+    }
+  }
 
-  std::vector<AudioCallback *>::iterator iter = mAudioCallbacks.begin();
-  while (iter != mAudioCallbacks.end()) {
+  const CallbackChain *chain = mCallbackChain.load(std::memory_order_acquire);
+  if (!chain) {
+    return;
+  }
+  for (size_t i = 0; i < chain->callbacks.size(); i++) {
     frame(0);
-    (*iter++)->onAudioCB(*this);
+    chain->callbacks[i]->onAudioCB(*this);
+    if (profiling) {
+      uint64_t end = mProfiler.now();
+      mProfiler.record(chain->stages[i], start, end);
+      start = end;
+    }
   }
 }
 
+void AudioIO::processAudioBlock(int numOutChannels, float *interleavedOut) {
+  const uint64_t blockStart = mProfiler.now();
+  unsigned int frameCount = framesPerBuffer();
+  numOutChannels = std::min(numOutChannels, int(channelsOut()));
+
+  if (autoZeroOut()) zeroOut();
+
+  processAudio();  // call callback
+  const uint64_t outputStart = mProfiler.now();
+
+  // Smoothly ramped gain, NaN zeroing and clipping in one pass, writing
+  // straight to the device buffer when it is interleaved
+  float gain = 1.f, gainStep = 0.f;
+  if (usingGain()) {
+    gain = mGainPrev;
+    gainStep = (mGain - mGainPrev) / frameCount;
+    mGainPrev = mGain;
+  }
+  processOutput(interleavedOut ? interleavedOut : mBufO, mBufO, frameCount,
+                numOutChannels, gain, gainStep, zeroNANs(), clipOut(),
+                interleavedOut != nullptr);
+
+  const uint64_t blockEnd = mProfiler.now();
+  mProfiler.record(AudioProfiler::OUTPUT_STAGE, outputStart, blockEnd);
+  mProfiler.recordBlock(blockStart, blockEnd, frameCount / framesPerSecond());
+}
+
 bool AudioIO::isOpen()
 {
     return mBackend->isOpen();
@@ -1203,7 +1274,10 @@ bool AudioIO::isRunning()
     return mBackend->isRunning();
 }
 
-double AudioIO::cpu() const { return mBackend->cpu(); }
+double AudioIO::cpu() const {
+  double load = mBackend->cpu();
+  return load >= 0 ? load : mProfiler.load();
+}
 bool AudioIO::zeroNANs() const { return mZeroNANs; }
 
 void AudioIO::clipOut(bool v) {
@@ -7,10 +7,320 @@
 
 #include "al/core/io/al_AudioIOData.hpp"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#define AL_AUDIOIODATA_SSE
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define AL_AUDIOIODATA_SSE
+#endif
+
 namespace al {
 
 //==============================================================================
 
+// Gain ramp, NaN zeroing and clipping of output samples, in the order
+// AudioIO has always applied them. frame is the frame of the first sample
+template <bool ramp, bool scrub, bool clip>
+struct OutputOps {
+  float gain, step;
+
+  float operator()(float x, int frame) const {
+    if (ramp) x *= gain + step * float(frame);
+    if (scrub && x != x) x = 0.f;  // only NaNs do not equal themselves
+    if (clip) {
+      if (x < -1.f)
+        x = -1.f;
+      else if (x > 1.f)
+        x = 1.f;
+    }
+    return x;
+  }
+
+// min and max return their second operand when one is NaN, so the clip lets
+// NaNs through like the scalar comparisons
+#ifdef AL_AUDIOIODATA_SSE
+  __m128 operator()(__m128 x, int frame) const {
+    if (ramp) {
+      __m128 frames = _mm_add_ps(_mm_set1_ps(float(frame)), _mm_setr_ps(0, 1, 2, 3));
+      x = _mm_mul_ps(x, _mm_add_ps(_mm_set1_ps(gain), _mm_mul_ps(_mm_set1_ps(step), frames)));
+    }
+    if (scrub) x = _mm_and_ps(x, _mm_cmpord_ps(x, x));
+    if (clip) x = _mm_min_ps(_mm_set1_ps(1.f), _mm_max_ps(_mm_set1_ps(-1.f), x));
+    return x;
+  }
+#endif
+
+#ifdef __AVX__
+  __m256 operator()(__m256 x, int frame) const {
+    if (ramp) {
+      __m256 frames = _mm256_add_ps(_mm256_set1_ps(float(frame)),
+                                    _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+      x = _mm256_mul_ps(x, _mm256_add_ps(_mm256_set1_ps(gain),
+                                         _mm256_mul_ps(_mm256_set1_ps(step), frames)));
+    }
+    if (scrub) x = _mm256_and_ps(x, _mm256_cmp_ps(x, x, _CMP_ORD_Q));
+    if (clip) x = _mm256_min_ps(_mm256_set1_ps(1.f), _mm256_max_ps(_mm256_set1_ps(-1.f), x));
+    return x;
+  }
+#endif
+};
+
+typedef OutputOps<false, false, false> NoOutputOps;
+
+#ifdef __AVX__
+// Written out so that the rows stay in registers
+#define AL_TRANSPOSE8_PS(r0, r1, r2, r3, r4, r5, r6, r7)                  \
+  do {                                                                    \
+    __m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpackhi_ps(r0, r1); \
+    __m256 t2 = _mm256_unpacklo_ps(r2, r3), t3 = _mm256_unpackhi_ps(r2, r3); \
+    __m256 t4 = _mm256_unpacklo_ps(r4, r5), t5 = _mm256_unpackhi_ps(r4, r5); \
+    __m256 t6 = _mm256_unpacklo_ps(r6, r7), t7 = _mm256_unpackhi_ps(r6, r7); \
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));        \
+    __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));        \
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));        \
+    __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));        \
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));        \
+    __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));        \
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));        \
+    __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));        \
+    r0 = _mm256_permute2f128_ps(s0, s4, 0x20);                            \
+    r1 = _mm256_permute2f128_ps(s1, s5, 0x20);                            \
+    r2 = _mm256_permute2f128_ps(s2, s6, 0x20);                            \
+    r3 = _mm256_permute2f128_ps(s3, s7, 0x20);                            \
+    r4 = _mm256_permute2f128_ps(s0, s4, 0x31);                            \
+    r5 = _mm256_permute2f128_ps(s1, s5, 0x31);                            \
+    r6 = _mm256_permute2f128_ps(s2, s6, 0x31);                            \
+    r7 = _mm256_permute2f128_ps(s3, s7, 0x31);                            \
+  } while (0)
+#endif
+
+// Frames of the tiles the transposes work on. With many channels, a tile's
+// reads and writes stay in the L1 cache
+static const int kTileFrames = 64;
+
+// Channels c0 to c1 of frames i0 to i1, one sample at a time
+template <class Ops>
+static void interleaveScalar(float *dst, const float *src, int numFrames, int numChannels,
+                             int c0, int c1, int i0, int i1, const Ops &ops) {
+  for (int c = c0; c < c1; c++) {
+    const float *in = src + c * numFrames;
+    for (int i = i0; i < i1; i++) {
+      dst[i * numChannels + c] = ops(in[i], i);
+    }
+  }
+}
+
+// Transposes blocks of 8 channels by 8 frames, then 4 by 4 and 2 by 4,
+// applying ops to the samples while they are in registers
+template <class Ops>
+static void interleaveOps(float *dst, const float *src, int numFrames, int numChannels,
+                          const Ops &ops) {
+  for (int i0 = 0; i0 < numFrames; i0 += kTileFrames) {
+    const int i1 = std::min(i0 + kTileFrames, numFrames);
+    int c = 0;
+#ifdef __AVX__
+    for (; c + 8 <= numChannels; c += 8) {
+      int i = i0;
+      for (; i + 8 <= i1; i += 8) {
+        const float *in = src + c * numFrames + i;
+        __m256 r0 = ops(_mm256_loadu_ps(in), i);
+        __m256 r1 = ops(_mm256_loadu_ps(in + numFrames), i);
+        __m256 r2 = ops(_mm256_loadu_ps(in + 2 * numFrames), i);
+        __m256 r3 = ops(_mm256_loadu_ps(in + 3 * numFrames), i);
+        __m256 r4 = ops(_mm256_loadu_ps(in + 4 * numFrames), i);
+        __m256 r5 = ops(_mm256_loadu_ps(in + 5 * numFrames), i);
+        __m256 r6 = ops(_mm256_loadu_ps(in + 6 * numFrames), i);
+        __m256 r7 = ops(_mm256_loadu_ps(in + 7 * numFrames), i);
+        AL_TRANSPOSE8_PS(r0, r1, r2, r3, r4, r5, r6, r7);
+        float *out = dst + i * numChannels + c;
+        _mm256_storeu_ps(out, r0);
+        _mm256_storeu_ps(out + numChannels, r1);
+        _mm256_storeu_ps(out + 2 * numChannels, r2);
+        _mm256_storeu_ps(out + 3 * numChannels, r3);
+        _mm256_storeu_ps(out + 4 * numChannels, r4);
+        _mm256_storeu_ps(out + 5 * numChannels, r5);
+        _mm256_storeu_ps(out + 6 * numChannels, r6);
+        _mm256_storeu_ps(out + 7 * numChannels, r7);
+      }
+      interleaveScalar(dst, src, numFrames, numChannels, c, c + 8, i, i1, ops);
+    }
+#endif
+#ifdef AL_AUDIOIODATA_SSE
+    for (; c + 4 <= numChannels; c += 4) {
+      int i = i0;
+      for (; i + 4 <= i1; i += 4) {
+        const float *in = src + c * numFrames + i;
+        __m128 r0 = ops(_mm_loadu_ps(in), i);
+        __m128 r1 = ops(_mm_loadu_ps(in + numFrames), i);
+        __m128 r2 = ops(_mm_loadu_ps(in + 2 * numFrames), i);
+        __m128 r3 = ops(_mm_loadu_ps(in + 3 * numFrames), i);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        float *out = dst + i * numChannels + c;
+        _mm_storeu_ps(out, r0);
+        _mm_storeu_ps(out + numChannels, r1);
+        _mm_storeu_ps(out + 2 * numChannels, r2);
+        _mm_storeu_ps(out + 3 * numChannels, r3);
+      }
+      interleaveScalar(dst, src, numFrames, numChannels, c, c + 4, i, i1, ops);
+    }
+    // A remaining pair of channels, e.g. stereo
+    for (; c + 2 <= numChannels; c += 2) {
+      int i = i0;
+      for (; i + 4 <= i1; i += 4) {
+        const float *in = src + c * numFrames + i;
+        __m128 left = ops(_mm_loadu_ps(in), i);
+        __m128 right = ops(_mm_loadu_ps(in + numFrames), i);
+        __m128 lo = _mm_unpacklo_ps(left, right);
+        __m128 hi = _mm_unpackhi_ps(left, right);
+        float *out = dst + i * numChannels + c;
+        _mm_storel_pi((__m64 *)out, lo);
+        _mm_storeh_pi((__m64 *)(out + numChannels), lo);
+        _mm_storel_pi((__m64 *)(out + 2 * numChannels), hi);
+        _mm_storeh_pi((__m64 *)(out + 3 * numChannels), hi);
+      }
+      interleaveScalar(dst, src, numFrames, numChannels, c, c + 2, i, i1, ops);
+    }
+#endif
+    interleaveScalar(dst, src, numFrames, numChannels, c, numChannels, i0, i1, ops);
+  }
+}
+
+template <class Ops>
+static void processPlanar(float *dst, const float *src, int numFrames, int numChannels,
+                          const Ops &ops) {
+  for (int c = 0; c < numChannels; c++) {
+    const float *in = src + c * numFrames;
+    float *out = dst + c * numFrames;
+    int i = 0;
+#ifdef __AVX__
+    for (; i + 8 <= numFrames; i += 8) {
+      _mm256_storeu_ps(out + i, ops(_mm256_loadu_ps(in + i), i));
+    }
+#endif
+#ifdef AL_AUDIOIODATA_SSE
+    for (; i + 4 <= numFrames; i += 4) {
+      _mm_storeu_ps(out + i, ops(_mm_loadu_ps(in + i), i));
+    }
+#endif
+    for (; i < numFrames; i++) {
+      out[i] = ops(in[i], i);
+    }
+  }
+}
+
+template <bool ramp, bool scrub, bool clip>
+static void processOutputOps(float *dst, const float *src, int numFrames, int numChannels,
+                             float gain, float gainStep, bool interleaved) {
+  OutputOps<ramp, scrub, clip> ops{gain, gainStep};
+  if (interleaved) {
+    interleaveOps(dst, src, numFrames, numChannels, ops);
+  } else if (ramp || scrub || clip || dst != src) {
+    processPlanar(dst, src, numFrames, numChannels, ops);
+  }
+}
+
+void processOutput(float *dst, const float *src, int numFrames, int numChannels,
+                   float gain, float gainStep, bool zeroNANs, bool clip,
+                   bool interleaved) {
+  const bool ramp = gain != 1.f || gainStep != 0.f;
+  // Only the operations in use are compiled into the loop
+  typedef void (*Process)(float *, const float *, int, int, float, float, bool);
+  static const Process process[8] = {
+      processOutputOps<false, false, false>, processOutputOps<false, false, true>,
+      processOutputOps<false, true, false>,  processOutputOps<false, true, true>,
+      processOutputOps<true, false, false>,  processOutputOps<true, false, true>,
+      processOutputOps<true, true, false>,   processOutputOps<true, true, true>};
+  process[(ramp ? 4 : 0) | (zeroNANs ? 2 : 0) | (clip ? 1 : 0)](
+      dst, src, numFrames, numChannels, gain, gainStep, interleaved);
+}
+
+void interleave(float *dst, const float *src, int numFrames, int numChannels) {
+  interleaveOps(dst, src, numFrames, numChannels, NoOutputOps{1.f, 0.f});
+}
+
+// Channels c0 to c1 of frames i0 to i1, one sample at a time
+static void deinterleaveScalar(float *dst, const float *src, int numFrames, int numChannels,
+                               int c0, int c1, int i0, int i1) {
+  for (int c = c0; c < c1; c++) {
+    float *out = dst + c * numFrames;
+    for (int i = i0; i < i1; i++) {
+      out[i] = src[i * numChannels + c];
+    }
+  }
+}
+
+void deinterleave(float *dst, const float *src, int numFrames, int numChannels) {
+  for (int i0 = 0; i0 < numFrames; i0 += kTileFrames) {
+    const int i1 = std::min(i0 + kTileFrames, numFrames);
+    int c = 0;
+#ifdef __AVX__
+    for (; c + 8 <= numChannels; c += 8) {
+      int i = i0;
+      for (; i + 8 <= i1; i += 8) {
+        const float *in = src + i * numChannels + c;
+        __m256 r0 = _mm256_loadu_ps(in);
+        __m256 r1 = _mm256_loadu_ps(in + numChannels);
+        __m256 r2 = _mm256_loadu_ps(in + 2 * numChannels);
+        __m256 r3 = _mm256_loadu_ps(in + 3 * numChannels);
+        __m256 r4 = _mm256_loadu_ps(in + 4 * numChannels);
+        __m256 r5 = _mm256_loadu_ps(in + 5 * numChannels);
+        __m256 r6 = _mm256_loadu_ps(in + 6 * numChannels);
+        __m256 r7 = _mm256_loadu_ps(in + 7 * numChannels);
+        AL_TRANSPOSE8_PS(r0, r1, r2, r3, r4, r5, r6, r7);
+        float *out = dst + c * numFrames + i;
+        _mm256_storeu_ps(out, r0);
+        _mm256_storeu_ps(out + numFrames, r1);
+        _mm256_storeu_ps(out + 2 * numFrames, r2);
+        _mm256_storeu_ps(out + 3 * numFrames, r3);
+        _mm256_storeu_ps(out + 4 * numFrames, r4);
+        _mm256_storeu_ps(out + 5 * numFrames, r5);
+        _mm256_storeu_ps(out + 6 * numFrames, r6);
+        _mm256_storeu_ps(out + 7 * numFrames, r7);
+      }
+      deinterleaveScalar(dst, src, numFrames, numChannels, c, c + 8, i, i1);
+    }
+#endif
+#ifdef AL_AUDIOIODATA_SSE
+    for (; c + 4 <= numChannels; c += 4) {
+      int i = i0;
+      for (; i + 4 <= i1; i += 4) {
+        const float *in = src + i * numChannels + c;
+        __m128 r0 = _mm_loadu_ps(in);
+        __m128 r1 = _mm_loadu_ps(in + numChannels);
+        __m128 r2 = _mm_loadu_ps(in + 2 * numChannels);
+        __m128 r3 = _mm_loadu_ps(in + 3 * numChannels);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        float *out = dst + c * numFrames + i;
+        _mm_storeu_ps(out, r0);
+        _mm_storeu_ps(out + numFrames, r1);
+        _mm_storeu_ps(out + 2 * numFrames, r2);
+        _mm_storeu_ps(out + 3 * numFrames, r3);
+      }
+      deinterleaveScalar(dst, src, numFrames, numChannels, c, c + 4, i, i1);
+    }
+    for (; c + 2 <= numChannels; c += 2) {
+      int i = i0;
+      for (; i + 4 <= i1; i += 4) {
+        const float *in = src + i * numChannels + c;
+        const float *in2 = in + 2 * numChannels;
+        __m128 a = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)in),
+                                (const __m64 *)(in + numChannels));
+        __m128 b = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)in2),
+                                (const __m64 *)(in2 + numChannels));
+        float *out = dst + c * numFrames + i;
+        _mm_storeu_ps(out, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(out + numFrames, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+      }
+      deinterleaveScalar(dst, src, numFrames, numChannels, c, c + 2, i, i1);
+    }
+#endif
+    deinterleaveScalar(dst, src, numFrames, numChannels, c, numChannels, i0, i1);
+  }
+}
+
+//==============================================================================
+
 AudioDeviceInfo::AudioDeviceInfo(int deviceNum)
     : mID(deviceNum), mChannelsInMax(0), mChannelsOutMax(0),
       mDefaultSampleRate(0.0) {}
@@ -52,6 +362,10 @@ AudioIOData::~AudioIOData() {
 void AudioIOData::zeroBus() { zero(mBufB, framesPerBuffer() * mNumB); }
 void AudioIOData::zeroOut() { zero(mBufO, channelsOut() * framesPerBuffer()); }
 
+void AudioIOData::zeroIn() {
+  if (mBufI) zero(mBufI, channelsIn() * framesPerBuffer());
+}
+
 
 void AudioIOData::channelsBus(int num) {
   resize(mBufB, num * mFramesPerBuffer);
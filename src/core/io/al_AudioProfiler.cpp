@@ -0,0 +1,263 @@
+#include "al/core/io/al_AudioProfiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace al {
+
+// Duration histograms: 8 bins per octave from 64 ns to about 4 s
+static const int kBinsPerOctave = 8;
+static const int kDurationBins = 26 * kBinsPerOctave;
+static const double kMinDuration = 64.0;
+
+static int durationBin(uint64_t ns) {
+  if (ns <= kMinDuration) return 0;
+  int bin = int(std::log2(ns / kMinDuration) * kBinsPerOctave);
+  return std::min(bin, kDurationBins - 1);
+}
+
+static std::string escapeJSON(const std::string &s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if ((unsigned char)c < 0x20) {
+      char code[8];
+      std::snprintf(code, sizeof(code), "\\u%04x", c);
+      out += code;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+static bool writeFile(const std::string &fileName, const std::string &contents) {
+  std::ofstream file(fileName);
+  if (!file.is_open()) {
+    std::cerr << "AudioProfiler: Can't open " << fileName << std::endl;
+    return false;
+  }
+  file << contents;
+  return bool(file);
+}
+
+AudioProfiler::AudioProfiler(size_t ringSize, size_t traceSize)
+    : mEpoch(std::chrono::steady_clock::now()),
+      mRingSize(ringSize),
+      mLoadBins(LOAD_BINS),
+      mTraceSize(traceSize) {
+  stage("block");
+  stage("callback");
+  stage("output");
+}
+
+void AudioProfiler::enable(bool v) {
+  if (v && !mRing) {
+    std::lock_guard<std::mutex> lk(mLock);
+    mRing.reset(new SPSCRing<Event>(mRingSize));
+  }
+  mEnabled.store(v, std::memory_order_release);
+}
+
+int AudioProfiler::stage(const std::string &name) {
+  std::lock_guard<std::mutex> lk(mLock);
+  auto found = std::find(mStageNames.begin(), mStageNames.end(), name);
+  if (found != mStageNames.end()) {
+    return int(found - mStageNames.begin());
+  }
+  mStageNames.push_back(name);
+  mStages.emplace_back();
+  mStages.back().bins.resize(kDurationBins);
+  return int(mStageNames.size()) - 1;
+}
+
+std::string AudioProfiler::stageName(int id) {
+  std::lock_guard<std::mutex> lk(mLock);
+  return id >= 0 && id < int(mStageNames.size()) ? mStageNames[id] : std::string();
+}
+
+int AudioProfiler::numStages() {
+  std::lock_guard<std::mutex> lk(mLock);
+  return int(mStageNames.size());
+}
+
+void AudioProfiler::recordBlock(uint64_t start, uint64_t end, double budgetSeconds) {
+  uint64_t budget = uint64_t(budgetSeconds * 1e9);
+  if (budget > 0) {
+    // One pole average over about ten blocks, like PortAudio's
+    double load = double(end - start) / budget;
+    double previous = mLoad.load(std::memory_order_relaxed);
+    mLoad.store(previous + 0.1 * (load - previous), std::memory_order_relaxed);
+  }
+  if (enabled()) push(Event{BLOCK_STAGE, start, end - start, budget});
+}
+
+void AudioProfiler::update() {
+  std::lock_guard<std::mutex> lk(mLock);
+  if (!mRing) return;
+  if (mTrace.size() < mTraceSize) {
+    mTrace.resize(mTraceSize);
+  }
+  Event event;
+  while (mRing->pop(event)) {
+    if (event.stage < 0 || event.stage >= int(mStages.size())) {
+      continue;
+    }
+    Histogram &histogram = mStages[event.stage];
+    histogram.bins[durationBin(event.duration)]++;
+    histogram.count++;
+    histogram.total += event.duration;
+    histogram.max = std::max(histogram.max, event.duration);
+    if (event.stage == BLOCK_STAGE && event.budget > 0) {
+      mBlocks++;
+      if (event.duration > event.budget) mOverruns++;
+      double load = double(event.duration) / event.budget;
+      mLoadBins[std::min(int(load * (LOAD_BINS - 1) / 2), LOAD_BINS - 1)]++;
+    }
+    if (mTraceSize > 0) {
+      mTrace[mTraceNext] = event;
+      mTraceNext = (mTraceNext + 1) % mTraceSize;
+      mTraceCount = std::min(mTraceCount + 1, mTraceSize);
+    }
+  }
+}
+
+void AudioProfiler::reset() {
+  std::lock_guard<std::mutex> lk(mLock);
+  for (auto &histogram : mStages) {
+    std::fill(histogram.bins.begin(), histogram.bins.end(), 0);
+    histogram.count = histogram.total = histogram.max = 0;
+  }
+  std::fill(mLoadBins.begin(), mLoadBins.end(), 0);
+  mBlocks = mOverruns = 0;
+  mTraceNext = mTraceCount = 0;
+  mXruns = 0;
+  mDropped = 0;
+}
+
+double AudioProfiler::percentile(const Histogram &histogram, double p) const {
+  if (histogram.count == 0) return 0;
+  uint64_t target = std::max<uint64_t>(1, uint64_t(std::ceil(p * histogram.count)));
+  uint64_t sum = 0;
+  for (int bin = 0; bin < kDurationBins; bin++) {
+    sum += histogram.bins[bin];
+    if (sum >= target) {
+      // Geometric center of the bin, never above the measured maximum
+      double ns = kMinDuration * std::exp2((bin + 0.5) / kBinsPerOctave);
+      return std::min(ns, double(histogram.max)) / 1000.0;
+    }
+  }
+  return histogram.max / 1000.0;
+}
+
+std::vector<AudioProfiler::StageStatistics> AudioProfiler::stageStatistics() {
+  std::lock_guard<std::mutex> lk(mLock);
+  std::vector<StageStatistics> statistics;
+  for (size_t i = 0; i < mStages.size(); i++) {
+    const Histogram &h = mStages[i];
+    if (h.count == 0) continue;
+    statistics.push_back({mStageNames[i], h.count, h.total / 1000.0,
+                          h.total / 1000.0 / h.count, percentile(h, 0.5),
+                          percentile(h, 0.9), percentile(h, 0.99), h.max / 1000.0});
+  }
+  return statistics;
+}
+
+uint64_t AudioProfiler::blocks() {
+  std::lock_guard<std::mutex> lk(mLock);
+  return mBlocks;
+}
+
+uint64_t AudioProfiler::overruns() {
+  std::lock_guard<std::mutex> lk(mLock);
+  return mOverruns;
+}
+
+std::vector<uint64_t> AudioProfiler::loadHistogram() {
+  std::lock_guard<std::mutex> lk(mLock);
+  return mLoadBins;
+}
+
+double AudioProfiler::loadPercentile(double p) {
+  std::lock_guard<std::mutex> lk(mLock);
+  if (mBlocks == 0) return 0;
+  uint64_t target = std::max<uint64_t>(1, uint64_t(std::ceil(p * mBlocks)));
+  uint64_t sum = 0;
+  for (int bin = 0; bin < LOAD_BINS; bin++) {
+    sum += mLoadBins[bin];
+    if (sum >= target) {
+      // Upper edge of the bin
+      return 2.0 * (bin + 1) / (LOAD_BINS - 1);
+    }
+  }
+  return 2.0 * LOAD_BINS / (LOAD_BINS - 1);
+}
+
+std::string AudioProfiler::json() {
+  std::vector<StageStatistics> statistics = stageStatistics();
+  std::vector<uint64_t> histogram = loadHistogram();
+  double p50 = loadPercentile(0.5), p99 = loadPercentile(0.99);
+  std::ostringstream s;
+  s << "{\"blocks\":" << blocks() << ",\"overruns\":" << overruns()
+    << ",\"xruns\":" << xruns() << ",\"droppedEvents\":" << droppedEvents()
+    << ",\"load\":{\"average\":" << load() << ",\"p50\":" << p50
+    << ",\"p99\":" << p99 << ",\"binWidth\":" << 2.0 / (LOAD_BINS - 1)
+    << ",\"histogram\":[";
+  for (size_t i = 0; i < histogram.size(); i++) {
+    s << (i ? "," : "") << histogram[i];
+  }
+  s << "]},\"stages\":[";
+  for (size_t i = 0; i < statistics.size(); i++) {
+    const StageStatistics &stage = statistics[i];
+    s << (i ? "," : "") << "{\"name\":\"" << escapeJSON(stage.name)
+      << "\",\"count\":" << stage.count << ",\"totalUs\":" << stage.total
+      << ",\"meanUs\":" << stage.mean << ",\"p50Us\":" << stage.p50
+      << ",\"p90Us\":" << stage.p90 << ",\"p99Us\":" << stage.p99
+      << ",\"maxUs\":" << stage.max << "}";
+  }
+  s << "]}";
+  return s.str();
+}
+
+std::string AudioProfiler::chromeTrace() {
+  std::lock_guard<std::mutex> lk(mLock);
+  std::ostringstream s;
+  s << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  // Name the track of each stage
+  for (size_t i = 0; i < mStageNames.size(); i++) {
+    s << (i ? "," : "")
+      << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+      << ",\"args\":{\"name\":\"" << escapeJSON(mStageNames[i]) << "\"}}";
+  }
+  s.setf(std::ios::fixed);
+  s.precision(3);
+  size_t first = (mTraceNext + mTraceSize - mTraceCount) % std::max<size_t>(mTraceSize, 1);
+  for (size_t i = 0; i < mTraceCount; i++) {
+    const Event &event = mTrace[(first + i) % mTraceSize];
+    s << ",{\"name\":\"" << escapeJSON(mStageNames[event.stage])
+      << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.stage
+      << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0;
+    if (event.stage == BLOCK_STAGE) {
+      s << ",\"args\":{\"budgetUs\":" << event.budget / 1000.0 << "}";
+    }
+    s << "}";
+  }
+  s << "]}";
+  return s.str();
+}
+
+bool AudioProfiler::writeJSON(const std::string &fileName) {
+  return writeFile(fileName, json());
+}
+
+bool AudioProfiler::writeChromeTrace(const std::string &fileName) {
+  return writeFile(fileName, chromeTrace());
+}
+
+}  // al::
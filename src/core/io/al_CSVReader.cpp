@@ -1,13 +1,168 @@
 #include <cassert>
 #include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
 
 #include "al/core/io/al_CSVReader.hpp"
 
-CSVReader::~CSVReader() {
-  for (auto row: mData) {
-    delete[] row;
+#ifdef AL_WINDOWS
+  #define WIN32_LEAN_AND_MEAN
+  #define NOMINMAX
+  #include <windows.h>
+  #undef NOMINMAX
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+const size_t CSVReader::maxStringSize;
+
+// Chunks of the file, split at line boundaries, parsed by separate threads
+struct CSVReader::Chunk {
+  const char *begin;
+  const char *end;
+  size_t firstRow;
+};
+
+namespace {
+
+const size_t minChunkBytes = 1 << 20;
+
+// Find the next line in [p, end), without the line break. Returns false
+// when there are no more lines.
+inline bool nextLine(const char *&p, const char *end,
+                     const char *&lineBegin, const char *&lineEnd) {
+  if (p >= end) {
+    return false;
+  }
+  lineBegin = p;
+  const char *newline = static_cast<const char *>(memchr(p, '\n', size_t(end - p)));
+  lineEnd = newline ? newline : end;
+  p = newline ? newline + 1 : end;
+  if (lineEnd > lineBegin && lineEnd[-1] == '\r') {
+    lineEnd--;
+  }
+  return true;
+}
+
+size_t countRows(const char *p, const char *end) {
+  size_t rows = 0;
+  const char *lineBegin, *lineEnd;
+  while (nextLine(p, end, lineBegin, lineEnd)) {
+    if (lineEnd > lineBegin) {
+      rows++;
+    }
+  }
+  return rows;
+}
+
+bool isSpace(char c) {
+  return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+// Parses like atoi(), to 64 bits
+int64_t parseInteger(const char *p, const char *end) {
+  while (p < end && isSpace(*p)) {
+    p++;
+  }
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  uint64_t value = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    value = value * 10 + uint64_t(*p - '0');
+    p++;
+  }
+  return negative ? int64_t(0 - value) : int64_t(value);
+}
+
+// Parses like atof(). Decimal numbers with up to 15 significant digits and
+// small exponents are converted exactly here, as the mantissa and the
+// power of ten are both exact doubles. Anything else goes through strtod().
+double parseReal(const char *begin, const char *end) {
+  static const double powersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const char *p = begin;
+  while (p < end && isSpace(*p)) {
+    p++;
+  }
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool anyDigits = false;
+  while (p < end && *p >= '0' && *p <= '9') {
+    if (mantissa != 0 || *p != '0') {
+      mantissa = mantissa * 10 + uint64_t(*p - '0');
+      digits++;
+    }
+    anyDigits = true;
+    p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && *p >= '0' && *p <= '9') {
+      if (mantissa != 0 || *p != '0') {
+        mantissa = mantissa * 10 + uint64_t(*p - '0');
+        digits++;
+      }
+      exponent--;
+      anyDigits = true;
+      p++;
+    }
+  }
+  bool fast = anyDigits && digits <= 15 && (p == end || (*p != 'x' && *p != 'X'));
+  if (fast && p < end && (*p == 'e' || *p == 'E')) {
+    const char *e = p + 1;
+    bool negativeExponent = false;
+    if (e < end && (*e == '-' || *e == '+')) {
+      negativeExponent = *e == '-';
+      e++;
+    }
+    if (e < end && *e >= '0' && *e <= '9') {
+      int value = 0;
+      while (e < end && *e >= '0' && *e <= '9') {
+        if (value < 1000) {
+          value = value * 10 + (*e - '0');
+        }
+        e++;
+      }
+      exponent += negativeExponent ? -value : value;
+    }
+  }
+  if (fast && exponent >= -22 && exponent <= 22) {
+    double value = double(mantissa);
+    value = exponent < 0 ? value / powersOfTen[-exponent] : value * powersOfTen[exponent];
+    return negative ? -value : value;
+  }
+
+  char buffer[64];
+  size_t length = size_t(end - begin);
+  if (length < sizeof(buffer)) {
+    memcpy(buffer, begin, length);
+    buffer[length] = '\0';
+    return std::strtod(buffer, nullptr);
   }
-  mData.clear();
+  return std::strtod(std::string(begin, end).c_str(), nullptr);
+}
+
+bool parseBoolean(const char *begin, const char *end) {
+  size_t length = size_t(end - begin);
+  return (length == 4 && (memcmp(begin, "True", 4) == 0 || memcmp(begin, "true", 4) == 0))
+      || (length == 1 && *begin == '1');
+}
+
 }
 
 bool CSVReader::readFile(std::string fileName, bool hasColumnNames) {
@@ -18,185 +173,348 @@ bool CSVReader::readFile(std::string fileName, bool hasColumnNames) {
       fileName = mBasePath + "/" + fileName;
     }
   }
-  std::ifstream f(fileName);
-  if (!f.is_open()) {
-    std::cout << "Could not open:" << fileName << std::endl;
-    return false;
-  }
 
   mColumnNames.clear();
-  mData.clear();
-
-  std::string line;
-  size_t rowLength = calculateRowLength();
+  mColumns.clear();
+  mNumRows = 0;
 
+  // Map the file
+  const char *data = nullptr;
+  size_t size = 0;
+#ifdef AL_WINDOWS
+  HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    std::cout << "Could not open:" << fileName << std::endl;
+    return false;
+  }
+  LARGE_INTEGER fileSize;
+  HANDLE mapping = NULL;
+  if (!GetFileSizeEx(file, &fileSize)) {
+    CloseHandle(file);
+    std::cout << "Could not open:" << fileName << std::endl;
+    return false;
+  }
+  size = size_t(fileSize.QuadPart);
+  if (size > 0) {
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping) {
+      data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!data) {
+      if (mapping) {
+        CloseHandle(mapping);
+      }
+      CloseHandle(file);
+      std::cout << "Could not map:" << fileName << std::endl;
+      return false;
+    }
+  }
+#else
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cout << "Could not open:" << fileName << std::endl;
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    ::close(fd);
+    std::cout << "Could not open:" << fileName << std::endl;
+    return false;
+  }
+  size = size_t(info.st_size);
+  if (size > 0) {
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      ::close(fd);
+      std::cout << "Could not map:" << fileName << std::endl;
+      return false;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    data = static_cast<const char *>(mapped);
+  }
+  ::close(fd); // The mapping keeps the file open
+#endif
+  const char *p = data;
+  const char *end = data + size;
+  const char *lineBegin, *lineEnd;
 
-  // Infer separator
+  // Infer separator from first line of data
   bool commaSeparated = false;
   {
+    const char *q = p;
     if (hasColumnNames) {
-      getline(f, line);
+      nextLine(q, end, lineBegin, lineEnd);
     }
-    getline(f, line); // Infer from first line of data
-    if (std::count(line.begin(), line.end(), ',') > 0) {
-      commaSeparated = true;
+    if (nextLine(q, end, lineBegin, lineEnd)) {
+      commaSeparated = memchr(lineBegin, ',', size_t(lineEnd - lineBegin)) != nullptr;
     }
-    // Reset file
-    f.clear();
-    f.seekg(0, std::ios::beg);
   }
 
-  if (hasColumnNames) {
-    getline(f, line);
-    std::stringstream columnNameStream(line);
-    std::string columnName;
+  if (hasColumnNames && nextLine(p, end, lineBegin, lineEnd)) {
     if (commaSeparated) {
-      while (std::getline(columnNameStream, columnName, ',')) {
-        mColumnNames.push_back(columnName);
+      // As std::getline(), a trailing empty name is dropped
+      const char *name = lineBegin;
+      while (name < lineEnd) {
+        const char *comma = static_cast<const char *>(memchr(name, ',', size_t(lineEnd - name)));
+        const char *nameEnd = comma ? comma : lineEnd;
+        mColumnNames.emplace_back(name, nameEnd);
+        name = comma ? comma + 1 : lineEnd;
       }
     } else {
-      while (std::getline(columnNameStream, columnName, ' ')) {
-        if (columnName.size() > 0) {
-          mColumnNames.push_back(columnName);
+      const char *name = lineBegin;
+      while (name < lineEnd) {
+        const char *nameEnd = std::find(name, lineEnd, ' ');
+        if (nameEnd > name) {
+          mColumnNames.emplace_back(name, nameEnd);
         }
+        name = nameEnd + (nameEnd < lineEnd ? 1 : 0);
       }
     }
   }
 
-  //	std::cout << line << std::endl;
-  while (getline(f, line)) {
-    if (line.size() == 0) {
+  // Split the rest of the file into chunks at line boundaries
+  unsigned int numThreads = mNumThreads;
+  if (numThreads == 0) {
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t dataSize = size_t(end - p);
+  size_t numChunks = std::max<size_t>(1, std::min<size_t>(numThreads, dataSize / minChunkBytes));
+  std::vector<Chunk> chunks;
+  const char *chunkBegin = p;
+  for (size_t i = 1; i <= numChunks && chunkBegin < end; i++) {
+    const char *chunkEnd = end;
+    if (i < numChunks) {
+      chunkEnd = std::max(chunkBegin, p + dataSize * i / numChunks);
+      const char *newline = static_cast<const char *>(memchr(chunkEnd, '\n', size_t(end - chunkEnd)));
+      chunkEnd = newline ? newline + 1 : end;
+    }
+    chunks.push_back({chunkBegin, chunkEnd, 0});
+    chunkBegin = chunkEnd;
+  }
+
+  // Count the rows in each chunk to know where each chunk's rows go
+  std::vector<size_t> chunkRows(chunks.size());
+  {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < chunks.size(); i++) {
+      threads.emplace_back([&, i]() {
+        chunkRows[i] = countRows(chunks[i].begin, chunks[i].end);
+      });
+    }
+    if (chunks.size() > 0) {
+      chunkRows[0] = countRows(chunks[0].begin, chunks[0].end);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+  for (size_t i = 0; i < chunks.size(); i++) {
+    chunks[i].firstRow = mNumRows;
+    mNumRows += chunkRows[i];
+  }
+
+  // Columns are zeroed, so values not found in a row are 0
+  for (auto type : mDataTypes) {
+    size_t valueSize = 0;
+    switch (type) {
+    case STRING:
+      valueSize = maxStringSize * sizeof (char);
+      break;
+    case INTEGER:
+      valueSize = sizeof (int64_t);
+      break;
+    case REAL:
+      valueSize = sizeof (double);
+      break;
+    case BOOLEAN:
+      valueSize = sizeof (bool);
+      break;
+    case IGNORE_COLUMN:
+      break;
+    }
+    mColumns.emplace_back((valueSize * mNumRows + sizeof(double) - 1) / sizeof(double), 0.0);
+  }
+
+  {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < chunks.size(); i++) {
+      threads.emplace_back([&, i]() {
+        parseChunk(chunks[i], commaSeparated);
+      });
+    }
+    if (chunks.size() > 0) {
+      parseChunk(chunks[0], commaSeparated);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+
+#ifdef AL_WINDOWS
+  if (data) {
+    UnmapViewOfFile(data);
+    CloseHandle(mapping);
+  }
+  CloseHandle(file);
+#else
+  if (data) {
+    munmap(const_cast<char *>(data), size);
+  }
+#endif
+  return true;
+}
+
+void CSVReader::parseChunk(const Chunk &chunk, bool commaSeparated) {
+  size_t numTypes = mDataTypes.size();
+  std::vector<char *> columns(numTypes);
+  for (size_t i = 0; i < numTypes; i++) {
+    columns[i] = reinterpret_cast<char *>(mColumns[i].data());
+  }
+
+  size_t row = chunk.firstRow;
+  const char *p = chunk.begin;
+  const char *lineBegin, *lineEnd;
+  while (nextLine(p, chunk.end, lineBegin, lineEnd)) {
+    if (lineEnd == lineBegin) {
       continue;
     }
-    std::stringstream ss(line);
-    char * row = new char[rowLength];
-    memset(row, 0, rowLength);
-    mData.push_back(row);
+    const char *field = lineBegin;
     if (commaSeparated) {
-      if ((unsigned long) std::count(line.begin(), line.end(), ',') == mDataTypes.size() - 1) { // Check that we have enough commas
-        int byteCount = 0;
-        for(auto type:mDataTypes) {
-          std::string field;
-          std::getline(ss, field, ',');
-          size_t stringLen = std::min(maxStringSize - 1, field.size());
-          int32_t intValue;
-          double doubleValue;
-          bool booleanValue;
-          auto data = row + byteCount;
-          assert((size_t)(data - mData.back()) < rowLength);
-          switch (type){
-          case STRING:
-            std::memcpy(data, field.data(), stringLen * sizeof (char));
-            byteCount += maxStringSize * sizeof (char);
-            break;
-          case INTEGER:
-            intValue = std::atoi(field.data());
-            std::memcpy(data, &intValue, sizeof (int64_t));
-            byteCount += sizeof (int64_t);
-            break;
-          case REAL:
-            doubleValue = std::atof(field.data());
-            std::memcpy(data, &doubleValue, sizeof (double));
-            byteCount += sizeof (double);
-            break;
-          case BOOLEAN:
-            booleanValue = field == "True" || field == "true" || field == "1";
-            std::memcpy(data, &booleanValue, sizeof (bool));
-            byteCount += sizeof (bool);
-            break;
-          case IGNORE_COLUMN:
-            break;
-          }
-        }
+      // Check that we have enough commas
+      if (size_t(std::count(lineBegin, lineEnd, ',')) + 1 != numTypes) {
+        row++;
+        continue;
       }
-    } else { // Space separated
-      int byteCount = 0;
-      for(auto type:mDataTypes) {
-        std::string field;
-        while (field.size() == 0) {
-          std::getline(ss, field, ' ');
-          if (ss.eof()) {
-            break;
-          }
+    }
+    for (size_t i = 0; i < numTypes; i++) {
+      const char *fieldEnd;
+      if (commaSeparated) {
+        fieldEnd = std::find(field, lineEnd, ',');
+      } else { // Space separated
+        while (field < lineEnd && *field == ' ') {
+          field++;
         }
-        if (field.size() == 0) {
+        if (field == lineEnd) {
           break;
         }
-        // Trim white space from start
-        field.erase(field.begin(), std::find_if(field.begin(), field.end(), [](int ch) {
-          return !std::isspace(ch);
-        }));
-        // Trim white space from end
-        field.erase(std::find_if(field.rbegin(), field.rend(), [](int ch) {
-          return !std::isspace(ch);
-        }).base(), field.end());
-        size_t stringLen = std::min(maxStringSize - 1, field.size());
-        int32_t intValue;
-        double doubleValue;
-        bool booleanValue;
-
-        auto data = row + byteCount;
-        assert((size_t) (data - mData.back()) < rowLength);
-        switch (type){
-        case STRING:
-          std::memcpy(data, field.data(), stringLen * sizeof (char));
-          byteCount += maxStringSize * sizeof (char);
-          break;
-        case INTEGER:
-          intValue = std::atoi(field.data());
-          std::memcpy(data, &intValue, sizeof (int64_t));
-          byteCount += sizeof (int64_t);
-          break;
-        case REAL:
-          doubleValue = std::atof(field.data());
-          std::memcpy(data, &doubleValue, sizeof (double));
-          byteCount += sizeof (double);
-          break;
-        case BOOLEAN:
-          booleanValue = field == "True" || field == "true" || field == "1";
-          std::memcpy(data, &booleanValue, sizeof (bool));
-          byteCount += sizeof (bool);
-          break;
-        case IGNORE_COLUMN:
-          break;
+        fieldEnd = std::find(field, lineEnd, ' ');
+      }
+      const char *next = fieldEnd < lineEnd ? fieldEnd + 1 : lineEnd;
+      if (!commaSeparated) {
+        // Trim white space
+        while (field < fieldEnd && isSpace(*field)) {
+          field++;
         }
+        while (fieldEnd > field && isSpace(fieldEnd[-1])) {
+          fieldEnd--;
+        }
+      }
+      switch (mDataTypes[i]) {
+      case STRING:
+      {
+        char *dest = columns[i] + row * maxStringSize;
+        size_t stringLen = std::min(maxStringSize - 1, size_t(fieldEnd - field));
+        std::memcpy(dest, field, stringLen * sizeof (char));
+        break;
       }
+      case INTEGER:
+        reinterpret_cast<int64_t *>(columns[i])[row] = parseInteger(field, fieldEnd);
+        break;
+      case REAL:
+        reinterpret_cast<double *>(columns[i])[row] = parseReal(field, fieldEnd);
+        break;
+      case BOOLEAN:
+        reinterpret_cast<bool *>(columns[i])[row] = parseBoolean(field, fieldEnd);
+        break;
+      case IGNORE_COLUMN:
+        break;
+      }
+      field = next;
     }
+    row++;
+  }
+}
+
+const void *CSVReader::columnData(int index, DataType type) const {
+  if (index < 0 || size_t(index) >= mColumns.size() || mDataTypes[index] != type) {
+    return nullptr;
   }
-  f.close();
-  //        if (f.bad()) {
-  //                std::cout << "Error ____ reading:" << fileName << std::endl;
-  //        }
-  return !f.bad();
+  return mColumns[index].data();
+}
+
+CSVReader::ColumnView<double> CSVReader::getRealColumn(int index) const {
+  auto data = static_cast<const double *>(columnData(index, REAL));
+  return ColumnView<double>(data, data ? mNumRows : 0);
+}
+
+CSVReader::ColumnView<int64_t> CSVReader::getIntegerColumn(int index) const {
+  auto data = static_cast<const int64_t *>(columnData(index, INTEGER));
+  return ColumnView<int64_t>(data, data ? mNumRows : 0);
+}
+
+CSVReader::ColumnView<bool> CSVReader::getBooleanColumn(int index) const {
+  auto data = static_cast<const bool *>(columnData(index, BOOLEAN));
+  return ColumnView<bool>(data, data ? mNumRows : 0);
+}
+
+const char *CSVReader::getString(int index, size_t row) const {
+  auto data = static_cast<const char *>(columnData(index, STRING));
+  if (!data || row >= mNumRows) {
+    return nullptr;
+  }
+  return data + row * maxStringSize;
 }
 
 std::vector<double> CSVReader::getColumn(int index) {
-	std::vector<double> out;
-	int offset = 0;
-	for (int i = 0; i < index; i++) {
-		switch (mDataTypes[i]){
-		case STRING:
-			offset += maxStringSize * sizeof (char);
-			break;
-		case INTEGER:
-			offset += sizeof (int64_t);
-			break;
-		case REAL:
-			offset += sizeof (double);
-			break;
-		case BOOLEAN:
-			offset += sizeof (bool);
-			break;
-        case IGNORE_COLUMN:
-			break;
-		}
-	}
-//	std::cout << offset << std::endl;
-	for (auto row: mData) {
-		double *val = (double *)(row + offset);
-		out.push_back(*val);
-	}
-	return out;
+  if (index < 0 || size_t(index) >= mColumns.size()) {
+    return std::vector<double>();
+  }
+  switch (mDataTypes[index]) {
+  case REAL:
+  {
+    auto column = getRealColumn(index);
+    return std::vector<double>(column.begin(), column.end());
+  }
+  case INTEGER:
+  {
+    auto column = getIntegerColumn(index);
+    return std::vector<double>(column.begin(), column.end());
+  }
+  case BOOLEAN:
+  {
+    auto column = getBooleanColumn(index);
+    return std::vector<double>(column.begin(), column.end());
+  }
+  default:
+    return std::vector<double>();
+  }
+}
+
+void CSVReader::copyRow(size_t row, char *dest) const {
+  for (size_t i = 0; i < mDataTypes.size(); i++) {
+    const char *column = reinterpret_cast<const char *>(mColumns[i].data());
+    switch (mDataTypes[i]) {
+    case STRING:
+      std::memcpy(dest, column + row * maxStringSize, maxStringSize * sizeof (char));
+      dest += maxStringSize * sizeof (char);
+      break;
+    case INTEGER:
+      std::memcpy(dest, column + row * sizeof (int64_t), sizeof (int64_t));
+      dest += sizeof (int64_t);
+      break;
+    case REAL:
+      std::memcpy(dest, column + row * sizeof (double), sizeof (double));
+      dest += sizeof (double);
+      break;
+    case BOOLEAN:
+      std::memcpy(dest, column + row * sizeof (bool), sizeof (bool));
+      dest += sizeof (bool);
+      break;
+    case IGNORE_COLUMN:
+      break;
+    }
+  }
 }
 
 size_t CSVReader::calculateRowLength() {
@@ -0,0 +1,169 @@
+#include "al/core/io/al_OfflineAudio.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace al {
+
+//==============================================================================
+
+bool MemoryAudioSink::open(int numChannels, double framesPerSecond) {
+  if (!mChannels.empty() &&
+      (int(mChannels.size()) != numChannels || mFramesPerSecond != framesPerSecond)) {
+    std::cerr << "MemoryAudioSink: Channels or frame rate changed, clearing." << std::endl;
+    mChannels.clear();
+  }
+  mChannels.resize(numChannels);
+  mFramesPerSecond = framesPerSecond;
+  return true;
+}
+
+bool MemoryAudioSink::write(const float *buffers, int numChannels, int numFrames) {
+  for (int c = 0; c < numChannels && c < int(mChannels.size()); c++) {
+    const float *in = buffers + c * numFrames;
+    mChannels[c].insert(mChannels[c].end(), in, in + numFrames);
+  }
+  return true;
+}
+
+//==============================================================================
+
+static void putLE(unsigned char *bytes, uint32_t value, int numBytes) {
+  for (int i = 0; i < numBytes; i++) {
+    bytes[i] = (value >> (8 * i)) & 0xFF;
+  }
+}
+
+SoundFileAudioSink::~SoundFileAudioSink() { close(); }
+
+bool SoundFileAudioSink::open(int numChannels, double framesPerSecond) {
+  close();
+  mFile = std::fopen(mFileName.c_str(), "wb");
+  if (!mFile) {
+    std::cerr << "SoundFileAudioSink: Can't open " << mFileName << std::endl;
+    return false;
+  }
+  mChannels = numChannels;
+  mFramesPerSecond = framesPerSecond;
+  mFrames = 0;
+  // Sizes are written again on close()
+  return writeHeader();
+}
+
+bool SoundFileAudioSink::writeHeader() {
+  // WAVE_FORMAT_EXTENSIBLE for more than two channels
+  bool extensible = mChannels > 2;
+  uint32_t formatBytes = extensible ? 40 : 16;
+  uint32_t frameBytes = 4 * mChannels;
+  uint64_t dataBytes = mFrames * frameBytes;
+  unsigned char header[68] = {0};
+  unsigned char *p = header;
+  memcpy(p, "RIFF", 4);
+  putLE(p + 4, uint32_t(4 + 8 + formatBytes + 8 + dataBytes), 4);
+  memcpy(p + 8, "WAVEfmt ", 8);
+  putLE(p + 16, formatBytes, 4);
+  p += 20;
+  putLE(p, extensible ? 0xFFFE : 3, 2);  // 3: IEEE float
+  putLE(p + 2, mChannels, 2);
+  putLE(p + 4, uint32_t(mFramesPerSecond), 4);
+  putLE(p + 8, uint32_t(mFramesPerSecond) * frameBytes, 4);
+  putLE(p + 12, frameBytes, 2);
+  putLE(p + 14, 32, 2);
+  if (extensible) {
+    static const unsigned char floatFormat[16] = {0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+                                                  0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+    putLE(p + 16, 22, 2);
+    putLE(p + 18, 32, 2);
+    putLE(p + 20, 0, 4);  // No speaker positions
+    memcpy(p + 24, floatFormat, 16);
+  }
+  p += formatBytes;
+  memcpy(p, "data", 4);
+  putLE(p + 4, uint32_t(dataBytes), 4);
+  p += 8;
+  size_t headerBytes = p - header;
+  return std::fseek(mFile, 0, SEEK_SET) == 0 &&
+         std::fwrite(header, 1, headerBytes, mFile) == headerBytes;
+}
+
+bool SoundFileAudioSink::write(const float *buffers, int numChannels, int numFrames) {
+  if (!mFile || numChannels != mChannels) {
+    return false;
+  }
+  // RIFF sizes are 32 bit
+  if ((mFrames + numFrames) * 4 * mChannels > 0xFFFFFFFFull - 80) {
+    std::cerr << "SoundFileAudioSink: " << mFileName << " reached the WAV size limit" << std::endl;
+    return false;
+  }
+  size_t numSamples = size_t(numFrames) * numChannels;
+  if (mInterleaved.size() < numSamples) {
+    mInterleaved.resize(numSamples);
+  }
+  interleave(mInterleaved.data(), buffers, numFrames, numChannels);
+  if (std::fwrite(mInterleaved.data(), sizeof(float), numSamples, mFile) != numSamples) {
+    std::cerr << "SoundFileAudioSink: Error writing " << mFileName << std::endl;
+    return false;
+  }
+  mFrames += numFrames;
+  return true;
+}
+
+bool SoundFileAudioSink::close() {
+  if (!mFile) {
+    return true;
+  }
+  bool ok = writeHeader();
+  ok = std::fclose(mFile) == 0 && ok;
+  mFile = nullptr;
+  return ok;
+}
+
+//==============================================================================
+
+bool OfflineAudioRenderer::render(AudioSink &sink, uint64_t numFrames) {
+  typedef std::chrono::steady_clock clock;
+  mStop = false;
+  mFramesRendered = 0;
+  const unsigned int framesPerBuffer = mIO.framesPerBuffer();
+  const int numChannels = mIO.channelsOut();
+  const double framesPerSecond = mIO.framesPerSecond();
+  if (!sink.open(numChannels, framesPerSecond)) {
+    return false;
+  }
+
+  const std::chrono::duration<double> blockDuration(framesPerBuffer / framesPerSecond);
+  std::chrono::duration<double> processing(0);
+  auto start = clock::now();
+  uint64_t blocks = 0;
+  bool ok = true;
+  while (mFramesRendered.load() < numFrames) {
+    if (mStop.load()) {
+      ok = false;
+      break;
+    }
+    if (mPace) {
+      std::this_thread::sleep_until(
+          start + std::chrono::duration_cast<clock::duration>(blockDuration * double(blocks)));
+    }
+    auto blockStart = clock::now();
+    mIO.zeroIn();
+    mIO.processAudioBlock(numChannels);
+    processing += clock::now() - blockStart;
+    if (!sink.write(mIO.outBuffer(0), numChannels, framesPerBuffer)) {
+      ok = false;
+      break;
+    }
+    blocks++;
+    mFramesRendered += framesPerBuffer;
+  }
+  std::chrono::duration<double> elapsed = clock::now() - start;
+
+  double audioSeconds = mFramesRendered.load() / framesPerSecond;
+  mRealTimeFactor = elapsed.count() > 0 ? audioSeconds / elapsed.count() : 0;
+  mCpu = audioSeconds > 0 ? processing.count() / audioSeconds : 0;
+  return sink.close() && ok;
+}
+
+}  // al::
@@ -438,6 +438,10 @@ bool Recv::open(uint16_t port, const char * address, al_sec timeout) {
     
     mAddress = address;
     mPort = port;
+    if (port == 0) {
+      // Ask the socket which port the system bound it to
+      mPort = uint16_t(socketReceiver->receiveSocket.LocalEndpoint().port);
+    }
   }
   catch (const std::runtime_error& e) {
     std::cout << "run time exception at Recv::open: " << e.what() << " " << address << ":" << port << std::endl;
@@ -465,6 +469,9 @@ void Recv::stop() {
 }
 
 void Recv::parse(const char *packet, int size, const char *senderAddr) {
+  if (size > int(mBuffer.size())) {
+    mBuffer.resize(size);
+  }
   std::memcpy(&mBuffer[0], packet, size);
   for (auto *handler : mHandlers) {
     handler->parse(&mBuffer[0], size, 1, senderAddr);
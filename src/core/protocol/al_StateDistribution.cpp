@@ -0,0 +1,293 @@
+#include "al/core/protocol/al_StateDistribution.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "al/core/system/al_Time.hpp"
+
+using namespace al;
+
+namespace {
+
+void writeVarint(std::vector<char> &out, size_t value) {
+  while (value >= 0x80) {
+    out.push_back(char((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(char(value));
+}
+
+bool readVarint(const char *&data, const char *end, size_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && data < end; shift += 7) {
+    unsigned char byte = (unsigned char) *data++;
+    value |= size_t(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Sequence numbers wrap around, compare them through their difference
+int32_t sequenceDiff(uint32_t a, uint32_t b) { return int32_t(a - b); }
+
+} // namespace
+
+StateSender::StateSender(size_t stateSize, std::string id)
+  : mStateSize(stateSize), mOscAddress(oscAddress(id)), mKeyframe(stateSize)
+{
+  mEncoded.reserve(stateSize);
+}
+
+std::string StateSender::oscAddress(const std::string &id) {
+  return id.size() > 0 ? "/_state/" + id : "/_state";
+}
+
+bool StateSender::addListener(std::string address, uint16_t port) {
+  auto sender = std::make_unique<osc::Send>(int(mFragmentSize + 128));
+  if (!sender->open(port, address.c_str())) {
+    return false;
+  }
+  mSenders.push_back(std::move(sender));
+  return true;
+}
+
+void StateSender::encodeDelta(const char *state, const char *reference, size_t size,
+                              std::vector<char> &encoded) {
+  // Pairs of (equal byte count, changed byte count) followed by the changed
+  // bytes XOR the reference. Trailing equal bytes are implicit.
+  encoded.clear();
+  size_t pos = 0;
+  while (pos < size) {
+    size_t start = pos;
+    while (pos + 8 <= size && memcmp(state + pos, reference + pos, 8) == 0) {
+      pos += 8;
+    }
+    while (pos < size && state[pos] == reference[pos]) {
+      pos++;
+    }
+    if (pos == size) {
+      break;
+    }
+    size_t equalCount = pos - start;
+    // Changed region ends when there are at least 8 equal bytes in a row
+    size_t changedStart = pos;
+    size_t changedEnd = pos;
+    size_t equalRun = 0;
+    while (pos < size && equalRun < 8) {
+      if (state[pos] == reference[pos]) {
+        equalRun++;
+      } else {
+        equalRun = 0;
+        changedEnd = pos + 1;
+      }
+      pos++;
+    }
+    writeVarint(encoded, equalCount);
+    writeVarint(encoded, changedEnd - changedStart);
+    for (size_t i = changedStart; i < changedEnd; i++) {
+      encoded.push_back(state[i] ^ reference[i]);
+    }
+    pos = changedEnd;
+  }
+}
+
+bool StateSender::decodeDelta(const char *encoded, size_t encodedSize,
+                              const char *reference, char *state, size_t size) {
+  memcpy(state, reference, size);
+  const char *data = encoded;
+  const char *end = encoded + encodedSize;
+  size_t pos = 0;
+  while (data < end) {
+    size_t equalCount, changedCount;
+    if (!readVarint(data, end, equalCount) || !readVarint(data, end, changedCount)) {
+      return false;
+    }
+    pos += equalCount;
+    if (pos > size || changedCount > size - pos || changedCount > size_t(end - data)) {
+      return false;
+    }
+    for (size_t i = 0; i < changedCount; i++) {
+      state[pos + i] = reference[pos + i] ^ data[i];
+    }
+    data += changedCount;
+    pos += changedCount;
+  }
+  return true;
+}
+
+size_t StateSender::send(const void *state) {
+  const char *stateBytes = static_cast<const char *>(state);
+  bool keyframe = !mHaveKeyframe
+      || sequenceDiff(mSequence, mKeyframeSequence) >= int32_t(mKeyframeInterval);
+  if (!keyframe) {
+    encodeDelta(stateBytes, mKeyframe.data(), mStateSize, mEncoded);
+    keyframe = mEncoded.size() >= mStateSize; // Delta is no smaller than the state
+  }
+  const char *payload;
+  size_t payloadSize;
+  if (keyframe) {
+    memcpy(mKeyframe.data(), stateBytes, mStateSize);
+    mKeyframeSequence = mSequence;
+    mHaveKeyframe = true;
+    payload = stateBytes;
+    payloadSize = mStateSize;
+  } else {
+    payload = mEncoded.data();
+    payloadSize = mEncoded.size();
+  }
+
+  int numFragments = int((payloadSize + mFragmentSize - 1) / mFragmentSize);
+  if (numFragments == 0) {
+    numFragments = 1; // Empty delta, state is equal to keyframe
+  }
+  size_t bytesSent = 0;
+  for (int fragment = 0; fragment < numFragments; fragment++) {
+    size_t offset = fragment * mFragmentSize;
+    size_t fragmentBytes = std::min(mFragmentSize, payloadSize - offset);
+    for (auto &sender : mSenders) {
+      sender->beginMessage(mOscAddress);
+      *sender << int(mSequence) << int(mKeyframeSequence)
+              << fragment << numFragments << int(payloadSize) << int(offset)
+              << osc::Blob(payload + offset, fragmentBytes);
+      sender->endMessage();
+      if (sender == mSenders.front()) {
+        bytesSent += sender->size();
+      }
+      sender->send();
+    }
+    if (mBurstSize > 0 && (fragment + 1) % mBurstSize == 0) {
+      // Give receivers time to drain their socket buffers
+      al_sleep(mBurstInterval);
+    }
+  }
+  mSequence++;
+  return bytesSent;
+}
+
+// ---------------------------------------------------------------------------
+
+StateReceiver::StateReceiver(size_t stateSize, std::string id)
+  : mStateSize(stateSize), mOscAddress(StateSender::oscAddress(id)), mKeyframe(stateSize)
+{
+  mAssembly.reserve(stateSize);
+  for (auto &buffer : mBuffers) {
+    buffer.resize(stateSize);
+  }
+}
+
+StateReceiver::~StateReceiver() {
+  close();
+}
+
+bool StateReceiver::open(uint16_t port, const char *address) {
+  close();
+  mRecv = std::make_unique<osc::Recv>();
+  if (!mRecv->open(port, address, 0.05)) {
+    mRecv = nullptr;
+    return false;
+  }
+  mRecv->handler(*this);
+  return mRecv->start();
+}
+
+void StateReceiver::close() {
+  if (mRecv) {
+    mRecv->stop();
+    mRecv = nullptr;
+  }
+}
+
+int StateReceiver::update() {
+  if (!(mMiddle.load(std::memory_order_relaxed) & kNewState)) {
+    return 0;
+  }
+  mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & ~kNewState;
+  // The count is incremented before the swap, so it can include a state that
+  // is published right after this. That state then reports 0 here later.
+  int completed = std::max(mCompleted.exchange(0, std::memory_order_relaxed), 1);
+  if (completed > 1) {
+    mStaleFrames += completed - 1;
+  }
+  return completed;
+}
+
+int StateReceiver::get(void *state) {
+  int newStates = update();
+  if (newStates > 0) {
+    memcpy(state, mBuffers[mFront].data(), mStateSize);
+  }
+  return newStates;
+}
+
+void StateReceiver::onMessage(osc::Message &m) {
+  if (m.addressPattern() != mOscAddress || m.typeTags() != "iiiiiib") {
+    return;
+  }
+  int sequence, keyframeSequence, fragment, numFragments, payloadSize, offset;
+  osc::Blob blob;
+  m >> sequence >> keyframeSequence >> fragment >> numFragments
+    >> payloadSize >> offset >> blob;
+  bool isKeyframe = sequence == keyframeSequence;
+  if (numFragments <= 0 || fragment < 0 || fragment >= numFragments
+      || payloadSize < 0 || size_t(payloadSize) > mStateSize
+      || (isKeyframe && size_t(payloadSize) != mStateSize)
+      || offset < 0 || size_t(offset) + blob.size > size_t(payloadSize)) {
+    return;
+  }
+  if (mHaveCompleted && sequenceDiff(uint32_t(sequence), mLastCompleted) <= 0) {
+    return; // Late fragment of a frame already completed
+  }
+  if (mAssembling && uint32_t(sequence) != mAssemblySequence) {
+    if (sequenceDiff(uint32_t(sequence), mAssemblySequence) < 0) {
+      return; // Older than the frame being assembled
+    }
+    mDroppedFrames++; // Newer frame arrived before the current one was complete
+    mAssembling = false;
+  }
+  if (!mAssembling) {
+    mAssembling = true;
+    mAssemblySequence = uint32_t(sequence);
+    mAssemblyKeyframe = uint32_t(keyframeSequence);
+    mFragmentsLeft = numFragments;
+    mFragmentReceived.assign(numFragments, false);
+    mAssembly.resize(payloadSize);
+  }
+  if (size_t(payloadSize) != mAssembly.size()
+      || size_t(numFragments) != mFragmentReceived.size()
+      || mFragmentReceived[fragment]) {
+    return;
+  }
+  mFragmentReceived[fragment] = true;
+  memcpy(mAssembly.data() + offset, blob.data, blob.size);
+  if (--mFragmentsLeft == 0) {
+    completeFrame();
+  }
+}
+
+void StateReceiver::completeFrame() {
+  mAssembling = false;
+  mHaveCompleted = true;
+  mLastCompleted = mAssemblySequence;
+  if (mAssemblySequence == mAssemblyKeyframe) {
+    mKeyframe.swap(mAssembly);
+    mKeyframeSequence = mAssemblySequence;
+    mHaveKeyframe = true;
+    memcpy(mBuffers[mBack].data(), mKeyframe.data(), mStateSize);
+    publish();
+  } else if (mHaveKeyframe && mKeyframeSequence == mAssemblyKeyframe
+             && StateSender::decodeDelta(mAssembly.data(), mAssembly.size(),
+                                         mKeyframe.data(), mBuffers[mBack].data(),
+                                         mStateSize)) {
+    publish();
+  } else {
+    mDroppedFrames++;
+  }
+}
+
+void StateReceiver::publish() {
+  mCompleted.fetch_add(1, std::memory_order_relaxed);
+  mBack = mMiddle.exchange(mBack | kNewState, std::memory_order_acq_rel) & ~kNewState;
+}
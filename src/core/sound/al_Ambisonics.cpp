@@ -1,7 +1,15 @@
 #include <string.h>
+#include <algorithm>
 
 #include "al/core/sound/al_Ambisonics.hpp"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define AL_AMBISONICS_SSE
+#endif
+
 #ifdef USE_GAMMA
 	#include "scl.h"
 	#define COS			gam::scl::cosT8
@@ -21,6 +29,28 @@ static const double c1_sqrt2	= 0.707106781186548;
 static const double c8_11		= 8./11.;
 static const double c40_11		= 40./11.;
 
+// (2m-1)!!, P_m^m without the cos^m(el) factor
+static const float doubleFactorials[8] = {1, 1, 3, 15, 105, 945, 10395, 135135};
+
+// SN3D normalization sqrt((2 - delta_m0) (l-m)! / (l+m)!), for m <= l <= 7
+struct SN3DTable {
+	float n[8][8];
+	SN3DTable(){
+		for(int l=0; l<8; ++l){
+			for(int m=0; m<=l; ++m){
+				double ratio = 1;
+				for(int k=l-m+1; k<=l+m; ++k) ratio /= k;
+				n[l][m] = sqrt((m == 0 ? 1. : 2.) * ratio);
+			}
+		}
+	}
+};
+
+static const SN3DTable& sn3d(){
+	static const SN3DTable table;
+	return table;
+}
+
 
 //// @see http://www.ai.sri.com/ajh/ambisonics/
 //
@@ -41,8 +71,8 @@ static const double c40_11		= 40./11.;
 
 // AmbiBase
 
-AmbiBase::AmbiBase(int dim, int order)
-:	mDim(dim), mOrder(0), mWeights(0)
+AmbiBase::AmbiBase(int dim, int order, Format format)
+:	mDim(dim), mOrder(-1), mFormat(format), mWeights(0)
 {	this->order(order); }
 
 AmbiBase::~AmbiBase(){
@@ -61,6 +91,10 @@ void AmbiBase::dim(int dim)
 }
 
 void AmbiBase::order(int o){
+	if(o > maxOrder(mFormat)){
+		std::cout << "AmbiBase: order " << o << " not supported, using " << maxOrder(mFormat) << std::endl;
+		o = maxOrder(mFormat);
+	}
 	if(o != mOrder){
 		mOrder = o;
 		mChannels = orderToChannels(mDim, mOrder);
@@ -69,6 +103,17 @@ void AmbiBase::order(int o){
 	}
 }
 
+void AmbiBase::format(Format f){
+	if(f != mFormat){
+		mFormat = f;
+		if(mOrder > maxOrder(mFormat)){
+			order(maxOrder(mFormat));
+		} else {
+			onChannelsChange();
+		}
+	}
+}
+
 int AmbiBase::channelsToUniformOrder(int channels){
 	// M = floor(sqrt(N) - 1)
 	return (int)(sqrt((double)channels) - 1);
@@ -173,6 +218,143 @@ void AmbiBase::encodeWeightsFuMa16(float * ws, float az, float el){
 
 
 
+void AmbiBase::encodeWeightsACN(float * ws, int dim, int order, float x, float y, float z){
+	const SN3DTable &norm = sn3d();
+
+	// cos(m az) cos^m(el) and sin(m az) cos^m(el) are the real and
+	// imaginary parts of (x + iy)^m
+	float c[8], s[8];
+	c[0] = 1; s[0] = 0;
+	for(int m=1; m<=order; ++m){
+		c[m] = x * c[m-1] - y * s[m-1];
+		s[m] = x * s[m-1] + y * c[m-1];
+	}
+
+	ws[0] = 1;
+	if(dim == 2){
+		for(int l=1; l<=order; ++l){
+			float n = norm.n[l][l] * doubleFactorials[l];
+			ws[2*l-1] = n * s[l];
+			ws[2*l  ] = n * c[l];
+		}
+		return;
+	}
+
+	// P_l^m(z) / cos^m(el) for l = m, m+1, ... with the three term recurrence
+	for(int m=0; m<=order; ++m){
+		float p2 = 0;
+		float p1 = doubleFactorials[m];
+		for(int l=m; l<=order; ++l){
+			float p = p1;
+			if(l > m){
+				p = ((2*l - 1) * z * p1 - (l + m - 1) * p2) / (l - m);
+				p2 = p1;
+				p1 = p;
+			}
+			float n = norm.n[l][m] * p;
+			int center = l * l + l;	// ACN = l^2 + l + m
+			if(m == 0){
+				ws[center] = n;
+			} else {
+				ws[center + m] = n * c[m];
+				ws[center - m] = n * s[m];
+			}
+		}
+	}
+}
+
+void AmbiBase::encodeWeightsACN(float * ws, int dim, int order, float az, float el){
+	WRAP(az);
+	WRAP(el);
+	float cosel = COS(el);
+	float x = COS(az) * cosel;
+	float y = SIN(az) * cosel;
+	float z = dim>=3 ? SIN(el) : 0;
+	encodeWeightsACN(ws, dim, order, x,y,z);
+}
+
+namespace {
+
+// Real spherical harmonic rotation matrices from
+// J. Ivanic, K. Ruedenberg, "Rotation Matrices for Real Spherical Harmonics.
+// Direct Determination by Recursion", J. Phys. Chem. 1996, 100, 6342-6347
+// (and the 1998 corrections)
+struct SHRotation {
+	double r[8][15][15];	// r[l][m+l][n+l]
+
+	double R(int l, int m, int n) const { return r[l][m+l][n+l]; }
+
+	double P(int i, int l, int a, int b) const {
+		if(b == l){
+			return R(1,i,1) * R(l-1,a,l-1) - R(1,i,-1) * R(l-1,a,-l+1);
+		} else if(b == -l){
+			return R(1,i,1) * R(l-1,a,-l+1) + R(1,i,-1) * R(l-1,a,l-1);
+		}
+		return R(1,i,0) * R(l-1,a,b);
+	}
+
+	double U(int l, int m, int n) const { return P(0,l,m,n); }
+
+	double V(int l, int m, int n) const {
+		if(m == 0){
+			return P(1,l,1,n) + P(-1,l,-1,n);
+		} else if(m > 0){
+			if(m == 1) return P(1,l,0,n) * c1_sqrt2 * 2;
+			return P(1,l,m-1,n) - P(-1,l,-m+1,n);
+		}
+		if(m == -1) return P(-1,l,0,n) * c1_sqrt2 * 2;
+		return P(1,l,m+1,n) + P(-1,l,-m-1,n);
+	}
+
+	double W(int l, int m, int n) const {
+		if(m > 0) return P(1,l,m+1,n) + P(-1,l,-m-1,n);
+		return P(1,l,m-1,n) - P(-1,l,-m+1,n);
+	}
+
+	void compute(int order, const Mat3d& rot){
+		r[0][0][0] = 1;
+		// Order 1 harmonics are (y, z, x)
+		static const int axis[3] = {1, 2, 0};
+		for(int m=0; m<3; ++m){
+			for(int n=0; n<3; ++n){
+				r[1][m][n] = rot(axis[m], axis[n]);
+			}
+		}
+		for(int l=2; l<=order; ++l){
+			for(int m=-l; m<=l; ++m){
+				int am = m < 0 ? -m : m;
+				for(int n=-l; n<=l; ++n){
+					int an = n < 0 ? -n : n;
+					double d = an == l ? (2*l) * (2*l - 1) : (l + n) * (l - n);
+					double u = sqrt((l + m) * (l - m) / d);
+					double v = 0.5 * sqrt((m == 0 ? 2. : 1.) * (l + am - 1) * (l + am) / d) * (m == 0 ? -1 : 1);
+					double w = m == 0 ? 0 : -0.5 * sqrt((l - am - 1) * (l - am) / d);
+					double value = v * V(l,m,n);
+					if(u != 0) value += u * U(l,m,n);
+					if(w != 0) value += w * W(l,m,n);
+					r[l][m+l][n+l] = value;
+				}
+			}
+		}
+	}
+};
+
+}
+
+void AmbiBase::rotationMatrices(float * matrices, int order, const Mat3d& rot){
+	SHRotation sh;
+	sh.compute(order, rot);
+	for(int l=0; l<=order; ++l){
+		int size = 2*l + 1;
+		for(int m=0; m<size; ++m){
+			for(int n=0; n<size; ++n){
+				*matrices++ = sh.r[l][m][n];
+			}
+		}
+	}
+}
+
+
 // AmbiDecode
 
 float AmbiDecode::flavorWeights[4][5][5] = {
@@ -203,9 +385,9 @@ float AmbiDecode::flavorWeights[4][5][5] = {
 	}
 };
 
-AmbiDecode::AmbiDecode(int dim, int order, int numSpeakers, int flav)
-	: AmbiBase(dim, order),
-	mNumSpeakers(0), mDecodeMatrix(nullptr)
+AmbiDecode::AmbiDecode(int dim, int order, int numSpeakers, int flav, Format format)
+	: AmbiBase(dim, order, format),
+	mNumSpeakers(0), mFlavor(flav), mDecodeMatrix(nullptr)
 {
 	resizeArrays(channels(), numSpeakers);
 	flavor(flav);
@@ -216,34 +398,156 @@ AmbiDecode::~AmbiDecode(){
 	//delete[] mSpeakers; // listener now owns speakers and will delete them
 }
 
+// out[k][i] += sum over c of w[c * 4 + k] * ambi[c * numFrames + i]
+template <int K>
+static void decodeSpeakers(float * const * out, const float * w, const float * ambi,
+                           int numChannels, int numFrames)
+{
+	int i = 0;
+#if defined(__AVX__)
+	for(; i + 8 <= numFrames; i += 8){
+		__m256 acc[K];
+		for(int k=0; k<K; ++k) acc[k] = _mm256_loadu_ps(out[k] + i);
+		const float * in = ambi + i;
+		const float * wc = w;
+		for(int c=0; c<numChannels; ++c, in += numFrames, wc += 4){
+			__m256 x = _mm256_loadu_ps(in);
+			for(int k=0; k<K; ++k){
+				acc[k] = _mm256_add_ps(acc[k], _mm256_mul_ps(x, _mm256_broadcast_ss(wc + k)));
+			}
+		}
+		for(int k=0; k<K; ++k) _mm256_storeu_ps(out[k] + i, acc[k]);
+	}
+#elif defined(AL_AMBISONICS_SSE)
+	for(; i + 4 <= numFrames; i += 4){
+		__m128 acc[K];
+		for(int k=0; k<K; ++k) acc[k] = _mm_loadu_ps(out[k] + i);
+		const float * in = ambi + i;
+		const float * wc = w;
+		for(int c=0; c<numChannels; ++c, in += numFrames, wc += 4){
+			__m128 x = _mm_loadu_ps(in);
+			for(int k=0; k<K; ++k){
+				acc[k] = _mm_add_ps(acc[k], _mm_mul_ps(x, _mm_set1_ps(wc[k])));
+			}
+		}
+		for(int k=0; k<K; ++k) _mm_storeu_ps(out[k] + i, acc[k]);
+	}
+#endif
+	for(; i<numFrames; ++i){
+		for(int k=0; k<K; ++k){
+			float acc = out[k][i];
+			for(int c=0; c<numChannels; ++c) acc += ambi[c * numFrames + i] * w[c * 4 + k];
+			out[k][i] = acc;
+		}
+	}
+}
+
 void AmbiDecode::decode(float * dec, const float * ambi, int numDecFrames) const {
+	const int numChannels = channels();
+	float w[64 * 4];
+	float * outs[4];
+	int k = 0;
+	auto flush = [&](){
+		switch(k){
+		case 4: decodeSpeakers<4>(outs, w, ambi, numChannels, numDecFrames); break;
+		case 3: decodeSpeakers<3>(outs, w, ambi, numChannels, numDecFrames); break;
+		case 2: decodeSpeakers<2>(outs, w, ambi, numChannels, numDecFrames); break;
+		case 1: decodeSpeakers<1>(outs, w, ambi, numChannels, numDecFrames); break;
+		default:;
+		}
+	};
 
-	// iterate speakers
+	// iterate speakers in groups of 4
 	for(int s=0; s<numSpeakers(); ++s){
 		// skip zero-amp speakers:
-		if (mSpeakers[s].gain != 0.) {
-			float * out = dec + mSpeakers[s].deviceChannel * numDecFrames;
-
-			// iterate ambi channels
-			for(int c=0; c<channels(); ++c){
-				const float * in = ambi + c * numDecFrames;
-				float w = decodeWeight(s, c);
-				for(int i=0; i<numDecFrames; ++i) out[i] += in[i] * w;
-			}
+		if (mSpeakers[s].gain == 0.) continue;
+		float * out = dec + mSpeakers[s].deviceChannel * numDecFrames;
+		// speakers sharing an output must not be in the same group
+		if(std::find(outs, outs + k, out) != outs + k){
+			flush();
+			k = 0;
+		}
+		outs[k] = out;
+		for(int c=0; c<numChannels; ++c) w[c * 4 + k] = decodeWeight(s, c);
+		if(++k == 4){
+			flush();
+			k = 0;
 		}
     }
+	flush();
 }
 
 void AmbiDecode::flavor(int type){
 	if(type < 4){
 		mFlavor = type;
 		const int No = sizeof(mWOrder)/sizeof(mWOrder[0]);
-		for(int i=0; i<No; ++i) mWOrder[i] = flavorWeights[flavor()][i][order()];
+		if(mFormat == FUMA){
+			for(int i=0; i<No; ++i) mWOrder[i] = i < 5 ? flavorWeights[flavor()][i][order()] : 0;
+		} else {
+			orderWeightsACN(mWOrder, flavor(), mDim, order());
+		}
 		updateChanWeights();
 
 	}
 }
 
+void AmbiDecode::orderWeightsACN(float * weights, int flavor, int dim, int order){
+	const SN3DTable &norm = sn3d();
+	double g[8];
+	for(int l=0; l<=order; ++l){
+		switch(flavor){
+		case 0: // basic
+			g[l] = 1;
+			break;
+		case 2: // in-phase
+		{
+			double num = 1, den = 1;
+			if(dim == 3){
+				// N! (N+1)! / ((N+l+1)! (N-l)!)
+				for(int k=order-l+1; k<=order; ++k) num *= k;
+				for(int k=order+2; k<=order+l+1; ++k) den *= k;
+			} else {
+				// N!^2 / ((N+l)! (N-l)!)
+				for(int k=order-l+1; k<=order; ++k) num *= k;
+				for(int k=order+1; k<=order+l; ++k) den *= k;
+			}
+			g[l] = num / den;
+			break;
+		}
+		default: // max-rE
+			if(dim == 3){
+				// P_l(cos(137.9 deg / (N + 1.51)))
+				double x = cos(137.9 * M_PI / 180. / (order + 1.51));
+				double p2 = 1, p1 = x;
+				g[l] = l == 0 ? 1 : x;
+				for(int k=2; k<=l; ++k){
+					g[l] = ((2*k - 1) * x * p1 - (k - 1) * p2) / k;
+					p2 = p1;
+					p1 = g[l];
+				}
+			} else {
+				g[l] = cos(l * M_PI / (2 * order + 2));
+			}
+		}
+	}
+
+	// Projection decoder factors. The sum over m of the products of SN3D
+	// harmonics of two directions is P_l(cos(angle)) in 3D and
+	// N_l^2 cos(l angle) in 2D
+	double sum = 0;
+	for(int l=0; l<=order; ++l){
+		double p = 1;
+		if(dim == 2 && l > 0){
+			double n = norm.n[l][l] * doubleFactorials[l];
+			p = n * n;
+		}
+		double factor = dim == 3 ? 2*l + 1 : (l == 0 ? 1 : 2 / p);
+		weights[l] = factor * g[l];
+		sum += weights[l] * p;
+	}
+	for(int l=0; l<8; ++l) weights[l] = l <= order ? weights[l] / sum : 0;
+}
+
 void AmbiDecode::numSpeakers(int num){
 	resizeArrays(channels(), num);
 }
@@ -262,7 +566,8 @@ void AmbiDecode::setSpeakerRadians(int index, int deviceChannel, float az, float
 	mSpeakers[index].gain = amp;
 
 	// update encoding weights
-	encodeWeightsFuMa(mDecodeMatrix + index * channels(), mDim, mOrder, az, el);
+	if(mFormat == FUMA) encodeWeightsFuMa(mDecodeMatrix + index * channels(), mDim, mOrder, az, el);
+	else encodeWeightsACN(mDecodeMatrix + index * channels(), mDim, mOrder, az, el);
     for (int i=0; i<channels(); i++) {
         mDecodeMatrix[index * channels() + i] *= amp;
     }
@@ -287,6 +592,14 @@ void AmbiDecode::setSpeakers(Speakers &spkrs) {
 
 void AmbiDecode::updateChanWeights(){
 	float * wc = mWeights;
+	if(mFormat == ACN_SN3D){
+		*wc++ = mWOrder[0];
+		for(int l=1; l<=mOrder; ++l){
+			int n = 3 == mDim ? 2*l + 1 : 2;
+			for(int m=0; m<n; ++m) *wc++ = mWOrder[l];
+		}
+		return;
+	}
 	*wc++ = mWOrder[0];
 
 	if(mOrder > 0){
@@ -349,6 +662,8 @@ void AmbiDecode::resizeArrays(int numChannels, int numSpeakers){
 
 void AmbiDecode::onChannelsChange(){
 	resizeArrays(channels(), mNumSpeakers);
+	// The order weights depend on the order and the format
+	flavor(mFlavor);
 }
 
 void AmbiDecode::print(std::ostream &stream) const {
@@ -389,9 +704,9 @@ void AmbiEncode::print(std::ostream &stream)
 // Ambisonics Spatializer -----------------
 
 AmbisonicsSpatializer::AmbisonicsSpatializer(
-	SpeakerLayout &sl, int dim, int order, int flavor
+	SpeakerLayout &sl, int dim, int order, int flavor, AmbiBase::Format format
 )
-	:	Spatializer(sl), mDecoder(dim, order, sl.numSpeakers(), flavor), mEncoder(dim,order)
+	:	Spatializer(sl), mDecoder(dim, order, sl.numSpeakers(), flavor, format), mEncoder(dim,order,format)
 {
 };
 
@@ -408,6 +723,48 @@ void AmbisonicsSpatializer::configure(int dim, int order, int flavor)
 
      mEncoder.dim(dim);
      mEncoder.order(order);
+     compile();
+}
+
+void AmbisonicsSpatializer::format(AmbiBase::Format format)
+{
+    mDecoder.format(format);
+    mEncoder.format(format);
+    compile();
+}
+
+// OpenGL to Ambisonic coordinates and back
+static Vec3d toAmbi(const Vec3d& v){ return Vec3d(-v.z, -v.x, v.y); }
+static Vec3d fromAmbi(const Vec3d& v){ return Vec3d(-v.y, v.z, -v.x); }
+
+bool AmbisonicsSpatializer::listenerOrientation(const Quatd& orientation)
+{
+    if (mDecoder.format() != AmbiBase::ACN_SN3D || mDecoder.dim() != 3) {
+        mRotate = false;
+        return false;
+    }
+    bool first = !mRotate;
+    mRotationChanged = !first && orientation != mOrientation;
+    if (first || mRotationChanged) {
+        mOrientation = orientation;
+        // Scenes rotate source directions with Quat::rotate()
+        Mat3d rot;
+        for (int j = 0; j < 3; j++) {
+            Vec3d axis;
+            axis[j] = 1;
+            Vec3d column = toAmbi(orientation.rotate(fromAmbi(axis)));
+            for (int i = 0; i < 3; i++) {
+                rot(i, j) = column[i];
+            }
+        }
+        mRotation.resize(AmbiBase::rotationSize(mDecoder.order()));
+        AmbiBase::rotationMatrices(mRotation.data(), mDecoder.order(), rot);
+        if (first) {
+            mPreviousRotation = mRotation;
+        }
+    }
+    mRotate = true;
+    return true;
 }
 
 void AmbisonicsSpatializer::compile()
@@ -416,7 +773,8 @@ void AmbisonicsSpatializer::compile()
 
 	size_t numSpeakers = mSpeakers.size();
 	for(size_t i = 0; i < numSpeakers; i++){
-        mDecoder.setSpeakerRadians(
+		// Speaker angles are in degrees
+		mDecoder.setSpeaker(
 			i,
 			mSpeakers[i].deviceChannel,
 			mSpeakers[i].azimuth,
@@ -424,6 +782,13 @@ void AmbisonicsSpatializer::compile()
 			mSpeakers[i].gain
 		);
 	}
+
+	// Buffer sizes depend on the number of channels
+	if (mNumFrames > 0) {
+		numFrames(mNumFrames);
+	}
+	// Restart the sound field rotation
+	mRotate = false;
 }
 
 void AmbisonicsSpatializer::numFrames(unsigned int v){
@@ -431,6 +796,8 @@ void AmbisonicsSpatializer::numFrames(unsigned int v){
 	if(mAmbiDomainChannels.size() != (unsigned long)(mDecoder.channels() * v)){
 		mAmbiDomainChannels.resize(mDecoder.channels() * v);
 	}
+	// One order at a time
+	mRotatedChannels.resize((2 * mDecoder.order() + 1) * v);
 }
 
 void AmbisonicsSpatializer::numSpeakers(int num){
@@ -475,7 +842,7 @@ void AmbisonicsSpatializer::renderBuffer(AudioIOData& io,
 	//Rotate vector according to listener-rotation
 	Quatd srcRot = listeningPose.quat();
 	direction = srcRot.rotate(direction);
-	direction = Vec4d(-direction.z, -direction.x, direction.y).normalize();
+	direction = Vec3d(-direction.z, -direction.x, direction.y).normalize();
     mEncoder.direction(direction);
 //	for(int i = 0; i < numFrames; i++){
 ////		// cheaper:
@@ -512,23 +879,60 @@ void AmbisonicsSpatializer::renderSample(AudioIOData& io, const Pose& listeningP
 	//Rotate vector according to listener-rotation
 	Quatd srcRot = listeningPose.quat();
 	direction = srcRot.rotate(direction);
-	direction = Vec4d(direction.x, direction.z, direction.y);
 
     //mEncoder.direction(azimuth, elevation);
     //mEncoder.direction(-rf, -rr, ru);
 //    mEncoder.direction(-direction[2], -direction[0], direction[1]);
-    direction = Vec4d(-direction.z, -direction.x, direction.y).normalize();
+    direction = Vec3d(-direction.z, -direction.x, direction.y).normalize();
     mEncoder.direction(direction);
     mEncoder.encode(ambiChans(), io.framesPerBuffer(), frameIndex, sample);
 }
 
 
+void AmbisonicsSpatializer::rotateAmbi(){
+	if(!mRotationChanged && mOrientation == Quatd::identity()){
+		return;
+	}
+	const int numFrames = mNumFrames;
+	const float *matrix = mRotation.data() + 1;
+	const float *previous = mPreviousRotation.data() + 1;
+	for(int l = 1; l <= mDecoder.order(); l++){
+		const int size = 2 * l + 1;
+		float *block = ambiChans(l * l);
+		float *rotated = mRotatedChannels.data();
+		memset(rotated, 0, size * numFrames * sizeof(float));
+		for(int m = 0; m < size; m++){
+			float *out = rotated + m * numFrames;
+			for(int n = 0; n < size; n++){
+				const float *in = block + n * numFrames;
+				// Interpolating the matrices interpolates the outputs
+				if(mRotationChanged){
+					applyGainRamp(out, in, previous[m * size + n], matrix[m * size + n], numFrames);
+				} else {
+					applyGain(out, in, matrix[m * size + n], numFrames);
+				}
+			}
+		}
+		memcpy(block, rotated, size * numFrames * sizeof(float));
+		matrix += size * size;
+		previous += size * size;
+	}
+	if(mRotationChanged){
+		mPreviousRotation = mRotation;
+		mRotationChanged = false;
+	}
+}
+
 void AmbisonicsSpatializer::finalize(AudioIOData& io){
 	//previously done in render method of audioscene
 
 	float *outs = &io.out(0,0);//io.outBuffer();
 	int numFrames = io.framesPerBuffer();
 
+	if(mRotate){
+		rotateAmbi();
+	}
+
     mDecoder.decode(outs, ambiChans(), numFrames);
 }
 
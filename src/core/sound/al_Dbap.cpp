@@ -35,29 +35,44 @@ void Dbap::renderSample(AudioIOData &io, const Pose &listeningPose, const float
 	}
 }
 
-void Dbap::renderBuffer(AudioIOData &io, const Pose &listeningPose, const float *samples, const int &numFrames)
+Vec3d Dbap::sourcePosition(const Pose &listeningPose)
 {
 	Vec3d relpos = listeningPose.vec();
 
 	//Rotate vector according to listener-rotation
 	Quatd srcRot = listeningPose.quat();
 	relpos = srcRot.rotate(relpos);
-	relpos = Vec4d(relpos.x, relpos.z, relpos.y);
+	return Vec4d(relpos.x, relpos.z, relpos.y);
+}
+
+float Dbap::speakerGain(const Vec3d &relpos, unsigned int speaker)
+{
+	Vec3d vec = relpos - mSpeakerVecs[speaker];
+	double dist = vec.mag();
+	float gain = 1.0 / (1.0 + dist);
+	return powf(gain, mFocus);
+}
+
+void Dbap::renderBuffer(AudioIOData &io, const Pose &listeningPose, const float *samples, const int &numFrames)
+{
+	Vec3d relpos = sourcePosition(listeningPose);
 
-    for (unsigned int k = 0; k < mNumSpeakers; ++k)
+	for (unsigned int k = 0; k < mNumSpeakers; ++k)
 	{
-		float gain = 1.f;
+		applyGain(io.outBuffer(mDeviceChannels[k]), samples, speakerGain(relpos, k), numFrames);
+	}
+}
 
-		Vec3d vec = relpos - mSpeakerVecs[k];
-		double dist = vec.mag();
-		gain = 1.0 / (1.0 + dist);
-		gain = powf(gain, mFocus);
+void Dbap::renderBufferRamp(AudioIOData &io, const Pose &previousPose, const Pose &listeningPose, const float *samples, const int &numFrames)
+{
+	Vec3d previousPos = sourcePosition(previousPose);
+	Vec3d relpos = sourcePosition(listeningPose);
 
-		float * out = io.outBuffer(mDeviceChannels[k]);
-		for(int i = 0; i < numFrames; ++i){
-			out[i] += gain * samples[i];
-		}
-    }
+	for (unsigned int k = 0; k < mNumSpeakers; ++k)
+	{
+		applyGainRamp(io.outBuffer(mDeviceChannels[k]), samples,
+		              speakerGain(previousPos, k), speakerGain(relpos, k), numFrames);
+	}
 }
 
 void Dbap::print(std::ostream &stream) {
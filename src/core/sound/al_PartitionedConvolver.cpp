@@ -0,0 +1,306 @@
+#include "al/core/sound/al_PartitionedConvolver.hpp"
+#include "al/core/math/al_Constants.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+using namespace al;
+
+struct PartitionedConvolver::ImpulseResponses {
+    unsigned int numPartitions {0};
+    unsigned int crossfadeFrames {0};
+    std::vector<unsigned int> inputs;
+    // Per output: numPartitions spectra of partitionSize + 1 bins
+    std::vector<std::vector<Complex>> spectra;
+    ImpulseResponses *next {nullptr}; // For AtomicHandoff
+};
+
+PartitionedConvolver::PartitionedConvolver() {
+}
+
+PartitionedConvolver::~PartitionedConvolver() {
+    clear();
+}
+
+void PartitionedConvolver::clear() {
+    delete mCurrent;
+    delete mNext;
+    mCurrent = mNext = nullptr;
+    mCrossfading = false;
+    mHandoff.clear();
+}
+
+bool PartitionedConvolver::configure(unsigned int numInputs, unsigned int numOutputs,
+                          unsigned int blockSize, unsigned int maxIRLength) {
+    clear();
+    if (numInputs == 0 || numOutputs == 0 || blockSize == 0 || maxIRLength == 0) {
+        return false;
+    }
+    mNumInputs = numInputs;
+    mNumOutputs = numOutputs;
+    mPartitionSize = 1;
+    while (mPartitionSize < blockSize) {
+        mPartitionSize <<= 1;
+    }
+    mNumPartitions = (maxIRLength + mPartitionSize - 1) / mPartitionSize;
+
+    unsigned int fftSize = 2 * mPartitionSize;
+    unsigned int bits = 0;
+    while ((1u << bits) < fftSize) {
+        bits++;
+    }
+    mTwiddles.resize(fftSize / 2);
+    for (unsigned int i = 0; i < fftSize / 2; i++) {
+        mTwiddles[i] = std::polar(1.0f, float(-M_2PI * i / fftSize));
+    }
+    mBitReverse.resize(fftSize);
+    for (unsigned int i = 0; i < fftSize; i++) {
+        unsigned int reversed = 0;
+        for (unsigned int b = 0; b < bits; b++) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        mBitReverse[i] = reversed;
+    }
+
+    unsigned int numBins = mPartitionSize + 1;
+    mInputHistory.assign(numInputs, std::vector<float>(fftSize, 0.0f));
+    mInputSpectra.assign(numInputs, std::vector<Complex>(mNumPartitions * numBins));
+    mCurrentSpectrum = 0;
+    mScratch.resize(fftSize);
+    mAccumulator.resize(numBins);
+    mOutputBlock.resize(mPartitionSize);
+    mFadeBlock.resize(mPartitionSize);
+    mInputPointers.resize(numInputs);
+    mOutputPointers.resize(numOutputs);
+
+    mBuffered = mPartitionSize != blockSize;
+    mInputFifo.assign(mBuffered ? numInputs : 0, std::vector<float>(mPartitionSize, 0.0f));
+    mOutputFifo.assign(mBuffered ? numOutputs : 0, std::vector<float>(mPartitionSize, 0.0f));
+    mInputFifoPointers.clear();
+    for (auto &fifo : mInputFifo) {
+        mInputFifoPointers.push_back(fifo.data());
+    }
+    mOutputFifoPointers.clear();
+    for (auto &fifo : mOutputFifo) {
+        mOutputFifoPointers.push_back(fifo.data());
+    }
+    mFifoPosition = 0;
+    return true;
+}
+
+bool PartitionedConvolver::setImpulseResponses(const std::vector<std::vector<float>> &irs,
+                                    std::vector<unsigned int> inputChannels,
+                                    unsigned int crossfadeFrames) {
+    if (irs.size() > mNumOutputs) {
+        std::cerr << "PartitionedConvolver: " << irs.size() << " IRs for " << mNumOutputs << " outputs" << std::endl;
+        return false;
+    }
+    if (inputChannels.size() == 0) {
+        for (unsigned int i = 0; i < irs.size(); i++) {
+            inputChannels.push_back(std::min(i, mNumInputs - 1));
+        }
+    }
+    if (inputChannels.size() != irs.size()) {
+        std::cerr << "PartitionedConvolver: " << inputChannels.size() << " input channels for " << irs.size() << " IRs" << std::endl;
+        return false;
+    }
+    for (auto input : inputChannels) {
+        if (input >= mNumInputs) {
+            std::cerr << "PartitionedConvolver: Invalid input channel " << input << std::endl;
+            return false;
+        }
+    }
+
+    ImpulseResponses *newIRs = new ImpulseResponses;
+    newIRs->crossfadeFrames = crossfadeFrames;
+    newIRs->inputs = inputChannels;
+    size_t length = 0;
+    for (auto &ir : irs) {
+        length = std::max(length, ir.size());
+    }
+    if (length > size_t(mNumPartitions) * mPartitionSize) {
+        std::cerr << "PartitionedConvolver: IR longer than " << mNumPartitions * mPartitionSize << " frames truncated" << std::endl;
+    }
+    newIRs->numPartitions = std::min(mNumPartitions, unsigned((length + mPartitionSize - 1) / mPartitionSize));
+
+    unsigned int numBins = mPartitionSize + 1;
+    std::vector<Complex> scratch(2 * mPartitionSize);
+    for (auto &ir : irs) {
+        newIRs->spectra.emplace_back(newIRs->numPartitions * numBins);
+        for (unsigned int p = 0; p < newIRs->numPartitions; p++) {
+            // Partition zero padded to the FFT size
+            std::fill(scratch.begin(), scratch.end(), Complex(0.0f));
+            for (unsigned int i = 0; i < mPartitionSize && p * mPartitionSize + i < ir.size(); i++) {
+                scratch[i] = ir[p * mPartitionSize + i];
+            }
+            fft(scratch.data(), false);
+            std::copy(scratch.begin(), scratch.begin() + numBins, newIRs->spectra.back().begin() + p * numBins);
+        }
+    }
+
+    mHandoff.publish(newIRs);
+    return true;
+}
+
+void PartitionedConvolver::process(const float *const *inputs, float *const *outputs, unsigned int numFrames) {
+    update();
+    if (mBuffered) {
+        unsigned int offset = 0;
+        while (offset < numFrames) {
+            unsigned int count = std::min(numFrames - offset, mPartitionSize - mFifoPosition);
+            // Inputs first, so processing can be in place
+            for (unsigned int i = 0; i < mNumInputs; i++) {
+                memcpy(mInputFifo[i].data() + mFifoPosition, inputs[i] + offset, count * sizeof(float));
+            }
+            for (unsigned int o = 0; o < mNumOutputs; o++) {
+                memcpy(outputs[o] + offset, mOutputFifo[o].data() + mFifoPosition, count * sizeof(float));
+            }
+            offset += count;
+            mFifoPosition += count;
+            if (mFifoPosition == mPartitionSize) {
+                processPartition(mInputFifoPointers.data(), mOutputFifoPointers.data(), 0);
+                mFifoPosition = 0;
+            }
+        }
+        return;
+    }
+    unsigned int offset = 0;
+    for (; offset + mPartitionSize <= numFrames; offset += mPartitionSize) {
+        processPartition(inputs, outputs, offset);
+    }
+    for (unsigned int o = 0; o < mNumOutputs; o++) {
+        std::fill(outputs[o] + offset, outputs[o] + numFrames, 0.0f);
+    }
+}
+
+void PartitionedConvolver::processBlock(AudioIOData &io, bool buses) {
+    assert(mNumInputs <= (buses ? io.channelsBus() : io.channelsOut()));
+    assert(mNumOutputs <= io.channelsOut());
+    for (unsigned int i = 0; i < mNumInputs; i++) {
+        mInputPointers[i] = buses ? io.busBuffer(i) : io.outBuffer(i);
+    }
+    for (unsigned int o = 0; o < mNumOutputs; o++) {
+        mOutputPointers[o] = io.outBuffer(o);
+    }
+    process(mInputPointers.data(), mOutputPointers.data(), io.framesPerBuffer());
+}
+
+void PartitionedConvolver::update() {
+    if (mNext) {
+        return;
+    }
+    ImpulseResponses *pending = mHandoff.take();
+    if (pending) {
+        mNext = pending;
+        mCrossfadePosition = 0;
+        mCrossfading = true;
+    }
+}
+
+void PartitionedConvolver::processPartition(const float *const *inputs, float *const *outputs, unsigned int offset) {
+    // Spectra of the last two partitions of each input. All inputs are
+    // read before any output is written, so processing can be in place
+    unsigned int numBins = mPartitionSize + 1;
+    mCurrentSpectrum = (mCurrentSpectrum + 1) % mNumPartitions;
+    for (unsigned int i = 0; i < mNumInputs; i++) {
+        float *history = mInputHistory[i].data();
+        memmove(history, history + mPartitionSize, mPartitionSize * sizeof(float));
+        memcpy(history + mPartitionSize, inputs[i] + offset, mPartitionSize * sizeof(float));
+        for (unsigned int n = 0; n < 2 * mPartitionSize; n++) {
+            mScratch[n] = history[n];
+        }
+        fft(mScratch.data(), false);
+        std::copy(mScratch.begin(), mScratch.begin() + numBins,
+                  mInputSpectra[i].begin() + mCurrentSpectrum * numBins);
+    }
+
+    for (unsigned int o = 0; o < mNumOutputs; o++) {
+        if (mCurrent && o < mCurrent->spectra.size()) {
+            convolve(*mCurrent, o);
+        } else {
+            std::fill(mOutputBlock.begin(), mOutputBlock.end(), 0.0f);
+        }
+        float *out = outputs[o] + offset;
+        if (!mNext) {
+            memcpy(out, mOutputBlock.data(), mPartitionSize * sizeof(float));
+            continue;
+        }
+        mFadeBlock.swap(mOutputBlock);
+        if (o < mNext->spectra.size()) {
+            convolve(*mNext, o);
+        } else {
+            std::fill(mOutputBlock.begin(), mOutputBlock.end(), 0.0f);
+        }
+        unsigned int crossfadeFrames = mNext->crossfadeFrames;
+        for (unsigned int n = 0; n < mPartitionSize; n++) {
+            unsigned int position = mCrossfadePosition + n;
+            float gain = position < crossfadeFrames ? float(position) / crossfadeFrames : 1.0f;
+            out[n] = mFadeBlock[n] + gain * (mOutputBlock[n] - mFadeBlock[n]);
+        }
+    }
+
+    if (mNext) {
+        mCrossfadePosition += mPartitionSize;
+        if (mCrossfadePosition >= mNext->crossfadeFrames) {
+            if (mCurrent) {
+                mHandoff.retire(mCurrent);
+            }
+            mCurrent = mNext;
+            mNext = nullptr;
+            mCrossfading = false;
+        }
+    }
+}
+
+void PartitionedConvolver::convolve(const ImpulseResponses &irs, unsigned int output) {
+    unsigned int numBins = mPartitionSize + 1;
+    const std::vector<Complex> &inputSpectra = mInputSpectra[irs.inputs[output]];
+    const Complex *irSpectra = irs.spectra[output].data();
+    std::fill(mAccumulator.begin(), mAccumulator.end(), Complex(0.0f));
+    // Partition p of the IR is applied to the input from p partitions ago
+    for (unsigned int p = 0; p < irs.numPartitions; p++) {
+        unsigned int index = (mCurrentSpectrum + mNumPartitions - p) % mNumPartitions;
+        const Complex *x = inputSpectra.data() + index * numBins;
+        const Complex *h = irSpectra + p * numBins;
+        for (unsigned int k = 0; k < numBins; k++) {
+            mAccumulator[k] += x[k] * h[k];
+        }
+    }
+    // The spectrum of a real signal is conjugate symmetric
+    unsigned int fftSize = 2 * mPartitionSize;
+    for (unsigned int k = 0; k < numBins; k++) {
+        mScratch[k] = mAccumulator[k];
+    }
+    for (unsigned int k = 1; k < mPartitionSize; k++) {
+        mScratch[fftSize - k] = std::conj(mAccumulator[k]);
+    }
+    fft(mScratch.data(), true);
+    // Overlap-save: the first half wraps around and is discarded
+    for (unsigned int n = 0; n < mPartitionSize; n++) {
+        mOutputBlock[n] = mScratch[mPartitionSize + n].real() / fftSize;
+    }
+}
+
+void PartitionedConvolver::fft(Complex *data, bool inverse) const {
+    unsigned int fftSize = 2 * mPartitionSize;
+    for (unsigned int i = 0; i < fftSize; i++) {
+        if (i < mBitReverse[i]) {
+            std::swap(data[i], data[mBitReverse[i]]);
+        }
+    }
+    for (unsigned int length = 2; length <= fftSize; length <<= 1) {
+        unsigned int half = length / 2;
+        unsigned int step = fftSize / length;
+        for (unsigned int start = 0; start < fftSize; start += length) {
+            for (unsigned int j = 0; j < half; j++) {
+                Complex w = inverse ? std::conj(mTwiddles[j * step]) : mTwiddles[j * step];
+                Complex u = data[start + j];
+                Complex v = data[start + j + half] * w;
+                data[start + j] = u + v;
+                data[start + j + half] = u - v;
+            }
+        }
+    }
+}
@@ -1,5 +1,12 @@
 #include "al/core/sound/al_Spatializer.hpp"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define AL_SPATIALIZER_SSE
+#endif
+
 using namespace  al;
 
 Spatializer::Spatializer(const SpeakerLayout& sl)
@@ -9,3 +16,70 @@ Spatializer::Spatializer(const SpeakerLayout& sl)
         mSpeakers.push_back(sl.speakers()[i]);
     }
 }
+
+void Spatializer::applyGain(float *out, const float *in, float gain, int numFrames)
+{
+    if (gain == 0.0f) {
+        return;
+    }
+    int i = 0;
+#if defined(__AVX__)
+    const __m256 g = _mm256_set1_ps(gain);
+    for (; i + 8 <= numFrames; i += 8) {
+        __m256 o = _mm256_loadu_ps(out + i);
+        o = _mm256_add_ps(o, _mm256_mul_ps(_mm256_loadu_ps(in + i), g));
+        _mm256_storeu_ps(out + i, o);
+    }
+#elif defined(AL_SPATIALIZER_SSE)
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= numFrames; i += 4) {
+        __m128 o = _mm_loadu_ps(out + i);
+        o = _mm_add_ps(o, _mm_mul_ps(_mm_loadu_ps(in + i), g));
+        _mm_storeu_ps(out + i, o);
+    }
+#endif
+    for (; i < numFrames; i++) {
+        out[i] += in[i] * gain;
+    }
+}
+
+void Spatializer::applyGainRamp(float *out, const float *in,
+                                float startGain, float endGain, int numFrames)
+{
+    if (startGain == endGain || numFrames <= 0) {
+        applyGain(out, in, endGain, numFrames);
+        return;
+    }
+    const float step = (endGain - startGain) / numFrames;
+    // gain for frame i is startGain + step * (i + 1). The frame index is kept
+    // as an exact float counter to avoid accumulating rounding errors
+    int i = 0;
+#if defined(__AVX__)
+    const __m256 start = _mm256_set1_ps(startGain);
+    const __m256 inc = _mm256_set1_ps(step);
+    const __m256 eight = _mm256_set1_ps(8.0f);
+    __m256 index = _mm256_setr_ps(1, 2, 3, 4, 5, 6, 7, 8);
+    for (; i + 8 <= numFrames; i += 8) {
+        __m256 g = _mm256_add_ps(start, _mm256_mul_ps(index, inc));
+        __m256 o = _mm256_loadu_ps(out + i);
+        o = _mm256_add_ps(o, _mm256_mul_ps(_mm256_loadu_ps(in + i), g));
+        _mm256_storeu_ps(out + i, o);
+        index = _mm256_add_ps(index, eight);
+    }
+#elif defined(AL_SPATIALIZER_SSE)
+    const __m128 start = _mm_set1_ps(startGain);
+    const __m128 inc = _mm_set1_ps(step);
+    const __m128 four = _mm_set1_ps(4.0f);
+    __m128 index = _mm_setr_ps(1, 2, 3, 4);
+    for (; i + 4 <= numFrames; i += 4) {
+        __m128 g = _mm_add_ps(start, _mm_mul_ps(index, inc));
+        __m128 o = _mm_loadu_ps(out + i);
+        o = _mm_add_ps(o, _mm_mul_ps(_mm_loadu_ps(in + i), g));
+        _mm_storeu_ps(out + i, o);
+        index = _mm_add_ps(index, four);
+    }
+#endif
+    for (; i < numFrames; i++) {
+        out[i] += in[i] * (startGain + step * (i + 1));
+    }
+}
@@ -37,11 +37,8 @@ void al::StereoPanner::renderBuffer(al::AudioIOData &io, const al::Pose &listeni
     float gainL, gainR;
     equalPowerPan(vec, gainL, gainR);
 
-    for(int i = 0; i < numFrames; i++)
-    {
-      bufL[i] += gainL*samples[i];
-      bufR[i] += gainR*samples[i];
-    }
+    applyGain(bufL, samples, gainL, numFrames);
+    applyGain(bufR, samples, gainR, numFrames);
   }
   else // dont pan
   {
@@ -50,6 +47,26 @@ void al::StereoPanner::renderBuffer(al::AudioIOData &io, const al::Pose &listeni
   }
 }
 
+void al::StereoPanner::renderBufferRamp(al::AudioIOData &io, const al::Pose &previousPose, const al::Pose &listeningPose, const float *samples, const int &numFrames)
+{
+  if(numSpeakers == 2)
+  {
+    Vec3d previousVec = previousPose.quat().rotate(previousPose.vec());
+    Vec3d vec = listeningPose.quat().rotate(listeningPose.vec());
+
+    float previousL, previousR, gainL, gainR;
+    equalPowerPan(previousVec, previousL, previousR);
+    equalPowerPan(vec, gainL, gainR);
+
+    applyGainRamp(io.outBuffer(0), samples, previousL, gainL, numFrames);
+    applyGainRamp(io.outBuffer(1), samples, previousR, gainR, numFrames);
+  }
+  else
+  {
+    renderBuffer(io, listeningPose, samples, numFrames);
+  }
+}
+
 void al::StereoPanner::equalPowerPan(const al::Vec3d &relPos, float &gainL, float &gainR)
 {
   double panVal = 0.5;
@@ -1,6 +1,7 @@
 #include <utility> // move
 #include <vector>
 #include <list>
+#include <algorithm>
 
 #include "al/core/sound/al_Vbap.hpp"
 
@@ -397,96 +398,210 @@ void Vbap::makePhantomChannel(int channelIndex, std::vector<int> assignedOutputs
 //	this->mListener = &listener;
 //}
 
-void Vbap::renderBuffer(AudioIOData &io, const Pose &listeningPose, const float *samples, const int &numFrames)
+Vec3d Vbap::sourceVector(const Pose &listeningPose)
 {
-	// FIMXE AC use cached index
-//	unsigned currentTripletIndex = src.cachedIndex();
-	unsigned currentTripletIndex = 0;
-	// unsigned currentTripletIndex = mCachedTripletIndex; // Cached source placement, so it starts searching from there.
-
 	Vec3d vec = listeningPose.vec();
 
 	//Rotate vector according to listener-rotation
 	Quatd srcRot = listeningPose.quat();
 	vec = srcRot.rotate(vec);
-	vec = Vec4d(-vec.z, -vec.x, vec.y);
+	return Vec4d(-vec.z, -vec.x, vec.y);
+}
 
-	//Silent by default
-	Vec3d gains;
+bool Vbap::findTriplet(const Vec3d &vec, int &tripletIndex, Vec3d &gains)
+{
+	auto contains = [&](unsigned int index) {
+		gains = computeGains(vec, mTriplets[index]);
+		return (gains[0] >= 0) && (gains[1] >= 0) && (!mIs3D || (gains[2] >= 0));
+	};
+	// Sources usually stay within the same triplet, so try the hint first
+	if (tripletIndex >= 0 && tripletIndex < (int) mTriplets.size() && contains(tripletIndex)) {
+		gains.normalize();
+		return true;
+	}
+	int bin = mBinOffsets.empty() ? -1 : lookupBin(vec);
+	if (bin >= 0) {
+		// Only the triplets that can contain directions in this bin
+		for (unsigned int i = mBinOffsets[bin]; i < mBinOffsets[bin + 1]; i++) {
+			if (contains(mBinTriplets[i])) {
+				gains.normalize();
+				tripletIndex = mBinTriplets[i];
+				return true;
+			}
+		}
+		return false;
+	}
 
 	// Search thru the triplets array in search of a match for the source position.
-	for (unsigned count = 0; count < mTriplets.size(); ++count) {
-		gains = computeGains(vec, mTriplets[currentTripletIndex]);
-		if ((gains[0] >= 0) && (gains[1] >= 0) && (!mIs3D || (gains[2] >= 0)) ){
+	for (unsigned index = 0; index < mTriplets.size(); ++index) {
+		if (contains(index)) {
 			gains.normalize();
+			tripletIndex = index;
+			return true;
+		}
+	}
+	return false;
+}
 
-			SpeakerTriple triple = mTriplets[currentTripletIndex];
+int Vbap::lookupBin(const Vec3d &vec)
+{
+	double ax = fabs(vec.x), ay = fabs(vec.y), az = fabs(vec.z);
+	int face;
+	double u, v;
+	if (ax >= ay && ax >= az) {
+		if (ax == 0.0) {
+			return -1;
+		}
+		face = vec.x > 0 ? 0 : 1;
+		u = vec.y / ax;
+		v = vec.z / ax;
+	} else if (ay >= az) {
+		face = vec.y > 0 ? 2 : 3;
+		u = vec.x / ay;
+		v = vec.z / ay;
+	} else {
+		face = vec.z > 0 ? 4 : 5;
+		u = vec.x / az;
+		v = vec.y / az;
+	}
+	int iu = std::min(int((u + 1.0) * 0.5 * mLookupSize), mLookupSize - 1);
+	int iv = std::min(int((v + 1.0) * 0.5 * mLookupSize), mLookupSize - 1);
+	return (face * mLookupSize + iv) * mLookupSize + iu;
+}
 
-			float * outBuff1 = io.outBuffer(triple.s1Chan);
-			float * outBuff2 = io.outBuffer(triple.s2Chan);
-			float * outBuff3 = nullptr;
-			if(mIs3D){
-				outBuff3 = io.outBuffer(triple.s3Chan);
+void Vbap::buildLookup()
+{
+	// Direction for a point (u, v) on a face of the cube map
+	auto faceVector = [](int face, double u, double v) {
+		double sign = (face % 2 == 0) ? 1.0 : -1.0;
+		switch (face / 2) {
+		case 0: return Vec3d(sign, u, v).normalize();
+		case 1: return Vec3d(u, sign, v).normalize();
+		default: return Vec3d(u, v, sign).normalize();
+		}
+	};
+	unsigned dimensions = mIs3D ? 3 : 2;
+	// Gains are linear in the direction, so within distance d of the bin
+	// center a gain can only decrease by d times the norm of its matrix column
+	std::vector<Vec3d> columnNorms;
+	for (auto &triple : mTriplets) {
+		Vec3d norms(0, 0, 0);
+		for (unsigned i = 0; i < dimensions; i++) {
+			for (unsigned j = 0; j < dimensions; j++) {
+				norms[i] += triple.mat(j, i) * triple.mat(j, i);
 			}
+			norms[i] = sqrt(norms[i]);
+		}
+		columnNorms.push_back(norms);
+	}
 
-			// Check if any of the triplets are phantom channels and
-			// reassign signal
-			auto it1 = mPhantomChannels.find(triple.s1Chan);
-			auto it2 = mPhantomChannels.find(triple.s2Chan);
-			auto it3 = mPhantomChannels.find(triple.s3Chan);
-
-			for(int i = 0; i < numFrames; ++i){
-				float sample = samples[i];
-				if (it1 != mPhantomChannels.end()) { // vertex 1 is phantom
-					float splitGain = gains[0] /mPhantomChannels.size();
-					float splitGainSQ = splitGain * splitGain;
-					for(auto const &element : it1->second) { // iterate across all assigned speakers
-						io.out(element, i) += sample*splitGainSQ;
-					}
-				} else {
-					outBuff1[i] += sample*gains[0];
+	const int numBins = 6 * mLookupSize * mLookupSize;
+	const double binSize = 2.0 / mLookupSize;
+	mBinOffsets.resize(numBins + 1);
+	mBinTriplets.clear();
+	for (int face = 0; face < 6; face++) {
+		for (int iv = 0; iv < mLookupSize; iv++) {
+			for (int iu = 0; iu < mLookupSize; iu++) {
+				double u0 = -1.0 + iu * binSize;
+				double v0 = -1.0 + iv * binSize;
+				Vec3d center = faceVector(face, u0 + 0.5 * binSize, v0 + 0.5 * binSize);
+				double radius = 0.0; // Largest distance from center to a corner
+				for (int corner = 0; corner < 4; corner++) {
+					Vec3d cornerVec = faceVector(face, u0 + (corner & 1) * binSize,
+					                             v0 + (corner >> 1) * binSize);
+					radius = std::max(radius, (cornerVec - center).mag());
 				}
-				if (it2 != mPhantomChannels.end()) { // vertex 2 is phantom
-					float splitGain = gains[1] /mPhantomChannels.size();
-					float splitGainSQ = splitGain * splitGain;
-					for(auto const &element : it2->second) {
-						io.out(element, i) += sample*splitGainSQ;
-					}
-				} else {
-					outBuff2[i] += sample*gains[1];
-				}
-				if(mIs3D){
-					if (it3 != mPhantomChannels.end()) {
-						float splitGain = gains[2] /mPhantomChannels.size();
-						float splitGainSQ = splitGain * splitGain;
-						for(auto const &element : it3->second) {
-							io.out(element, i) += sample*splitGainSQ;
+				radius = radius * 1.0001 + 1e-9;
+
+				int bin = (face * mLookupSize + iv) * mLookupSize + iu;
+				mBinOffsets[bin] = (unsigned int) mBinTriplets.size();
+				for (unsigned int t = 0; t < mTriplets.size(); t++) {
+					Vec3d gains = computeGains(center, mTriplets[t]);
+					bool candidate = true;
+					for (unsigned i = 0; i < dimensions; i++) {
+						if (gains[i] + columnNorms[t][i] * radius < 0) {
+							candidate = false;
+							break;
 						}
-					} else {
-						outBuff3[i] += sample*gains[2];
+					}
+					if (candidate) {
+						mBinTriplets.push_back(t);
 					}
 				}
+			}
+		}
+	}
+	mBinOffsets[numBins] = (unsigned int) mBinTriplets.size();
+}
 
+void Vbap::renderTriplet(AudioIOData &io, int tripletIndex,
+                         const Vec3d &startGains, const Vec3d &endGains,
+                         const float *samples, int numFrames)
+{
+	const SpeakerTriple &triple = mTriplets[tripletIndex];
+	const unsigned int chans[3] = {triple.s1Chan, triple.s2Chan, triple.s3Chan};
+	for (int v = 0; v < (mIs3D ? 3 : 2); v++) {
+		// Check if the vertex is a phantom channel and reassign signal
+		auto it = mPhantomChannels.find(chans[v]);
+		if (it == mPhantomChannels.end()) {
+			applyGainRamp(io.outBuffer(chans[v]), samples, startGains[v], endGains[v], numFrames);
+		} else {
+			float splitStart = startGains[v] / mPhantomChannels.size();
+			float splitEnd = endGains[v] / mPhantomChannels.size();
+			for(auto const &element : it->second) { // iterate across all assigned speakers
+				applyGainRamp(io.outBuffer(element), samples,
+				              splitStart * splitStart, splitEnd * splitEnd, numFrames);
 			}
-			break;
 		}
+	}
+}
+
+void Vbap::renderBuffer(AudioIOData &io, const Pose &listeningPose, const float *samples, const int &numFrames)
+{
+	int tripletIndex = -1;
+	Vec3d gains; //Silent by default
+	if (findTriplet(sourceVector(listeningPose), tripletIndex, gains)) {
+		renderTriplet(io, tripletIndex, gains, gains, samples, numFrames);
+	}
+}
+
+void Vbap::renderBufferRamp(AudioIOData &io, const Pose &previousPose, const Pose &listeningPose, const float *samples, const int &numFrames)
+{
+	renderBufferGain(io, previousPose, 1.0f, listeningPose, 1.0f, samples, numFrames);
+}
 
-		++currentTripletIndex;
-		if (currentTripletIndex >= mTriplets.size()){
-			currentTripletIndex = 0;
+void Vbap::renderBufferGain(AudioIOData &io, const Pose &previousPose, float previousGain,
+                            const Pose &listeningPose, float gain,
+                            const float *samples, int numFrames)
+{
+	int previousIndex = -1;
+	Vec3d previousGains, gains;
+	Vec3d previousVec = sourceVector(previousPose);
+	Vec3d vec = sourceVector(listeningPose);
+	bool previousFound = findTriplet(previousVec, previousIndex, previousGains);
+	int index = previousIndex; // Start the search from the previous triplet
+	bool found = previousFound;
+	if (previousVec == vec) { // Source is not moving
+		gains = previousGains;
+	} else {
+		found = findTriplet(vec, index, gains);
+	}
+	if (previousFound && found && previousIndex == index) {
+		renderTriplet(io, index, previousGains * previousGain, gains * gain, samples, numFrames);
+	} else {
+		// Source moved to a different triplet, fade out the old triplet and
+		// fade in the new one. The sum is still a linear ramp per speaker
+		if (previousFound) {
+			renderTriplet(io, previousIndex, previousGains * previousGain, Vec3d(0, 0, 0), samples, numFrames);
+		}
+		if (found) {
+			renderTriplet(io, index, Vec3d(0, 0, 0), gains * gain, samples, numFrames);
 		}
 	}
-	// FIXME AC store cached index
-//	src.cachedIndex(currentTripletIndex);
-	//mCachedTripletIndex = currentTripletIndex; // Store the new index
 }
 
 void Vbap::renderSample(AudioIOData &io, const Pose &listeningPose, const float &sample, const int &frameIndex)
 {
-	// FIXME AC use cached index
-//	unsigned currentTripletIndex = src.cachedIndex();
-	//unsigned currentTripletIndex = mCachedTripletIndex; // Cached source placement, so it starts searching from there.
-	unsigned currentTripletIndex = 0;
 	Vec3d vec = listeningPose.vec();
 
 	//Rotate vector according to listener-rotation
@@ -497,27 +612,12 @@ void Vbap::renderSample(AudioIOData &io, const Pose &listeningPose, const float
 	vec = Vec4d(vec.x, vec.z, vec.y);
 	//Silent by default
 	Vec3d gains;
-//	Vec3d gainsTemp;
-
-	// Search thru the triplets array in search of a match for the source position.
-	for (unsigned count = 0; count < mTriplets.size(); ++count) {
-		gains = computeGains(vec, mTriplets[currentTripletIndex]);
-		if ((gains[0] >= 0) && (gains[1] >= 0) && (!mIs3D || (gains[2] >= 0)) ){
-			gains.normalize();
-			break;
-		}
-
-		++currentTripletIndex;
-		if (currentTripletIndex >= mTriplets.size()){
-			currentTripletIndex = 0;
-		}
+	int tripletIndex = -1;
+	if (!findTriplet(vec, tripletIndex, gains)) {
+		return;
 	}
 
-	SpeakerTriple triple = mTriplets[currentTripletIndex];
-
-	//mCachedTripletIndex = currentTripletIndex; // Store the new index
-	// FIXME stored cached index
-//	src.cachedIndex(currentTripletIndex);
+	const SpeakerTriple &triple = mTriplets[tripletIndex];
 
 	// Check if any of the triplets are phantom channels and
 	// reassign signal
@@ -574,6 +674,9 @@ void Vbap::makeTriple(int s1, int s2, int s3)
 	triple.s3 = s3;
 	triple.loadVectors(mSpeakers);
 	addTriple(triple);
+	if (!mBinOffsets.empty()) { // Already compiled
+		buildLookup();
+	}
 }
 
 void Vbap::compile() {
@@ -591,6 +694,7 @@ void Vbap::compile() {
 		printf("No SpeakerSets found. Check mode setting or speaker layout.\n");
 		throw -1;
 	}
+	buildLookup();
 }
 
 std::vector<SpeakerTriple> Vbap::triplets() const
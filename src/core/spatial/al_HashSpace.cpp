@@ -1,8 +1,79 @@
 #include "al/core/spatial/al_HashSpace.hpp"
 #include "al/core/math/al_Functions.hpp"
 
+#include <cmath>
+#include <condition_variable>
+#include <thread>
+
 using namespace al;
 
+// Threads kept between calls to moveAll() and queryKNN(). The thread
+// calling run() is worker 0.
+struct HashSpace::Workers {
+  explicit Workers(unsigned numWorkers) {
+    for (unsigned w = 1; w < numWorkers; w++) {
+      threads.emplace_back([this, w]() { loop(w); });
+    }
+  }
+
+  ~Workers() {
+    {
+      std::unique_lock<std::mutex> lk(lock);
+      quit = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  unsigned size() const { return threads.size() + 1; }
+
+  // Run func(worker) on the first numWorkers workers and wait for them
+  void run(unsigned numWorkers, const std::function<void(unsigned)>& func) {
+    {
+      std::unique_lock<std::mutex> lk(lock);
+      job = &func;
+      jobWorkers = numWorkers;
+      busy = numWorkers - 1;
+      generation++;
+    }
+    wake.notify_all();
+    func(0);
+    std::unique_lock<std::mutex> lk(lock);
+    done.wait(lk, [this]() { return busy == 0; });
+  }
+
+  void loop(unsigned worker) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lk(lock);
+    while (true) {
+      wake.wait(lk, [&]() { return quit || generation != seen; });
+      if (quit) {
+        return;
+      }
+      seen = generation;
+      if (worker < jobWorkers) {
+        lk.unlock();
+        (*job)(worker);
+        lk.lock();
+        if (--busy == 0) {
+          done.notify_one();
+        }
+      }
+    }
+  }
+
+  std::vector<std::thread> threads;
+  std::mutex lock;
+  std::condition_variable wake, done;
+  const std::function<void(unsigned)>* job {nullptr};
+  unsigned jobWorkers {0};
+  unsigned busy {0};
+  uint64_t generation {0};
+  bool quit {false};
+};
+
 // resolution can be 1 to 10; the dim is 2^resolution i.e. 2..1024
 // (the limit is 10 so that the hash can fit inside a uint32_t integer)
 // default 5 implies 32 units per side
@@ -39,7 +110,9 @@ HashSpace :: HashSpace(uint32_t resolution, uint32_t numObjects)
   // so e.g. a query can simply walk the lists...
   // it must handle +/- mDimHalf for a toroidal space
   std::vector<std::vector<uint32_t> > shells;
+  std::vector<std::vector<Vec<3,int16_t>> > shellOffsets;
   shells.resize(mMaxHalfD2+1);
+  shellOffsets.resize(mMaxHalfD2+1);
   mDistanceToVoxelIndices.resize(mMaxHalfD2+1);
   for(int x=-mDimHalf; x < mDimHalf; x++) {
     for(int y=-mDimHalf; y < mDimHalf; y++) {
@@ -56,6 +129,7 @@ HashSpace :: HashSpace(uint32_t resolution, uint32_t numObjects)
           uint32_t h = hash(x, y, z);
           //uint32_t h = hash(x-0.5, y-0.5, z-0.5);
           shells[d].push_back(h);
+          shellOffsets[d].push_back(Vec<3,int16_t>(x, y, z));
         } else {
           //printf("out of range"); Vec3i(x, y, z).print();
         }
@@ -73,14 +147,33 @@ HashSpace :: HashSpace(uint32_t resolution, uint32_t numObjects)
       mVoxelIndicesToDistance[mVoxelIndices.size()] = d;
       for (unsigned j=0; j<shell.size(); j++) {
         mVoxelIndices.push_back(shell[j]);
+        mVoxelOffsets.push_back(shellOffsets[d][j]);
       }
     } else {
-      mDistanceToVoxelIndices[d] = d ? mDistanceToVoxelIndices[d-1] : 0;
+      // empty shell, starts and ends where the next one starts
+      mDistanceToVoxelIndices[d] = mVoxelIndices.size();
     }
   }
   // store last shell:
   mDistanceToVoxelIndices[mMaxHalfD2] = mVoxelIndices.size();
 
+  // points in voxels at offset (x, y, z) are at least (|x|-1, |y|-1, |z|-1)
+  // apart. Used by nearestNeighbors() to stop searching.
+  mShellGap2.assign(mMaxHalfD2 + 1, mMaxHalfD2);
+  for (unsigned i=0; i<mVoxelIndices.size(); i++) {
+    const Vec<3,int16_t>& o = mVoxelOffsets[i];
+    uint32_t d = o.x*o.x + o.y*o.y + o.z*o.z;
+    uint32_t gap2 = 0;
+    for (int axis=0; axis<3; axis++) {
+      int gap = std::max(std::abs(int(o[axis])) - 1, 0);
+      gap2 += gap*gap;
+    }
+    mShellGap2[d] = std::min(mShellGap2[d], gap2);
+  }
+  for (int d=int(mMaxHalfD2)-1; d>=0; d--) {
+    mShellGap2[d] = std::min(mShellGap2[d], mShellGap2[d+1]);
+  }
+
 //  // dump the lists:
 //  uint32_t offset = hash(0, 1, 0);
 //  printf("offset %d\n", offset);
@@ -99,3 +192,194 @@ HashSpace :: HashSpace(uint32_t resolution, uint32_t numObjects)
 
 HashSpace :: ~HashSpace() {}
 
+unsigned HashSpace :: numRanges(uint32_t n, unsigned numThreads) const {
+  if (numThreads == 0) {
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return std::max(1u, std::min(numThreads, n / 256 + 1));
+}
+
+void HashSpace :: parallelRanges(uint32_t n, unsigned ranges,
+                                 const std::function<void(unsigned, uint32_t, uint32_t)>& func) const {
+  auto runRange = [&](unsigned r) {
+    func(r, uint32_t(uint64_t(n) * r / ranges), uint32_t(uint64_t(n) * (r + 1) / ranges));
+  };
+  if (ranges == 1) {
+    runRange(0);
+    return;
+  }
+  std::unique_lock<std::mutex> lk(mWorkersLock);
+  if (!mWorkers || mWorkers->size() < ranges) {
+    mWorkers.reset();
+    mWorkers.reset(new Workers(ranges));
+  }
+  mWorkers->run(ranges, runRange);
+}
+
+
+HashSpace& HashSpace :: moveAll(const Vec3d * positions, unsigned numThreads) {
+  const uint32_t n = mObjects.size();
+  const uint32_t numVoxels = mVoxels.size();
+  const unsigned ranges = numRanges(n, numThreads);
+  if (ranges == 1) {
+    for (uint32_t v = 0; v < numVoxels; v++) {
+      mVoxels[v].mObjects = NULL;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      mObjects[i].pos.set(wrap(positions[i]));
+      mObjects[i].hash = hash(mObjects[i].pos);
+      mVoxels[mObjects[i].hash].add(&mObjects[i]);
+    }
+    return *this;
+  }
+  // Range r of the objects counts its objects per range of voxels, then
+  // writes their indices into its part of each voxel range's bucket. The
+  // voxel ranges are then rebuilt from their buckets, so no two threads
+  // touch the same list and each object is visited once per pass.
+  std::vector<uint32_t> hashes(n);
+  std::vector<uint32_t> counts(size_t(ranges) * ranges, 0);
+  // Voxel range v is [voxelBegin(v), voxelBegin(v + 1))
+  auto voxelRange = [&](uint32_t hash) {
+    return unsigned(uint64_t(hash) * ranges / numVoxels);
+  };
+  auto voxelBegin = [&](unsigned v) {
+    return uint32_t((uint64_t(numVoxels) * v + ranges - 1) / ranges);
+  };
+  parallelRanges(n, ranges, [&](unsigned r, uint32_t begin, uint32_t end) {
+    uint32_t * rangeCounts = counts.data() + size_t(r) * ranges;
+    for (uint32_t i = begin; i < end; i++) {
+      mObjects[i].pos.set(wrap(positions[i]));
+      hashes[i] = hash(mObjects[i].pos);
+      rangeCounts[voxelRange(hashes[i])]++;
+    }
+  });
+  // Buckets are ordered by voxel range, then by object range, so each
+  // voxel gets its objects in index order
+  std::vector<uint32_t> offsets(counts.size());
+  uint32_t offset = 0;
+  for (unsigned v = 0; v < ranges; v++) {
+    for (unsigned r = 0; r < ranges; r++) {
+      offsets[size_t(r) * ranges + v] = offset;
+      offset += counts[size_t(r) * ranges + v];
+    }
+  }
+  std::vector<uint32_t> buckets(n);
+  parallelRanges(n, ranges, [&](unsigned r, uint32_t begin, uint32_t end) {
+    uint32_t * rangeOffsets = offsets.data() + size_t(r) * ranges;
+    for (uint32_t i = begin; i < end; i++) {
+      buckets[rangeOffsets[voxelRange(hashes[i])]++] = i;
+    }
+  });
+  parallelRanges(ranges, ranges, [&](unsigned v, uint32_t, uint32_t) {
+    for (uint32_t h = voxelBegin(v); h < voxelBegin(v + 1); h++) {
+      mVoxels[h].mObjects = NULL;
+    }
+    // After the scatter, the offsets of object range r end where those of
+    // range r + 1 start
+    uint32_t bucketBegin = v == 0 ? 0 : offsets[size_t(ranges - 1) * ranges + v - 1];
+    uint32_t bucketEnd = offsets[size_t(ranges - 1) * ranges + v];
+    for (uint32_t b = bucketBegin; b < bucketEnd; b++) {
+      uint32_t i = buckets[b];
+      mObjects[i].hash = hashes[i];
+      mVoxels[hashes[i]].add(&mObjects[i]);
+    }
+  });
+  return *this;
+}
+
+uint32_t HashSpace :: nearestNeighbors(const Vec3d& center, const Object * exclude,
+                                       uint32_t k, double maxRadius,
+                                       uint32_t * objects, double * distancesSquared) const {
+  if (k == 0) return 0;
+  maxRadius = std::min(maxRadius, double(mDimHalf));
+  const double maxr2 = maxRadius * maxRadius;
+  const Object * first = mObjects.data();
+  const double dim = mDim, half = mDimHalf;
+  const int cell[3] = {int(center.x), int(center.y), int(center.z)};
+  uint32_t count = 0;
+  // shells are visited nearest first, stop when no further shell can have
+  // anything within maxRadius or nearer than the k-th result
+  for (uint32_t d = 0; d < mMaxHalfD2 && mShellGap2[d] <= maxr2; d++) {
+    uint32_t cellstart = mDistanceToVoxelIndices[d];
+    uint32_t cellend = mDistanceToVoxelIndices[d + 1];
+    if (cellstart == cellend) continue;
+    if (count == k && mShellGap2[d] >= distancesSquared[k - 1]) break;
+    for (uint32_t i = cellstart; i < cellend; i++) {
+      const Vec<3,int16_t>& offset = mVoxelOffsets[i];
+      const Object * head = mVoxels[hash(cell[0] + offset[0], cell[1] + offset[1],
+                                         cell[2] + offset[2])].mObjects;
+      if (!head) continue;
+      const Object * o = head;
+      do {
+        if (o != exclude) {
+          // both positions are wrapped, so one correction per axis is enough
+          double d2 = 0.;
+          for (int axis = 0; axis < 3; axis++) {
+            double rel = o->pos[axis] - center[axis];
+            if (rel > half) rel -= dim;
+            else if (rel < -half) rel += dim;
+            d2 += rel * rel;
+          }
+          if (d2 <= maxr2 && (count < k || d2 < distancesSquared[k - 1])) {
+            // insertion sort into the k results
+            uint32_t j = count < k ? count++ : k - 1;
+            for (; j > 0 && distancesSquared[j - 1] > d2; j--) {
+              distancesSquared[j] = distancesSquared[j - 1];
+              objects[j] = objects[j - 1];
+            }
+            distancesSquared[j] = d2;
+            objects[j] = uint32_t(o - first);
+          }
+        }
+        o = o->next;
+      } while (o != head);
+    }
+  }
+  return count;
+}
+
+static void resizeResults(HashSpace::KNNResults& results, uint32_t numQueries, uint32_t k) {
+  results.k = k;
+  results.counts.resize(numQueries);
+  results.objects.resize(size_t(numQueries) * k);
+  results.distancesSquared.resize(size_t(numQueries) * k);
+}
+
+void HashSpace :: queryKNN(const Vec3d * centers, uint32_t numQueries, uint32_t k,
+                           double maxRadius, KNNResults& results, unsigned numThreads) const {
+  resizeResults(results, numQueries, k);
+  parallelRanges(numQueries, numRanges(numQueries, numThreads),
+                 [&](unsigned, uint32_t begin, uint32_t end) {
+    for (uint32_t q = begin; q < end; q++) {
+      size_t offset = size_t(q) * k;
+      results.counts[q] = nearestNeighbors(wrap(centers[q]), NULL, k, maxRadius,
+                                           results.objects.data() + offset,
+                                           results.distancesSquared.data() + offset);
+    }
+  });
+}
+
+void HashSpace :: queryKNN(uint32_t k, double maxRadius, KNNResults& results,
+                           unsigned numThreads) const {
+  const uint32_t n = mObjects.size();
+  resizeResults(results, n, k);
+  std::fill(results.counts.begin(), results.counts.end(), 0);
+  // Walk the objects voxel by voxel rather than by index, so that consecutive
+  // queries visit the same neighbouring voxels while they are in cache.
+  parallelRanges(mVoxels.size(), numRanges(n, numThreads),
+                 [&](unsigned, uint32_t begin, uint32_t end) {
+    for (uint32_t v = begin; v < end; v++) {
+      const Object * head = mVoxels[v].mObjects;
+      if (!head) continue;
+      const Object * o = head;
+      do {
+        uint32_t i = uint32_t(o - mObjects.data());
+        size_t offset = size_t(i) * k;
+        results.counts[i] = nearestNeighbors(o->pos, o, k, maxRadius,
+                                             results.objects.data() + offset,
+                                             results.distancesSquared.data() + offset);
+        o = o->next;
+      } while (o != head);
+    }
+  });
+}
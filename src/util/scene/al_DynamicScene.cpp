@@ -1,6 +1,8 @@
 #include "al/util/scene/al_DynamicScene.hpp"
 #include "al/core/graphics/al_Shapes.hpp"
 
+#include <chrono>
+
 using namespace std;
 using namespace al;
 
@@ -68,6 +70,110 @@ void ThreadPool::stopThreads()
 
 // ------------------------------------------------
 
+ForkJoinPool::ForkJoinPool(unsigned int numWorkers)
+    : mRanges(new TaskRange[numWorkers + 1]),
+      mNumThreads(numWorkers + 1)
+{
+    for (unsigned int i = 0; i < numWorkers; ++i) {
+        mWorkers.emplace_back(std::bind(&ForkJoinPool::workerLoop, this, i + 1));
+    }
+}
+
+ForkJoinPool::~ForkJoinPool()
+{
+    stopThreads();
+}
+
+void ForkJoinPool::stopThreads()
+{
+    if (!mRunning.exchange(false)) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lk(mSleepLock);
+        mWakeUp.notify_all();
+    }
+    for (auto &t : mWorkers) {
+        t.join();
+    }
+    mWorkers.clear();
+}
+
+void ForkJoinPool::runTasks(unsigned int numTasks)
+{
+    // Give each thread a contiguous range of tasks
+    unsigned int start = 0;
+    for (unsigned int i = 0; i < mNumThreads; i++) {
+        unsigned int count = numTasks / mNumThreads + (i < numTasks % mNumThreads ? 1 : 0);
+        mRanges[i].next.store(start, std::memory_order_relaxed);
+        mRanges[i].end = start + count;
+        start += count;
+    }
+    mBusyWorkers.store((unsigned int) mWorkers.size(), std::memory_order_relaxed);
+    mGeneration.fetch_add(1); // Publishes task and ranges to the workers
+    if (mSleepingWorkers.load() > 0) {
+        std::unique_lock<std::mutex> lk(mSleepLock);
+        mWakeUp.notify_all();
+    }
+    processTasks(0);
+    // Join. Workers only report done once they find no task left to steal
+    unsigned int spins = 0;
+    while (mBusyWorkers.load(std::memory_order_acquire) != 0) {
+        if (++spins > 64) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ForkJoinPool::processTasks(unsigned int threadIndex)
+{
+    // Own range first, then steal from the other threads' ranges
+    for (unsigned int i = 0; i < mNumThreads; i++) {
+        TaskRange &range = mRanges[(threadIndex + i) % mNumThreads];
+        unsigned int task;
+        while ((task = range.next.fetch_add(1, std::memory_order_relaxed)) < range.end) {
+            mTaskFunction(mTask, task, threadIndex);
+        }
+    }
+}
+
+void ForkJoinPool::workerLoop(unsigned int threadIndex)
+{
+    using namespace std::chrono;
+    unsigned int seen = 0;
+    while (true) {
+        unsigned int generation;
+        unsigned int spins = 0;
+        auto idleStart = steady_clock::now();
+        while ((generation = mGeneration.load(std::memory_order_acquire)) == seen) {
+            if (!mRunning.load(std::memory_order_relaxed)) {
+                return;
+            }
+            if (++spins < 64) {
+                continue;
+            }
+            spins = 0;
+            if (duration<double>(steady_clock::now() - idleStart).count() > mSpinTimeSec) {
+                // Idle for a while, block until next run()
+                mSleepingWorkers++;
+                {
+                    std::unique_lock<std::mutex> lk(mSleepLock);
+                    mWakeUp.wait(lk, [&]() { return mGeneration.load() != seen || !mRunning.load(); });
+                }
+                mSleepingWorkers--;
+                idleStart = steady_clock::now();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        seen = generation;
+        processTasks(threadIndex);
+        mBusyWorkers.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+// ------------------------------------------------
+
 DynamicScene::DynamicScene (int threadPoolSize, TimeMasterMode masterMode)
     : PolySynth(masterMode)
 {
@@ -75,11 +181,7 @@ DynamicScene::DynamicScene (int threadPoolSize, TimeMasterMode masterMode)
     setSpatializer<StereoPanner>(sl);
     if (threadPoolSize > 0) {
         mWorkerThreads = std::make_unique<ThreadPool>(threadPoolSize);
-    }
-    for (int i = 0; i < threadPoolSize; i++) {
-        mAudioThreads.push_back(std::thread(DynamicScene::audioThreadFunc,this, i));
-        mThreadMap[i] = std::vector<int>();
-        mThreadMap[i].reserve(16);
+        mAudioWorkers = std::make_unique<ForkJoinPool>(threadPoolSize);
     }
 
     addSphere(mWorldMarker);
@@ -115,13 +217,23 @@ void DynamicScene::prepare(AudioIOData &io) {
     if ((int) io.channelsBus() < mVoiceBusChannels) {
         std::cout << "WARNING: You don't have enough buses in AudioIO object. This is likely to crash." << std::endl;
     }
-    mThreadedAudioData.resize(mAudioThreads.size());
+    unsigned int numThreads = mAudioWorkers ? mAudioWorkers->size() : 0;
+    mThreadedAudioData.resize(numThreads);
     for (auto &threadio: mThreadedAudioData) {
         threadio.framesPerBuffer(io.framesPerBuffer());
         threadio.channelsIn(mVoiceMaxInputChannels);
         threadio.channelsOut(mVoiceMaxOutputChannels);
         threadio.channelsBus(mVoiceBusChannels);
     }
+    mChunkAudioData.resize(numThreads * mChunksPerThread);
+    for (auto &chunkio: mChunkAudioData) {
+        chunkio.framesPerBuffer(io.framesPerBuffer());
+        chunkio.channelsIn(0);
+        chunkio.channelsOut(io.channelsOut());
+        chunkio.channelsBus(io.channelsBus());
+    }
+    // Active voices beyond this capacity are rendered serially in render()
+    mVoicesToRender.reserve(std::max<size_t>(1024, mAllocatedVoices.load()));
     m_internalAudioConfigured = true;
 }
 
@@ -166,7 +278,9 @@ void DynamicScene::render(AudioIOData &io) {
     }
     assert(mSpatializer && "ERROR: call setSpatializer before starting audio");
     io.frame(0);
+    mSpatializerRotates = mSpatializer->listenerOrientation(mListenerPose.quat());
     mSpatializer->prepare(io);
+    mRenderBlock++;
     if (mMasterMode == TIME_MASTER_AUDIO) {
         processVoices();
         // Turn off voices
@@ -175,97 +289,68 @@ void DynamicScene::render(AudioIOData &io) {
     io.zeroBus();
 
     auto *voice = mActiveVoices;
-    int fpb = internalAudioIO.framesPerBuffer();
-    if (mAudioThreads.size() == 0 || !mThreadedAudio) { // Not using worker threads
+    if (!mAudioWorkers || !mThreadedAudio) { // Not using worker threads
         // Render active voices
         while (voice) {
             if (voice->active()) {
-                int offset = voice->getStartOffsetFrames(fpb);
-                if (offset < fpb) {
-                    // io.frame(offset);
-                    int endOffsetFrames = voice->getEndOffsetFrames(fpb);
-                    if (endOffsetFrames > 0 && endOffsetFrames <= fpb) {
-                        voice->triggerOff(endOffsetFrames);
-                    }
-                    internalAudioIO.zeroOut();
-                    internalAudioIO.zeroBus();
-                    internalAudioIO.frame(offset);
-                    voice->onProcess(internalAudioIO);
-                    Vec3d listeningDir;
-                    vector<Vec3f> posOffsets;
-                    if (dynamic_cast<PositionedVoice *>(voice)) {
-                        PositionedVoice *posVoice = static_cast<PositionedVoice *>(voice);
-                        Vec3d direction = posVoice->pose().vec() - mListenerPose.vec();
-
-                        //Rotate vector according to listener-rotation
-                        Quatd srcRot = mListenerPose.quat();
-                        listeningDir = srcRot.rotate(direction);
-                        posOffsets = posVoice->audioOutOffsets();
-                        assert(posOffsets.size() == 0 || posOffsets.size() == posVoice->numOutChannels());
-                        if (posVoice->useDistanceAttenuation()) {
-                            float distance = listeningDir.mag();
-                            float atten = mDistAtten.attenuation(distance);
-                            internalAudioIO.frame(0);
-                            float *buf = internalAudioIO.outBuffer(0);
-
-                            while (internalAudioIO()) {
-                                *buf = *buf * atten;
-                                buf++;
-                            }
-                        }
-                    } else {
-                        listeningDir = mListenerPose;
-                    }
-                    if (mBusRoutingCallback) {
-                        // First call callback to route signals to internal buses
-                        internalAudioIO.frame(offset);
-                        Pose listeningPose = listeningDir;
-                        (*mBusRoutingCallback)(internalAudioIO, listeningPose);
-                        io.frame(offset);
-                        internalAudioIO.frame(offset);
-                        // Then gather all the internal buses into the master AudioIO buses
-                        while (io() && internalAudioIO()) {
-                            for (int i = 0; i < mVoiceBusChannels; i++) {
-                                io.bus(i) += internalAudioIO.bus(i);
-                            }
-                        }
-                    }
-                    for (unsigned int i = 0; i < voice->numOutChannels(); i++) {
-                        io.frame(offset);
-                        internalAudioIO.frame(offset);
-                        Pose offsetPose = listeningDir;
-                        if (posOffsets.size() > 0) {
-                            // Is there need to rotate the position according to the quat()?
-                            // It would only really be useful if the source has a direction dependent
-                            // dispersion model...
-                            offsetPose.vec() += posOffsets[i];
-                        }
-                        mSpatializer->renderBuffer(io, offsetPose, internalAudioIO.outBuffer(i), fpb);
-
-                    }
-                }
+                renderVoice(voice, internalAudioIO, io, false);
             }
             voice = voice->next;
         }
     } else { // Process Audio Threaded
-        mAudioBusy = 0;
-        for (auto& tmap: mThreadMap) {
-            tmap.second.resize(0);
+        // Never grow the vector here: voices past its capacity are left in
+        // the list and rendered after the threaded ones
+        mVoicesToRender.clear();
+        while (voice && mVoicesToRender.size() < mVoicesToRender.capacity()) {
+            if (voice->active()) {
+                mVoicesToRender.push_back(voice);
+            }
+            voice = voice->next;
+        }
+        unsigned int numVoices = (unsigned int) mVoicesToRender.size();
+        if (numVoices > 0) {
+            // Split voices in contiguous chunks. Threads steal whole chunks from
+            // each other, and each chunk has its own output buffers.
+            unsigned int numChunks = std::min(numVoices, (unsigned int) mChunkAudioData.size());
+            unsigned int voicesPerChunk = (numVoices + numChunks - 1) / numChunks;
+            numChunks = (numVoices + voicesPerChunk - 1) / voicesPerChunk;
+            auto renderChunk = [&](unsigned int chunk, unsigned int thread) {
+                AudioIOData &chunkIO = mChunkAudioData[chunk];
+                chunkIO.zeroOut();
+                chunkIO.zeroBus();
+                unsigned int end = std::min((chunk + 1) * voicesPerChunk, numVoices);
+                for (unsigned int i = chunk * voicesPerChunk; i < end; i++) {
+                    renderVoice(mVoicesToRender[i], mThreadedAudioData[thread], chunkIO, true);
+                }
+            };
+            mAudioWorkers->run(numChunks, renderChunk);
+
+            // Add chunk outputs in a fixed order so the result is deterministic
+            unsigned int fpb = io.framesPerBuffer();
+            for (unsigned int chunk = 0; chunk < numChunks; chunk++) {
+                AudioIOData &chunkIO = mChunkAudioData[chunk];
+                for (unsigned int chan = 0; chan < chunkIO.channelsOut(); chan++) {
+                    float *out = io.outBuffer(chan);
+                    const float *in = chunkIO.outBuffer(chan);
+                    for (unsigned int i = 0; i < fpb; i++) {
+                        out[i] += in[i];
+                    }
+                }
+                for (unsigned int chan = 0; chan < chunkIO.channelsBus(); chan++) {
+                    float *out = io.busBuffer(chan);
+                    const float *in = chunkIO.busBuffer(chan);
+                    for (unsigned int i = 0; i < fpb; i++) {
+                        out[i] += in[i];
+                    }
+                }
+            }
         }
-        unsigned int counter = 0;
         while (voice) {
             if (voice->active()) {
-                mThreadMap[counter++].push_back(voice->id());
-                if (counter > mThreadMap.size()) {
-                    counter = 0;
-                }
+                renderVoice(voice, internalAudioIO, io, false);
             }
             voice = voice->next;
         }
-        externalAudioIO = &io;
-        mThreadTrigger.notify_all();
-        std::unique_lock<std::mutex> lk(mThreadTriggerLock);
-        mAudioThreadDone.wait(lk, [this](){ return mAudioBusy == 0; });
     }
     mSpatializer->finalize(io);
     processGain(io);
@@ -343,89 +428,101 @@ void DynamicScene::updateThreadFunc(UpdateThreadFuncData data) {
     voice->update(dt);
 }
 
-void DynamicScene::audioThreadFunc(DynamicScene *scene, int id) {
-    while (scene->mSynthRunning) {
-        std::unique_lock<std::mutex> lk(scene->mThreadTriggerLock);
-        scene->mThreadTrigger.wait(lk);
-        scene->mAudioBusy++;
-
-        vector<int> &idsToProcess = scene->mThreadMap[id];
-        AudioIOData &internalAudioIO = scene->mThreadedAudioData[id];
-        AudioIOData &io = *scene->externalAudioIO;
-        unsigned int fpb = internalAudioIO.framesPerBuffer();
-        SynthVoice *voice = scene->mActiveVoices;
-        while (voice) {
-            //                if (voice->active()) { // No need to check as only active voices are put in mThreadMap
-            if (find(idsToProcess.begin(), idsToProcess.end(), voice->id()) != idsToProcess.end()) { // voice has been assigned to this thread
-                int offset = voice->getStartOffsetFrames(fpb);
-                if (offset < fpb) {
-                    io.frame(offset);
-                    int endOffsetFrames = voice->getEndOffsetFrames(fpb);
-                    if (endOffsetFrames > 0 && endOffsetFrames <= fpb) {
-                        voice->triggerOff(endOffsetFrames);
-                    }
-                    internalAudioIO.zeroOut();
-                    internalAudioIO.zeroBus();
-                    internalAudioIO.frame(offset);
-                    voice->onProcess(internalAudioIO);
-                    Vec3d listeningDir;
-                    vector<Vec3f> posOffsets;
-                    if (dynamic_cast<PositionedVoice *>(voice)) {
-                        PositionedVoice *posVoice = static_cast<PositionedVoice *>(voice);
-                        Vec3d direction = posVoice->pose().vec() - scene->mListenerPose.vec();
-
-                        //Rotate vector according to listener-rotation
-                        Quatd srcRot = scene->mListenerPose.quat();
-                        listeningDir = srcRot.rotate(direction);
-                        posOffsets = posVoice->audioOutOffsets();
-                        assert(posOffsets.size() == 0 || posOffsets.size() == posVoice->numOutChannels());
-                        if (posVoice->useDistanceAttenuation()) {
-                            float distance = scene->mListenerPose.vec().mag();
-                            float atten = scene->mDistAtten.attenuation(distance);
-                            internalAudioIO.frame(0);
-                            float *buf = internalAudioIO.outBuffer(0);
-
-                            while (internalAudioIO()) {
-                                *buf = *buf * atten;
-                                buf++;
-                            }
-                        }
-                    } else {
-                        listeningDir = scene->mListenerPose;
-                        // FIXME what should we do here if voice not a PositionedVoice?
-                    }
-                    scene->mSpatializerLock.lock();
-                    if (scene->mBusRoutingCallback) {
-                        // First call callback to route signals to internal buses
-                        internalAudioIO.frame(offset);
-                        (*scene->mBusRoutingCallback)(internalAudioIO, scene->mListenerPose);
-                        io.frame(offset);
-                        internalAudioIO.frame(offset);
-                        // Then gather all the internal buses into the master AudioIO buses
-                        while (io() && internalAudioIO()) {
-                            for (int i = 0; i < scene->mVoiceBusChannels; i++) {
-                                io.bus(i) += internalAudioIO.bus(i);
-                            }
-                        }
-                    }
-                    for (unsigned int i = 0; i < voice->numOutChannels(); i++) {
-                        io.frame(offset);
-                        internalAudioIO.frame(offset);
-                        Pose offsetPose = scene->mListenerPose;
-                        if (posOffsets.size() > 0) {
-                            offsetPose.vec() += posOffsets[i];
-                        }
-                        scene->mSpatializer->renderBuffer(io, offsetPose, internalAudioIO.outBuffer(i), fpb);
-                    }
-                    scene->mSpatializerLock.unlock();
-                }
+void DynamicScene::renderVoice(SynthVoice *voice, AudioIOData &internalIO, AudioIOData &io, bool threaded) {
+    int fpb = internalIO.framesPerBuffer();
+    int offset = voice->getStartOffsetFrames(fpb);
+    if (offset >= fpb) {
+        return;
+    }
+    int endOffsetFrames = voice->getEndOffsetFrames(fpb);
+    if (endOffsetFrames > 0 && endOffsetFrames <= fpb) {
+        voice->triggerOff(endOffsetFrames);
+    }
+    internalIO.zeroOut();
+    internalIO.zeroBus();
+    internalIO.frame(offset);
+    voice->onProcess(internalIO);
+    Vec3d listeningDir;
+    const vector<Vec3f> *posOffsets = nullptr;
+    PositionedVoice *posVoice = dynamic_cast<PositionedVoice *>(voice);
+    bool ramp = false;
+    if (posVoice) {
+        Vec3d direction = posVoice->pose().vec() - mListenerPose.vec();
+
+        //Rotate vector according to listener-rotation, unless the
+        //spatializer rotates its whole output
+        if (mSpatializerRotates) {
+            listeningDir = direction;
+        } else {
+            Quatd srcRot = mListenerPose.quat();
+            listeningDir = srcRot.rotate(direction);
+        }
+        // Ramp gains if the voice moved since the previous block
+        ramp = posVoice->mLastRenderBlock + 1 == mRenderBlock
+                && posVoice->mLastRenderId == voice->id()
+                && posVoice->mLastListeningDir != listeningDir;
+        posOffsets = &posVoice->audioOutOffsets();
+        assert(posOffsets->size() == 0 || posOffsets->size() == posVoice->numOutChannels());
+        if (posVoice->useDistanceAttenuation()) {
+            float distance = listeningDir.mag();
+            float atten = mDistAtten.attenuation(distance);
+            internalIO.frame(0);
+            float *buf = internalIO.outBuffer(0);
+
+            while (internalIO()) {
+                *buf = *buf * atten;
+                buf++;
             }
-            voice = voice->next;
         }
-        scene->mAudioBusy--;
-        scene->mAudioThreadDone.notify_one();
+    } else {
+        listeningDir = mListenerPose;
+    }
+    if (mBusRoutingCallback) {
+        // The routing callback is not expected to be thread safe
+        std::unique_lock<std::mutex> lk(mSpatializerLock, std::defer_lock);
+        if (threaded) {
+            lk.lock();
+        }
+        // First call callback to route signals to internal buses
+        internalIO.frame(offset);
+        Pose listeningPose = listeningDir;
+        (*mBusRoutingCallback)(internalIO, listeningPose);
+        io.frame(offset);
+        internalIO.frame(offset);
+        // Then gather all the internal buses into the master AudioIO buses
+        while (io() && internalIO()) {
+            for (int i = 0; i < mVoiceBusChannels; i++) {
+                io.bus(i) += internalIO.bus(i);
+            }
+        }
+    }
+    std::unique_lock<std::mutex> lk(mSpatializerLock, std::defer_lock);
+    if (threaded && !mSpatializer->concurrentRender()) {
+        lk.lock();
+    }
+    for (unsigned int i = 0; i < voice->numOutChannels(); i++) {
+        io.frame(offset);
+        internalIO.frame(offset);
+        Pose offsetPose = listeningDir;
+        Pose previousPose = ramp ? posVoice->mLastListeningDir : listeningDir;
+        if (posOffsets && posOffsets->size() > 0) {
+            // Is there need to rotate the position according to the quat()?
+            // It would only really be useful if the source has a direction dependent
+            // dispersion model...
+            offsetPose.vec() += (*posOffsets)[i];
+            previousPose.vec() += (*posOffsets)[i];
+        }
+        if (ramp) {
+            mSpatializer->renderBufferRamp(io, previousPose, offsetPose, internalIO.outBuffer(i), fpb);
+        } else {
+            mSpatializer->renderBuffer(io, offsetPose, internalIO.outBuffer(i), fpb);
+        }
+    }
+    if (posVoice) {
+        posVoice->mLastListeningDir = listeningDir;
+        posVoice->mLastRenderBlock = voice->active() ? mRenderBlock : 0;
+        posVoice->mLastRenderId = voice->id();
     }
-    std::cout << "Audio thread " << id << " done" << std::endl;
 }
 
 
@@ -155,6 +155,12 @@ PolySynth::~PolySynth() {
     mRunCPUClock = false;
     mCpuClockThread->join();
   }
+  delete mPendingVoiceIndex.exchange(nullptr);
+  delete mRetiredVoiceIndex.exchange(nullptr);
+  if (mDroppedTriggerOffs.load() > 0) {
+    std::cerr << "ERROR: PolySynth trigger off queue was full. Dropped "
+              << mDroppedTriggerOffs.load() << " trigger offs." << std::endl;
+  }
 }
 
 int PolySynth::triggerOn(SynthVoice *voice, int offsetFrames, int id, void *userData) {
@@ -179,17 +185,13 @@ int PolySynth::triggerOn(SynthVoice *voice, int offsetFrames, int id, void *user
     voice->userData(userData);
   }
   bool allCallbacksOk = true;
-  for (auto cbNode: mTriggerOnCallbacks) {
+  for (auto &cbNode: mTriggerOnCallbacks) {
     allCallbacksOk &= cbNode.first(voice, offsetFrames, thisId, cbNode.second);
   }
   if (allCallbacksOk) {
     voice->triggerOn(offsetFrames);
-    {
-      std::unique_lock<std::mutex> lk(mVoiceToInsertLock);
-      voice->next = mVoicesToInsert;
-      voice->mActive = true; // We need to mark this here to avoid race conditions if active() is checked on separate thread, and the voice removed before it has been triggered.
-      mVoicesToInsert = voice;
-    }
+    voice->mActive = true; // We need to mark this here to avoid race conditions if active() is checked on separate thread, and the voice removed before it has been triggered.
+    pushVoices(mVoicesToInsert, voice, voice);
     return thisId;
   } else {
     return -1;
@@ -198,11 +200,14 @@ int PolySynth::triggerOn(SynthVoice *voice, int offsetFrames, int id, void *user
 
 void PolySynth::triggerOff(int id) {
   bool allCallbacksOk = true;
-  for (auto cbNode: mTriggerOffCallbacks) {
+  for (auto &cbNode: mTriggerOffCallbacks) {
     allCallbacksOk &= cbNode.first(id, cbNode.second);
   }
   if (allCallbacksOk) {
-    mVoiceIdsToTurnOff.write((const char*) &id, sizeof (int));
+    if (!mVoiceIdsToTurnOff.push(id)) {
+      // May be on the audio thread: count it, droppedTriggerOffs() reports it
+      mDroppedTriggerOffs.fetch_add(1, std::memory_order_relaxed);
+    }
   }
 }
 
@@ -214,6 +219,7 @@ void PolySynth::allNotesOff()
 SynthVoice *PolySynth::getVoice(std::string name, bool forceAlloc)
 {
     std::unique_lock<std::mutex> lk(mFreeVoiceLock); // Only one getVoice() call at a time
+    collectFreedVoices();
     SynthVoice *freeVoice = mFreeVoices;
     SynthVoice *previousVoice = nullptr;
     while (freeVoice) {
@@ -243,12 +249,61 @@ SynthVoice *PolySynth::getVoice(std::string name, bool forceAlloc)
         }
 
     }
+    updateVoiceIndexCapacity();
+    return freeVoice;
+}
+
+const std::type_info *PolySynth::voiceType(const std::string &name)
+{
+    auto registered = mCreatorTypes.find(name);
+    if (registered != mCreatorTypes.end()) {
+        return registered->second;
+    }
+    // Voices can be preallocated without registering their class
+    std::unique_lock<std::mutex> lk(mFreeVoiceLock);
+    collectFreedVoices();
+    for (SynthVoice *voice = mFreeVoices; voice; voice = voice->next) {
+        if (demangle(typeid(*voice).name()) == name
+                || strncmp(typeid(*voice).name(), name.c_str(), name.size()) == 0) {
+            return &typeid(*voice);
+        }
+    }
+    return nullptr;
+}
+
+SynthVoice *PolySynth::getVoice(const std::type_info &type, const std::string &name)
+{
+    std::unique_lock<std::mutex> lk(mFreeVoiceLock); // Only one getVoice() call at a time
+    collectFreedVoices();
+    SynthVoice *freeVoice = mFreeVoices;
+    SynthVoice *previousVoice = nullptr;
+    while (freeVoice) {
+        if (typeid(*freeVoice) == type) {
+            if (previousVoice) {
+                previousVoice->next = freeVoice->next;
+            } else {
+                mFreeVoices = freeVoice->next;
+            }
+            break;
+        }
+        previousVoice = freeVoice;
+        freeVoice = freeVoice->next;
+    }
+    if (!freeVoice) { // No free voice in list, so we need to allocate it
+        if (std::find(mNoAllocationList.begin(), mNoAllocationList.end(), name) == mNoAllocationList.end()) {
+            freeVoice = allocateVoice(name);
+        } else {
+            std::cout << "Automatic allocation disabled for voice:" << name << std::endl;
+        }
+    }
+    updateVoiceIndexCapacity();
     return freeVoice;
 }
 
 SynthVoice *PolySynth::getFreeVoice()
 {
   std::unique_lock<std::mutex> lk(mFreeVoiceLock); // Only one getVoice() call at a time
+  collectFreedVoices();
   SynthVoice *freeVoice = mFreeVoices;
   if (freeVoice) {
     mFreeVoices = freeVoice->next;
@@ -266,11 +321,22 @@ void PolySynth::render(AudioIOData &io) {
         processVoiceTurnOff();
     }
 
+    VoiceTypeStages *stages = mVoiceTypeStages.load(std::memory_order_acquire);
+    AudioProfiler *profiler = stages ? stages->profiler : nullptr;
+    const bool profiling = profiler && profiler->enabled();
+    if (profiling && stages != mTimedStages) {
+        for (auto &typeTime : mVoiceTypeTimes) {
+            typeTime.total = 0;
+        }
+        mTimedStages = stages;
+    }
+
     // Render active voices
     auto *voice = mActiveVoices;
     int fpb = io.framesPerBuffer();
     while (voice) {
         if (voice->active()) {
+            uint64_t voiceStart = profiling ? profiler->now() : 0;
 
             int offset = voice->getStartOffsetFrames(fpb);
             if (offset < fpb) {
@@ -306,9 +372,15 @@ void PolySynth::render(AudioIOData &io) {
                   io.frame(offset);
                   voice->onProcess(io);
             }
+            if (profiling) {
+                addVoiceTime(*profiler, voice, voiceStart);
+            }
         }
         voice = voice->next;
     }
+    if (profiling) {
+        recordVoiceTimes(*profiler);
+    }
     processGain(io);
     // Run post processing callbacks
     for (auto cb: mPostProcessing) {
@@ -320,6 +392,81 @@ void PolySynth::render(AudioIOData &io) {
     }
 }
 
+void PolySynth::setProfiler(AudioProfiler *profiler) {
+    std::unique_lock<std::mutex> lk(mVoiceTypesLock);
+    VoiceTypeStages *stages = mVoiceTypeStages.load();
+    if (stages && stages->profiler == profiler) {
+        return;
+    }
+    stages = nullptr;
+    if (profiler) {
+        mVoiceTypeStageTables.emplace_back(new VoiceTypeStages);
+        stages = mVoiceTypeStageTables.back().get();
+        stages->profiler = profiler;
+        for (auto *type : mVoiceTypes) {
+            addVoiceTypeStage(*stages, *type);
+        }
+    }
+    mVoiceTypeStages.store(stages, std::memory_order_release);
+}
+
+void PolySynth::registerVoiceType(const std::type_info &type) {
+    std::unique_lock<std::mutex> lk(mVoiceTypesLock);
+    for (auto *registered : mVoiceTypes) {
+        if (*registered == type) {
+            return;
+        }
+    }
+    mVoiceTypes.push_back(&type);
+    VoiceTypeStages *stages = mVoiceTypeStages.load();
+    if (stages) {
+        addVoiceTypeStage(*stages, type);
+    }
+}
+
+void PolySynth::addVoiceTypeStage(VoiceTypeStages &stages, const std::type_info &type) {
+    int size = stages.size.load(std::memory_order_relaxed);
+    if (size == VoiceTypeStages::maxTypes) {
+        if (mVerbose) {
+            std::cout << "Not profiling voice type " << demangle(type.name())
+                      << ". Too many voice types." << std::endl;
+        }
+        return;
+    }
+    stages.types[size] = &type;
+    stages.stages[size] = stages.profiler->stage("voice " + demangle(type.name()));
+    // render() only reads the entries below size
+    stages.size.store(size + 1, std::memory_order_release);
+}
+
+void PolySynth::addVoiceTime(AudioProfiler &profiler, SynthVoice *voice, uint64_t start) {
+    uint64_t end = profiler.now();
+    const std::type_info &type = typeid(*voice);
+    int size = mTimedStages->size.load(std::memory_order_acquire);
+    for (int i = 0; i < size; i++) {
+        if (*mTimedStages->types[i] == type) {
+            VoiceTypeTime &typeTime = mVoiceTypeTimes[i];
+            if (typeTime.total == 0) {
+                typeTime.start = start;
+            }
+            typeTime.total += end - start;
+            return;
+        }
+    }
+    // Voices that were not allocated or inserted by the synth are not timed
+}
+
+void PolySynth::recordVoiceTimes(AudioProfiler &profiler) {
+    int size = mTimedStages->size.load(std::memory_order_acquire);
+    for (int i = 0; i < size; i++) {
+        VoiceTypeTime &typeTime = mVoiceTypeTimes[i];
+        if (typeTime.total > 0) {
+            profiler.record(mTimedStages->stages[i], typeTime.start, typeTime.start + typeTime.total);
+            typeTime.total = 0;
+        }
+    }
+}
+
 void PolySynth::render(Graphics &g) {
     if (mMasterMode == TIME_MASTER_GRAPHICS) {
         processVoices();
@@ -369,6 +516,7 @@ void PolySynth::disableAllocation(std::string name)
 void PolySynth::allocatePolyphony(std::string name, int number)
 {
     std::unique_lock<std::mutex> lk(mFreeVoiceLock);
+    collectFreedVoices();
     // Find last voice and add polyphony there
     SynthVoice *lastVoice = mFreeVoices;
     if (lastVoice) {
@@ -381,9 +529,11 @@ void PolySynth::allocatePolyphony(std::string name, int number)
         lastVoice->next = allocateVoice(name);
         lastVoice = lastVoice->next;
     }
+    updateVoiceIndexCapacity();
 }
 
 void PolySynth::insertFreeVoice(SynthVoice *voice) {
+    registerVoiceType(typeid(*voice));
     std::unique_lock<std::mutex> lk(mFreeVoiceLock);
     voice->next = mFreeVoices;
     mFreeVoices = voice;
@@ -391,6 +541,7 @@ void PolySynth::insertFreeVoice(SynthVoice *voice) {
 
 bool PolySynth::popFreeVoice(SynthVoice *voice) {
     std::unique_lock<std::mutex> lk(mFreeVoiceLock);
+    collectFreedVoices();
     SynthVoice *lastVoice = mFreeVoices;
     SynthVoice *previousVoice = nullptr;
     while (lastVoice) {
@@ -466,6 +617,7 @@ PolySynth &PolySynth::remove(AudioCallback &v) {
 void PolySynth::print(std::ostream &stream) {
     {
         std::unique_lock<std::mutex> lk(mFreeVoiceLock);
+        collectFreedVoices();
         auto voice = mFreeVoices;
         int counter = 0;
         stream << " ---- Free Voices ----" << std:: endl;
@@ -486,8 +638,7 @@ void PolySynth::print(std::ostream &stream) {
     }
     //
     {
-        std::unique_lock<std::mutex> lk(mVoiceToInsertLock);
-        auto voice = mVoicesToInsert;
+        auto voice = mVoicesToInsert.load();
         int counter = 0;
         stream << " ---- Queued Voices ----" << std:: endl;
         while(voice) {
@@ -1,130 +1,113 @@
-
 #include "al/util/scene/al_SynthRecorder.hpp"
+#include "al/util/scene/al_SynthSequenceFile.hpp"
+
+#include <algorithm>
+#include <cstring>
 
 using namespace al;
 
+SynthRecorder::~SynthRecorder() {
+    if (mRecording) {
+        stopRecord();
+    }
+}
+
 void SynthRecorder::startRecord(std::string name, bool overwrite, bool startOnEvent) {
+    if (mRecording) {
+        stopRecord();
+    }
     mOverwrite = overwrite;
-    mStartOnEvent = startOnEvent;
-    mRecording = true;
-    mSequenceStart = std::chrono::high_resolution_clock::now();
     mSequenceName = name;
-}
 
-void SynthRecorder::stopRecord() {
-    mRecording = false;
     std::string path = File::conformDirectory(mDirectory);
-    std::string fileName = path + mSequenceName + ".synthSequence";
-
-    std::string newSequenceName = mSequenceName;
+    std::string extension = mFormat == BINARY ? ".synthSequenceBin" : ".synthSequence";
+    std::string fileName = path + mSequenceName + extension;
     if (!mOverwrite) {
         std::string newFileName = fileName;
         int counter = 0;
         while (File::exists(newFileName)) {
-            newSequenceName = mSequenceName + "_" + std::to_string(counter++);
-            newFileName =  path + newSequenceName + ".synthSequence";
+            std::string newSequenceName = mSequenceName + "_" + std::to_string(counter++);
+            newFileName =  path + newSequenceName + extension;
         }
         fileName = newFileName;
     }
-    std::vector<std::string> usedInstruments;
-    std::ofstream f(fileName);
-    if (!f.is_open()) {
-        std::cout << "Error while opening sequence file: " << fileName << std::endl;
+    mFileName = fileName;
+    if (mFormat != BINARY) {
+        mFile.open(fileName);
+        if (!mFile.is_open()) {
+            std::cout << "Error while opening sequence file: " << fileName << std::endl;
+            return;
+        }
+    }
+
+    // Discard events left from a previous recording
+    RecordedEvent event;
+    while (mEvents.pop(event)) {}
+    mPendingEvents.clear();
+    mBinaryEvents.clear();
+    mDroppedEvents = 0;
+
+    mStartOnEvent = startOnEvent;
+    mSequenceStart = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    mWriterRunning = true;
+    mWriterThread = std::unique_ptr<std::thread>(new std::thread(&SynthRecorder::writeEvents, this));
+    mRecording = true;
+}
+
+void SynthRecorder::stopRecord() {
+    if (!mRecording) {
         return;
     }
-    if (mFormat == CPP_FORMAT) {
-        for (SynthEvent &event: mSequence) {
-            f << "s.add<" << event.synthName << ">("  << event.time << ").set(";
-            for (unsigned int i = 0; i < event.pFields.size(); i++) {
-                if (event.pFields[i].type() == ParameterField::STRING) {
-                    f << "\"" << event.pFields[i].get<std::string>()<< "\"" ;
-                } else {
-                    f  << event.pFields[i].get<float>();
-                }
-                if (i <  event.pFields.size() - 1) {
-                    f << ", ";
-                }
-            }
-            f << ");" << std::endl;
-            if (std::find(usedInstruments.begin(), usedInstruments.end(), event.synthName) == usedInstruments.end()) {
-                usedInstruments.push_back(event.synthName);
-            }
-        }
-    } else if (mFormat == SEQUENCER_EVENT) {
-        std::map<int, SynthEvent *> eventStack;
-        for (SynthEvent &event: mSequence) {
-            if (event.type == SynthEventType::TRIGGER_ON) {
-                eventStack[event.id] = &event;
-            } else if (event.type == SynthEventType::TRIGGER_OFF) {
-                auto idMatch = eventStack.find(event.id);
-                if (idMatch != eventStack.end()) {
-                    double duration = event.time - idMatch->second->time;
-                    f << "@ " << idMatch->second->time << " " << duration << " " << idMatch->second->synthName << " ";
-                    for (auto &field : idMatch->second->pFields) {
-                        if (field.type() == ParameterField::STRING) {
-                            f << "\"" << field.get<std::string>()<< "\" " ;
-                        } else {
-                            f  << field.get<float>()<< " ";
-                        }
-                    }
-                    f << std::endl;
-                }
-            }
-            if (std::find(usedInstruments.begin(), usedInstruments.end(), event.synthName) == usedInstruments.end()) {
-                usedInstruments.push_back(event.synthName);
-            }
-        }
-        if (eventStack.size() > 0) {
-            std::cout << "WARNING: event stack not empty (trigger on doesn't have a trigger off match)" << std::endl;
-        }
+    mRecording = false;
+    mWriterRunning = false;
+    mWriterThread->join();
+    mWriterThread = nullptr;
+    // Events that arrived while the writer was stopping
+    RecordedEvent event;
+    while (mEvents.pop(event)) {
+        writeEvent(event);
+    }
 
+    if (mPendingEvents.size() > 0 && mFormat != SEQUENCER_TRIGGERS && mFormat != CPP_FORMAT) {
+        std::cout << "WARNING: event stack not empty (trigger on doesn't have a trigger off match)" << std::endl;
+    }
+    mPendingEvents.clear();
+    if (mDroppedEvents > 0) {
+        std::cout << "WARNING: SynthRecorder event buffer full. Dropped " << mDroppedEvents << " events" << std::endl;
+    }
 
-    } else if (mFormat == SEQUENCER_TRIGGERS) {
-        for (SynthEvent &event: mSequence) {
-            if (event.type == SynthEventType::TRIGGER_ON) {
-                f << "+ " << event.time << " " << event.id << " " << event.synthName << " ";
-                for (auto field : event.pFields) {
-                    if (field.type() == ParameterField::STRING) {
-                        f << "\"" << field.get<std::string>()<< "\"" ;
-                    } else {
-                        f  << field.get<float>()<< " ";
-                    }
-                }
-                f << std::endl;
-            } else if (event.type == SynthEventType::TRIGGER_OFF) {
-                f << "- " << event.time << " " << event.id << " ";
-                for (unsigned int i = 0; i < event.pFields.size(); i++) {
-                    if (event.pFields[i].type() == ParameterField::STRING) {
-                        f << "\"" << event.pFields[i].get<std::string>()<< "\" " ;
-                    } else {
-                        f  << event.pFields[i].get<float>() << " ";
-                    }
-                }
-                f << std::endl;
-            }
-            if (std::find(usedInstruments.begin(), usedInstruments.end(), event.synthName) == usedInstruments.end()) {
-                usedInstruments.push_back(event.synthName);
-            }
+    if (mFormat == BINARY) {
+        if (SynthSequenceFile::write(mFileName, mBinaryEvents)) {
+            std::cout << "Recorded: " << mFileName << std::endl;
         }
+        mBinaryEvents.clear();
+        return;
     }
-
-    if (f.bad()) {
-        std::cout << "Error while writing sequence file: " << fileName << std::endl;
+    if (!mFile.is_open()) {
+        return;
+    }
+    if (mFile.bad()) {
+        std::cout << "Error while writing sequence file: " << mFileName << std::endl;
     }
-    mSequence.clear();
-    for (auto &instr: usedInstruments) {
-        f << "# " << instr << " ";
+    for (int i = 0; i < maxClasses; i++) {
+        if (mClassNames[i].size() == 0) {
+            continue;
+        }
+        mFile << "# " << mClassNames[i] << " ";
         // Hack to get the parameter names. Get a voice from the polysynth and then check the parameters. Should there be a better way?
-        auto *voice = mPolySynth->getVoice(instr);
-        for (auto p: voice->triggerParameters()) {
-            f << p->getName() << " ";
+        auto *voice = mPolySynth->getVoice(mClassNames[i]);
+        if (voice) {
+            for (auto p: voice->triggerParameters()) {
+                mFile << p->getName() << " ";
+            }
+            mPolySynth->insertFreeVoice(voice);
         }
-        f << std::endl;
-        mPolySynth->insertFreeVoice(voice);
+        mFile << std::endl;
+        mClassNames[i].clear();
     }
-    f.close();
+    mFile.close();
 
-    std::cout << "Recorded: " << fileName << std::endl;
+    std::cout << "Recorded: " << mFileName << std::endl;
     //        recorder->mLastSequenceName = newSequenceName;
     //        recorder->mLastSequenceSubDir = recorder->mPresetHandler->getSubDirectory();
 }
@@ -135,4 +118,191 @@ void SynthRecorder::registerPolySynth(PolySynth &polySynth) {
     mPolySynth = &polySynth;
 }
 
+bool SynthRecorder::onTriggerOn(SynthVoice *voice, int offsetFrames, int id, void *userData)
+{
+    SynthRecorder *rec = static_cast<SynthRecorder *>(userData);
+    if (!rec->mRecording) {
+        return true;
+    }
+    RecordedEvent event;
+    event.type = SynthEventType::TRIGGER_ON;
+    event.id = voice->id();
+    event.classIndex = rec->classIndex(voice);
+    if (event.classIndex == maxClasses) {
+        rec->mDroppedEvents++;
+        return true;
+    }
+    event.time = rec->eventTime();
+    event.numFields = uint16_t(voice->getTriggerParams(event.fields, maxFields));
+    // String and menu parameters are written as 0 by getTriggerParams().
+    // Copy their values into the record.
+    event.stringFields = 0;
+    size_t stringBytes = 0;
+    auto &params = voice->triggerParameters();
+    for (size_t i = 0; i < params.size() && i < event.numFields; i++) {
+        auto *param = params[i];
+        bool isString = strcmp(typeid(*param).name(), typeid(ParameterString).name()) == 0;
+        bool isMenu = strcmp(typeid(*param).name(), typeid(ParameterMenu).name()) == 0;
+        if (!isString && !isMenu) {
+            continue;
+        }
+        if (stringBytes >= size_t(maxStringBytes)) {
+            break;
+        }
+        char *value = event.strings + stringBytes;
+        size_t available = maxStringBytes - stringBytes;
+        if (isString) {
+            static_cast<ParameterString *>(param)->copyValue(value, available);
+        } else if (!static_cast<ParameterMenu *>(param)->copyCurrent(value, available)) {
+            continue; // Elements are being changed, leave the field as 0
+        }
+        stringBytes += strlen(value) + 1;
+        event.stringFields |= 1u << i;
+    }
+    if (!rec->mEvents.push(event)) {
+        rec->mDroppedEvents++;
+    }
+    return true;
+}
+
+bool SynthRecorder::onTriggerOff(int id, void *userData)
+{
+    SynthRecorder *rec = static_cast<SynthRecorder *>(userData);
+    if (!rec->mRecording) {
+        return true;
+    }
+    RecordedEvent event;
+    event.type = SynthEventType::TRIGGER_OFF;
+    event.id = id;
+    event.classIndex = maxClasses;
+    event.time = rec->eventTime();
+    event.numFields = 0;
+    event.stringFields = 0;
+    if (!rec->mEvents.push(event)) {
+        rec->mDroppedEvents++;
+    }
+    return true;
+}
+
+double SynthRecorder::eventTime() {
+    int64_t now = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    if (mStartOnEvent.load() && mStartOnEvent.exchange(false)) {
+        mSequenceStart = now;
+    }
+    double seconds = std::chrono::duration<double>(
+                std::chrono::high_resolution_clock::duration(now - mSequenceStart.load())).count();
+    return seconds > 0 ? seconds : 0;
+}
+
+uint16_t SynthRecorder::classIndex(SynthVoice *voice) {
+    const std::type_info *voiceType = &typeid(*voice);
+    for (uint16_t i = 0; i < maxClasses; i++) {
+        const std::type_info *entry = mClasses[i].load(std::memory_order_acquire);
+        if (!entry) {
+            if (mClasses[i].compare_exchange_strong(entry, voiceType, std::memory_order_acq_rel)) {
+                return i;
+            }
+            // Another thread took the slot. entry now holds its type
+        }
+        if (*entry == *voiceType) {
+            return i;
+        }
+    }
+    return maxClasses;
+}
+
+void SynthRecorder::writeEvents() {
+    while (mWriterRunning) {
+        RecordedEvent event;
+        while (mEvents.pop(event)) {
+            writeEvent(event);
+        }
+        mFile.flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
 
+std::vector<ParameterField> SynthRecorder::eventFields(RecordedEvent &event) {
+    std::vector<ParameterField> pFields;
+    const char *strings = event.strings;
+    for (int i = 0; i < event.numFields; i++) {
+        if (event.stringFields & (1u << i)) {
+            pFields.push_back(std::string(strings));
+            strings += strlen(strings) + 1;
+        } else {
+            pFields.push_back(event.fields[i]);
+        }
+    }
+    return pFields;
+}
+
+void SynthRecorder::writeFields(RecordedEvent &event, const char *separator) {
+    const char *strings = event.strings;
+    for (int i = 0; i < event.numFields; i++) {
+        if (event.stringFields & (1u << i)) {
+            mFile << "\"" << strings << "\"";
+            strings += strlen(strings) + 1;
+        } else {
+            mFile << event.fields[i];
+        }
+        if (i < event.numFields - 1) {
+            mFile << separator;
+        }
+    }
+}
+
+void SynthRecorder::writeEvent(RecordedEvent &event) {
+    std::string *className = nullptr;
+    if (event.type == SynthEventType::TRIGGER_ON) {
+        className = &mClassNames[event.classIndex];
+        if (className->size() == 0) {
+            *className = demangle(mClasses[event.classIndex].load()->name());
+        }
+        if (verbose()) {
+            std::cout << "trigger at " << event.time << ":" << *className << ":" << event.id << std::endl;
+        }
+    } else if (verbose()) {
+        std::cout << "trigger OFF at " << event.time << ":" << event.id << std::endl;
+    }
+
+    if (mFormat == CPP_FORMAT) {
+        if (className) {
+            mFile << "s.add<" << *className << ">("  << event.time << ").set(";
+            writeFields(event, ", ");
+            mFile << ");\n";
+        }
+    } else if (mFormat == SEQUENCER_TRIGGERS) {
+        if (className) {
+            mFile << "+ " << event.time << " " << event.id << " " << *className << " ";
+            writeFields(event, " ");
+        } else {
+            mFile << "- " << event.time << " " << event.id;
+        }
+        mFile << "\n";
+    } else if (mFormat == SEQUENCER_EVENT || mFormat == BINARY) {
+        // Events are written when their trigger off arrives, with their duration
+        if (className) {
+            mPendingEvents[event.id] = event;
+            return;
+        }
+        auto idMatch = mPendingEvents.find(event.id);
+        if (idMatch == mPendingEvents.end()) {
+            return;
+        }
+        RecordedEvent &on = idMatch->second;
+        double duration = event.time - on.time;
+        if (mFormat == BINARY) {
+            mBinaryEvents.emplace_back();
+            mBinaryEvents.back().type = SynthSequencerEvent::EVENT_PFIELDS;
+            mBinaryEvents.back().startTime = on.time;
+            mBinaryEvents.back().duration = duration;
+            mBinaryEvents.back().fields.name = mClassNames[on.classIndex];
+            mBinaryEvents.back().fields.pFields = eventFields(on);
+        } else {
+            mFile << "@ " << on.time << " " << duration << " " << mClassNames[on.classIndex] << " ";
+            writeFields(on, " ");
+            mFile << "\n";
+        }
+        mPendingEvents.erase(idMatch);
+    }
+}
@@ -0,0 +1,442 @@
+#include "al/util/scene/al_SynthSequenceFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <typeinfo>
+#include <unordered_map>
+
+#ifdef AL_WINDOWS
+  #define WIN32_LEAN_AND_MEAN
+  #define NOMINMAX
+  #include <windows.h>
+  #undef NOMINMAX
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+using namespace al;
+
+const uint32_t SynthSequenceFile::noString;
+
+static const char sequenceMagic[8] = {'a', 'l', 'S', 'y', 'n', 'S', 'e', 'q'};
+static const uint32_t sequenceVersion = 2;
+static const uint32_t byteOrderMark = 0x01020304;
+
+struct SynthSequenceFile::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t numStrings;
+  uint64_t numEvents;
+  uint64_t numFields;
+  uint64_t stringBytes;
+  // Byte offsets of the sections from the start of the file
+  uint64_t stringsOffset;     // StringRef table
+  uint64_t stringDataOffset;  // Characters of all strings
+  uint64_t eventsOffset;
+  uint64_t fieldValuesOffset;
+  uint64_t fieldStringsOffset;
+  uint64_t stringEventsOffset;  // Indices of the events with string pfields
+  uint64_t numStringEvents;
+  uint64_t numNames;            // Voice names at the start of the string table
+  uint64_t maxOverlap;
+};
+
+namespace {
+
+struct StringRef {
+  uint32_t offset; // From the start of the string data
+  uint32_t length;
+};
+
+// All sections start on an 8 byte boundary so the mapped records are aligned
+uint64_t alignSection(uint64_t offset) {
+  return (offset + 7) & ~uint64_t(7);
+}
+
+}
+
+bool SynthSequenceFile::open(std::string fileName) {
+  close();
+#ifdef AL_WINDOWS
+  HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  HANDLE mapping = NULL;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  }
+  if (mapping == NULL) {
+    CloseHandle(file);
+    return false;
+  }
+  mData = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!mData) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  mFileHandle = file;
+  mMappingHandle = mapping;
+  mSize = uint64_t(size.QuadPart);
+#else
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  void *data = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd); // The mapping keeps the file open
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  madvise(data, size_t(info.st_size), MADV_SEQUENTIAL);
+  mData = data;
+  mSize = uint64_t(info.st_size);
+#endif
+
+  // Check the header and that all sections are within the file
+  const char *bytes = static_cast<const char *>(mData);
+  const Header *header = static_cast<const Header *>(mData);
+  auto sectionFits = [&](uint64_t offset, uint64_t count, uint64_t elementSize) {
+    return offset % 8 == 0 && offset <= mSize && count <= (mSize - offset) / elementSize;
+  };
+  if (mSize < sizeof(Header)
+      || memcmp(header->magic, sequenceMagic, sizeof(sequenceMagic)) != 0
+      || header->byteOrder != byteOrderMark
+      || header->version != sequenceVersion
+      || !sectionFits(header->stringsOffset, header->numStrings, sizeof(StringRef))
+      || !sectionFits(header->stringDataOffset, header->stringBytes, 1)
+      || !sectionFits(header->eventsOffset, header->numEvents, sizeof(Event))
+      || !sectionFits(header->fieldValuesOffset, header->numFields, sizeof(float))
+      || !sectionFits(header->fieldStringsOffset, header->numFields, sizeof(uint32_t))
+      || !sectionFits(header->stringEventsOffset, header->numStringEvents, sizeof(uint64_t))
+      || header->numNames > header->numStrings) {
+    std::cerr << "SynthSequenceFile: Not a valid binary sequence: " << fileName << std::endl;
+    close();
+    return false;
+  }
+
+  const StringRef *refs = reinterpret_cast<const StringRef *>(bytes + header->stringsOffset);
+  const char *stringData = bytes + header->stringDataOffset;
+  mStrings.reserve(header->numStrings);
+  for (uint64_t i = 0; i < header->numStrings; i++) {
+    if (uint64_t(refs[i].offset) + refs[i].length > header->stringBytes) {
+      std::cerr << "SynthSequenceFile: Corrupt string table: " << fileName << std::endl;
+      close();
+      return false;
+    }
+    mStrings.emplace_back(stringData + refs[i].offset, refs[i].length);
+  }
+  mEvents = reinterpret_cast<const Event *>(bytes + header->eventsOffset);
+  mNumEvents = header->numEvents;
+  mFieldValues = reinterpret_cast<const float *>(bytes + header->fieldValuesOffset);
+  mFieldStrings = reinterpret_cast<const uint32_t *>(bytes + header->fieldStringsOffset);
+  mNumFields = header->numFields;
+  mNumNames = uint32_t(header->numNames);
+  mMaxOverlap = header->maxOverlap;
+
+  // Copy the pfields of the events that have string pfields, so playing
+  // them needs no lookups
+  mStringEvents = reinterpret_cast<const uint64_t *>(bytes + header->stringEventsOffset);
+  mNumStringEvents = header->numStringEvents;
+  mStringEventFirstField.reserve(mNumStringEvents);
+  uint64_t numStringEventFields = 0;
+  for (uint64_t i = 0; i < mNumStringEvents; i++) {
+    if (mStringEvents[i] >= mNumEvents || (i > 0 && mStringEvents[i] <= mStringEvents[i - 1])
+        || !validEvent(mEvents[mStringEvents[i]])) {
+      std::cerr << "SynthSequenceFile: Corrupt string event index: " << fileName << std::endl;
+      close();
+      return false;
+    }
+    mStringEventFirstField.push_back(numStringEventFields);
+    numStringEventFields += mEvents[mStringEvents[i]].numFields;
+  }
+  mStringEventFields.reserve(numStringEventFields);
+  for (uint64_t i = 0; i < mNumStringEvents; i++) {
+    const Event &event = mEvents[mStringEvents[i]];
+    for (uint32_t field = event.firstField; field < event.firstField + event.numFields; field++) {
+      if (mFieldStrings[field] != noString && mFieldStrings[field] < mStrings.size()) {
+        mStringEventFields.emplace_back(mStrings[mFieldStrings[field]]);
+      } else {
+        mStringEventFields.emplace_back(mFieldValues[field]);
+      }
+    }
+  }
+  return true;
+}
+
+void SynthSequenceFile::close() {
+  if (mData) {
+#ifdef AL_WINDOWS
+    UnmapViewOfFile(mData);
+    CloseHandle(mMappingHandle);
+    CloseHandle(mFileHandle);
+    mMappingHandle = mFileHandle = nullptr;
+#else
+    munmap(mData, size_t(mSize));
+#endif
+  }
+  mData = nullptr;
+  mSize = 0;
+  mStrings.clear();
+  mEvents = nullptr;
+  mNumEvents = 0;
+  mFieldValues = nullptr;
+  mFieldStrings = nullptr;
+  mNumFields = 0;
+  mNumNames = 0;
+  mMaxOverlap = 0;
+  mStringEvents = nullptr;
+  mNumStringEvents = 0;
+  mStringEventFields.clear();
+  mStringEventFirstField.clear();
+}
+
+uint64_t SynthSequenceFile::firstEventAt(double time) const {
+  return std::lower_bound(mEvents, mEvents + mNumEvents, time,
+                          [](const Event &event, double t) { return event.startTime < t; })
+      - mEvents;
+}
+
+bool SynthSequenceFile::floatFieldsOnly(const Event &event) const {
+  for (uint32_t i = event.firstField; i < event.firstField + event.numFields; i++) {
+    if (mFieldStrings[i] != noString) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const ParameterField *SynthSequenceFile::stringEventFields(uint64_t eventIndex) const {
+  const uint64_t *found = std::lower_bound(mStringEvents, mStringEvents + mNumStringEvents, eventIndex);
+  if (found == mStringEvents + mNumStringEvents || *found != eventIndex) {
+    return nullptr;
+  }
+  return mStringEventFields.data() + mStringEventFirstField[found - mStringEvents];
+}
+
+std::vector<ParameterField> SynthSequenceFile::fields(const Event &event) const {
+  std::vector<ParameterField> pFields;
+  if (!validEvent(event)) {
+    return pFields;
+  }
+  pFields.reserve(event.numFields);
+  for (uint32_t i = event.firstField; i < event.firstField + event.numFields; i++) {
+    if (mFieldStrings[i] != noString && mFieldStrings[i] < mStrings.size()) {
+      pFields.push_back(mStrings[mFieldStrings[i]]);
+    } else {
+      pFields.push_back(mFieldValues[i]);
+    }
+  }
+  return pFields;
+}
+
+std::vector<SynthSequencerEvent> SynthSequenceFile::toEvents(double timeOffset) const {
+  std::vector<SynthSequencerEvent> events;
+  events.reserve(mNumEvents);
+  for (uint64_t i = 0; i < mNumEvents; i++) {
+    const Event &event = mEvents[i];
+    if (!validEvent(event)) {
+      continue;
+    }
+    events.emplace_back();
+    events.back().type = SynthSequencerEvent::EVENT_PFIELDS;
+    events.back().startTime = timeOffset + event.startTime;
+    events.back().duration = event.duration;
+    events.back().fields.name = mStrings[event.name];
+    events.back().fields.pFields = fields(event);
+  }
+  return events;
+}
+
+bool SynthSequenceFile::write(std::string fileName, const std::vector<SynthSequencerEvent> &events) {
+  std::vector<std::string> strings;
+  std::unordered_map<std::string, uint32_t> stringIndex;
+  auto intern = [&](const std::string &s) {
+    auto found = stringIndex.find(s);
+    if (found != stringIndex.end()) {
+      return found->second;
+    }
+    uint32_t index = uint32_t(strings.size());
+    stringIndex[s] = index;
+    strings.push_back(s);
+    return index;
+  };
+
+  std::vector<size_t> order(events.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return events[a].startTime < events[b].startTime;
+  });
+
+  // Voice names go first in the string table
+  auto written = [&](const SynthSequencerEvent &event) {
+    return event.type == SynthSequencerEvent::EVENT_PFIELDS
+        || (event.type == SynthSequencerEvent::EVENT_VOICE && event.voice);
+  };
+  for (size_t index : order) {
+    const SynthSequencerEvent &event = events[index];
+    if (event.type == SynthSequencerEvent::EVENT_PFIELDS) {
+      intern(event.fields.name);
+    } else if (written(event)) {
+      intern(demangle(typeid(*event.voice).name()));
+    }
+  }
+  uint64_t numNames = strings.size();
+
+  std::vector<Event> records;
+  std::vector<float> fieldValues;
+  std::vector<uint32_t> fieldStrings;
+  std::vector<uint64_t> stringEvents;
+  records.reserve(events.size());
+  for (size_t index : order) {
+    const SynthSequencerEvent &event = events[index];
+    if (!written(event)) {
+      continue;
+    }
+    Event record;
+    record.startTime = event.startTime;
+    record.duration = event.duration;
+    record.firstField = uint32_t(fieldValues.size());
+    record.id = -1;
+    std::vector<ParameterField> voiceFields;
+    const std::vector<ParameterField> *pFields;
+    if (event.type == SynthSequencerEvent::EVENT_PFIELDS) {
+      record.name = intern(event.fields.name);
+      pFields = &event.fields.pFields;
+    } else {
+      record.name = intern(demangle(typeid(*event.voice).name()));
+      record.id = event.voice->id();
+      voiceFields = event.voice->getTriggerParams();
+      pFields = &voiceFields;
+    }
+    bool hasStrings = false;
+    for (const ParameterField &field : *pFields) {
+      if (field.type() == ParameterField::STRING) {
+        fieldValues.push_back(0.0f);
+        fieldStrings.push_back(intern(field.get<std::string>()));
+        hasStrings = true;
+      } else {
+        fieldValues.push_back(field.get<float>());
+        fieldStrings.push_back(noString);
+      }
+    }
+    if (hasStrings) {
+      stringEvents.push_back(records.size());
+    }
+    record.numFields = uint32_t(fieldValues.size()) - record.firstField;
+    records.push_back(record);
+  }
+
+  // Most events on at once, so the sequencer can reserve for them without
+  // reading the events
+  std::priority_queue<double, std::vector<double>, std::greater<double>> endTimes;
+  size_t maxOverlap = 0;
+  for (const Event &record : records) {
+    while (endTimes.size() > 0 && endTimes.top() < record.startTime) {
+      endTimes.pop();
+    }
+    endTimes.push(record.startTime + record.duration);
+    maxOverlap = std::max(maxOverlap, endTimes.size());
+  }
+
+  std::vector<StringRef> refs;
+  std::string stringData;
+  for (auto &s : strings) {
+    refs.push_back({uint32_t(stringData.size()), uint32_t(s.size())});
+    stringData += s;
+  }
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, sequenceMagic, sizeof(sequenceMagic));
+  header.version = sequenceVersion;
+  header.byteOrder = byteOrderMark;
+  header.numStrings = refs.size();
+  header.numEvents = records.size();
+  header.numFields = fieldValues.size();
+  header.stringBytes = stringData.size();
+  header.stringsOffset = alignSection(sizeof(Header));
+  header.stringDataOffset = alignSection(header.stringsOffset + refs.size() * sizeof(StringRef));
+  header.eventsOffset = alignSection(header.stringDataOffset + stringData.size());
+  header.fieldValuesOffset = alignSection(header.eventsOffset + records.size() * sizeof(Event));
+  header.fieldStringsOffset = alignSection(header.fieldValuesOffset + fieldValues.size() * sizeof(float));
+  header.stringEventsOffset = alignSection(header.fieldStringsOffset + fieldStrings.size() * sizeof(uint32_t));
+  header.numStringEvents = stringEvents.size();
+  header.numNames = numNames;
+  header.maxOverlap = maxOverlap;
+
+  std::ofstream f(fileName, std::ios::binary | std::ios::trunc);
+  if (!f.is_open()) {
+    std::cerr << "SynthSequenceFile: Could not open for writing: " << fileName << std::endl;
+    return false;
+  }
+  uint64_t position = 0;
+  auto writeSection = [&](uint64_t offset, const void *data, uint64_t size) {
+    static const char padding[8] = {0};
+    f.write(padding, std::streamsize(offset - position));
+    f.write(static_cast<const char *>(data), std::streamsize(size));
+    position = offset + size;
+  };
+  writeSection(0, &header, sizeof(header));
+  writeSection(header.stringsOffset, refs.data(), refs.size() * sizeof(StringRef));
+  writeSection(header.stringDataOffset, stringData.data(), stringData.size());
+  writeSection(header.eventsOffset, records.data(), records.size() * sizeof(Event));
+  writeSection(header.fieldValuesOffset, fieldValues.data(), fieldValues.size() * sizeof(float));
+  writeSection(header.fieldStringsOffset, fieldStrings.data(), fieldStrings.size() * sizeof(uint32_t));
+  writeSection(header.stringEventsOffset, stringEvents.data(), stringEvents.size() * sizeof(uint64_t));
+  if (f.bad()) {
+    std::cerr << "SynthSequenceFile: Error writing: " << fileName << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool SynthSequenceFile::writeText(std::string fileName) const {
+  std::ofstream f(fileName);
+  if (!f.is_open()) {
+    std::cerr << "SynthSequenceFile: Could not open for writing: " << fileName << std::endl;
+    return false;
+  }
+  // Enough digits for the text to read back to the same values
+  const int timePrecision = std::numeric_limits<double>::digits10;
+  const int fieldPrecision = std::numeric_limits<float>::max_digits10;
+  for (uint64_t i = 0; i < mNumEvents; i++) {
+    const Event &event = mEvents[i];
+    if (!validEvent(event)) {
+      continue;
+    }
+    f << std::setprecision(timePrecision) << "@ " << event.startTime << " " << event.duration
+      << " " << mStrings[event.name] << std::setprecision(fieldPrecision);
+    for (uint32_t field = event.firstField; field < event.firstField + event.numFields; field++) {
+      if (mFieldStrings[field] != noString && mFieldStrings[field] < mStrings.size()) {
+        f << " \"" << mStrings[mFieldStrings[field]] << "\"";
+      } else {
+        f << " " << mFieldValues[field];
+      }
+    }
+    f << "\n";
+  }
+  if (f.bad()) {
+    std::cerr << "SynthSequenceFile: Error writing: " << fileName << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -5,12 +5,27 @@
 #include <fstream>
 #include <algorithm>
 #include <climits>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <unordered_map>
 #include <typeinfo> // For class name instrospection
 
 #include "al/util/scene/al_SynthSequencer.hpp"
+#include "al/util/scene/al_SynthSequenceFile.hpp"
 
 using namespace al;
 
+static bool startsBefore(const SynthSequencerEvent &a, const SynthSequencerEvent &b) {
+  return a.startTime < b.startTime;
+}
+
+static const std::string binaryExtension = ".synthSequenceBin";
+
+static bool startsBeforeTime(const SynthSequencerEvent &event, double time) {
+  return event.startTime < time;
+}
+
 void SynthSequencer::render(AudioIOData &io) {
     if (mMasterMode ==  PolySynth::TIME_MASTER_AUDIO) {
         double timeIncrement = mNormalizedTempo * io.framesPerBuffer()/(double) io.framesPerSecond();
@@ -42,11 +57,30 @@ bool SynthSequencer::playSequence(std::string sequenceName, float startTime) {
   mMasterTime = startTime;
   double currentMasterTime = mMasterTime;
   const double startPad = 0.1;
-  std::list<SynthSequencerEvent> events = loadSequence(sequenceName, currentMasterTime - startTime + startPad);
+  std::shared_ptr<SynthSequenceFile> mappedSequence = openBinarySequence(sequenceName);
+  std::vector<SynthSequencerEvent> events;
+  size_t mappedPolyphony = 0;
+  std::vector<const std::type_info *> mappedVoiceTypes;
+  if (mappedSequence) {
+    // Only the voice names are looked up. Nothing is read per event
+    mappedPolyphony = mappedSequence->maxOverlap();
+    mappedVoiceTypes.resize(mappedSequence->numStrings(), nullptr);
+    for (uint32_t i = 0; i < mappedSequence->numNames(); i++) {
+      mappedVoiceTypes[i] = mPolySynth->voiceType(mappedSequence->string(i));
+    }
+  } else {
+    events = loadSequenceEvents(sequenceName, currentMasterTime - startTime + startPad);
+  }
   std::unique_lock<std::mutex> lk(mEventLock);
   mLastSequencePlayed = sequenceName;
-  mEvents = events;
+  mEvents = std::move(events);
   mNextEvent = 0;
+  mMappedSequence = mappedSequence;
+  mMappedPolyphony = mappedPolyphony;
+  mMappedVoiceTypes = std::move(mappedVoiceTypes);
+  mNextMappedEvent = 0;
+  reserveActiveVoices();
+  mMappedTimeOffset = currentMasterTime - startTime + startPad;
   mPlaybackStartTime = currentMasterTime - startTime + startPad;
   mPlaying = true;
   lk.unlock();
@@ -59,7 +93,7 @@ bool SynthSequencer::playSequence(std::string sequenceName, float startTime) {
       auto startTime = std::chrono::high_resolution_clock::now();
       while (running) {
         std::unique_lock<std::mutex> lk(mEventLock);
-        if (mEvents.size() == 0) {
+        if (mEvents.size() == 0 && !mMappedSequence) {
           running = false;
           if (verbose()) {
             std::cout << "CPU play thread done." << std::endl;
@@ -90,14 +124,24 @@ void SynthSequencer::stopSequence() {
 
   mEvents.clear();
   mNextEvent = 0;
+  mMappedSequence = nullptr;
+  mMappedPolyphony = 0;
+  mMappedVoiceTypes.clear();
+  mNextMappedEvent = 0;
   mPlaying = false;
 }
 
 void SynthSequencer::setTime(float newTime) {
   synth().allNotesOff();
+  std::unique_lock<std::mutex> lk(mEventLock);
 //  mPlaybackStartTime = newTime;
   mMasterTime = newTime;
-  mNextEvent = 0;
+  mActiveVoices.clear();
+  // Resume from the first event at or after the new time
+  mNextEvent = std::lower_bound(mEvents.begin(), mEvents.end(), double(newTime), startsBeforeTime) - mEvents.begin();
+  if (mMappedSequence) {
+    mNextMappedEvent = mMappedSequence->firstEventAt(newTime - mMappedTimeOffset);
+  }
 
 //  std::cout << "Setting time not implemented" <<std::endl;
 }
@@ -137,6 +181,50 @@ void SynthSequencer::registerSynth(PolySynth &synth) {
   mMasterMode = mPolySynth->mMasterMode;
 }
 
+void SynthSequencer::insertVoiceEvent(SynthVoice *voice, double startTime, double duration) {
+  // Events that are already due go right after the ones played, so they are
+  // triggered on the next block instead of shifting mNextEvent.
+  auto position = std::lower_bound(mEvents.begin() + mNextEvent, mEvents.end(), startTime, startsBeforeTime);
+  auto insertedEvent = mEvents.insert(position, SynthSequencerEvent());
+  insertedEvent->startTime = startTime;
+  insertedEvent->duration = duration;
+  insertedEvent->voice = voice;
+  reserveActiveVoices();
+}
+
+void SynthSequencer::reserveActiveVoices() {
+  // Every pending event adds at most one entry. Entries are kept until their
+  // end time even if the voice was freed earlier, so the size of the voice
+  // pool is not a bound.
+  size_t needed = mActiveVoices.size() + (mEvents.size() - mNextEvent) + mMappedPolyphony;
+  if (mActiveVoices.capacity() < needed) {
+    mActiveVoices.reserve(std::max(needed, 2 * mActiveVoices.capacity()));
+  }
+}
+
+bool SynthSequencer::pushActiveVoice(double endTime, int voiceId) {
+  bool turnedOff = false;
+  if (mActiveVoices.size() == mActiveVoices.capacity()) {
+    // Voices ending in this block would be removed after the new ones are
+    // pushed. Removing them first keeps the heap within its reserved size.
+    turnedOff = turnOffEndedVoices();
+  }
+  mActiveVoices.push_back({endTime, voiceId});
+  std::push_heap(mActiveVoices.begin(), mActiveVoices.end(), ActiveVoice::endsLater);
+  return turnedOff;
+}
+
+bool SynthSequencer::turnOffEndedVoices() {
+  bool turnedOff = false;
+  while (mActiveVoices.size() > 0 && mActiveVoices.front().endTime <= mMasterTime) {
+    mPolySynth->triggerOff(mActiveVoices.front().voiceId);
+    std::pop_heap(mActiveVoices.begin(), mActiveVoices.end(), ActiveVoice::endsLater);
+    mActiveVoices.pop_back();
+    turnedOff = true;
+  }
+  return turnedOff;
+}
+
 std::string SynthSequencer::buildFullPath(std::string sequenceName)
 {
   std::string fullName = mDirectory;
@@ -151,9 +239,65 @@ std::string SynthSequencer::buildFullPath(std::string sequenceName)
   return fullName;
 }
 
+std::string SynthSequencer::buildBinaryPath(std::string sequenceName)
+{
+  if (checkExtension(sequenceName, binaryExtension)) {
+    sequenceName = sequenceName.substr(0, sequenceName.size() - binaryExtension.size());
+  }
+  std::string fullName = buildFullPath(sequenceName);
+  return fullName.substr(0, fullName.size() - 14) + binaryExtension;
+}
+
+std::shared_ptr<SynthSequenceFile> SynthSequencer::openBinarySequence(std::string sequenceName)
+{
+  std::string binaryPath = buildBinaryPath(sequenceName);
+  if (!checkExtension(sequenceName, binaryExtension)
+      && (File::exists(buildFullPath(sequenceName)) || !File::exists(binaryPath))) {
+    return nullptr;
+  }
+  auto sequence = std::make_shared<SynthSequenceFile>();
+  if (!sequence->open(binaryPath)) {
+    std::cout << "Could not open:" << binaryPath << std::endl;
+    return nullptr;
+  }
+  return sequence;
+}
+
+bool SynthSequencer::convertToBinary(std::string sequenceName)
+{
+  std::vector<SynthSequencerEvent> events = loadSequenceEvents(sequenceName);
+  bool written = SynthSequenceFile::write(buildBinaryPath(sequenceName), events);
+  for (auto &event: events) {
+    if (event.voice) {
+      mPolySynth->insertFreeVoice(event.voice);
+    }
+  }
+  return written;
+}
+
+bool SynthSequencer::convertToText(std::string sequenceName)
+{
+  std::string binaryPath = buildBinaryPath(sequenceName);
+  SynthSequenceFile sequence;
+  if (!sequence.open(binaryPath)) {
+    return false;
+  }
+  // Text path is the binary path without "Bin"
+  return sequence.writeText(binaryPath.substr(0, binaryPath.size() - 3));
+}
+
 std::list<SynthSequencerEvent> SynthSequencer::loadSequence(std::string sequenceName, double timeOffset, double timeScale) {
+  std::vector<SynthSequencerEvent> events = loadSequenceEvents(sequenceName, timeOffset, timeScale);
+  return std::list<SynthSequencerEvent>(std::make_move_iterator(events.begin()),
+                                        std::make_move_iterator(events.end()));
+}
+
+std::vector<SynthSequencerEvent> SynthSequencer::loadSequenceEvents(std::string sequenceName, double timeOffset, double timeScale) {
   std::unique_lock<std::mutex> lk(mLoadingLock);
-  std::list<SynthSequencerEvent> events;
+  // Events are appended in file order and sorted by start time once at the end
+  std::vector<SynthSequencerEvent> events;
+  // Turn on events waiting for their turn off, oldest first, by event id
+  std::unordered_map<int, std::deque<size_t>> pendingTurnOffs;
   std::string fullName = buildFullPath(sequenceName);
   std::ifstream f(fullName);
   if (!f.is_open()) {
@@ -254,12 +398,8 @@ std::list<SynthSequencerEvent> SynthSequencer::loadSequence(std::string sequence
             mPolySynth->insertFreeVoice(newVoice); // Return voice to sequencer.
           } else {
             double absoluteTime = timeOffset + startTime;
-            // Insert into event list, sorted.
-            auto position = events.begin();
-            while(position != events.end() && position->startTime < absoluteTime) {
-              position++;
-            }
-            auto insertedEvent = events.insert(position, SynthSequencerEvent());
+            events.emplace_back();
+            auto insertedEvent = &events.back();
             // Add 0.1 padding to ensure all events play.
             insertedEvent->type = SynthSequencerEvent::EVENT_VOICE;
             insertedEvent->startTime = absoluteTime;
@@ -270,19 +410,15 @@ std::list<SynthSequencerEvent> SynthSequencer::loadSequence(std::string sequence
         }
       } else {
         double absoluteTime = timeOffset + startTime;
-        // Insert into event list, sorted.
-        auto position = events.begin();
-        while(position != events.end() && position->startTime < absoluteTime) {
-          position++;
-        }
-        auto insertedEvent = events.insert(position, SynthSequencerEvent());
+        events.emplace_back();
+        auto insertedEvent = &events.back();
         // Add 0.1 padding to ensure all events play.
         insertedEvent->type = SynthSequencerEvent::EVENT_PFIELDS;
         insertedEvent->startTime = absoluteTime;
         insertedEvent->duration = duration;
         insertedEvent->fields.name = name;
         insertedEvent->voice = nullptr;
-        insertedEvent->fields.pFields = pFields; // TODO it would be nice not to have to copy here...
+        insertedEvent->fields.pFields = std::move(pFields);
       }
 
       //                std::cout << "Done reading sequence" << std::endl;
@@ -321,16 +457,10 @@ std::list<SynthSequencerEvent> SynthSequencer::loadSequence(std::string sequence
           }
           std::cerr << std::endl;
         } else {
-          std::list<SynthSequencerEvent>::iterator insertedEvent;
           double absoluteTime = timeOffset + startTime;
-          {
-            //                            // Insert into event list, sorted.
-            auto position = events.begin();
-            while(position != events.end() && position->startTime < absoluteTime) {
-              position++;
-            }
-            insertedEvent = events.insert(position, SynthSequencerEvent());
-          }
+          pendingTurnOffs[id].push_back(events.size());
+          events.emplace_back();
+          auto insertedEvent = &events.back();
           // Add 0.1 padding to ensure all events play.
           insertedEvent->type = SynthSequencerEvent::EVENT_VOICE;
           insertedEvent->startTime = absoluteTime;
@@ -349,16 +479,16 @@ std::list<SynthSequencerEvent> SynthSequencer::loadSequence(std::string sequence
       std::getline(ss, idText);
       int id = std::stoi(idText);
       double eventTime = std::stod(time) * timeScale * tempoFactor;
-      for (SynthSequencerEvent &event: events) {
-        if (event.voice->id() == id && event.duration < 0 && event.type == SynthSequencerEvent::EVENT_VOICE) {
-          double duration = eventTime - event.startTime + timeOffset;
-          if (duration < 0) {
-            duration = 0;
-          }
-          event.duration = duration;
-          //                        std::cout << "Set event duration " << id << " to " << duration << std::endl;
-          break;
+      auto pending = pendingTurnOffs.find(id);
+      if (pending != pendingTurnOffs.end() && pending->second.size() > 0) {
+        SynthSequencerEvent &event = events[pending->second.front()];
+        pending->second.pop_front();
+        double duration = eventTime - event.startTime + timeOffset;
+        if (duration < 0) {
+          duration = 0;
         }
+        event.duration = duration;
+        //                        std::cout << "Set event duration " << id << " to " << duration << std::endl;
       }
     } else if (command == '=' && ss.get() == ' ') {
       std::string time, sequenceName, timeScaleInFile;
@@ -372,16 +502,15 @@ std::list<SynthSequencerEvent> SynthSequencer::loadSequence(std::string sequence
         sequenceName = sequenceName.substr(0, sequenceName.size() - 1);
       }
       lk.unlock();
-      auto newEvents = loadSequence(sequenceName, stod(time) + timeOffset, stod(timeScaleInFile) * tempoFactor);
+      auto newEvents = loadSequenceEvents(sequenceName, stod(time) + timeOffset, stod(timeScaleInFile) * tempoFactor);
       lk.lock();
-      events.insert(events.end(), newEvents.begin(), newEvents.end());
-      // FIXME: This sorting only works if both the existing sequence and
-      // the incoming sequence use absolute event times. Sorting
-      // anything else results in chaos... This should be detected
-      // and acted on
-      events.sort([](const SynthSequencerEvent &a, const SynthSequencerEvent &b) {
-        return a.startTime < b.startTime;
-      });
+      // Turn ons left open by the inserted sequence can be closed here
+      for (auto &event: newEvents) {
+        if (event.type == SynthSequencerEvent::EVENT_VOICE && event.duration < 0) {
+          pendingTurnOffs[event.voice->id()].push_back(events.size());
+        }
+        events.push_back(std::move(event));
+      }
     } else if (command == '>' && ss.get() == ' ') {
       std::string time;
       std::getline(ss, time);
@@ -402,6 +531,13 @@ std::list<SynthSequencerEvent> SynthSequencer::loadSequence(std::string sequence
   if (f.bad()) {
     std::cout << "Error reading:" << fullName << std::endl;
   }
+  // FIXME: This sorting only works if both the existing sequence and
+  // inserted sequences use absolute event times. Sorting
+  // anything else results in chaos... This should be detected
+  // and acted on
+  if (!std::is_sorted(events.begin(), events.end(), startsBefore)) {
+    std::stable_sort(events.begin(), events.end(), startsBefore);
+  }
   return events;
 }
 
@@ -414,7 +550,7 @@ std::vector<std::string> SynthSequencer::getSequenceList() {
 
   // get list of files ending in ".synthSequence"
   FileList sequence_files = filterInDir(path, [](const FilePath& f){
-    if (al::checkExtension(f, ".synthSequence")) return true;
+    if (al::checkExtension(f, ".synthSequence") || al::checkExtension(f, binaryExtension)) return true;
     else return false;
   });
 
@@ -423,7 +559,11 @@ std::vector<std::string> SynthSequencer::getSequenceList() {
     const FilePath& path = sequence_files[i];
     const std::string& name = path.file();
     // exclude extension when adding to sequence list
-    sequenceList.push_back(name.substr(0, name.size()-14));
+    std::string sequenceName = al::checkExtension(name, binaryExtension) ?
+          name.substr(0, name.size() - binaryExtension.size()) : name.substr(0, name.size()-14);
+    if (std::find(sequenceList.begin(), sequenceList.end(), sequenceName) == sequenceList.end()) {
+      sequenceList.push_back(sequenceName);
+    }
   }
 
 
@@ -437,8 +577,16 @@ std::vector<std::string> SynthSequencer::getSequenceList() {
 }
 
 double SynthSequencer::getSequenceDuration(std::string sequenceName) {
-  std::list<SynthSequencerEvent> events = loadSequence(sequenceName, 0.0);
   double dur = 0.0;
+  auto mappedSequence = openBinarySequence(sequenceName);
+  if (mappedSequence) {
+    for (uint64_t i = 0; i < mappedSequence->numEvents(); i++) {
+      auto &event = mappedSequence->event(i);
+      dur = std::max(dur, event.startTime + event.duration);
+    }
+    return dur;
+  }
+  std::vector<SynthSequencerEvent> events = loadSequenceEvents(sequenceName, 0.0);
   for (auto const &event: events) {
     if (event.startTime + event.duration > dur) {
       dur = event.startTime + event.duration;
@@ -449,8 +597,9 @@ double SynthSequencer::getSequenceDuration(std::string sequenceName) {
 
 void SynthSequencer::processEvents(double blockStartTime, double fpsAdjusted) {
   if (mEventLock.try_lock()) {
-
-    if (mNextEvent < mEvents.size()) {
+    bool mappedEventsPending = mMappedSequence && mNextMappedEvent < mMappedSequence->numEvents();
+    bool triggerOffThisBlock = false;
+    if (mNextEvent < mEvents.size() || mappedEventsPending) {
 
       int i = 0;
       for (auto cb: mTimeChangeCallbacks) {
@@ -462,58 +611,43 @@ void SynthSequencer::processEvents(double blockStartTime, double fpsAdjusted) {
         }
         i++;
       }
-      auto iter = mEvents.begin();
-      std::advance(iter, mNextEvent);
-      auto event = iter;
-      while (event != mEvents.end() && event->startTime <= mMasterTime - blockStartTime) {
-        event++;
-      }
-      while (event->startTime <= mMasterTime) {
-        event->offsetCounter = (event->startTime - blockStartTime)*fpsAdjusted;
-        if (event->type == SynthSequencerEvent::EVENT_VOICE) {
-          mPolySynth->triggerOn(event->voice, event->offsetCounter);
-          event->voiceId = event->voice->id();
-          event->voice = nullptr; // Voice has been consumed, all voices reamining in the event list are put back in the synth's free voice pool
-        } else if (event->type == SynthSequencerEvent::EVENT_PFIELDS){
-          auto *voice = mPolySynth->getVoice(event->fields.name);
+      // Only the events due in this block are visited
+      while (mNextEvent < mEvents.size() && mEvents[mNextEvent].startTime <= mMasterTime) {
+        SynthSequencerEvent &event = mEvents[mNextEvent];
+        event.offsetCounter = std::max(0, int((event.startTime - blockStartTime)*fpsAdjusted));
+        int voiceId = -1;
+        if (event.type == SynthSequencerEvent::EVENT_VOICE) {
+          if (event.voice) {
+            mPolySynth->triggerOn(event.voice, event.offsetCounter);
+            voiceId = event.voice->id();
+          }
+          event.voice = nullptr; // Voice has been consumed, all voices reamining in the event list are put back in the synth's free voice pool
+        } else if (event.type == SynthSequencerEvent::EVENT_PFIELDS){
+          auto *voice = mPolySynth->getVoice(event.fields.name);
           if (voice) {
-            voice->setTriggerParams(event->fields.pFields);
-            mPolySynth->triggerOn(voice, event->offsetCounter);
-            event->voiceId = voice->id();
-//            event->voice = voice;
+            voice->setTriggerParams(event.fields.pFields);
+            mPolySynth->triggerOn(voice, event.offsetCounter);
+            voiceId = voice->id();
           } else {
-            std::cerr << "SynthSequencer::processEvents: Could not get free voice '" << event->fields.name << "' for sequencer!" << std::endl;
+            std::cerr << "SynthSequencer::processEvents: Could not get free voice '" << event.fields.name << "' for sequencer!" << std::endl;
           }
-        } else if (event->type == SynthSequencerEvent::EVENT_TEMPO){
+        } else if (event.type == SynthSequencerEvent::EVENT_TEMPO){
           // TODO support tempo events
         }
-        //                std::cout << "Event " << mNextEvent << " " << event->startTime << " " << typeid(*event->voice).name() << std::endl;
-        mNextEvent++;
-        iter++;
-        if (iter == mEvents.end()) {
-          break;
+        event.voiceId = voiceId;
+        if (voiceId >= 0) {
+          triggerOffThisBlock |= pushActiveVoice(event.startTime + event.duration, voiceId);
         }
-        event = iter;
-      }
-    }
-    bool allEventsDone = true;
-    bool triggerOffThisBlock = false;
-    for (auto &event : mEvents) {
-      //            if (event.startTime*mNormalizedTempo > mMasterTime) {
-      //                break;
-      //            }
-      double eventTermination = event.startTime + event.duration;
-      if (event.voiceId >= 0 && eventTermination <= mMasterTime) {
-        mPolySynth->triggerOff(event.voiceId);
-        event.voiceId = -1;
-//        std::cout << "trigger off " <<  event.voice->id() << " " << eventTermination << " " << mMasterTime  << std::endl;
-//        event.voice = nullptr; // When an event gives up a voice, it is done.
-        triggerOffThisBlock = true;
+        mNextEvent++;
       }
-      if (eventTermination > mMasterTime) {
-        allEventsDone = false;
+      if (mMappedSequence) {
+        triggerOffThisBlock |= processMappedEvents(blockStartTime, fpsAdjusted);
       }
     }
+    // Turn off the voices whose end time falls within this block
+    triggerOffThisBlock |= turnOffEndedVoices();
+    bool allEventsDone = mNextEvent >= mEvents.size() && mActiveVoices.size() == 0
+        && (!mMappedSequence || mNextMappedEvent >= mMappedSequence->numEvents());
     if (allEventsDone && triggerOffThisBlock) { // This block marks the end of the sequence
       mPlaying = false;
       for (auto cb: mSequenceEndCallbacks) {
@@ -523,3 +657,38 @@ void SynthSequencer::processEvents(double blockStartTime, double fpsAdjusted) {
     mEventLock.unlock();
   }
 }
+
+bool SynthSequencer::processMappedEvents(double blockStartTime, double fpsAdjusted) {
+  const SynthSequenceFile &sequence = *mMappedSequence;
+  bool turnedOff = false;
+  while (mNextMappedEvent < sequence.numEvents()
+         && mMappedTimeOffset + sequence.event(mNextMappedEvent).startTime <= mMasterTime) {
+    uint64_t eventIndex = mNextMappedEvent++;
+    const SynthSequenceFile::Event &event = sequence.event(eventIndex);
+    if (!sequence.validEvent(event)) {
+      continue;
+    }
+    double startTime = mMappedTimeOffset + event.startTime;
+    int offsetCounter = std::max(0, int((startTime - blockStartTime)*fpsAdjusted));
+    const std::type_info *voiceType = mMappedVoiceTypes[event.name];
+    SynthVoice *voice = nullptr;
+    if (voiceType) {
+      voice = mPolySynth->getVoice(*voiceType, sequence.string(event.name));
+    }
+    if (!voice) {
+      std::cerr << "SynthSequencer::processEvents: Could not get free voice '" << sequence.string(event.name) << "' for sequencer!" << std::endl;
+      continue;
+    }
+    const ParameterField *fields = sequence.stringEventFields(eventIndex);
+    if (!fields) {
+      // Values are passed straight from the mapped file. setTriggerParams()
+      // only reads them.
+      voice->setTriggerParams(const_cast<float *>(sequence.fieldValues() + event.firstField), event.numFields);
+    } else {
+      voice->setTriggerParams(std::vector<ParameterField>(fields, fields + event.numFields));
+    }
+    mPolySynth->triggerOn(voice, offsetCounter);
+    turnedOff |= pushActiveVoice(startTime + event.duration, voice->id());
+  }
+  return turnedOff;
+}
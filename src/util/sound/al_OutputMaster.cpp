@@ -1,33 +1,233 @@
-
+#include <algorithm>
+#include <cfloat> // for FLT_MAX
+#include <cmath>
 #include <iostream>
-#include <sstream>
-#include <float.h> // for FLT_MAX and FLT_MIN
 
 #include "al/util/sound/al_OutputMaster.hpp"
 #include "al/core/system/al_Time.hpp"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#define AL_OUTPUTMASTER_SSE
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define AL_OUTPUTMASTER_SSE
+#endif
+
 using namespace al;
 
-template<class DataType>
-void butter_set_fc(DataType fc, DataType sr, DataType *a, DataType *b, bool lp = true)
+static const unsigned int kMaxStages = 4;
+/* Frames processed at once when signals are summed across channels */
+static const unsigned int kChunkFrames = 64;
+static const float kLoudnessFloor = -120.0f;
+
+void BiquadBank::resize(unsigned int numChannels, unsigned int numStages)
+{
+    if (numStages > kMaxStages) {
+        std::cout << "BiquadBank: Only " << kMaxStages << " stages supported." << std::endl;
+        numStages = kMaxStages;
+    }
+    m_numChannels = numChannels;
+    m_numStages = numStages;
+    m_coefficients.assign(numStages * 5, 0.0f);
+    for (unsigned int stage = 0; stage < numStages; stage++) {
+        m_coefficients[stage * 5] = 1.0f;
+    }
+    m_state.assign(((numChannels + 3) / 4) * numStages * 8, 0.0f);
+}
+
+void BiquadBank::setStage(unsigned int stage, double b0, double b1, double b2, double a1, double a2)
+{
+    assert(stage < m_numStages);
+    float *c = m_coefficients.data() + stage * 5;
+    c[0] = float(b0);
+    c[1] = float(b1);
+    c[2] = float(b2);
+    c[3] = float(a1);
+    c[4] = float(a2);
+}
+
+void BiquadBank::setButterworth(unsigned int stage, double frequency, double sampleRate, bool lowpass)
+{
+    double w0 = 2.0 * M_PI * frequency / sampleRate;
+    double cosw0 = std::cos(w0);
+    double alpha = std::sin(w0) / std::sqrt(2.0); // Q = 1/sqrt(2)
+    double a0 = 1.0 + alpha;
+    double b1 = lowpass ? 1.0 - cosw0 : -(1.0 + cosw0);
+    double b0 = std::fabs(b1) * 0.5;
+    setStage(stage, b0 / a0, b1 / a0, b0 / a0, -2.0 * cosw0 / a0, (1.0 - alpha) / a0);
+}
+
+void BiquadBank::reset()
+{
+    std::fill(m_state.begin(), m_state.end(), 0.0f);
+}
+
+#if defined(AL_OUTPUTMASTER_SSE)
+static inline __m128 biquadTick(__m128 x, __m128 *s1, __m128 *s2, const __m128 (*c)[5], unsigned int numStages)
+{
+    for (unsigned int stage = 0; stage < numStages; stage++) {
+        __m128 y = _mm_add_ps(_mm_mul_ps(x, c[stage][0]), s1[stage]);
+        s1[stage] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(x, c[stage][1]), _mm_mul_ps(y, c[stage][3])), s2[stage]);
+        s2[stage] = _mm_sub_ps(_mm_mul_ps(x, c[stage][2]), _mm_mul_ps(y, c[stage][4]));
+        x = y;
+    }
+    return x;
+}
+#endif
+
+void BiquadBank::process(float *const *out, const float *const *in, unsigned int firstChannel,
+                         unsigned int numChannels, unsigned int numFrames)
+{
+    assert(firstChannel % 4 == 0 && numChannels <= 4 && firstChannel + numChannels <= m_numChannels);
+    float *state = m_state.data() + (firstChannel / 4) * m_numStages * 8;
+#if defined(AL_OUTPUTMASTER_SSE)
+    // Four frames of four channels are transposed so that each vector holds
+    // one frame, and the four channels are filtered together
+    __m128 c[kMaxStages][5], s1[kMaxStages], s2[kMaxStages];
+    for (unsigned int stage = 0; stage < m_numStages; stage++) {
+        for (int k = 0; k < 5; k++) {
+            c[stage][k] = _mm_set1_ps(m_coefficients[stage * 5 + k]);
+        }
+        s1[stage] = _mm_loadu_ps(state + stage * 8);
+        s2[stage] = _mm_loadu_ps(state + stage * 8 + 4);
+    }
+    unsigned int i = 0;
+    if (numChannels == 4) {
+        for (; i + 4 <= numFrames; i += 4) {
+            __m128 x0 = _mm_loadu_ps(in[0] + i);
+            __m128 x1 = _mm_loadu_ps(in[1] + i);
+            __m128 x2 = _mm_loadu_ps(in[2] + i);
+            __m128 x3 = _mm_loadu_ps(in[3] + i);
+            _MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+            x0 = biquadTick(x0, s1, s2, c, m_numStages);
+            x1 = biquadTick(x1, s1, s2, c, m_numStages);
+            x2 = biquadTick(x2, s1, s2, c, m_numStages);
+            x3 = biquadTick(x3, s1, s2, c, m_numStages);
+            _MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+            _mm_storeu_ps(out[0] + i, x0);
+            _mm_storeu_ps(out[1] + i, x1);
+            _mm_storeu_ps(out[2] + i, x2);
+            _mm_storeu_ps(out[3] + i, x3);
+        }
+    }
+    // The last group of channels and the last frames, one frame at a time
+    for (; i < numFrames; i++) {
+        float frame[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (unsigned int k = 0; k < numChannels; k++) {
+            frame[k] = in[k][i];
+        }
+        _mm_storeu_ps(frame, biquadTick(_mm_loadu_ps(frame), s1, s2, c, m_numStages));
+        for (unsigned int k = 0; k < numChannels; k++) {
+            out[k][i] = frame[k];
+        }
+    }
+    for (unsigned int stage = 0; stage < m_numStages; stage++) {
+        _mm_storeu_ps(state + stage * 8, s1[stage]);
+        _mm_storeu_ps(state + stage * 8 + 4, s2[stage]);
+    }
+#else
+    for (unsigned int k = 0; k < numChannels; k++) {
+        const float *input = in[k];
+        for (unsigned int stage = 0; stage < m_numStages; stage++) {
+            const float *c = m_coefficients.data() + stage * 5;
+            float s1 = state[stage * 8 + k];
+            float s2 = state[stage * 8 + 4 + k];
+            for (unsigned int i = 0; i < numFrames; i++) {
+                float x = input[i];
+                float y = x * c[0] + s1;
+                s1 = x * c[1] - y * c[3] + s2;
+                s2 = x * c[2] - y * c[4];
+                out[k][i] = y;
+            }
+            state[stage * 8 + k] = s1;
+            state[stage * 8 + 4 + k] = s2;
+            input = out[k];
+        }
+    }
+#endif
+    // Flush the state of decayed filters before it becomes denormal
+    for (unsigned int j = 0; j < m_numStages * 8; j++) {
+        if (std::fabs(state[j]) < 1e-15f) {
+            state[j] = 0.0f;
+        }
+    }
+}
+
+/* Apply gain and clip to [-limit, limit]. When metering, also accumulate the
+ * maximum, the minimum and the sum of squares of the output. */
+template <bool meter>
+static void gainClipMeter(float *buffer, unsigned int numFrames, float gain, float limit,
+                          float &maximum, float &minimum, double &squares)
 {
-    DataType lambda;
-    DataType const0 = M_PI/(double) sr;
-    if (lp) { // low pass
-        lambda = 1/tan(fc * const0);
-    } else {
-        lambda = tan(fc * const0);
+    unsigned int i = 0;
+    float mx = maximum, mn = minimum, sq = 0.0f;
+#if defined(__AVX__)
+    const __m256 g = _mm256_set1_ps(gain);
+    const __m256 hi = _mm256_set1_ps(limit);
+    const __m256 lo = _mm256_set1_ps(-limit);
+    __m256 vmx = _mm256_set1_ps(mx), vmn = _mm256_set1_ps(mn), vsq = _mm256_setzero_ps();
+    for (; i + 8 <= numFrames; i += 8) {
+        __m256 x = _mm256_mul_ps(_mm256_loadu_ps(buffer + i), g);
+        x = _mm256_min_ps(_mm256_max_ps(x, lo), hi);
+        _mm256_storeu_ps(buffer + i, x);
+        if (meter) {
+            vmx = _mm256_max_ps(vmx, x);
+            vmn = _mm256_min_ps(vmn, x);
+            vsq = _mm256_add_ps(vsq, _mm256_mul_ps(x, x));
+        }
     }
-    DataType lambda_2 = lambda * lambda;
-    a[0] = 1.0/(1.0 + (sqrt(DataType(2.0))*lambda) + (lambda_2));
-    a[2] =a[0];
-    b[2] =a[0] * (1.0 - (sqrt(DataType(2.0))*lambda) + (lambda_2));
-    if (lp) {
-        a[1] = 2.0 * a[0];
-        b[1] = 2.0 * a[0] * (1.0 - lambda_2);
-    } else {
-        a[1] = - 2.0 * a[0];
-        b[1] = 2.0 * a[0] * (lambda_2 - 1.0);
+    if (meter) {
+        float lanes[3][8];
+        _mm256_storeu_ps(lanes[0], vmx);
+        _mm256_storeu_ps(lanes[1], vmn);
+        _mm256_storeu_ps(lanes[2], vsq);
+        for (int k = 0; k < 8; k++) {
+            mx = std::max(mx, lanes[0][k]);
+            mn = std::min(mn, lanes[1][k]);
+            sq += lanes[2][k];
+        }
+    }
+#elif defined(AL_OUTPUTMASTER_SSE)
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 hi = _mm_set1_ps(limit);
+    const __m128 lo = _mm_set1_ps(-limit);
+    __m128 vmx = _mm_set1_ps(mx), vmn = _mm_set1_ps(mn), vsq = _mm_setzero_ps();
+    for (; i + 4 <= numFrames; i += 4) {
+        __m128 x = _mm_mul_ps(_mm_loadu_ps(buffer + i), g);
+        x = _mm_min_ps(_mm_max_ps(x, lo), hi);
+        _mm_storeu_ps(buffer + i, x);
+        if (meter) {
+            vmx = _mm_max_ps(vmx, x);
+            vmn = _mm_min_ps(vmn, x);
+            vsq = _mm_add_ps(vsq, _mm_mul_ps(x, x));
+        }
+    }
+    if (meter) {
+        float lanes[3][4];
+        _mm_storeu_ps(lanes[0], vmx);
+        _mm_storeu_ps(lanes[1], vmn);
+        _mm_storeu_ps(lanes[2], vsq);
+        for (int k = 0; k < 4; k++) {
+            mx = std::max(mx, lanes[0][k]);
+            mn = std::min(mn, lanes[1][k]);
+            sq += lanes[2][k];
+        }
+    }
+#endif
+    for (; i < numFrames; i++) {
+        float x = std::min(std::max(buffer[i] * gain, -limit), limit);
+        buffer[i] = x;
+        if (meter) {
+            mx = std::max(mx, x);
+            mn = std::min(mn, x);
+            sq += x * x;
+        }
+    }
+    if (meter) {
+        maximum = mx;
+        minimum = mn;
+        squares += sq;
     }
 }
 
@@ -43,20 +243,20 @@ OutputMaster::~OutputMaster()
 
 void OutputMaster::initialize(unsigned int num_chnls, double sampleRate)
 {
+  m_framesPerSec = sampleRate;
   allocateChannels(num_chnls);
   initializeData();
-  m_framesPerSec = sampleRate;
 }
 
 void OutputMaster::setMasterGain(double gain)
 {
-	m_masterGain = gain;
+	m_masterGain = float(gain);
 }
 
 void OutputMaster::setGain(unsigned int channelIndex, double gain)
 {
     assert (channelIndex < m_numChnls);
-    m_gains[channelIndex] = gain;
+    m_gains[channelIndex] = float(gain);
 }
 
 void OutputMaster::setMuteAll(bool muteAll)
@@ -71,18 +271,16 @@ void OutputMaster::setClipperOn(bool clipperOn)
 
 void OutputMaster::setMeterUpdateFreq(double freq)
 {
-	m_meterUpdateSamples = (int)(m_framesPerSec/freq);
+	if (freq > 0) {
+		m_meterUpdateSamples = std::max(1, (int)(m_framesPerSec/freq));
+	}
 }
 
 void OutputMaster::setBassManagementFreq(double frequency)
 {
-	if (frequency > 0) {
-		for (unsigned int i = 0; i < m_numChnls; i++) {
-			butter_set_fc<float>(frequency, m_framesPerSec, m_lopass1[i].a(), m_lopass1[i].a());
-			butter_set_fc<float>(frequency, m_framesPerSec, m_lopass2[i].a(), m_lopass2[i].a());
-			butter_set_fc<float>(frequency, m_framesPerSec, m_hipass1[i].a(), m_hipass1[i].a(), false);
-			butter_set_fc<float>(frequency, m_framesPerSec, m_hipass2[i].a(), m_hipass2[i].a(), false);
-		}
+	// The filters are set in the audio callback
+	if (frequency > 0 && frequency < m_framesPerSec * 0.5) {
+		m_bassManagementFreq = float(frequency);
 	}
 }
 
@@ -96,9 +294,9 @@ void OutputMaster::setBassManagementMode(bass_mgmt_mode_t mode)
 void OutputMaster::setSwIndeces(int i1, int i2, int i3, int i4)
 {
 	swIndex[0] = i1;
-	swIndex[1] = i1;
-	swIndex[2] = i1;
-	swIndex[3] = i1;
+	swIndex[1] = i2;
+	swIndex[2] = i3;
+	swIndex[3] = i4;
 }
 
 void OutputMaster::setMeterOn(bool meterOn)
@@ -106,6 +304,11 @@ void OutputMaster::setMeterOn(bool meterOn)
 	m_meterOn = meterOn;
 }
 
+void OutputMaster::setLoudnessOn(bool loudnessOn)
+{
+	m_loudnessOn = loudnessOn;
+}
+
 
 int OutputMaster::getNumChnls()
 {
@@ -114,84 +317,165 @@ int OutputMaster::getNumChnls()
 
 void OutputMaster::onAudioCB(AudioIOData &io)
 {
-	unsigned int nframes = io.framesPerBuffer();
-	double filt_out;
-	double filt_low = 0.0;
-	double master_gain;
-
-//	m_parameterQueue.update(0);
-	master_gain = m_masterGain * (m_muteAll ? 0.0 : 1.0);
-    io.frame(0);
-    while (io()) {
-        double bassbuf = 0.0; // Accumulate sw signals
-        for (unsigned int chan = 0; chan < m_numChnls; chan++) {
-            double gain = master_gain * m_gains[chan];
-            double filt_temp;
-
-            switch (m_BassManagementMode) {
-            case BASSMODE_NONE:
-                break;
-            case BASSMODE_MIX:
-                filt_low = io.out(chan);
-                break;
-            case BASSMODE_LOWPASS:
-                filt_temp = m_lopass1[chan](io.out(chan));
-                filt_low = m_lopass1[chan](filt_temp);
-                break;
-            case BASSMODE_HIGHPASS:
-                filt_temp = m_hipass1[chan](io.out(chan));
-                filt_out = m_hipass1[chan](filt_temp);
-                io.out(chan) = filt_out;
-                break;
-            case BASSMODE_FULL:
-                filt_temp = m_lopass1[chan](io.out(chan));
-                filt_low = m_lopass1[chan](filt_temp);
-                filt_temp = m_hipass1[chan](io.out(chan));
-                filt_out = m_hipass1[chan](filt_temp);
-                io.out(chan) = filt_out;
-                break;
-            default:
-                filt_low = 0.0;
-                break;
-            }
-            bassbuf += filt_low;
-            io.out(chan) *= gain;
-            if (m_clipperOn && io.out(chan) > master_gain) {
-                io.out(chan) = master_gain;
+    unsigned int numFrames = io.framesPerBuffer();
+    unsigned int numChnls = std::min(m_numChnls, (unsigned int) io.channelsOut());
+    if (numChnls == 0) {
+        return;
+    }
+
+    // Parameters are read once per block
+    int mode = m_BassManagementMode.load();
+    if (mode != m_lastBassManagementMode) {
+        m_lopass.reset();
+        m_hipass.reset();
+        m_lastBassManagementMode = mode;
+    }
+    if (mode != BASSMODE_NONE) {
+        float frequency = m_bassManagementFreq.load();
+        if (frequency != m_filterFreq) {
+            // Linkwitz-Riley: two Butterworth filters for each side
+            for (unsigned int stage = 0; stage < 2; stage++) {
+                m_lopass.setButterworth(stage, frequency, m_framesPerSec, true);
+                m_hipass.setButterworth(stage, frequency, m_framesPerSec, false);
             }
+            m_filterFreq = frequency;
         }
-        if (m_BassManagementMode != BASSMODE_NONE) {
-            int sw;
-            for(sw = 0; sw < 4; sw++) {
-                if (swIndex[sw] < 0) continue;
-                io.out(swIndex[sw]) = bassbuf * m_gains[swIndex[sw]];
-            }
+        processBassManagement(io, numChnls, mode);
+    }
+
+    float masterGain = m_muteAll.load() ? 0.0f : m_masterGain.load();
+    float limit = m_clipperOn.load() ? std::fabs(masterGain) : FLT_MAX;
+    bool meterOn = m_meterOn.load();
+    if (meterOn && !m_meterWasOn) {
+        resetMeters();
+    }
+    m_meterWasOn = meterOn;
+
+    float *maximum = m_meterValues.data() + METER_MAX * m_numChnls;
+    float *minimum = m_meterValues.data() + METER_MIN * m_numChnls;
+    for (unsigned int chan = 0; chan < numChnls; chan++) {
+        float gain = masterGain * m_gains[chan].load(std::memory_order_relaxed);
+        if (meterOn) {
+            gainClipMeter<true>(io.outBuffer(chan), numFrames, gain, limit,
+                                maximum[chan], minimum[chan], m_meterSquares[chan]);
+        } else {
+            float unused = 0.0f;
+            double unusedSquares = 0.0;
+            gainClipMeter<false>(io.outBuffer(chan), numFrames, gain, limit,
+                                 unused, unused, unusedSquares);
         }
-        if (m_meterOn) {
-            for (unsigned int chan = 0; chan < m_numChnls; chan++) {
-                float out = io.out(chan);
-//                float absValue = fabs(out);
-                if (m_meterMax[chan] < out) {
-                    m_meterMax[chan] = out;
+    }
+    if (!meterOn) {
+        return;
+    }
+
+    bool loudnessOn = m_loudnessOn.load();
+    if (loudnessOn && !m_loudnessWasOn) {
+        resetLoudness();
+    }
+    m_loudnessWasOn = loudnessOn;
+    if (loudnessOn) {
+        processLoudness(io, numChnls);
+    }
+
+    m_meterCounter += numFrames;
+    if (m_meterCounter >= m_meterUpdateSamples.load()) {
+        float *peak = m_meterValues.data() + METER_PEAK * m_numChnls;
+        float *rms = m_meterValues.data() + METER_RMS * m_numChnls;
+        for (unsigned int chan = 0; chan < numChnls; chan++) {
+            peak[chan] = std::max(maximum[chan], -minimum[chan]);
+            rms[chan] = float(std::sqrt(m_meterSquares[chan] / m_meterCounter));
+        }
+        m_meterBuffer.write(m_meterValues.data());
+        resetMeters();
+    }
+}
+
+void OutputMaster::processBassManagement(AudioIOData &io, unsigned int numChnls, int mode)
+{
+    unsigned int numFrames = io.framesPerBuffer();
+    bool lowpass = mode == BASSMODE_LOWPASS || mode == BASSMODE_FULL;
+    bool highpass = mode == BASSMODE_HIGHPASS || mode == BASSMODE_FULL;
+    int subwoofers[4];
+    for (int sw = 0; sw < 4; sw++) {
+        subwoofers[sw] = swIndex[sw].load();
+    }
+
+    float bass[kChunkFrames];
+    float lowpassed[4][kChunkFrames];
+    float *lows[4] = {lowpassed[0], lowpassed[1], lowpassed[2], lowpassed[3]};
+    for (unsigned int start = 0; start < numFrames; start += kChunkFrames) {
+        unsigned int n = std::min(kChunkFrames, numFrames - start);
+        std::fill(bass, bass + n, 0.0f);
+        for (unsigned int chan = 0; chan < numChnls; chan += 4) {
+            unsigned int groupSize = std::min(4u, numChnls - chan);
+            float *buffers[4];
+            for (unsigned int k = 0; k < groupSize; k++) {
+                buffers[k] = io.outBuffer(chan + k) + start;
+            }
+            if (mode == BASSMODE_MIX || lowpass) {
+                float **sources = buffers;
+                if (lowpass) {
+                    m_lopass.process(lows, buffers, chan, groupSize, n);
+                    sources = lows;
                 }
-                if (m_meterMin[chan] > out) {
-                    m_meterMin[chan] = out;
+                for (unsigned int k = 0; k < groupSize; k++) {
+                    for (unsigned int i = 0; i < n; i++) {
+                        bass[i] += sources[k][i];
+                    }
                 }
             }
-            m_meterCounter++;
-            if (m_meterCounter >= m_meterUpdateSamples) {
-                m_meterMaxBuffer.write(m_meterMax.data());
-                m_meterCounter = m_meterCounter - m_meterUpdateSamples;
-                for (unsigned int chan = 0; chan < m_numChnls; chan++) {
-                  //FIXME offload to separate thread, trigger by condition variable
-                  // FIXME on separate thread allow both printing and sending values via OSC
-                  std::cout <<  m_meterMax[chan] << " : " << m_meterMin[chan] << " ---- " << std::endl;
-                    m_meterMax[chan] = FLT_MIN;
-                    m_meterMin[chan] = FLT_MAX;
+            if (highpass) {
+                m_hipass.process(buffers, buffers, chan, groupSize, n);
+            }
+        }
+        // The subwoofers get the bass, and then their gain like the other channels
+        for (int sw = 0; sw < 4; sw++) {
+            if (subwoofers[sw] >= 0 && subwoofers[sw] < int(numChnls)) {
+                std::copy(bass, bass + n, io.outBuffer(subwoofers[sw]) + start);
+            }
+        }
+    }
+}
+
+void OutputMaster::processLoudness(AudioIOData &io, unsigned int numChnls)
+{
+    unsigned int numFrames = io.framesPerBuffer();
+    float weighted[4][kChunkFrames];
+    float *outputs[4] = {weighted[0], weighted[1], weighted[2], weighted[3]};
+    for (unsigned int chan = 0; chan < numChnls; chan += 4) {
+        unsigned int groupSize = std::min(4u, numChnls - chan);
+        const float *inputs[4];
+        for (unsigned int start = 0; start < numFrames; start += kChunkFrames) {
+            unsigned int n = std::min(kChunkFrames, numFrames - start);
+            for (unsigned int k = 0; k < groupSize; k++) {
+                inputs[k] = io.outBuffer(chan + k) + start;
+            }
+            m_kWeighting.process(outputs, inputs, chan, groupSize, n);
+            float sum = 0.0f;
+            for (unsigned int k = 0; k < groupSize; k++) {
+                for (unsigned int i = 0; i < n; i++) {
+                    sum += weighted[k][i] * weighted[k][i];
                 }
             }
+            m_loudnessSum += sum;
         }
-	}
+    }
+    m_loudnessCounter += numFrames;
+    // Mean square of 100 ms blocks, and the loudness of the last four
+    if (m_loudnessCounter >= int(m_framesPerSec * 0.1)) {
+        m_loudnessSquares[m_loudnessBlock] = m_loudnessSum / m_loudnessCounter;
+        m_loudnessBlock = (m_loudnessBlock + 1) % 4;
+        m_loudnessSum = 0.0;
+        m_loudnessCounter = 0;
+        double meanSquare = 0.25 * (m_loudnessSquares[0] + m_loudnessSquares[1] +
+                                    m_loudnessSquares[2] + m_loudnessSquares[3]);
+        float loudness = kLoudnessFloor;
+        if (meanSquare > 0.0) {
+            loudness = std::max(kLoudnessFloor, float(-0.691 + 10.0 * std::log10(meanSquare)));
+        }
+        m_meterValues[METER_COUNT * m_numChnls] = loudness;
+    }
 }
 
 void OutputMaster::setGainTimestamped(al_sec until, int channelIndex, double gain)
@@ -265,37 +549,78 @@ int OutputMaster::chanIsSubwoofer(int index)
 
 void OutputMaster::initializeData()
 {
-	m_masterGain = 1.0;
+	m_masterGain = 1.0f;
 	m_muteAll = false;
 	m_clipperOn = true;
 	m_addressPrefix = "/Alloaudio";
-	m_meterCounter = 0;
 	m_meterOn = false;
+	m_meterWasOn = false;
+	m_loudnessOn = false;
+	m_loudnessWasOn = false;
 	m_meterAddrHasChannel = false;
 
 	setBassManagementMode(BASSMODE_NONE);
+	m_lastBassManagementMode = BASSMODE_NONE;
+	m_filterFreq = 0.0f;
 	setBassManagementFreq(150);
 	setMeterUpdateFreq(10.0);
+
+	// K-weighting for loudness (ITU-R BS.1770), a high shelf and a high pass
+	double K = std::tan(M_PI * 1681.974450955533 / m_framesPerSec);
+	double Q = 0.7071752369554196;
+	double Vh = std::pow(10.0, 3.999843853973347 / 20.0);
+	double Vb = std::pow(Vh, 0.4996667741545416);
+	double a0 = 1.0 + K / Q + K * K;
+	m_kWeighting.setStage(0, (Vh + Vb * K / Q + K * K) / a0, 2.0 * (K * K - Vh) / a0,
+	                      (Vh - Vb * K / Q + K * K) / a0, 2.0 * (K * K - 1.0) / a0,
+	                      (1.0 - K / Q + K * K) / a0);
+	K = std::tan(M_PI * 38.13547087602444 / m_framesPerSec);
+	Q = 0.5003270373238773;
+	a0 = 1.0 + K / Q + K * K;
+	m_kWeighting.setStage(1, 1.0, -2.0, 1.0, 2.0 * (K * K - 1.0) / a0, (1.0 - K / Q + K * K) / a0);
+
+	resetMeters();
+	resetLoudness();
 }
 
 void OutputMaster::allocateChannels(unsigned int numChnls)
 {
-	m_gains.resize(numChnls);
-    m_meterMaxBuffer.setSize(numChnls);
-    m_meterMinBuffer.setSize(numChnls);
-    m_meterMax.resize(numChnls);
-    m_meterMin.resize(numChnls);
+	m_gains.reset(new std::atomic<float>[numChnls]);
+	for (unsigned int i = 0; i < numChnls; i++) {
+		m_gains[i] = 1.0f;
+	}
+	m_meterValues.assign(METER_COUNT * numChnls + 1, 0.0f);
+	m_meterSquares.assign(numChnls, 0.0);
+	m_meterBuffer.setSize(METER_COUNT * numChnls + 1);
+	for (auto &lastRead : m_lastMeterRead) {
+		lastRead = 0;
+	}
 
-	m_lopass1.resize(numChnls);
-	m_lopass2.resize(numChnls);
-	m_hipass1.resize(numChnls);
-	m_hipass2.resize(numChnls);
+	m_lopass.resize(numChnls, 2);
+	m_hipass.resize(numChnls, 2);
+	m_kWeighting.resize(numChnls, 2);
 	swIndex[0] = numChnls - 1;
 	swIndex[1] =  swIndex[2] = swIndex[3] = -1;
 
-	for (unsigned int i = 0; i < numChnls; i++) {
-		m_gains[i] = 1.0;
-	}
     m_numChnls = numChnls;
 }
 
+void OutputMaster::resetMeters()
+{
+	m_meterCounter = 0;
+	std::fill(m_meterValues.begin() + METER_MAX * m_numChnls,
+	          m_meterValues.begin() + METER_MIN * m_numChnls, -FLT_MAX);
+	std::fill(m_meterValues.begin() + METER_MIN * m_numChnls,
+	          m_meterValues.begin() + METER_RMS * m_numChnls, FLT_MAX);
+	std::fill(m_meterSquares.begin(), m_meterSquares.end(), 0.0);
+}
+
+void OutputMaster::resetLoudness()
+{
+	m_kWeighting.reset();
+	std::fill(m_loudnessSquares, m_loudnessSquares + 4, 0.0);
+	m_loudnessSum = 0.0;
+	m_loudnessCounter = 0;
+	m_loudnessBlock = 0;
+	m_meterValues[METER_COUNT * m_numChnls] = kLoudnessFloor;
+}
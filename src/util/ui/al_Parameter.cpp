@@ -3,6 +3,7 @@
 #include <fstream>
 #include <sstream>
 #include <regex>
+#include <chrono>
 
 #include "al/util/ui/al_Parameter.hpp"
 #include "al/core/io/al_File.hpp"
@@ -17,18 +18,16 @@ Parameter::Parameter(std::string parameterName, std::string Group,
                      float max) :
     ParameterWrapper<float>(parameterName, Group, defaultValue, prefix, min, max)
 {
-  mFloatValue = defaultValue;
 }
 
 Parameter::Parameter(std::string parameterName, float defaultValue, float min, float max) :
   ParameterWrapper<float>(parameterName, "", defaultValue, "", min, max)
 {
-  mFloatValue = defaultValue;
 }
 
 float Parameter::get()
 {
-	return mFloatValue;
+	return mValue.load();
 }
 
 void Parameter::setNoCalls(float value, void *blockReceiver)
@@ -39,12 +38,10 @@ void Parameter::setNoCalls(float value, void *blockReceiver)
         value = (*mProcessCallback)(value); //, mProcessUdata);
 	}
     if (blockReceiver) {
-        for(auto cb:mCallbacks) {
-            (*cb)(value);
-        }
-	}
-
-	mFloatValue = value;
+        storeAndNotify(value);
+	} else {
+        mValue.store(value);
+    }
 }
 
 void Parameter::set(float value)
@@ -54,10 +51,7 @@ void Parameter::set(float value)
     if (mProcessCallback) {
         value = (*mProcessCallback)(value); //, mProcessUdata);
     }
-    for(auto cb:mCallbacks) {
-        (*cb)(value);
-    }
-    mFloatValue = value;
+    storeAndNotify(value);
 }
 
 // ParameterInt ------------------------------------------------------------------
@@ -68,12 +62,11 @@ ParameterInt::ParameterInt(std::string parameterName, std::string Group,
                      int32_t max) :
     ParameterWrapper<int32_t>(parameterName, Group, defaultValue, prefix, min, max)
 {
-	mIntValue = defaultValue;
 }
 
 int32_t ParameterInt::get()
 {
-	return mIntValue;
+	return mValue.load();
 }
 
 void ParameterInt::setNoCalls(int32_t value, void *blockReceiver)
@@ -84,12 +77,10 @@ void ParameterInt::setNoCalls(int32_t value, void *blockReceiver)
         value = (*mProcessCallback)(value); //, mProcessUdata);
 	}
     if (blockReceiver) {
-        for(auto cb:mCallbacks) {
-            (*cb)(value);
-        }
-	}
-
-	mIntValue = value;
+        storeAndNotify(value);
+	} else {
+        mValue.store(value);
+    }
 }
 
 void ParameterInt::set(int32_t value)
@@ -99,10 +90,61 @@ void ParameterInt::set(int32_t value)
     if (mProcessCallback) {
         value = (*mProcessCallback)(value); //, mProcessUdata);
     }
-    for(auto cb:mCallbacks) {
-        (*cb)(value);
+    storeAndNotify(value);
+}
+
+// ParameterNotifier ------------------------------------------------------------
+ParameterNotifier::ParameterNotifier(bool runThread, double period, size_t queueSize) :
+    mQueue(queueSize), mPeriod(period)
+{
+    if (runThread) {
+        mRunning = true;
+        mThread = std::thread([this]() {
+            while (mRunning) {
+                processNotifications();
+                std::this_thread::sleep_for(std::chrono::duration<double>(mPeriod));
+            }
+        });
+    }
+}
+
+ParameterNotifier::~ParameterNotifier()
+{
+    if (mRunning) {
+        mRunning = false;
+        mThread.join();
+    }
+}
+
+void ParameterNotifier::processNotifications()
+{
+    std::lock_guard<std::mutex> lk(mProcessLock);
+    mProcessingThread = std::this_thread::get_id();
+    ParameterMeta *param;
+    while (mQueue.pop(param)) {
+        auto forgotten = mForgotten.find(param);
+        if (forgotten != mForgotten.end()) {
+            mForgotten.erase(forgotten);
+            continue;
+        }
+        param->runDeferredCallbacks();
+    }
+    mProcessingThread = std::thread::id();
+}
+
+void ParameterNotifier::forget(ParameterMeta *param, const std::atomic<bool> &queued)
+{
+    if (mProcessingThread.load() == std::this_thread::get_id()) {
+        // Destroyed by a callback, the lock is already held
+        if (queued) {
+            mForgotten.insert(param);
+        }
+        return;
+    }
+    std::lock_guard<std::mutex> lk(mProcessLock);
+    if (queued) {
+        mForgotten.insert(param);
     }
-    mIntValue = value;
 }
 
 // ParameterBool ------------------------------------------------------------------
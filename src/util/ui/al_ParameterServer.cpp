@@ -182,10 +182,24 @@ bool ParameterServer::listen(int oscPort, std::string oscAddress)
     return true;
 }
 
+// Addresses that setParameterValueFromMessage() accepts for param
+static std::vector<std::string> messageAddresses(ParameterMeta &param)
+{
+    std::string address = param.getFullAddress();
+    if (strcmp(typeid(param).name(), typeid(ParameterPose).name()) == 0) {
+        return {address, address + "/pos", address + "/pos/x",
+                    address + "/pos/y", address + "/pos/z"};
+    }
+    return {address};
+}
+
 ParameterServer &ParameterServer::registerParameter(ParameterMeta &param)
 {
     mParameterLock.lock();
     mParameters.push_back(&param);
+    for (auto &address : messageAddresses(param)) {
+        mParameterIndex.emplace(address, &param);
+    }
     mParameterLock.unlock();
     mListenerLock.lock();
     if (strcmp(typeid(param).name(), typeid(ParameterBool).name() ) == 0) { // ParameterBool
@@ -261,10 +275,16 @@ ParameterServer &ParameterServer::registerParameterBundle(ParameterBundle &bundl
 void ParameterServer::unregisterParameter(ParameterMeta &param)
 {
     std::unique_lock<std::mutex> lk(mParameterLock);
-    auto it = mParameters.begin();
-    for(it = mParameters.begin(); it != mParameters.end(); it++) {
-        if (*it == &param) {
-            mParameters.erase(it);
+    mParameters.erase(std::remove(mParameters.begin(), mParameters.end(), &param),
+                      mParameters.end());
+    for (auto &address : messageAddresses(param)) {
+        auto range = mParameterIndex.equal_range(address);
+        for (auto it = range.first; it != range.second;) {
+            if (it->second == &param) {
+                it = mParameterIndex.erase(it);
+            } else {
+                it++;
+            }
         }
     }
 }
@@ -293,8 +313,10 @@ void ParameterServer::onMessage(osc::Message &m)
         return;
     }
     mParameterLock.lock();
-    for(ParameterMeta *param: mParameters) {
-        if (setParameterValueFromMessage(param, m.addressPattern(), m)) {
+    // Only parameters registered under this exact address can match
+    auto range = mParameterIndex.equal_range(m.addressPattern());
+    for (auto it = range.first; it != range.second; it++) {
+        if (setParameterValueFromMessage(it->second, it->first, m)) {
             m.resetStream();
         }
     }
@@ -508,7 +530,7 @@ void ParameterServer::changePoseCallback(Pose value, void *sender, void *userDat
     server->notifyListeners(parameter->getFullAddress(), value);
 }
 
-bool ParameterServer::setParameterValueFromMessage(ParameterMeta *param, std::string address, osc::Message &m)
+bool ParameterServer::setParameterValueFromMessage(ParameterMeta *param, const std::string &address, osc::Message &m)
 {
     if (strcmp(typeid(*param).name(), typeid(ParameterBool).name() ) == 0) { // ParameterBool
         ParameterBool *p = dynamic_cast<ParameterBool *>(param);
@@ -677,8 +699,8 @@ void ParameterServer::setValuesForBundleGroup(osc::Message &m, std::vector<Param
     for (auto bundle: bundleGroup) {
         std::string bundlePrefix = bundle->bundlePrefix();
         if (rootAddress.compare(0, bundlePrefix.size(), bundlePrefix) == 0) {
+            std::string subAddress = rootAddress.substr(bundlePrefix.size());
             for (ParameterMeta *p: bundle->parameters()) {
-                std::string subAddress = rootAddress.substr(bundlePrefix.size());
                 if (setParameterValueFromMessage(p, subAddress, m)) {
                     m.resetStream();
                     //                            std::cout << " match " << p->getFullAddress() <<std::endl;
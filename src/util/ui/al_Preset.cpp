@@ -158,25 +158,8 @@ void PresetHandler::storePreset(int index, std::string name, bool overwrite)
 		}
 	}
     ParameterStates values;
-	for(ParameterMeta *p: mParameters) {
-        values[p->getFullAddress()] = getParameterValue(p);
-	}
-    for (auto bundleGroup: mBundles) {
-        std::string bundleName = "/" + bundleGroup.first + "/";
-
-        for(unsigned int i = 0; i < bundleGroup.second.size(); i++) {
-            std::string bundlePrefix = bundleName + std::to_string(i);
-            for(ParameterMeta *p: bundleGroup.second.at(i)->parameters()) {
-                values[bundlePrefix + p->getFullAddress()] = getParameterValue(p);
-            }
-            for(auto subBundle: bundleGroup.second.at(i)->bundles()) {
-                auto bundleStates = getBundleStates(subBundle.second, subBundle.first);
-                for (auto &bundleValues: bundleStates) {
-                    values[bundlePrefix  + "/" + bundleValues.first] = bundleValues.second;
-
-                }
-            }
-        }
+    for (auto &parameter: presetParameters()) {
+        values[parameter.first] = getParameterValue(parameter.second);
     }
 
 	savePresetValues(values, name, overwrite);
@@ -756,20 +739,30 @@ void PresetHandler::morphingFunction(al::PresetHandler *handler)
     // handler->mMorphLock.unlock();
 }
 
-PresetHandler::ParameterStates PresetHandler::getBundleStates(ParameterBundle *bundle, std::string id)
+std::vector<std::pair<std::string, ParameterMeta *>> PresetHandler::presetParameters()
 {
-    ParameterStates values;
-    std::string bundlePrefix = bundle->name() + "/" + id;
-    for(ParameterMeta *p: bundle->parameters()) {
-        values[bundlePrefix + p->getFullAddress()] = getParameterValue(p);
+    std::vector<std::pair<std::string, ParameterMeta *>> parameters;
+    for (ParameterMeta *p: mParameters) {
+        parameters.push_back({p->getFullAddress(), p});
     }
-    for(auto b: bundle->bundles()) {
-        auto subBundleValues = getBundleStates(b.second, b.first);
-        for (auto bundleValue: subBundleValues) {
-            values[bundlePrefix + "/" + bundleValue.first ] = bundleValue.second;
+    for (auto bundleGroup: mBundles) {
+        std::string bundleName = "/" + bundleGroup.first + "/";
+        for (unsigned int i = 0; i < bundleGroup.second.size(); i++) {
+            getBundleParameters(bundleGroup.second.at(i), bundleName + std::to_string(i), parameters);
         }
     }
-    return values;
+    return parameters;
+}
+
+void PresetHandler::getBundleParameters(ParameterBundle *bundle, std::string prefix,
+                                        std::vector<std::pair<std::string, ParameterMeta *>> &parameters)
+{
+    for (ParameterMeta *p: bundle->parameters()) {
+        parameters.push_back({prefix + p->getFullAddress(), p});
+    }
+    for (auto b: bundle->bundles()) {
+        getBundleParameters(b.second, prefix + "/" + b.second->name() + "/" + b.first, parameters);
+    }
 }
 
 PresetHandler::ParameterStates PresetHandler::loadPresetValues(std::string name)
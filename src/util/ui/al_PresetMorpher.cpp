@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <typeinfo>
+
+#include "al/util/ui/al_PresetMorpher.hpp"
+
+using namespace al;
+
+struct PresetMorpher::Morph {
+    float morphTime {0};
+    bool hold {false}; // Stop at the current values
+    // Per slot. Slots with no value in start or target are filled in from
+    // the current values when the morph starts
+    std::vector<float> start;
+    std::vector<float> target;
+    std::vector<float> delta;
+    std::vector<char> hasStart;
+    std::vector<char> hasTarget;
+    Morph *next {nullptr}; // For AtomicHandoff
+};
+
+PresetMorpher::PresetMorpher(PresetHandler &handler, MorphRate rate) :
+    mHandler(handler), mRate(rate)
+{
+}
+
+PresetMorpher::~PresetMorpher()
+{
+    clear();
+}
+
+void PresetMorpher::clear()
+{
+    delete mActive;
+    mActive = nullptr;
+    mMorphing = false;
+    mHandoff.clear();
+}
+
+void PresetMorpher::compile()
+{
+    clear();
+    mEntries.clear();
+    mSlots.clear();
+    mSteppedSlots.clear();
+    mCurrent.clear();
+    for (auto &parameter: mHandler.presetParameters()) {
+        ParameterMeta *p = parameter.second;
+        std::vector<float> values = PresetHandler::getParameterValue(p);
+        if (values.size() == 0) {
+            continue;
+        }
+        unsigned int slot = mCurrent.size();
+        mSlots[parameter.first] = mEntries.size();
+        mEntries.push_back({p, slot, (unsigned int) values.size()});
+        const char *type = typeid(*p).name();
+        bool ramp = strcmp(type, typeid(Parameter).name()) == 0
+                || strcmp(type, typeid(ParameterVec3).name()) == 0
+                || strcmp(type, typeid(ParameterVec4).name()) == 0
+                || strcmp(type, typeid(ParameterPose).name()) == 0
+                || strcmp(type, typeid(ParameterColor).name()) == 0;
+        for (unsigned int i = 0; i < values.size(); i++) {
+            if (!ramp) {
+                mSteppedSlots.push_back(slot + i);
+            }
+            mCurrent.push_back(values[i]);
+        }
+    }
+    mNumSlots = mCurrent.size();
+    mIncrements.assign(mNumSlots, 0.0f);
+    mRampFrames = 0;
+    mEndedInBlock = false;
+    mValues.reset(new std::atomic<float>[mNumSlots]);
+    for (unsigned int i = 0; i < mNumSlots; i++) {
+        mValues[i].store(mCurrent[i], std::memory_order_relaxed);
+    }
+}
+
+int PresetMorpher::slot(std::string address) const
+{
+    auto it = mSlots.find(address);
+    if (it == mSlots.end()) {
+        return -1;
+    }
+    return mEntries[it->second].slot;
+}
+
+bool PresetMorpher::morphTo(std::string presetName, float morphTime)
+{
+    ParameterStates states = mHandler.loadPresetValues(presetName);
+    if (states.size() == 0) {
+        std::cout << "PresetMorpher: Could not load preset " << presetName << std::endl;
+        return false;
+    }
+    morphTo(states, morphTime);
+    return true;
+}
+
+void PresetMorpher::morphTo(const ParameterStates &parameterStates, float morphTime)
+{
+    Morph *morph = newMorph(morphTime);
+    fill(morph, parameterStates, false);
+    mHandoff.publish(morph);
+}
+
+void PresetMorpher::morph(const ParameterStates &from, const ParameterStates &to, float morphTime)
+{
+    Morph *morph = newMorph(morphTime);
+    fill(morph, from, true);
+    fill(morph, to, false);
+    mHandoff.publish(morph);
+}
+
+void PresetMorpher::stopMorph()
+{
+    Morph *morph = newMorph(0);
+    morph->hold = true;
+    mHandoff.publish(morph);
+}
+
+void PresetMorpher::updateParameters()
+{
+    std::vector<float> values;
+    for (auto &entry: mEntries) {
+        values.resize(entry.size);
+        for (unsigned int i = 0; i < entry.size; i++) {
+            values[i] = value(entry.slot + i);
+        }
+        PresetHandler::setParameterValues(entry.parameter, values, 0.0);
+    }
+}
+
+PresetMorpher::Morph *PresetMorpher::newMorph(float morphTime)
+{
+    Morph *morph = new Morph;
+    morph->morphTime = std::max(morphTime, 0.0f);
+    morph->start.resize(mNumSlots);
+    morph->target.resize(mNumSlots);
+    morph->delta.resize(mNumSlots);
+    morph->hasStart.assign(mNumSlots, 0);
+    morph->hasTarget.assign(mNumSlots, 0);
+    return morph;
+}
+
+void PresetMorpher::fill(Morph *morph, const ParameterStates &states, bool start)
+{
+    std::vector<float> &values = start ? morph->start : morph->target;
+    std::vector<char> &hasValue = start ? morph->hasStart : morph->hasTarget;
+    for (auto &state: states) {
+        auto slotIt = mSlots.find(state.first);
+        if (slotIt == mSlots.end()) {
+            if (mHandler.verbose()) {
+                std::cout << "Parameter not found " << state.first << std::endl;
+            }
+            continue;
+        }
+        const Entry &entry = mEntries[slotIt->second];
+        if (state.second.size() != entry.size) {
+            std::cout << "Unexpected number of values for " << state.first << std::endl;
+            continue;
+        }
+        for (unsigned int i = 0; i < entry.size; i++) {
+            values[entry.slot + i] = state.second[i];
+            hasValue[entry.slot + i] = 1;
+        }
+    }
+}
+
+void PresetMorpher::update(double framesPerSecond)
+{
+    Morph *morph = mHandoff.take();
+    if (!morph) {
+        return;
+    }
+    if (mActive) {
+        mHandoff.retire(mActive);
+    }
+    mActive = morph;
+    float *start = morph->start.data();
+    float *target = morph->target.data();
+    for (unsigned int i = 0; i < mNumSlots; i++) {
+        if (morph->hold || !morph->hasStart[i]) {
+            start[i] = mCurrent[i];
+        }
+        if (morph->hold || !morph->hasTarget[i]) {
+            target[i] = start[i];
+        }
+    }
+    for (auto slot: mSteppedSlots) {
+        start[slot] = target[slot];
+    }
+    for (unsigned int i = 0; i < mNumSlots; i++) {
+        morph->delta[i] = target[i] - start[i];
+    }
+    std::copy(start, start + mNumSlots, mCurrent.begin());
+    mEndedInBlock = false;
+    mElapsedFrames = 0;
+    mMorphFrames = std::round(morph->morphTime * framesPerSecond);
+    mMorphing = true;
+}
+
+void PresetMorpher::process(unsigned int numFrames, double framesPerSecond)
+{
+    update(framesPerSecond);
+    if (!mActive) {
+        if (mEndedInBlock) {
+            // The last morph ended during the previous block
+            mEndedInBlock = false;
+            for (unsigned int i = 0; i < mNumSlots; i++) {
+                mValues[i].store(mCurrent[i], std::memory_order_relaxed);
+            }
+            mRampFrames = 0;
+        }
+        return;
+    }
+
+    const float *start = mActive->start.data();
+    const float *delta = mActive->delta.data();
+    float *current = mCurrent.data();
+    bool sampleRate = mRate == MORPH_SAMPLE && mElapsedFrames < mMorphFrames;
+    if (sampleRate) {
+        // Values at the start of the block ramp by the increments
+        float position = float(mElapsedFrames / mMorphFrames);
+        float scale = float(1.0 / mMorphFrames);
+        for (unsigned int i = 0; i < mNumSlots; i++) {
+            current[i] = start[i] + delta[i] * position;
+            mIncrements[i] = delta[i] * scale;
+        }
+        mRampFrames = (unsigned int) std::min(double(numFrames), mMorphFrames - mElapsedFrames);
+    } else {
+        mRampFrames = 0;
+    }
+    mElapsedFrames += numFrames;
+    bool done = mElapsedFrames >= mMorphFrames;
+    if (!sampleRate) {
+        if (done) {
+            std::copy(mActive->target.begin(), mActive->target.end(), mCurrent.begin());
+        } else {
+            float position = float(mElapsedFrames / mMorphFrames);
+            for (unsigned int i = 0; i < mNumSlots; i++) {
+                current[i] = start[i] + delta[i] * position;
+            }
+        }
+    }
+    for (unsigned int i = 0; i < mNumSlots; i++) {
+        mValues[i].store(current[i], std::memory_order_relaxed);
+    }
+    if (done) {
+        if (sampleRate) {
+            // Published at the start of the next block
+            std::copy(mActive->target.begin(), mActive->target.end(), mCurrent.begin());
+            mEndedInBlock = true;
+        }
+        mHandoff.retire(mActive);
+        mActive = nullptr;
+        mMorphing = false;
+    }
+}
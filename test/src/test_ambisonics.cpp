@@ -0,0 +1,200 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "al/core/io/al_AudioIOData.hpp"
+#include "al/core/sound/al_Ambisonics.hpp"
+
+using namespace al;
+
+static double legendre(int l, double x) {
+    double p2 = 1, p1 = x;
+    if (l == 0) return 1;
+    for (int k = 2; k <= l; k++) {
+        double p = ((2 * k - 1) * x * p1 - (k - 1) * p2) / k;
+        p2 = p1;
+        p1 = p;
+    }
+    return p1;
+}
+
+static Vec3d randomDirection(int i) {
+    return Vec3d(std::sin(i * 1.7 + 0.3), std::cos(i * 2.3), std::sin(i * 0.9 - 1.1)).normalize();
+}
+
+TEST_CASE( "ACN/SN3D encoding" ) {
+    float ws[64];
+    Vec3d v = randomDirection(1);
+    AmbiBase::encodeWeightsACN(ws, 3, 2, v.x, v.y, v.z);
+    REQUIRE(ws[0] == 1.0f);
+    REQUIRE(ws[1] == Approx(v.y));
+    REQUIRE(ws[2] == Approx(v.z));
+    REQUIRE(ws[3] == Approx(v.x));
+    REQUIRE(ws[4] == Approx(std::sqrt(3.0) * v.x * v.y));
+    REQUIRE(ws[6] == Approx(0.5 * (3 * v.z * v.z - 1)));
+    REQUIRE(ws[8] == Approx(std::sqrt(3.0) / 2 * (v.x * v.x - v.y * v.y)));
+
+    // SN3D harmonics of each order sum to P_l(cos(angle)) for two directions
+    float ws2[64];
+    Vec3d v2 = randomDirection(2);
+    AmbiBase::encodeWeightsACN(ws, 3, 7, v.x, v.y, v.z);
+    AmbiBase::encodeWeightsACN(ws2, 3, 7, v2.x, v2.y, v2.z);
+    for (int l = 0; l <= 7; l++) {
+        double sum = 0;
+        for (int c = l * l; c < (l + 1) * (l + 1); c++) {
+            sum += ws[c] * ws2[c];
+        }
+        REQUIRE(sum == Approx(legendre(l, v.dot(v2))).margin(1e-5));
+    }
+
+    // 2D uses the sectoral harmonics
+    AmbiBase::encodeWeightsACN(ws2, 2, 7, v.x, v.y, v.z);
+    for (int l = 1; l <= 7; l++) {
+        REQUIRE(ws2[2 * l - 1] == Approx(ws[l * l]));
+        REQUIRE(ws2[2 * l] == Approx(ws[l * l + 2 * l]));
+    }
+
+    AmbiEncode encoder(3, 9, AmbiBase::ACN_SN3D);
+    REQUIRE(encoder.order() == 7);
+    REQUIRE(encoder.channels() == 64);
+    REQUIRE(AmbiBase::channelsToOrder(64) == 7);
+}
+
+TEST_CASE( "ACN/SN3D sound field rotation" ) {
+    Quatd q = Quatd().fromAxisAngle(1.1, Vec3d(0.3, -0.8, 0.5).normalize());
+    Mat3d rot;
+    for (int j = 0; j < 3; j++) {
+        Vec3d axis;
+        axis[j] = 1;
+        Vec3d column = q.rotate(axis);
+        for (int i = 0; i < 3; i++) {
+            rot(i, j) = column[i];
+        }
+    }
+    const int order = 7;
+    std::vector<float> matrices(AmbiBase::rotationSize(order));
+    AmbiBase::rotationMatrices(matrices.data(), order, rot);
+
+    for (int i = 0; i < 4; i++) {
+        Vec3d v = randomDirection(i);
+        Vec3d rotated = q.rotate(v);
+        float ws[64], expected[64];
+        AmbiBase::encodeWeightsACN(ws, 3, order, v.x, v.y, v.z);
+        AmbiBase::encodeWeightsACN(expected, 3, order, rotated.x, rotated.y, rotated.z);
+        const float *matrix = matrices.data();
+        for (int l = 0; l <= order; l++) {
+            int size = 2 * l + 1;
+            for (int m = 0; m < size; m++) {
+                double sum = 0;
+                for (int n = 0; n < size; n++) {
+                    sum += matrix[m * size + n] * ws[l * l + n];
+                }
+                REQUIRE(sum == Approx(expected[l * l + m]).margin(1e-4));
+            }
+            matrix += size * size;
+        }
+    }
+}
+
+TEST_CASE( "AmbiDecode matches scalar decoding" ) {
+    const int numSpeakers = 13;
+    const int numFrames = 37;
+    for (auto format : {AmbiBase::FUMA, AmbiBase::ACN_SN3D}) {
+        int order = format == AmbiBase::FUMA ? 3 : 5;
+        AmbiDecode decoder(3, order, numSpeakers, 3, format);
+        Speakers speakers;
+        for (int s = 0; s < numSpeakers; s++) {
+            // Speakers 4 and 5 share an output
+            speakers.push_back(Speaker(s == 5 ? 4 : s, 360.0f * s / numSpeakers, 40.0f * std::sin(s)));
+        }
+        speakers[7].gain = 0;
+        decoder.setSpeakers(speakers);
+        for (int s = 0; s < numSpeakers; s++) {
+            decoder.setSpeaker(s, speakers[s].deviceChannel, speakers[s].azimuth,
+                               speakers[s].elevation, speakers[s].gain);
+        }
+
+        int numChannels = decoder.channels();
+        std::vector<float> ambi(numChannels * numFrames);
+        for (size_t i = 0; i < ambi.size(); i++) {
+            ambi[i] = std::sin(i * 0.37f);
+        }
+        std::vector<float> out(numSpeakers * numFrames, 0.5f), expected(out);
+        decoder.decode(out.data(), ambi.data(), numFrames);
+        for (int s = 0; s < numSpeakers; s++) {
+            if (speakers[s].gain == 0) continue;
+            for (int i = 0; i < numFrames; i++) {
+                for (int c = 0; c < numChannels; c++) {
+                    expected[speakers[s].deviceChannel * numFrames + i] +=
+                            ambi[c * numFrames + i] * decoder.decodeWeight(s, c);
+                }
+            }
+        }
+        for (size_t i = 0; i < out.size(); i++) {
+            REQUIRE(out[i] == Approx(expected[i]).margin(1e-5));
+        }
+    }
+
+    // A speaker gets a gain of 1 from a source in its direction
+    AmbiDecode decoder(3, 7, 1, 3, AmbiBase::ACN_SN3D);
+    Speakers speaker {Speaker(0, 30, 20)};
+    decoder.setSpeakers(speaker);
+    decoder.setSpeaker(0, 0, 30, 20);
+    float ws[64];
+    AmbiBase::encodeWeightsACN(ws, 3, 7, 30 * float(M_PI) / 180, 20 * float(M_PI) / 180);
+    float out = 0;
+    decoder.decode(&out, ws, 1);
+    REQUIRE(out == Approx(1.0f));
+}
+
+TEST_CASE( "AmbisonicsSpatializer rotates the sound field" ) {
+    const int numSpeakers = 32;
+    const int fpb = 16;
+    SpeakerLayout layout;
+    for (int s = 0; s < numSpeakers; s++) {
+        layout.addSpeaker(Speaker(s, 360.0f * s * 0.618034f, std::asin(1 - 2 * (s + 0.5f) / numSpeakers) * 180 / float(M_PI)));
+    }
+    AudioIOData rotatedIO, referenceIO;
+    for (auto io : {&rotatedIO, &referenceIO}) {
+        io->framesPerBuffer(fpb);
+        io->framesPerSecond(44100);
+        io->channelsIn(0);
+        io->channelsOut(numSpeakers);
+    }
+    AmbisonicsSpatializer rotated(layout, 3, 4, 3, AmbiBase::ACN_SN3D);
+    AmbisonicsSpatializer reference(layout, 3, 4, 3, AmbiBase::ACN_SN3D);
+    rotated.compile();
+    reference.compile();
+    REQUIRE_FALSE(AmbisonicsSpatializer(layout, 3, 3, 1).listenerOrientation(Quatd()));
+
+    std::vector<float> samples(fpb, 1.0f);
+    std::vector<Vec3d> sources {Vec3d(1, 2, -3), Vec3d(-2, 0.5, 1), Vec3d(0, -1, -0.2)};
+    Quatd orientations[2] = {Quatd().fromAxisAngle(0.7, Vec3d(0, 1, 0.2).normalize()),
+                             Quatd().fromAxisAngle(-0.4, Vec3d(1, 0, 0))};
+    std::vector<float> previous(numSpeakers);
+    for (int block = 0; block < 2; block++) {
+        const Quatd &q = orientations[block];
+        rotatedIO.zeroOut();
+        referenceIO.zeroOut();
+        REQUIRE(rotated.listenerOrientation(q));
+        rotated.prepare(rotatedIO);
+        reference.prepare(referenceIO);
+        for (auto &source : sources) {
+            rotated.renderBuffer(rotatedIO, Pose(source), samples.data(), fpb);
+            reference.renderBuffer(referenceIO, Pose(q.rotate(source)), samples.data(), fpb);
+        }
+        rotated.finalize(rotatedIO);
+        reference.finalize(referenceIO);
+        // The second block moves to the new orientation on its last frame
+        int frame = block == 0 ? 0 : fpb - 1;
+        for (int s = 0; s < numSpeakers; s++) {
+            REQUIRE(rotatedIO.outBuffer(s)[frame] == Approx(referenceIO.outBuffer(s)[frame]).margin(1e-4));
+            if (block == 1) {
+                float halfway = 0.5f * (previous[s] + referenceIO.outBuffer(s)[0]);
+                REQUIRE(rotatedIO.outBuffer(s)[fpb / 2 - 1] == Approx(halfway).margin(1e-4));
+            }
+            previous[s] = referenceIO.outBuffer(s)[0];
+        }
+    }
+}
@@ -1,5 +1,7 @@
 
 #include <cmath>
+#include <limits>
+#include <vector>
 
 #include "catch.hpp"
 
@@ -75,4 +77,76 @@ TEST_CASE("Audio Channels/Virtual Channels") {
 
 #else
 
-#endif // TRAVIS_BUILD
\ No newline at end of file
+#endif // TRAVIS_BUILD
+
+TEST_CASE( "Interleave and deinterleave" ) {
+    for (int numChannels : {1, 3, 4, 5, 8, 11, 16, 35}) {
+        for (int numFrames : {1, 7, 8, 64, 67}) {
+            std::vector<float> planar(numChannels * numFrames), interleaved(planar.size());
+            for (size_t i = 0; i < planar.size(); i++) {
+                planar[i] = float(i);
+            }
+            // The generic templates are the reference
+            std::vector<float> expected(planar.size()), result(planar.size());
+            interleave<float>(expected.data(), planar.data(), numFrames, numChannels);
+            interleave(interleaved.data(), planar.data(), numFrames, numChannels);
+            REQUIRE(interleaved == expected);
+            deinterleave(result.data(), interleaved.data(), numFrames, numChannels);
+            REQUIRE(result == planar);
+        }
+    }
+}
+
+TEST_CASE( "Fused output processing" ) {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float gain = 0.5f, gainStep = 0.02f;
+    for (int numChannels : {2, 5, 12}) {
+        const int numFrames = 37;
+        std::vector<float> in(numChannels * numFrames);
+        for (size_t i = 0; i < in.size(); i++) {
+            in[i] = i % 13 == 0 ? nan : std::sin(float(i)) * 3.0f;
+        }
+        for (int flags = 0; flags < 4; flags++) {
+            bool zeroNANs = flags & 1, clip = flags & 2;
+            std::vector<float> planar(in), interleaved(in.size());
+            processOutput(planar.data(), planar.data(), numFrames, numChannels, gain, gainStep,
+                          zeroNANs, clip, false);
+            processOutput(interleaved.data(), in.data(), numFrames, numChannels, gain, gainStep,
+                          zeroNANs, clip, true);
+            for (int c = 0; c < numChannels; c++) {
+                for (int i = 0; i < numFrames; i++) {
+                    float x = in[c * numFrames + i] * (gain + gainStep * i);
+                    if (zeroNANs && x != x) x = 0.0f;
+                    if (clip) x = std::min(std::max(x, -1.0f), 1.0f);
+                    float p = planar[c * numFrames + i];
+                    float s = interleaved[i * numChannels + c];
+                    if (x != x) {
+                        REQUIRE(p != p);
+                        REQUIRE(s != s);
+                    } else {
+                        REQUIRE(p == Approx(x));
+                        REQUIRE(s == p);
+                    }
+                }
+            }
+        }
+    }
+
+    // Writing interleaved leaves the output buffers as the callbacks left them
+    AudioIO io;
+    io.init([](AudioIOData &io) {
+        while (io()) {
+            for (unsigned int c = 0; c < io.channelsOut(); c++) io.out(c) = c + 1.0f;
+        }
+    }, nullptr, 64, 48000, 4, 0);
+    io.gain(0.5f);
+    io.mGainPrev = 0.5f;
+    io.clipOut(false);
+    std::vector<float> device(64 * 3);
+    io.processAudioBlock(3, device.data());
+    for (int i = 0; i < 64; i++) {
+        REQUIRE(device[i * 3] == 0.5f);
+        REQUIRE(device[i * 3 + 2] == 1.5f);
+        REQUIRE(io.outBuffer(2)[i] == 3.0f);
+    }
+}
\ No newline at end of file
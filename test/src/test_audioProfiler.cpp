@@ -0,0 +1,227 @@
+#include "catch.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "al/core/io/al_AudioProfiler.hpp"
+#include "al/core/io/al_OfflineAudio.hpp"
+#include "al/util/scene/al_PolySynth.hpp"
+
+using namespace al;
+
+static void spin(double microseconds) {
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration<double, std::micro>(microseconds);
+    while (std::chrono::steady_clock::now() < end) {}
+}
+
+static const AudioProfiler::StageStatistics *findStage(
+        const std::vector<AudioProfiler::StageStatistics> &statistics, const std::string &name) {
+    for (auto &stage : statistics) {
+        if (stage.name == name) return &stage;
+    }
+    return nullptr;
+}
+
+class SpinCallback : public AudioCallback {
+public:
+    SpinCallback(double us) : mUs(us) {}
+    void onAudioCB(AudioIOData &io) override { spin(mUs); }
+    double mUs;
+};
+
+class SpinVoice : public SynthVoice {
+public:
+    void onProcess(AudioIOData &io) override { spin(20); }
+};
+
+class QuietVoice : public SynthVoice {
+public:
+    void onProcess(AudioIOData &io) override {}
+};
+
+TEST_CASE( "AudioProfiler statistics" ) {
+    AudioProfiler profiler;
+    int stage = profiler.stage("test");
+    REQUIRE(stage == AudioProfiler::OUTPUT_STAGE + 1);
+    REQUIRE(profiler.stage("test") == stage);
+    REQUIRE(profiler.stageName(stage) == "test");
+
+    // Nothing is recorded until enabled
+    profiler.record(stage, 0, 1000);
+    profiler.update();
+    REQUIRE(profiler.stageStatistics().empty());
+
+    profiler.enable(true);
+    for (uint64_t i = 1; i <= 100; i++) {
+        profiler.record(stage, i * 1000000, i * 1000000 + i * 1000);
+    }
+    // Ten blocks at half the budget, two over it
+    for (int i = 0; i < 12; i++) {
+        profiler.recordBlock(0, i < 10 ? 500000 : 1500000, 0.001);
+    }
+    profiler.xrun();
+    profiler.update();
+
+    auto statistics = profiler.stageStatistics();
+    REQUIRE(statistics.size() == 2);
+    const AudioProfiler::StageStatistics *test = findStage(statistics, "test");
+    REQUIRE(test);
+    REQUIRE(test->count == 100);
+    REQUIRE(test->mean == Approx(50.5));
+    REQUIRE(test->max == Approx(100.0));
+    REQUIRE(test->p50 == Approx(50.0).epsilon(0.05));
+    REQUIRE(test->p90 == Approx(90.0).epsilon(0.05));
+    REQUIRE(test->p99 == Approx(99.0).epsilon(0.05));
+
+    REQUIRE(profiler.blocks() == 12);
+    REQUIRE(profiler.overruns() == 2);
+    REQUIRE(profiler.xruns() == 1);
+    REQUIRE(profiler.loadHistogram()[25] == 10);
+    REQUIRE(profiler.loadHistogram()[75] == 2);
+    REQUIRE(profiler.loadPercentile(0.5) == Approx(0.52));
+    REQUIRE(profiler.loadPercentile(0.99) == Approx(1.52));
+    REQUIRE(profiler.load() > 0.5);
+
+    std::string json = profiler.json();
+    REQUIRE(json.find("\"blocks\":12,\"overruns\":2,\"xruns\":1") != std::string::npos);
+    REQUIRE(json.find("{\"name\":\"test\",\"count\":100,") != std::string::npos);
+    std::string trace = profiler.chromeTrace();
+    REQUIRE(trace.find("\"args\":{\"name\":\"test\"}") != std::string::npos);
+    REQUIRE(trace.find("{\"name\":\"test\",\"ph\":\"X\",\"pid\":1,\"tid\":3,\"ts\":100000.000,\"dur\":100.000}") != std::string::npos);
+
+    profiler.reset();
+    REQUIRE(profiler.stageStatistics().empty());
+    REQUIRE(profiler.blocks() == 0);
+    REQUIRE(profiler.xruns() == 0);
+
+    // The audio thread drops events when the ring is full
+    AudioProfiler small(16, 4);
+    small.enable(true);
+    for (int i = 0; i < 100; i++) {
+        small.record(AudioProfiler::CALLBACK_STAGE, i, i + 1);
+    }
+    REQUIRE(small.droppedEvents() == 84);
+    small.update();
+    REQUIRE(small.stageStatistics()[0].count == 16);
+    // Only the last four are kept for the trace
+    REQUIRE(small.chromeTrace().find("\"ts\":0.011") == std::string::npos);
+    REQUIRE(small.chromeTrace().find("\"ts\":0.012") != std::string::npos);
+}
+
+static void spinCallback(AudioIOData &io) { spin(30); }
+
+TEST_CASE( "AudioIO profiles its callback chain" ) {
+    AudioIO io;
+    io.init(spinCallback, nullptr, 256, 48000, 2, 0);
+    SpinCallback first(10), second(40);
+    io.append(first);
+    io.append(second);
+    io.profiler().enable(true);
+
+    OfflineAudioRenderer renderer(io);
+    MemoryAudioSink memory;
+    REQUIRE(renderer.render(memory, 256 * 100));
+    io.profiler().update();
+
+    auto statistics = io.profiler().stageStatistics();
+    REQUIRE(statistics.size() == 5);
+    for (const char *name : {"block", "callback", "output", "SpinCallback", "SpinCallback 2"}) {
+        const AudioProfiler::StageStatistics *stage = findStage(statistics, name);
+        REQUIRE(stage);
+        REQUIRE(stage->count == 100);
+    }
+    REQUIRE(findStage(statistics, "callback")->p50 >= 30 * 0.95);
+    REQUIRE(findStage(statistics, "SpinCallback")->p50 >= 10 * 0.95);
+    REQUIRE(findStage(statistics, "SpinCallback 2")->p50 >= 40 * 0.95);
+    REQUIRE(findStage(statistics, "block")->mean >= 80);
+    REQUIRE(io.profiler().blocks() == 100);
+    REQUIRE(io.profiler().load() > 0);
+
+    // Removing a callback keeps the stages of the others
+    io.remove(first);
+    REQUIRE(renderer.render(memory, 256));
+    io.profiler().update();
+    statistics = io.profiler().stageStatistics();
+    REQUIRE(findStage(statistics, "SpinCallback")->count == 100);
+    REQUIRE(findStage(statistics, "SpinCallback 2")->count == 101);
+}
+
+TEST_CASE( "PolySynth profiles each voice type" ) {
+    AudioIOData io;
+    io.framesPerBuffer(64);
+    io.framesPerSecond(48000);
+    io.channelsIn(0);
+    io.channelsOut(2);
+
+    AudioProfiler profiler;
+    profiler.enable(true);
+    PolySynth synth;
+    // Stages are registered by setProfiler() for the types allocated so
+    // far, and by the allocation of the first voice of a new type
+    synth.allocatePolyphony<QuietVoice>(1);
+    int numStages = profiler.numStages();
+    synth.setProfiler(&profiler);
+    REQUIRE(profiler.numStages() == numStages + 1);
+    for (int i = 0; i < 3; i++) {
+        synth.triggerOn(synth.getVoice<SpinVoice>());
+    }
+    REQUIRE(profiler.numStages() == numStages + 2);
+    synth.triggerOn(synth.getVoice<QuietVoice>());
+    for (int block = 0; block < 10; block++) {
+        io.zeroOut();
+        synth.render(io);
+    }
+    profiler.update();
+
+    auto statistics = profiler.stageStatistics();
+    const AudioProfiler::StageStatistics *spinning = findStage(statistics, "voice SpinVoice");
+    const AudioProfiler::StageStatistics *quiet = findStage(statistics, "voice QuietVoice");
+    REQUIRE(spinning);
+    REQUIRE(quiet);
+    // One event per type per block, with the time of all its voices
+    REQUIRE(spinning->count == 10);
+    REQUIRE(quiet->count == 10);
+    REQUIRE(spinning->p50 >= 60 * 0.95);
+    REQUIRE(quiet->max < spinning->p50);
+}
+
+#ifdef AL_AUDIO_DUMMY
+TEST_CASE( "AudioProfiler is read while the audio thread runs" ) {
+    AudioIO io;
+    io.init(spinCallback, nullptr, 64, 48000, 2, 0);
+    io.profiler().enable(true);
+    REQUIRE(io.start());
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    while (std::chrono::steady_clock::now() < end) {
+        io.profiler().update();
+        io.profiler().json();
+    }
+    REQUIRE(io.stop());
+    io.profiler().update();
+    REQUIRE(io.profiler().blocks() > 10);
+    REQUIRE(io.profiler().droppedEvents() == 0);
+    REQUIRE(io.cpu() == 0.0);
+    REQUIRE(io.profiler().load() > 0.0);
+}
+
+TEST_CASE( "AudioIO callbacks are added and removed while the audio thread runs" ) {
+    AudioIO io;
+    io.init(nullptr, nullptr, 64, 48000, 2, 0);
+    io.profiler().enable(true);
+    SpinCallback first(1), second(1);
+    io.append(first);
+    REQUIRE(io.start());
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    while (std::chrono::steady_clock::now() < end) {
+        io.append(second);
+        io.prepend(second);
+        io.profiler().update();
+        io.remove(second);
+    }
+    REQUIRE(io.stop());
+    io.profiler().update();
+    auto statistics = io.profiler().stageStatistics();
+    REQUIRE(findStage(statistics, "SpinCallback")->count == io.profiler().blocks());
+}
+#endif
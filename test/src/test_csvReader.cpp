@@ -0,0 +1,139 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "al/core/io/al_CSVReader.hpp"
+
+struct CSVRow {
+    char name[32];
+    int64_t count;
+    double value;
+    bool flag;
+};
+
+TEST_CASE( "CSVReader comma separated file" ) {
+    const char *name = "test_csvReader.csv";
+    {
+        std::ofstream f(name, std::ios::binary);
+        f << "name,count,value,ignored,flag\r\n";
+        f << "first,12,1.5,x,True\r\n";
+        f << "\r\n";
+        f << "a name longer than thirty one characters,-7,-2.25e2,x,0\n";
+        f << "too,few,commas\n";
+        f << " spaced, 3, 1e-300,x,true\n";
+        f << "hex,0x10,0x10,x,1";
+    }
+    CSVReader reader;
+    reader.addType(CSVReader::STRING);
+    reader.addType(CSVReader::INTEGER);
+    reader.addType(CSVReader::REAL);
+    reader.addType(CSVReader::IGNORE_COLUMN);
+    reader.addType(CSVReader::BOOLEAN);
+    REQUIRE_FALSE(reader.readFile("missing.csv"));
+    REQUIRE(reader.readFile(name));
+
+    REQUIRE(reader.getColumnNames() == std::vector<std::string>({"name", "count", "value", "ignored", "flag"}));
+    REQUIRE(reader.numRows() == 5);
+
+    // Rows without the right number of fields are zero
+    auto rows = reader.copyToStruct<CSVRow>();
+    REQUIRE(rows.size() == 5);
+    REQUIRE(std::string(rows[0].name) == "first");
+    REQUIRE(rows[0].count == 12);
+    REQUIRE(rows[0].value == 1.5);
+    REQUIRE(rows[0].flag);
+    REQUIRE(std::string(rows[1].name) == "a name longer than thirty one c");
+    REQUIRE(rows[1].count == -7);
+    REQUIRE(rows[1].value == -225.0);
+    REQUIRE_FALSE(rows[1].flag);
+    REQUIRE(rows[2].name[0] == '\0');
+    REQUIRE(rows[2].count == 0);
+    REQUIRE(std::string(rows[3].name) == " spaced");
+    REQUIRE(rows[3].count == 3);
+    REQUIRE(rows[3].value == 1e-300);
+    REQUIRE(rows[3].flag);
+    REQUIRE(rows[4].count == 0);
+    REQUIRE(rows[4].value == std::atof("0x10"));
+    REQUIRE(rows[4].flag);
+
+    auto values = reader.getRealColumn(2);
+    REQUIRE(values.size() == 5);
+    REQUIRE(values[1] == -225.0);
+    REQUIRE(reader.getIntegerColumn(1)[3] == 3);
+    REQUIRE(reader.getBooleanColumn(4)[0]);
+    REQUIRE(std::string(reader.getString(0, 0)) == "first");
+    REQUIRE(reader.getRealColumn(1).empty());
+    REQUIRE(reader.getString(1, 0) == nullptr);
+    REQUIRE(reader.getColumn(1) == std::vector<double>({12, -7, 0, 3, 0}));
+    std::remove(name);
+}
+
+TEST_CASE( "CSVReader space separated file" ) {
+    const char *name = "test_csvReader.txt";
+    {
+        std::ofstream f(name);
+        f << "name  count value\n";
+        f << "one   1  0.125\n";
+        f << "  two 2\t 3.75  \n";
+        f << "three\n";
+    }
+    CSVReader reader;
+    reader.addType(CSVReader::STRING);
+    reader.addType(CSVReader::INTEGER);
+    reader.addType(CSVReader::REAL);
+    REQUIRE(reader.readFile(name));
+    REQUIRE(reader.getColumnNames() == std::vector<std::string>({"name", "count", "value"}));
+    REQUIRE(reader.numRows() == 3);
+    REQUIRE(std::string(reader.getString(0, 1)) == "two");
+    REQUIRE(reader.getIntegerColumn(1)[1] == 2);
+    REQUIRE(reader.getColumn(2) == std::vector<double>({0.125, 3.75, 0}));
+    REQUIRE(std::string(reader.getString(0, 2)) == "three");
+    std::remove(name);
+}
+
+TEST_CASE( "CSVReader parallel parsing" ) {
+    const char *name = "test_csvReader_large.csv";
+    // Enough rows for several 1 MB chunks
+    const int numRows = 200000;
+    std::vector<std::string> fields(numRows);
+    {
+        std::ofstream f(name, std::ios::binary);
+        f << "index,value,flag\n";
+        unsigned int seed = 1;
+        for (int i = 0; i < numRows; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            char value[64];
+            // Mix of values parsed directly and through strtod
+            switch (i % 4) {
+            case 0: snprintf(value, sizeof(value), "%.6f", (seed % 100000) / 7.0); break;
+            case 1: snprintf(value, sizeof(value), "%.17g", seed / 3.0); break;
+            case 2: snprintf(value, sizeof(value), "%de%d", int(seed % 1000), int(seed % 40) - 20); break;
+            case 3: snprintf(value, sizeof(value), "-%.3e", seed * 1e-30); break;
+            }
+            fields[i] = value;
+            f << i << "," << value << "," << (i % 3 == 0 ? "true" : "false") << "\n";
+        }
+    }
+    CSVReader reader;
+    reader.addType(CSVReader::INTEGER);
+    reader.addType(CSVReader::REAL);
+    reader.addType(CSVReader::BOOLEAN);
+    reader.setNumThreads(4);
+    REQUIRE(reader.readFile(name));
+    REQUIRE(reader.numRows() == numRows);
+    auto indices = reader.getIntegerColumn(0);
+    auto values = reader.getRealColumn(1);
+    auto flags = reader.getBooleanColumn(2);
+    bool match = true;
+    for (int i = 0; i < numRows; i++) {
+        match &= indices[i] == i;
+        match &= values[i] == std::atof(fields[i].c_str());
+        match &= flags[i] == (i % 3 == 0);
+    }
+    REQUIRE(match);
+    std::remove(name);
+}
@@ -0,0 +1,78 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "al/util/scene/al_DynamicScene.hpp"
+#include "al/core/sound/al_Speaker.hpp"
+#include "al/core/sound/al_StereoPanner.hpp"
+#include "al/core/io/al_AudioIOData.hpp"
+
+using namespace al;
+
+class RampVoice : public PositionedVoice {
+public:
+    virtual void onProcess(AudioIOData& io) override {
+        while(io()) {
+            io.out(0) += value;
+            value += 0.001f;
+        }
+    }
+
+    float value {0.0f};
+};
+
+static void renderScene(DynamicScene &scene, int numVoices, int numBlocks,
+                        std::vector<float> &output) {
+    AudioIOData audioData;
+    audioData.framesPerBuffer(64);
+    audioData.framesPerSecond(44100);
+    audioData.channelsIn(0);
+    audioData.channelsOut(2);
+
+    SpeakerLayout layout = StereoSpeakerLayout();
+    scene.setSpatializer<StereoPanner>(layout);
+    scene.prepare(audioData);
+    for (int i = 0; i < numVoices; i++) {
+        auto *voice = scene.getVoice<RampVoice>();
+        voice->value = i * 0.01f;
+        voice->setPose(Pose(Vec3d(std::sin(i * 0.1), 0, -4)));
+        scene.triggerOn(voice);
+    }
+    for (int block = 0; block < numBlocks; block++) {
+        audioData.zeroOut();
+        scene.render(audioData);
+        for (int chan = 0; chan < 2; chan++) {
+            float *buf = audioData.outBuffer(chan);
+            output.insert(output.end(), buf, buf + 64);
+        }
+    }
+}
+
+TEST_CASE( "Dynamic Scene threaded render matches serial render" ) {
+    const int numVoices = 97; // Not a multiple of the number of chunks
+    const int numBlocks = 8;
+
+    std::vector<float> serialOutput;
+    DynamicScene serialScene;
+    renderScene(serialScene, numVoices, numBlocks, serialOutput);
+
+    std::vector<float> threadedOutput;
+    DynamicScene threadedScene(3);
+    threadedScene.setAudioThreaded(true);
+    renderScene(threadedScene, numVoices, numBlocks, threadedOutput);
+
+    REQUIRE(serialOutput.size() == threadedOutput.size());
+    REQUIRE(std::abs(serialOutput.back()) > 1.0f);
+    for (size_t i = 0; i < serialOutput.size(); i++) {
+        // Only the order of summation differs
+        REQUIRE(threadedOutput[i] == Approx(serialOutput[i]).epsilon(1e-5).margin(1e-4));
+    }
+
+    // Output of the threaded render does not depend on thread scheduling
+    std::vector<float> secondOutput;
+    DynamicScene secondScene(3);
+    secondScene.setAudioThreaded(true);
+    renderScene(secondScene, numVoices, numBlocks, secondOutput);
+    REQUIRE(secondOutput == threadedOutput);
+}
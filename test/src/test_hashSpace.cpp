@@ -0,0 +1,95 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "al/core/spatial/al_HashSpace.hpp"
+
+using namespace al;
+
+TEST_CASE( "HashSpace batch k nearest neighbours" ) {
+    const uint32_t numObjects = 3000;
+    const uint32_t k = 8;
+    HashSpace space(5, numObjects);
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> uniform(0.0, space.dim());
+    std::vector<Vec3d> positions(numObjects);
+    for (auto &p : positions) {
+        p = Vec3d(uniform(rng), uniform(rng), uniform(rng));
+    }
+    space.moveAll(positions.data(), 3);
+    space.remove(17);
+
+    // Brute force reference, using wrapped distances
+    auto bruteForce = [&](const Vec3d &center, int exclude, double maxRadius) {
+        std::vector<double> d2s;
+        for (uint32_t i = 0; i < numObjects; i++) {
+            if (int(i) == exclude || i == 17) continue;
+            double d2 = space.wrapRelative(space.object(i).pos - center).magSqr();
+            if (d2 <= maxRadius * maxRadius) d2s.push_back(d2);
+        }
+        std::sort(d2s.begin(), d2s.end());
+        d2s.resize(std::min<size_t>(d2s.size(), k));
+        return d2s;
+    };
+
+    for (double maxRadius : {1.5, 4.0, double(space.maxRadius())}) {
+        HashSpace::KNNResults results;
+        space.queryKNN(k, maxRadius, results, 3);
+        REQUIRE(results.size() == numObjects);
+        REQUIRE(results.count(17) == 0);
+        for (uint32_t i = 0; i < numObjects; i += 7) {
+            if (i == 17) continue;
+            auto expected = bruteForce(space.object(i).pos, i, maxRadius);
+            REQUIRE(results.count(i) == expected.size());
+            for (uint32_t n = 0; n < results.count(i); n++) {
+                REQUIRE(results.distanceSquared(i, n) == Approx(expected[n]));
+                REQUIRE(results.object(i, n) != i);
+                double d2 = space.wrapRelative(space.object(results.object(i, n)).pos
+                                               - space.object(i).pos).magSqr();
+                REQUIRE(d2 == Approx(results.distanceSquared(i, n)));
+            }
+        }
+
+        std::vector<Vec3d> centers {Vec3d(0, 0, 0), Vec3d(31.9, 0.1, 16), Vec3d(-3, 40, 7)};
+        space.queryKNN(centers.data(), centers.size(), k, maxRadius, results, 2);
+        for (uint32_t q = 0; q < centers.size(); q++) {
+            auto expected = bruteForce(space.wrap(centers[q]), -1, maxRadius);
+            REQUIRE(results.count(q) == expected.size());
+            for (uint32_t n = 0; n < results.count(q); n++) {
+                REQUIRE(results.distanceSquared(q, n) == Approx(expected[n]));
+            }
+        }
+    }
+}
+
+TEST_CASE( "HashSpace moveAll matches move" ) {
+    const uint32_t numObjects = 2000;
+    HashSpace a(4, numObjects), b(4, numObjects);
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> uniform(-20.0, 40.0);
+    std::vector<Vec3d> positions(numObjects);
+    for (int frame = 0; frame < 3; frame++) {
+        for (uint32_t i = 0; i < numObjects; i++) {
+            positions[i] = Vec3d(uniform(rng), uniform(rng), uniform(rng));
+            a.move(i, positions[i]);
+        }
+        b.moveAll(positions.data(), frame + 1);
+        HashSpace::Query qa(numObjects), qb(numObjects);
+        for (int q = 0; q < 20; q++) {
+            Vec3d center = b.object(q * 50).pos;
+            int na = qa(a, center, 3.0);
+            int nb = qb(b, center, 3.0);
+            REQUIRE(na == nb);
+            std::vector<uint32_t> ia, ib;
+            for (int i = 0; i < na; i++) {
+                ia.push_back(qa[i] - &a.object(0));
+                ib.push_back(qb[i] - &b.object(0));
+            }
+            std::sort(ia.begin(), ia.end());
+            std::sort(ib.begin(), ib.end());
+            REQUIRE(ia == ib);
+        }
+    }
+}
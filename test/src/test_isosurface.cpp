@@ -0,0 +1,81 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "al/core/graphics/al_Isosurface.hpp"
+
+using namespace al;
+
+struct RecordVertexAction : public Isosurface::VertexAction {
+    std::vector<Vec3i> positions;
+    std::vector<size_t> meshSizes;
+    virtual void operator()(const Isosurface::EdgeVertex &v, Isosurface &s) {
+        positions.push_back(v.pos);
+        meshSizes.push_back(s.vertices().size());
+    }
+};
+
+TEST_CASE( "Isosurface parallel generate matches cell by cell extraction" ) {
+    const int nx = 37, ny = 29, nz = 45;
+    // Blobs in one corner of the field, so there are empty blocks, plus
+    // field points exactly at the level
+    std::vector<float> field(nx * ny * nz);
+    for (int z = 0; z < nz; z++) {
+        for (int y = 0; y < ny; y++) {
+            for (int x = 0; x < nx; x++) {
+                float v = std::sin(x * 0.4f) * std::cos(y * 0.3f) + std::sin(z * 0.25f);
+                v *= std::exp(-0.002f * (x * x + y * y + z * z));
+                if ((x + y + z) % 17 == 0) v = 0.25f;
+                field[x + nx * (y + ny * z)] = v;
+            }
+        }
+    }
+
+    // Reference: all cells from the highest z layer to the lowest
+    RecordVertexAction referenceAction;
+    Isosurface reference(0.25f, referenceAction);
+    reference.fieldDims(nx, ny, nz);
+    reference.cellLengths(0.5, 1, 2);
+    reference.inBox(true);
+    reference.begin();
+    for (int z = nz - 2; z >= 0; z--) {
+        for (int y = 0; y < ny - 1; y++) {
+            for (int x = 0; x < nx - 1; x++) {
+                auto at = [&](int dx, int dy, int dz) { return field[(x + dx) + nx * ((y + dy) + ny * (z + dz))]; };
+                reference.addCell(x, y, z, at(0, 0, 0), at(1, 0, 0), at(0, 1, 0), at(1, 1, 0),
+                                  at(0, 0, 1), at(1, 0, 1), at(0, 1, 1), at(1, 1, 1));
+            }
+        }
+    }
+    reference.end();
+    REQUIRE(reference.indices().size() > 1000);
+
+    for (unsigned threads : {1u, 2u, 3u, 7u}) {
+        for (bool skip : {true, false}) {
+            RecordVertexAction action;
+            Isosurface iso(0.25f, action);
+            iso.numThreads(threads).skipEmptyBlocks(skip);
+            iso.generate(field.data(), nx, ny, nz, 0.5f, 1.0f, 2.0f);
+            REQUIRE(iso.validSurface());
+            REQUIRE(iso.vertices() == reference.vertices());
+            REQUIRE(iso.indices() == reference.indices());
+            // normals() is hidden by the Isosurface setter
+            REQUIRE(static_cast<Mesh &>(iso).normals() == static_cast<Mesh &>(reference).normals());
+            REQUIRE(action.positions == referenceAction.positions);
+            REQUIRE(action.meshSizes == referenceAction.meshSizes);
+        }
+    }
+
+    // Without a vertex action, and a field with no surface
+    Isosurface iso;
+    iso.numThreads(4).level(0.25f);
+    iso.generate(field.data(), nx, ny, nz, 0.5f, 1.0f, 2.0f);
+    REQUIRE(iso.vertices() == reference.vertices());
+    REQUIRE(iso.indices() == reference.indices());
+    std::vector<float> empty(field.size(), 1.0f);
+    iso.generate(empty.data(), nx, ny, nz, 0.5f, 1.0f, 2.0f);
+    REQUIRE(iso.validSurface());
+    REQUIRE(iso.vertices().size() == 0);
+    REQUIRE(iso.indices().size() == 0);
+}
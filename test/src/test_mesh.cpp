@@ -0,0 +1,110 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "al/core/graphics/al_Mesh.hpp"
+
+using namespace al;
+
+// Triangles as sorted vertex positions, to compare meshes independently of
+// vertex and triangle order
+static std::vector<std::array<float, 9>> triangleSet(const Mesh &m) {
+    std::vector<std::array<float, 9>> tris;
+    for (size_t i = 0; i + 2 < m.indices().size(); i += 3) {
+        std::array<Mesh::Vertex, 3> v {{m.vertices()[m.indices()[i]],
+                                        m.vertices()[m.indices()[i + 1]],
+                                        m.vertices()[m.indices()[i + 2]]}};
+        // Rotate so the smallest vertex is first, keeping the winding
+        auto smallest = std::min_element(v.begin(), v.end(), [](const Mesh::Vertex &a, const Mesh::Vertex &b) {
+            return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+        });
+        std::rotate(v.begin(), smallest, v.end());
+        std::array<float, 9> t;
+        for (int k = 0; k < 9; k++) t[k] = v[k / 3][k % 3];
+        tris.push_back(t);
+    }
+    std::sort(tris.begin(), tris.end());
+    return tris;
+}
+
+TEST_CASE( "Mesh compress" ) {
+    Mesh m(Mesh::TRIANGLES);
+    m.vertex(0, 0, 0); m.vertex(1, 0, 0); m.vertex(0, 1, 0);
+    m.vertex(1, 0, 0); m.vertex(1, 1, 0); m.vertex(0, 1, 0);
+    m.compress();
+    REQUIRE(m.vertices().size() == 4);
+    REQUIRE(m.indices().size() == 6);
+    REQUIRE(m.vertices()[m.indices()[3]] == Mesh::Vertex(1, 0, 0));
+
+    // Vertices within epsilon are welded
+    Mesh near(Mesh::TRIANGLES);
+    near.vertex(0, 0, 0); near.vertex(1, 0, 0); near.vertex(0, 1, 0);
+    near.vertex(1.0005f, 0, 0); near.vertex(1, 1, 0); near.vertex(0, 0.9995f, 0);
+    Mesh exact = near;
+    exact.compress();
+    REQUIRE(exact.vertices().size() == 6);
+    near.compress(0.001f);
+    REQUIRE(near.vertices().size() == 4);
+
+    // Only positions are compared, unless attributes are asked for
+    Mesh normals(Mesh::TRIANGLES);
+    normals.vertex(0, 0, 0); normals.normal(0, 0, 1);
+    normals.vertex(0, 0, 0); normals.normal(0, 1, 0);
+    normals.vertex(0, 0, 0); normals.normal(0, 0, 1);
+    Mesh positionOnly = normals;
+    positionOnly.compress();
+    REQUIRE(positionOnly.vertices().size() == 1);
+    REQUIRE(positionOnly.normals()[0] == Mesh::Normal(0, 0, 1));
+    normals.compress(0.0f, true);
+    REQUIRE(normals.vertices().size() == 2);
+    REQUIRE(normals.normals().size() == 2);
+    REQUIRE(normals.normals()[normals.indices()[1]] == Mesh::Normal(0, 1, 0));
+
+    // Indexed meshes are remapped
+    Mesh indexed(Mesh::TRIANGLES);
+    indexed.vertex(0, 0, 0); indexed.vertex(1, 0, 0); indexed.vertex(0, 1, 0);
+    indexed.vertex(1, 0, 0); indexed.vertex(1, 1, 0);
+    indexed.index(0, 1, 2);
+    indexed.index(3, 4, 2);
+    auto before = triangleSet(indexed);
+    indexed.compress();
+    REQUIRE(indexed.vertices().size() == 4);
+    REQUIRE(triangleSet(indexed) == before);
+}
+
+TEST_CASE( "Mesh vertex cache optimization" ) {
+    const int n = 32;
+    Mesh m(Mesh::TRIANGLES);
+    for (int x = 0; x < n; x++) {
+        for (int y = 0; y < n; y++) {
+            m.vertex(x, y, 0); m.vertex(x + 1, y, 0); m.vertex(x, y + 1, 0);
+            m.vertex(x + 1, y, 0); m.vertex(x + 1, y + 1, 0); m.vertex(x, y + 1, 0);
+        }
+    }
+    m.compress();
+    auto before = triangleSet(m);
+    size_t numVertices = m.vertices().size();
+
+    auto fifoMisses = [](const Mesh &mesh, int cacheSize) {
+        std::vector<int> cacheTime(mesh.vertices().size(), -1);
+        int misses = 0;
+        for (auto index : mesh.indices()) {
+            if (cacheTime[index] < 0 || misses - cacheTime[index] >= cacheSize) {
+                cacheTime[index] = misses++;
+            }
+        }
+        return misses;
+    };
+    int missesBefore = fifoMisses(m, 16);
+    m.optimizeVertexCache();
+
+    REQUIRE(m.vertices().size() == numVertices);
+    REQUIRE(triangleSet(m) == before);
+    REQUIRE(fifoMisses(m, 16) < missesBefore * 3 / 4);
+    // Vertices are renumbered in order of first use
+    REQUIRE(m.indices()[0] == 0);
+    REQUIRE(m.indices()[1] == 1);
+    REQUIRE(m.indices()[2] == 2);
+}
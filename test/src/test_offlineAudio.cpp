@@ -0,0 +1,147 @@
+#include "catch.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "al/core/io/al_OfflineAudio.hpp"
+
+using namespace al;
+
+// A ramp in channel 0 that counts frames, and a copy in the others at
+// decreasing levels
+static void rampCallback(AudioIOData &io) {
+    uint64_t &frame = io.user<uint64_t>();
+    while (io()) {
+        float value = (frame++ % 1000) / 1000.0f;
+        for (unsigned int c = 0; c < io.channelsOut(); c++) {
+            io.out(c) = value / (c + 1);
+        }
+    }
+}
+
+TEST_CASE( "OfflineAudioRenderer renders repeatable blocks" ) {
+    uint64_t frame = 0;
+    AudioIO io;
+    // More channels than the device has, so there are virtual channels
+    io.init(rampCallback, &frame, 64, 48000, 5, 0);
+    io.gain(0.5f);
+    REQUIRE(io.channelsOut() == 5);
+
+    OfflineAudioRenderer renderer(io);
+    MemoryAudioSink memory;
+    REQUIRE(renderer.render(memory, 1000));
+    REQUIRE(renderer.framesRendered() == 1024);
+    REQUIRE(memory.channels() == 5);
+    REQUIRE(memory.frames() == 1024);
+    REQUIRE(memory.framesPerSecond() == 48000);
+    REQUIRE(renderer.realTimeFactor() > 1.0);
+    REQUIRE(renderer.cpu() > 0.0);
+    REQUIRE(renderer.cpu() < 1.0);
+
+    // The gain ramps from 1 to 0.5 over the first block
+    REQUIRE(memory.channel(0)[0] == 0.0f);
+    REQUIRE(memory.channel(0)[32] == Approx(0.032f * (1 - 0.5f * 32 / 64)));
+    for (uint64_t i = 64; i < memory.frames(); i++) {
+        REQUIRE(memory.channel(0)[i] == Approx(0.5f * (i % 1000) / 1000.0f));
+        REQUIRE(memory.channel(4)[i] == Approx(0.1f * (i % 1000) / 1000.0f));
+    }
+
+    // The same callback state renders the same output
+    std::vector<float> first(memory.channel(3));
+    memory.clear();
+    frame = 0;
+    io.mGainPrev = 1.0f;
+    REQUIRE(renderer.render(memory, 1024));
+    REQUIRE(memory.channel(3) == first);
+
+    // Frames are appended
+    REQUIRE(renderer.render(memory, 64));
+    REQUIRE(memory.frames() == 1024 + 64);
+}
+
+TEST_CASE( "OfflineAudioRenderer writes WAV files" ) {
+    const char *name = "test_offlineAudio.wav";
+    uint64_t frame = 0;
+    AudioIO io;
+    io.init(rampCallback, &frame, 128, 44100, 3, 0);
+    OfflineAudioRenderer renderer(io);
+    {
+        SoundFileAudioSink sink(name);
+        REQUIRE(renderer.render(sink, 44100));
+        REQUIRE(sink.frames() == 44160);
+    }
+
+    // 3 channels use WAVE_FORMAT_EXTENSIBLE, so the samples start at byte 68
+    std::FILE *file = std::fopen(name, "rb");
+    REQUIRE(file);
+    unsigned char header[68];
+    REQUIRE(std::fread(header, 1, 68, file) == 68);
+    REQUIRE(memcmp(header, "RIFF", 4) == 0);
+    REQUIRE(memcmp(header + 60, "data", 4) == 0);
+    auto readLE = [&](int offset, int bytes) {
+        uint32_t value = 0;
+        for (int i = bytes - 1; i >= 0; i--) {
+            value = (value << 8) | header[offset + i];
+        }
+        return value;
+    };
+    REQUIRE(readLE(20, 2) == 0xFFFE);
+    REQUIRE(readLE(22, 2) == 3);
+    REQUIRE(readLE(24, 4) == 44100);
+    REQUIRE(readLE(34, 2) == 32);
+    REQUIRE(readLE(44, 2) == 3); // IEEE float sub format
+    REQUIRE(readLE(64, 4) == 44160 * 3 * 4);
+    std::vector<float> samples(44160 * 3);
+    REQUIRE(std::fread(samples.data(), sizeof(float), samples.size(), file) == samples.size());
+    std::fclose(file);
+    bool samplesMatch = true;
+    for (uint64_t i = 0; i < 44160; i++) {
+        float value = (i % 1000) / 1000.0f;
+        samplesMatch &= samples[3 * i] == value;
+        samplesMatch &= samples[3 * i + 2] == value / 3;
+    }
+    REQUIRE(samplesMatch);
+    std::remove(name);
+}
+
+TEST_CASE( "OfflineAudioRenderer pacing and stop" ) {
+    uint64_t frame = 0;
+    AudioIO io;
+    io.init(rampCallback, &frame, 256, 48000, 2, 0);
+    OfflineAudioRenderer renderer(io);
+    MemoryAudioSink memory;
+    renderer.pace(true);
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(renderer.render(memory, 4800));
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // The last block starts 0.096 seconds in
+    REQUIRE(seconds > 0.09);
+    REQUIRE(renderer.realTimeFactor() < 1.2);
+
+    // Stopped from another thread
+    std::thread stopper([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        renderer.stop();
+    });
+    REQUIRE_FALSE(renderer.render(memory, 48000 * 10));
+    stopper.join();
+    REQUIRE(renderer.framesRendered() < 48000);
+}
+
+#ifdef AL_AUDIO_DUMMY
+TEST_CASE( "Dummy audio backend runs the callbacks" ) {
+    uint64_t frame = 0;
+    AudioIO io;
+    io.init(rampCallback, &frame, 256, 48000, 2, 0);
+    REQUIRE(io.start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    REQUIRE(io.stop());
+    REQUIRE(frame > 0);
+    REQUIRE(frame <= 48000 / 4 + 256);
+    REQUIRE(io.time() == Approx(frame / 48000.0));
+}
+#endif
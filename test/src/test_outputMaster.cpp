@@ -0,0 +1,225 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "al/core/io/al_AudioIOData.hpp"
+#include "al/util/sound/al_OutputMaster.hpp"
+
+using namespace al;
+
+static void setupIO(AudioIOData &io, int numChannels, int framesPerBuffer, double sampleRate) {
+    io.framesPerBuffer(framesPerBuffer);
+    io.framesPerSecond(sampleRate);
+    io.channelsIn(0);
+    io.channelsOut(numChannels);
+}
+
+TEST_CASE( "BiquadBank matches a scalar biquad" ) {
+    const int numChannels = 6;
+    const int numFrames = 37;
+    const double c[2][5] = {{0.2, 0.3, 0.1, -0.4, 0.2}, {0.5, -0.1, 0.05, 0.3, 0.1}};
+    BiquadBank bank;
+    bank.resize(numChannels, 2);
+    for (int stage = 0; stage < 2; stage++) {
+        bank.setStage(stage, c[stage][0], c[stage][1], c[stage][2], c[stage][3], c[stage][4]);
+    }
+
+    std::vector<std::vector<float>> buffers(numChannels, std::vector<float>(numFrames));
+    std::vector<std::vector<double>> expected(numChannels, std::vector<double>(numFrames));
+    for (int k = 0; k < numChannels; k++) {
+        double s1[2] = {0, 0}, s2[2] = {0, 0};
+        for (int i = 0; i < numFrames; i++) {
+            buffers[k][i] = std::sin(i * 0.3f + k);
+            double x = buffers[k][i];
+            for (int stage = 0; stage < 2; stage++) {
+                double y = c[stage][0] * x + s1[stage];
+                s1[stage] = c[stage][1] * x - c[stage][3] * y + s2[stage];
+                s2[stage] = c[stage][2] * x - c[stage][4] * y;
+                x = y;
+            }
+            expected[k][i] = x;
+        }
+    }
+    // In place, in two groups and two calls
+    for (int chan = 0; chan < numChannels; chan += 4) {
+        float *pointers[4];
+        int groupSize = std::min(4, numChannels - chan);
+        for (int k = 0; k < groupSize; k++) {
+            pointers[k] = buffers[chan + k].data();
+        }
+        bank.process(pointers, pointers, chan, groupSize, 21);
+        for (int k = 0; k < groupSize; k++) {
+            pointers[k] += 21;
+        }
+        bank.process(pointers, pointers, chan, groupSize, numFrames - 21);
+    }
+    for (int k = 0; k < numChannels; k++) {
+        for (int i = 0; i < numFrames; i++) {
+            REQUIRE(buffers[k][i] == Approx(expected[k][i]).margin(1e-5));
+        }
+    }
+}
+
+TEST_CASE( "OutputMaster gains, clipper and bass management" ) {
+    const int numChannels = 6;
+    const int fpb = 64;
+    AudioIOData io;
+    setupIO(io, numChannels, fpb, 48000);
+    OutputMaster master(numChannels, 48000);
+    master.setGain(1, 0.5);
+    master.setMasterGain(0.8);
+
+    for (int chan = 0; chan < numChannels; chan++) {
+        std::fill(io.outBuffer(chan), io.outBuffer(chan) + fpb, chan == 2 ? -2.0f : 1.0f);
+    }
+    master.onAudioCB(io);
+    REQUIRE(io.outBuffer(0)[0] == Approx(0.8f));
+    REQUIRE(io.outBuffer(1)[0] == Approx(0.4f));
+    // Clipped on both sides
+    REQUIRE(io.outBuffer(2)[0] == Approx(-0.8f));
+
+    master.setMuteAll(true);
+    master.onAudioCB(io);
+    REQUIRE(io.outBuffer(0)[0] == 0.0f);
+    master.setMuteAll(false);
+
+    // A low tone goes to the subwoofers, a high tone stays in the mains
+    master.setMasterGain(1.0);
+    master.setGain(1, 1.0);
+    master.setSwIndeces(4, 5, -1, -1);
+    master.setBassManagementMode(BASSMODE_FULL);
+    for (double frequency : {40.0, 4000.0}) {
+        float mainPeak = 0, subPeak = 0;
+        for (int block = 0; block < 40; block++) {
+            for (int i = 0; i < fpb; i++) {
+                float sample = 0.1f * std::sin(2 * M_PI * frequency * (block * fpb + i) / 48000);
+                for (int chan = 0; chan < numChannels; chan++) {
+                    io.outBuffer(chan)[i] = sample;
+                }
+            }
+            master.onAudioCB(io);
+            if (block > 20) {
+                for (int i = 0; i < fpb; i++) {
+                    mainPeak = std::max(mainPeak, std::fabs(io.outBuffer(0)[i]));
+                    subPeak = std::max(subPeak, std::fabs(io.outBuffer(4)[i]));
+                    REQUIRE(io.outBuffer(5)[i] == io.outBuffer(4)[i]);
+                }
+            }
+        }
+        if (frequency < 100) {
+            // The bass of the six channels
+            REQUIRE(subPeak == Approx(0.6f).epsilon(0.05));
+            REQUIRE(mainPeak < 0.01f);
+        } else {
+            REQUIRE(subPeak < 0.01f);
+            REQUIRE(mainPeak == Approx(0.1f).epsilon(0.05));
+        }
+    }
+
+    // Linkwitz-Riley low and high pass sum to an all pass
+    BiquadBank lopass, hipass;
+    lopass.resize(1, 2);
+    hipass.resize(1, 2);
+    for (int stage = 0; stage < 2; stage++) {
+        lopass.setButterworth(stage, 150, 48000, true);
+        hipass.setButterworth(stage, 150, 48000, false);
+    }
+    for (double frequency : {50.0, 150.0, 400.0}) {
+        std::vector<float> in(9600), low(9600), high(9600);
+        for (size_t i = 0; i < in.size(); i++) {
+            in[i] = std::sin(2 * M_PI * frequency * i / 48000);
+        }
+        float *lowPointer = low.data(), *highPointer = high.data();
+        const float *inPointer = in.data();
+        lopass.process(&lowPointer, &inPointer, 0, 1, in.size());
+        hipass.process(&highPointer, &inPointer, 0, 1, in.size());
+        float peak = 0;
+        for (size_t i = 4800; i < in.size(); i++) {
+            peak = std::max(peak, std::fabs(low[i] + high[i]));
+        }
+        REQUIRE(peak == Approx(1.0f).epsilon(0.01));
+    }
+}
+
+TEST_CASE( "OutputMaster meters" ) {
+    const int numChannels = 3;
+    const int fpb = 128;
+    AudioIOData io;
+    setupIO(io, numChannels, fpb, 48000);
+    OutputMaster master(numChannels, 48000);
+    master.setMeterOn(true);
+    master.setLoudnessOn(true);
+    master.setMeterUpdateFreq(10);
+
+    auto run = [&]() {
+        for (int block = 0; block < 400; block++) {
+            for (int i = 0; i < fpb; i++) {
+                int frame = block * fpb + i;
+                io.outBuffer(0)[i] = std::sin(2 * M_PI * 997 * frame / 48000);
+                io.outBuffer(1)[i] = 0.5f * std::sin(2 * M_PI * 100 * frame / 48000) - 0.25f;
+                io.outBuffer(2)[i] = 0.0f;
+            }
+            master.onAudioCB(io);
+        }
+    };
+    float values[numChannels];
+    REQUIRE_FALSE(master.getCurrentValues(values));
+    run();
+    REQUIRE(master.getCurrentValues(values));
+    REQUIRE(values[0] == Approx(1.0f).epsilon(0.001));
+    REQUIRE(values[1] == Approx(0.75f).epsilon(0.001));
+    REQUIRE(values[2] == 0.0f);
+    REQUIRE(master.getCurrentChannelValue(1) == values[1]);
+    REQUIRE_FALSE(master.getCurrentValues(values));
+    // Each getter has its own updated flag
+    REQUIRE(master.getMaximumValues(values));
+    REQUIRE(values[1] == Approx(0.25f).epsilon(0.001));
+    master.getMinimumValues(values);
+    REQUIRE(values[1] == Approx(-0.75f).epsilon(0.001));
+    master.getRMSValues(values);
+    REQUIRE(values[0] == Approx(std::sqrt(0.5)).epsilon(0.01));
+    REQUIRE(values[1] == Approx(std::sqrt(0.125 + 0.0625)).epsilon(0.01));
+
+    // 997 Hz at full scale in one channel reads -3.01 LUFS
+    master.setGain(1, 0.0);
+    run();
+    REQUIRE(master.getLoudness() == Approx(-3.01f).margin(0.1));
+}
+
+TEST_CASE( "DoubleBuffering reads are never torn" ) {
+    const unsigned int size = 64;
+    DoubleBuffering<float> buffer;
+    buffer.setSize(size);
+    std::atomic<bool> running(true);
+    std::atomic<int> tornReads(0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; r++) {
+        readers.emplace_back([&]() {
+            float values[size];
+            while (running) {
+                buffer.read(values);
+                for (unsigned int i = 1; i < size; i++) {
+                    if (values[i] != values[0]) {
+                        tornReads++;
+                        break;
+                    }
+                }
+            }
+        });
+    }
+    float values[size];
+    for (int i = 0; i < 100000; i++) {
+        std::fill(values, values + size, float(i));
+        buffer.write(values);
+    }
+    running = false;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    REQUIRE(tornReads == 0);
+    REQUIRE(buffer.read(values, 10, 1) == 100000);
+    REQUIRE(values[0] == 99999.0f);
+}
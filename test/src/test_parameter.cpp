@@ -0,0 +1,143 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "al/util/ui/al_Parameter.hpp"
+
+using namespace al;
+
+TEST_CASE( "AtomicValue kinds" ) {
+    REQUIRE(atomic_value_kind<float>::value == 0);
+    REQUIRE(atomic_value_kind<int32_t>::value == 0);
+    REQUIRE(atomic_value_kind<Color>::value == 1);
+    REQUIRE(atomic_value_kind<Quatd>::value == 1);
+    // Not trivially copyable
+    REQUIRE(atomic_value_kind<Vec3f>::value == 2);
+    REQUIRE(atomic_value_kind<Pose>::value == 2);
+    REQUIRE(atomic_value_kind<std::string>::value == 2);
+}
+
+TEST_CASE( "Parameter reads are never torn" ) {
+    ParameterVec3 vec("vec");
+    ParameterPose pose("pose");
+    ParameterString str("str");
+    ParameterColor color("color");
+    pose.set(Pose(Vec3d(0, 0, 0), Quatd(0, 0, 0, 0)));
+    color.set(Color(0, 0, 0, 0));
+    std::atomic<bool> running(true);
+    std::atomic<int> tornReads(0);
+
+    // Every value written has all components equal
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; r++) {
+        readers.emplace_back([&]() {
+            while (running) {
+                Vec3f v = vec.get();
+                if (v.x != v.y || v.x != v.z) {
+                    tornReads++;
+                }
+                Pose p = pose.get();
+                if (p.pos().x != p.pos().z || p.pos().x != p.quat().w) {
+                    tornReads++;
+                }
+                Color c = color.get();
+                if (c.r != c.g || c.r != c.a) {
+                    tornReads++;
+                }
+                std::string s = str.get();
+                if (s.find_first_not_of(s.empty() ? ' ' : s[0]) != std::string::npos) {
+                    tornReads++;
+                }
+            }
+        });
+    }
+    std::vector<std::thread> writers;
+    for (int w = 0; w < 2; w++) {
+        writers.emplace_back([&, w]() {
+            for (int i = 0; i < 200000; i++) {
+                float value = float(i * 2 + w);
+                vec.set(Vec3f(value, value, value));
+                pose.set(Pose(Vec3d(value, value, value), Quatd(value, 0, 0, 0)));
+                str.set(std::string(1 + (i % 40), char('a' + (i + w) % 26)));
+                color.set(Color(value, value, value, value));
+            }
+        });
+    }
+    for (auto &writer : writers) {
+        writer.join();
+    }
+    running = false;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    REQUIRE(tornReads == 0);
+
+    vec.set(Vec3f(1, 2, 3));
+    REQUIRE(vec.get() == Vec3f(1, 2, 3));
+    str.set("last");
+    REQUIRE(str.get() == "last");
+}
+
+TEST_CASE( "ParameterNotifier defers callbacks" ) {
+    ParameterNotifier notifier(false);
+    Parameter gain("gain", "", 0.0f, "", 0.0f, 1.0f);
+    ParameterInt mode("mode", "", 0, "", 0, 10);
+    std::vector<float> gainValues;
+    int modeCalls = 0;
+    gain.registerChangeCallback([&](float value) { gainValues.push_back(value); });
+    mode.registerChangeCallback([&](int32_t) { modeCalls++; });
+    gain.setNotifier(&notifier);
+    mode.setNotifier(&notifier);
+
+    gain.set(0.25f);
+    gain.set(2.0f); // Clamped
+    mode.set(3);
+    // The value is stored right away, the callbacks wait for the notifier
+    REQUIRE(gain.get() == 1.0f);
+    REQUIRE(mode.get() == 3);
+    REQUIRE(gainValues.empty());
+    notifier.processNotifications();
+    // Changes before the callbacks run are notified once, with the last value
+    REQUIRE(gainValues.size() == 1);
+    REQUIRE(gainValues[0] == 1.0f);
+    REQUIRE(modeCalls == 1);
+
+    gain.setNoCalls(0.5f);
+    notifier.processNotifications();
+    REQUIRE(gainValues.size() == 1);
+
+    {
+        Parameter destroyed("destroyed");
+        destroyed.registerChangeCallback([&](float) { modeCalls++; });
+        destroyed.setNotifier(&notifier);
+        destroyed.set(1.0f);
+    }
+    notifier.processNotifications();
+    REQUIRE(modeCalls == 1);
+
+    gain.setNotifier(nullptr);
+    gain.set(0.75f);
+    REQUIRE(gainValues.size() == 2);
+}
+
+TEST_CASE( "String and menu parameters copy into buffers" ) {
+    char buffer[8];
+    ParameterString text("text", "", "a longer string");
+    REQUIRE(text.copyValue(buffer, sizeof(buffer)) == 7);
+    REQUIRE(std::string(buffer) == "a longe");
+    text.set("");
+    REQUIRE(text.copyValue(buffer, sizeof(buffer)) == 0);
+    REQUIRE(buffer[0] == '\0');
+
+    ParameterMenu menu("menu");
+    menu.setElements({"zero", "one"});
+    menu.set(1);
+    REQUIRE(menu.copyCurrent(buffer, sizeof(buffer)));
+    REQUIRE(std::string(buffer) == "one");
+    menu.set(5);
+    REQUIRE(menu.copyCurrent(buffer, sizeof(buffer)));
+    REQUIRE(buffer[0] == '\0');
+}
@@ -0,0 +1,66 @@
+#include "catch.hpp"
+
+#include "al/util/ui/al_ParameterServer.hpp"
+
+using namespace al;
+
+static void dispatch(ParameterServer &server, const std::string &address, float value) {
+    osc::Packet packet;
+    packet.addMessage(address, value);
+    osc::Message m(packet.data(), packet.size());
+    server.onMessage(m);
+}
+
+TEST_CASE( "ParameterServer dispatch by address" ) {
+    ParameterServer server("", 9010, false);
+    Parameter a("a", "group", 0.0f);
+    Parameter b("b", "group", 0.0f);
+    Parameter sameAddress("a", "group", 0.0f);
+    ParameterInt i("i", "group", 0);
+    server.registerParameter(a);
+    server.registerParameter(b);
+    server.registerParameter(sameAddress);
+    server.registerParameter(i);
+
+    dispatch(server, "/group/a", 0.5f);
+    REQUIRE(a.get() == 0.5f);
+    REQUIRE(sameAddress.get() == 0.5f);
+    REQUIRE(b.get() == 0.0f);
+
+    dispatch(server, "/group/b", 0.25f);
+    REQUIRE(b.get() == 0.25f);
+    REQUIRE(a.get() == 0.5f);
+
+    // Wrong type tags for an int parameter
+    dispatch(server, "/group/i", 3.0f);
+    REQUIRE(i.get() == 0);
+
+    dispatch(server, "/group/missing", 1.0f);
+
+    server.unregisterParameter(a);
+    dispatch(server, "/group/a", 0.75f);
+    REQUIRE(a.get() == 0.5f);
+    REQUIRE(sameAddress.get() == 0.75f);
+}
+
+TEST_CASE( "ParameterServer dispatch to ParameterPose sub-addresses" ) {
+    ParameterServer server("", 9010, false);
+    ParameterPose pose("pose", "group");
+    server.registerParameter(pose);
+
+    dispatch(server, "/group/pose/pos/x", 1.5f);
+    REQUIRE(pose.get().pos().x == 1.5);
+    dispatch(server, "/group/pose/pos/y", 2.5f);
+    dispatch(server, "/group/pose/pos/z", 3.5f);
+    REQUIRE(pose.get().pos() == Vec3d(1.5, 2.5, 3.5));
+
+    osc::Packet packet;
+    packet.addMessage("/group/pose/pos", 4.0f, 5.0f, 6.0f);
+    osc::Message m(packet.data(), packet.size());
+    server.onMessage(m);
+    REQUIRE(pose.get().pos() == Vec3d(4.0, 5.0, 6.0));
+
+    server.unregisterParameter(pose);
+    dispatch(server, "/group/pose/pos/x", 7.0f);
+    REQUIRE(pose.get().pos().x == 4.0);
+}
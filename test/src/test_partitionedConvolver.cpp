@@ -0,0 +1,115 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "al/core/sound/al_PartitionedConvolver.hpp"
+
+using namespace al;
+
+// Max error of the output against a direct convolution reference, with
+// the IRs and routing changed with a crossfade after 10 blocks
+static double crossfadeError(unsigned int framesPerBuffer, unsigned int blockSize, unsigned int partitionSize) {
+    const unsigned int numBlocks = 24;
+    const unsigned int numFrames = framesPerBuffer * numBlocks;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uniform(-0.5f, 0.5f);
+    auto randomIR = [&](size_t length) {
+        std::vector<float> ir(length);
+        for (auto &sample : ir) {
+            sample = uniform(rng) * 0.1f;
+        }
+        return ir;
+    };
+
+    PartitionedConvolver conv;
+    REQUIRE(conv.configure(2, 2, blockSize, 1000));
+    REQUIRE(conv.partitionSize() == partitionSize);
+    REQUIRE(conv.latency() == (partitionSize == blockSize ? 0 : partitionSize));
+    REQUIRE_FALSE(conv.setImpulseResponses({randomIR(10), randomIR(10), randomIR(10)}));
+    REQUIRE_FALSE(conv.setImpulseResponses({randomIR(10)}, {2}));
+
+    // IRs spanning several partitions, and a routing change
+    std::vector<std::vector<float>> irsA {randomIR(300), randomIR(700)};
+    std::vector<unsigned int> routingA {0, 1};
+    std::vector<std::vector<float>> irsB {randomIR(900), randomIR(50)};
+    std::vector<unsigned int> routingB {1, 0};
+    const unsigned int switchFrame = 10 * framesPerBuffer;
+    const unsigned int crossfadeFrames = 200;
+    // The crossfade starts with the partition being collected
+    const unsigned int crossfadeStart = switchFrame / partitionSize * partitionSize;
+
+    std::vector<std::vector<float>> input(2, std::vector<float>(numFrames));
+    for (auto &channel : input) {
+        for (auto &sample : channel) {
+            sample = uniform(rng);
+        }
+    }
+
+    AudioIOData io;
+    io.framesPerBuffer(framesPerBuffer);
+    io.channelsIn(0);
+    io.channelsOut(2);
+    std::vector<std::vector<float>> output(2, std::vector<float>(numFrames));
+    REQUIRE(conv.setImpulseResponses(irsA, routingA));
+    for (unsigned int block = 0; block < numBlocks; block++) {
+        if (block * framesPerBuffer == switchFrame) {
+            REQUIRE_FALSE(conv.crossfading());
+            // Replaced before the audio thread picks it up, never heard
+            REQUIRE(conv.setImpulseResponses({randomIR(500), randomIR(500)}, {0, 0}, 10));
+            REQUIRE(conv.setImpulseResponses(irsB, routingB, crossfadeFrames));
+            REQUIRE(conv.crossfading());
+        }
+        for (unsigned int c = 0; c < 2; c++) {
+            for (unsigned int i = 0; i < framesPerBuffer; i++) {
+                io.out(c, i) = input[c][block * framesPerBuffer + i];
+            }
+        }
+        // In place, as when used in the audio callback
+        conv.processBlock(io);
+        for (unsigned int c = 0; c < 2; c++) {
+            for (unsigned int i = 0; i < framesPerBuffer; i++) {
+                output[c][block * framesPerBuffer + i] = io.out(c, i);
+            }
+        }
+    }
+    REQUIRE_FALSE(conv.crossfading());
+
+    auto reference = [&](const std::vector<float> &ir, const std::vector<float> &x, unsigned int n) {
+        double sum = 0;
+        for (unsigned int k = 0; k < ir.size() && k <= n; k++) {
+            sum += double(ir[k]) * x[n - k];
+        }
+        return sum;
+    };
+    double maxError = 0;
+    for (unsigned int c = 0; c < 2; c++) {
+        for (unsigned int n = 0; n < numFrames; n++) {
+            if (n < conv.latency()) {
+                maxError = std::max(maxError, double(std::abs(output[c][n])));
+                continue;
+            }
+            unsigned int t = n - conv.latency();
+            double a = reference(irsA[c], input[routingA[c]], t);
+            double b = reference(irsB[c], input[routingB[c]], t);
+            double expected = a;
+            if (t >= crossfadeStart + crossfadeFrames) {
+                expected = b;
+            } else if (t >= crossfadeStart) {
+                double gain = double(t - crossfadeStart) / crossfadeFrames;
+                expected = a + gain * (b - a);
+            }
+            maxError = std::max(maxError, std::abs(output[c][n] - expected));
+        }
+    }
+    return maxError;
+}
+
+TEST_CASE( "PartitionedConvolver impulse response crossfade" ) {
+    // Blocks of two partitions
+    REQUIRE(crossfadeError(128, 64, 64) < 1e-5);
+    // Block sizes that are not a power of two are buffered
+    REQUIRE(crossfadeError(100, 100, 128) < 1e-5);
+    REQUIRE(crossfadeError(48, 48, 64) < 1e-5);
+}
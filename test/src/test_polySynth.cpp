@@ -0,0 +1,218 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "al/util/scene/al_PolySynth.hpp"
+#include "al/core/io/al_AudioIOData.hpp"
+
+using namespace al;
+
+class CountingVoice : public SynthVoice {
+public:
+    virtual void onProcess(AudioIOData& io) override {
+        while(io()) {
+            io.out(0) += 0.001f;
+        }
+    }
+
+    virtual void onTriggerOff() override {
+        free();
+    }
+};
+
+TEST_CASE( "PolySynth concurrent trigger stress" ) {
+    const int numProducers = 4;
+    const int triggersPerSecond = 10000;
+    const int durationMs = 500;
+    const int poolSize = 256;
+
+    AudioIOData audioData;
+    audioData.framesPerBuffer(64);
+    audioData.framesPerSecond(44100);
+    audioData.channelsIn(0);
+    audioData.channelsOut(2);
+
+    PolySynth synth;
+    synth.allocatePolyphony<CountingVoice>(poolSize);
+    synth.disableAllocation<CountingVoice>();
+
+    std::atomic<int> freedCount(0);
+    synth.registerFreeCallback([&](int id, void *) {
+        freedCount++;
+        return true;
+    });
+
+    std::atomic<bool> running(true);
+    std::atomic<int> triggeredCount(0);
+    std::atomic<int> failedTriggers(0);
+
+    std::thread audioThread([&]() {
+        while (running) {
+            audioData.zeroOut();
+            synth.render(audioData);
+        }
+    });
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < numProducers; p++) {
+        producers.emplace_back([&]() {
+            using namespace std::chrono;
+            auto interval = microseconds(1000000 * numProducers / triggersPerSecond);
+            auto next = steady_clock::now();
+            auto end = next + milliseconds(durationMs);
+            int previousId = -1;
+            while (steady_clock::now() < end) {
+                auto *voice = synth.getVoice<CountingVoice>();
+                if (voice) {
+                    int id = synth.triggerOn(voice);
+                    if (id < 0) {
+                        failedTriggers++;
+                        continue;
+                    }
+                    triggeredCount++;
+                    if (previousId >= 0) {
+                        synth.triggerOff(previousId);
+                    }
+                    previousId = id;
+                }
+                next += interval;
+                std::this_thread::sleep_until(next);
+            }
+            if (previousId >= 0) {
+                synth.triggerOff(previousId);
+            }
+        });
+    }
+
+    for (auto &t: producers) {
+        t.join();
+    }
+    // Let the audio thread retire the last voices
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (freedCount < triggeredCount && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    running = false;
+    audioThread.join();
+
+    REQUIRE(failedTriggers == 0);
+    REQUIRE(triggeredCount > 0);
+    REQUIRE(freedCount == triggeredCount);
+    REQUIRE(synth.getActiveVoices() == nullptr);
+
+    // Every preallocated voice must be back in the free pool
+    int numFree = 0;
+    while (auto *voice = synth.getFreeVoice()) {
+        REQUIRE(voice->id() == -1);
+        numFree++;
+    }
+    REQUIRE(numFree == poolSize);
+}
+
+TEST_CASE( "PolySynth all notes off" ) {
+    AudioIOData audioData;
+    audioData.framesPerBuffer(64);
+    audioData.framesPerSecond(44100);
+    audioData.channelsIn(0);
+    audioData.channelsOut(2);
+
+    PolySynth synth;
+    synth.allocatePolyphony<CountingVoice>(8);
+    for (int i = 0; i < 8; i++) {
+        synth.triggerOn(synth.getVoice<CountingVoice>());
+    }
+    synth.render(audioData);
+    REQUIRE(synth.getActiveVoices() != nullptr);
+
+    synth.allNotesOff();
+    synth.render(audioData);
+    REQUIRE(synth.getActiveVoices() == nullptr);
+
+    int numFree = 0;
+    while (synth.getFreeVoice()) {
+        numFree++;
+    }
+    REQUIRE(numFree == 8);
+}
+
+TEST_CASE( "PolySynth trigger off by id" ) {
+    const int numVoices = 2000;
+    AudioIOData audioData;
+    audioData.framesPerBuffer(64);
+    audioData.framesPerSecond(44100);
+    audioData.channelsIn(0);
+    audioData.channelsOut(2);
+
+    PolySynth synth;
+    synth.allocatePolyphony<CountingVoice>(numVoices);
+    std::vector<int> ids;
+    for (int i = 0; i < numVoices; i++) {
+        // Voices 0 and 1 share an id
+        ids.push_back(synth.triggerOn(synth.getVoice<CountingVoice>(), 0, i == 1 ? ids[0] : -1));
+    }
+    synth.render(audioData);
+
+    auto countActive = [&]() {
+        int count = 0;
+        auto *voice = synth.getActiveVoices();
+        while (voice) {
+            count++;
+            voice = voice->next;
+        }
+        return count;
+    };
+    REQUIRE(countActive() == numVoices);
+
+    std::vector<int> turnedOff;
+    for (int i = 2; i < numVoices; i += 2) {
+        synth.triggerOff(ids[i]);
+        turnedOff.push_back(ids[i]);
+    }
+    synth.render(audioData);
+    REQUIRE(countActive() == numVoices / 2 + 1);
+    auto *voice = synth.getActiveVoices();
+    while (voice) {
+        REQUIRE(std::find(turnedOff.begin(), turnedOff.end(), voice->id()) == turnedOff.end());
+        voice = voice->next;
+    }
+
+    synth.triggerOff(ids[0]);
+    synth.render(audioData);
+    REQUIRE(countActive() == numVoices / 2 - 1);
+}
+
+TEST_CASE( "PolySynth counts dropped trigger offs" ) {
+    PolySynth synth;
+    // Nothing drains the queue without render()
+    for (int id = 0; id < 1100; id++) {
+        synth.triggerOff(id);
+    }
+    REQUIRE(synth.droppedTriggerOffs() > 0);
+    REQUIRE(synth.droppedTriggerOffs() < 1100);
+}
+
+class OtherVoice : public SynthVoice {
+};
+
+TEST_CASE( "PolySynth voices by resolved type" ) {
+    PolySynth synth;
+    synth.registerSynthClass<CountingVoice>("counting");
+    synth.allocatePolyphony<OtherVoice>(2);
+
+    REQUIRE(synth.voiceType("counting") == &typeid(CountingVoice));
+    REQUIRE(synth.voiceType("OtherVoice") == &typeid(OtherVoice));
+    REQUIRE(synth.voiceType("missing") == nullptr);
+
+    // Allocated through the registered creator, then reused once freed
+    auto *voice = synth.getVoice(typeid(CountingVoice), "counting");
+    REQUIRE(dynamic_cast<CountingVoice *>(voice) != nullptr);
+    synth.insertFreeVoice(voice);
+    REQUIRE(synth.getVoice(typeid(CountingVoice), "counting") == voice);
+
+    auto *other = synth.getVoice(typeid(OtherVoice), "OtherVoice");
+    REQUIRE(dynamic_cast<OtherVoice *>(other) != nullptr);
+}
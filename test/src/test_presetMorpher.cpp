@@ -0,0 +1,102 @@
+#include "catch.hpp"
+
+#include <cmath>
+
+#include "al/core/io/al_File.hpp"
+#include "al/util/ui/al_PresetMorpher.hpp"
+
+using namespace al;
+
+TEST_CASE( "PresetMorpher ramps preset values per sample" ) {
+    PresetHandler presets("presetMorpherTest");
+    Parameter cutoff("cutoff", "", 100.0f, "", 0.0f, 20000.0f);
+    ParameterVec3 position("position");
+    ParameterInt mode("mode", "", 0, "", 0, 10);
+    Parameter notMorphed("notMorphed", "", 1.0f, "", 0.0f, 10.0f);
+    presets << cutoff << position << mode << notMorphed;
+
+    cutoff.set(1100.0f);
+    position.set(Vec3f(1, 2, 3));
+    mode.set(4);
+    presets.storePreset("target");
+    cutoff.set(100.0f);
+    position.set(Vec3f(0, 0, 0));
+    mode.set(0);
+
+    PresetMorpher morpher(presets);
+    morpher.compile();
+    REQUIRE(morpher.numSlots() == 6);
+    int cutoffSlot = morpher.slot("/cutoff");
+    int positionSlot = morpher.slot("/position");
+    int modeSlot = morpher.slot("/mode");
+    REQUIRE(morpher.slot("/missing") == -1);
+    REQUIRE(morpher.value(cutoffSlot) == 100.0f);
+
+    // 100 frames at 1 kHz in blocks of 16, so it ends during a block
+    const unsigned int framesPerBuffer = 16;
+    REQUIRE(morpher.morphTo("target", 0.1f));
+    REQUIRE(morpher.morphing());
+    float maxError = 0;
+    for (unsigned int block = 0; block < 8; block++) {
+        morpher.process(framesPerBuffer, 1000.0);
+        for (unsigned int i = 0; i < framesPerBuffer; i++) {
+            float t = std::min((block * framesPerBuffer + i) / 100.0f, 1.0f);
+            maxError = std::max(maxError, std::abs(morpher.value(cutoffSlot, i) - (100.0f + 1000.0f * t)));
+            maxError = std::max(maxError, std::abs(morpher.value(positionSlot + 2, i) - 3.0f * t));
+            // Stepped parameters jump at the start
+            REQUIRE(morpher.value(modeSlot, i) == 4.0f);
+        }
+    }
+    REQUIRE(maxError < 1e-3f);
+    REQUIRE_FALSE(morpher.morphing());
+    REQUIRE(morpher.value(cutoffSlot) == 1100.0f);
+    REQUIRE(morpher.value(cutoffSlot, framesPerBuffer - 1) == 1100.0f);
+
+    // The parameters are only set on request
+    REQUIRE(cutoff.get() == 100.0f);
+    morpher.updateParameters();
+    REQUIRE(cutoff.get() == 1100.0f);
+    REQUIRE(position.get() == Vec3f(1, 2, 3));
+    REQUIRE(mode.get() == 4);
+    REQUIRE(notMorphed.get() == 1.0f);
+}
+
+TEST_CASE( "PresetMorpher block rate and stop" ) {
+    PresetHandler presets("presetMorpherTest");
+    Parameter a("a", "", 0.0f, "", 0.0f, 100.0f);
+    Parameter b("b", "", 0.0f, "", 0.0f, 100.0f);
+    presets << a << b;
+
+    PresetMorpher morpher(presets, PresetMorpher::MORPH_BLOCK);
+    morpher.compile();
+    int slotA = morpher.slot("/a");
+    int slotB = morpher.slot("/b");
+
+    // Values are at the end of each block
+    morpher.morph({{"/a", {10.0f}}}, {{"/a", {20.0f}}, {"/b", {40.0f}}}, 0.1f);
+    morpher.process(25, 1000.0);
+    REQUIRE(morpher.value(slotA) == Approx(12.5f));
+    REQUIRE(morpher.value(slotA, 10) == Approx(12.5f));
+    REQUIRE(morpher.value(slotB) == Approx(10.0f));
+    morpher.process(25, 1000.0);
+    REQUIRE(morpher.value(slotA) == Approx(15.0f));
+
+    morpher.stopMorph();
+    morpher.process(25, 1000.0);
+    REQUIRE_FALSE(morpher.morphing());
+    REQUIRE(morpher.value(slotA) == Approx(15.0f));
+    REQUIRE(morpher.value(slotB) == Approx(20.0f));
+
+    // A new morph starts from where the last one stopped
+    morpher.rate(PresetMorpher::MORPH_SAMPLE);
+    morpher.morphTo({{"/b", {0.0f}}}, 0.01f);
+    morpher.process(20, 1000.0);
+    REQUIRE(morpher.value(slotB, 0) == Approx(20.0f));
+    REQUIRE(morpher.value(slotB, 5) == Approx(10.0f));
+    REQUIRE(morpher.value(slotB, 15) == Approx(0.0f));
+    REQUIRE(morpher.value(slotA, 15) == Approx(15.0f));
+    morpher.process(20, 1000.0);
+    REQUIRE(morpher.value(slotB) == 0.0f);
+    REQUIRE(morpher.value(slotB, 10) == 0.0f);
+    Dir::removeRecursively("presetMorpherTest");
+}
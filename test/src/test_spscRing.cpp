@@ -0,0 +1,121 @@
+#include "catch.hpp"
+
+#include <thread>
+#include <vector>
+
+#include "al/core/types/al_SPSCRing.hpp"
+#include "al/core/types/al_SingleRWRingBuffer.hpp"
+
+using namespace al;
+
+TEST_CASE( "SPSCRing single thread" ) {
+    SPSCRing<int> ring(5);
+    REQUIRE(ring.capacity() == 8);
+    REQUIRE(ring.writeSpace() == 8);
+    int value;
+    REQUIRE_FALSE(ring.pop(value));
+
+    int values[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    REQUIRE(ring.write(values, 6) == 6);
+    REQUIRE(ring.readSpace() == 6);
+    int out[8];
+    REQUIRE(ring.read(out, 4) == 4);
+    REQUIRE(out[3] == 3);
+
+    // Free space wraps around the end of the storage
+    auto span = ring.reserveWrite(6);
+    REQUIRE(span.size == 2);
+    span.data[0] = 10;
+    span.data[1] = 11;
+    ring.commitWrite(2);
+    span = ring.reserveWrite(6);
+    REQUIRE(span.size == 4);
+    REQUIRE(ring.reserveWrite(0).size == 0);
+    ring.commitWrite(0);
+    REQUIRE(ring.push(12));
+    REQUIRE(ring.write(values, 8) == 3);
+    REQUIRE_FALSE(ring.push(13));
+
+    REQUIRE(ring.peek(out, 8) == 8);
+    REQUIRE(ring.readSpace() == 8);
+    std::vector<int> expected {4, 5, 10, 11, 12, 0, 1, 2};
+    REQUIRE(std::vector<int>(out, out + 8) == expected);
+    auto readSpan = ring.reserveRead(8);
+    REQUIRE(readSpan.size == 4);
+    REQUIRE(readSpan.data[3] == 11);
+    ring.commitRead(4);
+    REQUIRE(ring.pop(value));
+    REQUIRE(value == 12);
+    ring.clear();
+    REQUIRE(ring.readSpace() == 0);
+    REQUIRE(ring.writeSpace() == 8);
+
+    SingleRWRingBuffer bytes(10);
+    REQUIRE(bytes.write("abcdefghijklmnopq", 17) == 16);
+    char text[4];
+    REQUIRE(bytes.read(text, 3) == 3);
+    REQUIRE(text[2] == 'c');
+    REQUIRE(bytes.readSpace() == 13);
+}
+
+TEST_CASE( "SPSCRing between two threads" ) {
+    const uint32_t count = 200000;
+    SPSCRing<uint32_t> ring(64);
+    std::thread writer([&]() {
+        uint32_t next = 0;
+        while (next < count) {
+            // Mix single pushes, copies and in place writes
+            if (next % 3 == 0) {
+                if (ring.push(next)) next++;
+            } else {
+                auto span = ring.reserveWrite(std::min<size_t>(17, count - next));
+                for (size_t i = 0; i < span.size; i++) span.data[i] = next + uint32_t(i);
+                ring.commitWrite(span.size);
+                next += uint32_t(span.size);
+            }
+        }
+    });
+    uint32_t expected = 0;
+    bool inOrder = true;
+    std::vector<uint32_t> buffer(23);
+    while (expected < count) {
+        size_t n;
+        if (expected % 2) {
+            n = ring.read(buffer.data(), buffer.size());
+            for (size_t i = 0; i < n; i++) inOrder &= buffer[i] == expected + i;
+        } else {
+            auto span = ring.reserveRead(11);
+            n = span.size;
+            for (size_t i = 0; i < n; i++) inOrder &= span.data[i] == expected + i;
+            ring.commitRead(n);
+        }
+        expected += uint32_t(n);
+    }
+    writer.join();
+    REQUIRE(inOrder);
+    REQUIRE(expected == count);
+}
+
+TEST_CASE( "SPSCFrameRing interleaves channels" ) {
+    SPSCFrameRing<float> ring(6, 3);
+    REQUIRE(ring.capacity() == 8);
+    REQUIRE(ring.channels() == 3);
+    std::vector<float> channels[3];
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < 10; i++) channels[c].push_back(c * 100.0f + i);
+    }
+    const float *buffers[3] = {channels[0].data(), channels[1].data(), channels[2].data()};
+    REQUIRE(ring.writeChannels(buffers, 5) == 5);
+    float frames[8 * 3];
+    REQUIRE(ring.read(frames, 4) == 4);
+    REQUIRE(frames[3 * 3 + 2] == 203.0f);
+    // Wraps around the end of the storage
+    REQUIRE(ring.writeChannels(buffers, 10) == 7);
+    auto span = ring.reserveRead(8);
+    REQUIRE(span.size == 4);
+    REQUIRE(span.data[0] == 4.0f);
+    REQUIRE(span.data[3 * 1 + 1] == 100.0f);
+    ring.commitRead(4);
+    REQUIRE(ring.read(frames, 8) == 4);
+    REQUIRE(frames[3 * 3 + 2] == 206.0f);
+}
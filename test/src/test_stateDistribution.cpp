@@ -0,0 +1,158 @@
+#include "catch.hpp"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "al/core/protocol/al_StateDistribution.hpp"
+#include "al/core/system/al_Time.hpp"
+
+using namespace al;
+
+// Poll condition until it is true or a second has passed
+template<class Condition>
+bool waitFor(Condition condition) {
+    al_sec deadline = al_steady_time() + 1.0;
+    while (!condition()) {
+        if (al_steady_time() > deadline) {
+            return false;
+        }
+        al_sleep(0.001);
+    }
+    return true;
+}
+
+TEST_CASE( "State delta encoding" ) {
+    const size_t size = 10000;
+    std::vector<char> reference(size), state(size), decoded(size, 0);
+    std::mt19937 rng(7);
+    for (auto &c : reference) {
+        c = char(rng());
+    }
+    std::vector<char> encoded;
+
+    // Equal states encode to nothing
+    state = reference;
+    StateSender::encodeDelta(state.data(), reference.data(), size, encoded);
+    REQUIRE(encoded.size() == 0);
+    REQUIRE(StateSender::decodeDelta(encoded.data(), encoded.size(),
+                                     reference.data(), decoded.data(), size));
+    REQUIRE(decoded == state);
+
+    // Sparse changes, including the first and last byte
+    for (int i = 0; i < 100; i++) {
+        state[rng() % size] ^= char(1 + rng() % 255);
+    }
+    state[0] ^= 1;
+    state[size - 1] ^= 1;
+    StateSender::encodeDelta(state.data(), reference.data(), size, encoded);
+    REQUIRE(encoded.size() < size / 4);
+    REQUIRE(StateSender::decodeDelta(encoded.data(), encoded.size(),
+                                     reference.data(), decoded.data(), size));
+    REQUIRE(decoded == state);
+
+    // Everything changed
+    for (auto &c : state) {
+        c = ~c;
+    }
+    StateSender::encodeDelta(state.data(), reference.data(), size, encoded);
+    REQUIRE(StateSender::decodeDelta(encoded.data(), encoded.size(),
+                                     reference.data(), decoded.data(), size));
+    REQUIRE(decoded == state);
+
+    // Malformed data is rejected
+    encoded.resize(encoded.size() / 2);
+    REQUIRE(!StateSender::decodeDelta(encoded.data(), encoded.size(),
+                                      reference.data(), decoded.data(), size));
+}
+
+TEST_CASE( "State distribution over loopback" ) {
+    struct State {
+        int frame;
+        float values[8000];
+    };
+    State state, received;
+    memset(&state, 0, sizeof(State));
+    memset(&received, 0, sizeof(State));
+
+    StateReceiver receiver(sizeof(State));
+    REQUIRE(receiver.open(0, "localhost"));
+    REQUIRE(receiver.port() != 0);
+    StateSender sender(sizeof(State));
+    sender.keyframeInterval(4);
+    REQUIRE(sender.addListener("localhost", receiver.port()));
+
+    size_t keyframeBytes = 0;
+    size_t deltaBytes = 0;
+    for (int frame = 0; frame < 10; frame++) {
+        state.frame = frame;
+        state.values[frame * 100] = float(frame);
+        size_t bytes = sender.send(&state);
+        if (frame == 0) {
+            keyframeBytes = bytes;
+        } else if (frame == 1) {
+            deltaBytes = bytes;
+        }
+        REQUIRE(waitFor([&]() { return receiver.pendingStates() > 0; }));
+        REQUIRE(receiver.get(&received) == 1);
+        REQUIRE(memcmp(&state, &received, sizeof(State)) == 0);
+    }
+    REQUIRE(keyframeBytes > sizeof(State));
+    REQUIRE(deltaBytes < 200);
+    REQUIRE(receiver.get(&received) == 0);
+    REQUIRE(receiver.droppedFrames() == 0);
+}
+
+TEST_CASE( "State receiver keeps only the newest state" ) {
+    int state[1000];
+    memset(state, 0, sizeof(state));
+
+    StateReceiver receiver(sizeof(state));
+    REQUIRE(receiver.open(0, "localhost"));
+    StateSender sender(sizeof(state));
+    REQUIRE(sender.addListener("localhost", receiver.port()));
+
+    for (int frame = 1; frame <= 3; frame++) {
+        state[0] = frame;
+        sender.send(state);
+    }
+    REQUIRE(waitFor([&]() { return receiver.pendingStates() == 3; }));
+    REQUIRE(receiver.update() == 3);
+    REQUIRE(receiver.staleFrames() == 2);
+    const int *received = static_cast<const int *>(receiver.state());
+    REQUIRE(received[0] == 3);
+    REQUIRE(receiver.update() == 0);
+    REQUIRE(receiver.state() == received);
+
+    state[1] = 7;
+    sender.send(state);
+    REQUIRE(waitFor([&]() { return receiver.pendingStates() == 1; }));
+    REQUIRE(receiver.update() == 1);
+    received = static_cast<const int *>(receiver.state());
+    REQUIRE(received[0] == 3);
+    REQUIRE(received[1] == 7);
+    REQUIRE(receiver.staleFrames() == 2);
+    REQUIRE(receiver.droppedFrames() == 0);
+}
+
+TEST_CASE( "State receiver ignores frames for other ids" ) {
+    int state[16];
+    memset(state, 0, sizeof(state));
+
+    StateReceiver receiver(sizeof(state), "a");
+    REQUIRE(receiver.open(0, "localhost"));
+    StateSender senderA(sizeof(state), "a");
+    REQUIRE(senderA.addListener("localhost", receiver.port()));
+    StateSender senderB(sizeof(state), "b");
+    REQUIRE(senderB.addListener("localhost", receiver.port()));
+
+    // Frames are delivered in order over loopback, so a frame from "b" would
+    // be counted before the one from "a"
+    state[0] = 2;
+    senderB.send(state);
+    state[0] = 1;
+    senderA.send(state);
+    REQUIRE(waitFor([&]() { return receiver.pendingStates() > 0; }));
+    REQUIRE(receiver.update() == 1);
+    REQUIRE(static_cast<const int *>(receiver.state())[0] == 1);
+}
@@ -0,0 +1,337 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+#include "al/util/scene/al_SynthRecorder.hpp"
+#include "al/util/scene/al_SynthSequencer.hpp"
+#include "al/util/scene/al_SynthSequenceFile.hpp"
+
+using namespace al;
+
+static int turnedOn = 0;
+static int turnedOff = 0;
+
+class SequencedVoice : public SynthVoice {
+public:
+    virtual void onTriggerOn() override { turnedOn++; }
+
+    virtual void onTriggerOff() override {
+        turnedOff++;
+        free();
+    }
+};
+
+static std::vector<float> triggeredFrequencies;
+
+class PitchedVoice : public SynthVoice {
+public:
+    PitchedVoice() { mFrequency = createInternalTriggerParameter("frequency"); }
+
+    virtual void onTriggerOn() override { triggeredFrequencies.push_back(mFrequency->get()); }
+
+    virtual void onTriggerOff() override {
+        turnedOff++;
+        free();
+    }
+
+    std::shared_ptr<Parameter> mFrequency;
+};
+
+TEST_CASE( "SynthSequencer event timeline" ) {
+    AudioIOData audioData;
+    audioData.framesPerBuffer(64);
+    audioData.framesPerSecond(6400); // 10 ms blocks
+    audioData.channelsIn(0);
+    audioData.channelsOut(2);
+
+    SynthSequencer seq(PolySynth::TIME_MASTER_AUDIO);
+    int sequenceEnds = 0;
+    seq.registerSequenceEndCallback([&](std::string) { sequenceEnds++; });
+    turnedOn = turnedOff = 0;
+
+    // Added out of order
+    seq.add<SequencedVoice>(0.5, 0.2);
+    seq.add<SequencedVoice>(0.1, 0.1);
+    seq.add<SequencedVoice>(0.3, 1.0);
+
+    double time = 0;
+    auto renderUntil = [&](double endTime) {
+        while (time < endTime) {
+            audioData.zeroOut();
+            seq.render(audioData);
+            time += 0.01;
+        }
+    };
+    renderUntil(0.15);
+    REQUIRE(turnedOn == 1);
+    REQUIRE(turnedOff == 0);
+    renderUntil(0.25);
+    REQUIRE(turnedOff == 1);
+    renderUntil(0.55);
+    REQUIRE(turnedOn == 3);
+    REQUIRE(turnedOff == 1);
+    renderUntil(0.75);
+    REQUIRE(turnedOff == 2);
+
+    // Events added in the past play on the next block
+    seq.add<SequencedVoice>(0.7, 0.3);
+    renderUntil(0.8);
+    REQUIRE(turnedOn == 4);
+    REQUIRE(turnedOff == 2);
+    renderUntil(1.1);
+    REQUIRE(turnedOff == 3);
+    REQUIRE(sequenceEnds == 0);
+    renderUntil(1.35);
+    REQUIRE(turnedOff == 4);
+    REQUIRE(sequenceEnds == 1);
+}
+
+TEST_CASE( "SynthSequencer text sequence loading" ) {
+    const char *name = "test_synthSequencer.synthSequence";
+    {
+        std::ofstream f(name);
+        f << "+ 0.1 7 SequencedVoice\n";
+        f << "@ 0.05 0.1 SequencedVoice 1 2\n";
+        f << "+ 0.2 7 SequencedVoice\n";
+        f << "- 0.3 7\n";
+        f << "- 0.6 7\n";
+        f << "> 1\n";
+        f << "@ 0 0.25 SequencedVoice\n";
+    }
+    SynthSequencer seq(PolySynth::TIME_MASTER_AUDIO);
+    seq.synth().registerSynthClass<SequencedVoice>("SequencedVoice");
+    auto loaded = seq.loadSequence(name);
+    std::vector<SynthSequencerEvent> events(loaded.begin(), loaded.end());
+    std::remove(name);
+
+    REQUIRE(events.size() == 4);
+    REQUIRE(events[0].startTime == Approx(0.05));
+    REQUIRE(events[0].duration == Approx(0.1));
+    REQUIRE(events[0].type == SynthSequencerEvent::EVENT_PFIELDS);
+    REQUIRE(events[0].fields.pFields.size() == 2);
+    REQUIRE(events[1].startTime == Approx(0.1));
+    REQUIRE(events[1].duration == Approx(0.2));
+    REQUIRE(events[1].type == SynthSequencerEvent::EVENT_VOICE);
+    REQUIRE(events[2].startTime == Approx(0.2));
+    REQUIRE(events[2].duration == Approx(0.4));
+    REQUIRE(events[3].startTime == Approx(1.0));
+    REQUIRE(events[3].duration == Approx(0.25));
+
+    for (auto &event : events) {
+        if (event.voice) {
+            seq.synth().insertFreeVoice(event.voice);
+        }
+    }
+}
+
+TEST_CASE( "SynthSequencer binary sequences" ) {
+    {
+        std::ofstream f("conversion.synthSequence");
+        f << "@ 0.3 0.2 PitchedVoice 660\n";
+        f << "@ 0.1 0.1 PitchedVoice 440\n";
+        f << "+ 0.2 3 PitchedVoice 550\n";
+        f << "- 0.4 3\n";
+        f << "@ 0.5 0.1 PitchedVoice 880 \"label\"\n";
+    }
+    SynthSequencer seq(PolySynth::TIME_MASTER_AUDIO);
+    seq.synth().registerSynthClass<PitchedVoice>("PitchedVoice");
+    REQUIRE(seq.convertToBinary("conversion"));
+    std::remove("conversion.synthSequence");
+
+    SynthSequenceFile sequence;
+    REQUIRE(sequence.open(seq.buildBinaryPath("conversion")));
+    REQUIRE(sequence.numEvents() == 4);
+    REQUIRE(sequence.numStrings() == 2);
+    REQUIRE(sequence.numNames() == 1);
+    REQUIRE(sequence.maxOverlap() == 2);
+    double startTimes[] = {0.1, 0.2, 0.3, 0.5};
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(sequence.event(i).startTime == Approx(startTimes[i]));
+        REQUIRE(sequence.validEvent(sequence.event(i)));
+        REQUIRE(sequence.string(sequence.event(i).name) == "PitchedVoice");
+    }
+    auto &turnOn = sequence.event(1);
+    REQUIRE(turnOn.duration == Approx(0.2));
+    REQUIRE(turnOn.id == 3);
+    REQUIRE(turnOn.numFields == 1);
+    REQUIRE(sequence.fieldValues()[turnOn.firstField] == 550.0f);
+    REQUIRE(sequence.floatFieldsOnly(turnOn));
+    auto &withString = sequence.event(3);
+    REQUIRE_FALSE(sequence.floatFieldsOnly(withString));
+    auto fields = sequence.fields(withString);
+    REQUIRE(fields.size() == 2);
+    REQUIRE(fields[0].get<float>() == 880.0f);
+    REQUIRE(fields[1].get<std::string>() == "label");
+    REQUIRE(sequence.stringEventFields(1) == nullptr);
+    const ParameterField *stringFields = sequence.stringEventFields(3);
+    REQUIRE(stringFields);
+    REQUIRE(stringFields[0].get<float>() == 880.0f);
+    REQUIRE(stringFields[1].get<std::string>() == "label");
+    REQUIRE(sequence.firstEventAt(0.25) == 2);
+
+    // There is no text sequence left, so the binary one is played
+    AudioIOData audioData;
+    audioData.framesPerBuffer(64);
+    audioData.framesPerSecond(6400);
+    audioData.channelsIn(0);
+    audioData.channelsOut(2);
+    int sequenceEnds = 0;
+    seq.registerSequenceEndCallback([&](std::string) { sequenceEnds++; });
+    triggeredFrequencies.clear();
+    turnedOff = 0;
+    seq.playSequence("conversion");
+    for (int block = 0; block < 100; block++) {
+        audioData.zeroOut();
+        seq.render(audioData);
+    }
+    REQUIRE(triggeredFrequencies == std::vector<float>({440, 550, 660, 880}));
+    REQUIRE(turnedOff == 4);
+    REQUIRE(sequenceEnds == 1);
+    seq.stopSequence();
+
+    // Back to text
+    REQUIRE(seq.convertToText("conversion"));
+    auto loaded = seq.loadSequence("conversion");
+    std::vector<SynthSequencerEvent> events(loaded.begin(), loaded.end());
+    REQUIRE(events.size() == 4);
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(events[i].startTime == Approx(startTimes[i]));
+        REQUIRE(events[i].fields.pFields.size() == sequence.event(i).numFields);
+    }
+    REQUIRE(events[1].duration == Approx(0.2));
+    REQUIRE(events[3].fields.pFields[1].get<std::string>() == "label");
+    std::remove("conversion.synthSequence");
+    std::remove("conversion.synthSequenceBin");
+}
+
+class RecordedVoice : public SynthVoice {
+public:
+    RecordedVoice() { mFrequency = createInternalTriggerParameter("frequency"); }
+
+    virtual void onTriggerOff() override { free(); }
+
+    std::shared_ptr<Parameter> mFrequency;
+};
+
+TEST_CASE( "SynthRecorder records triggers from several threads" ) {
+    const int numThreads = 3;
+    const int eventsPerThread = 2000;
+    for (auto format : {SynthRecorder::SEQUENCER_EVENT, SynthRecorder::BINARY}) {
+        PolySynth synth;
+        synth.registerSynthClass<RecordedVoice>("RecordedVoice");
+        SynthRecorder recorder(format, 1024);
+        recorder.setDirectory(".");
+        recorder << synth;
+        recorder.startRecord("recording", true);
+
+        AudioIOData audioData;
+        audioData.framesPerBuffer(64);
+        audioData.framesPerSecond(44100);
+        audioData.channelsIn(0);
+        audioData.channelsOut(2);
+        std::atomic<bool> rendering(true);
+        std::thread audioThread([&]() {
+            while (rendering) {
+                audioData.zeroOut();
+                synth.render(audioData);
+            }
+        });
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < numThreads; t++) {
+            threads.emplace_back([&, t]() {
+                for (int i = 0; i < eventsPerThread; i++) {
+                    auto *voice = synth.getVoice<RecordedVoice>();
+                    voice->mFrequency->set(float(t * eventsPerThread + i));
+                    int id = synth.triggerOn(voice);
+                    synth.triggerOff(id);
+                    if (i % 20 == 0) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        rendering = false;
+        audioThread.join();
+        recorder.stopRecord();
+        REQUIRE(recorder.droppedEvents() == 0);
+
+        SynthSequencer seq(PolySynth::TIME_MASTER_AUDIO);
+        seq.synth().registerSynthClass<RecordedVoice>("RecordedVoice");
+        std::vector<float> frequencies;
+        if (format == SynthRecorder::BINARY) {
+            SynthSequenceFile sequence;
+            REQUIRE(sequence.open("recording.synthSequenceBin"));
+            for (auto &event : sequence.toEvents()) {
+                frequencies.push_back(event.fields.pFields[0].get<float>());
+            }
+        } else {
+            for (auto &event : seq.loadSequence("recording")) {
+                frequencies.push_back(event.fields.pFields[0].get<float>());
+            }
+        }
+        std::remove("recording.synthSequence");
+        std::remove("recording.synthSequenceBin");
+        REQUIRE(frequencies.size() == numThreads * eventsPerThread);
+        std::sort(frequencies.begin(), frequencies.end());
+        std::vector<float> expected(frequencies.size());
+        for (size_t i = 0; i < expected.size(); i++) {
+            expected[i] = float(i);
+        }
+        REQUIRE(frequencies == expected);
+    }
+}
+
+class ScaledVoice : public SynthVoice {
+public:
+    ScaledVoice() { mFrequency = createInternalTriggerParameter("frequency"); }
+
+    // Only the std::vector version is overridden
+    virtual std::vector<ParameterField> getTriggerParams() override {
+        return {mFrequency->get() * 2.0f, 7.0f};
+    }
+
+    virtual void onTriggerOff() override { free(); }
+
+    std::shared_ptr<Parameter> mFrequency;
+};
+
+TEST_CASE( "SynthRecorder records overridden trigger params" ) {
+    PolySynth synth;
+    synth.registerSynthClass<ScaledVoice>("ScaledVoice");
+    auto *recorded = synth.getVoice<RecordedVoice>();
+    auto *scaled = synth.getVoice<ScaledVoice>();
+    recorded->mFrequency->set(220.0f);
+    scaled->mFrequency->set(220.0f);
+
+    float fields[4];
+    REQUIRE(recorded->getTriggerParams(fields, 4) == 1);
+    REQUIRE(fields[0] == 220.0f);
+    REQUIRE(static_cast<SynthVoice *>(scaled)->getTriggerParams(fields, 4) == 2);
+    REQUIRE(fields[0] == 440.0f);
+    REQUIRE(fields[1] == 7.0f);
+
+    SynthRecorder recorder(SynthRecorder::SEQUENCER_EVENT, 16);
+    recorder.setDirectory(".");
+    recorder << synth;
+    recorder.startRecord("scaled", true);
+    synth.triggerOff(synth.triggerOn(scaled));
+    recorder.stopRecord();
+    synth.insertFreeVoice(recorded);
+
+    SynthSequencer seq(PolySynth::TIME_MASTER_AUDIO);
+    seq.synth().registerSynthClass<ScaledVoice>("ScaledVoice");
+    auto events = seq.loadSequence("scaled");
+    std::remove("scaled.synthSequence");
+    REQUIRE(events.size() == 1);
+    REQUIRE(events.front().fields.pFields.size() == 2);
+    REQUIRE(events.front().fields.pFields[0].get<float>() == 440.0f);
+    REQUIRE(events.front().fields.pFields[1].get<float>() == 7.0f);
+}
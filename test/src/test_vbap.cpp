@@ -188,3 +188,117 @@ TEST_CASE ( "VBAP 3D Allosphere")
 
 //    }
 }
+
+TEST_CASE ( "VBAP gain ramp")
+{
+    const int fpb = 19; // Not a multiple of the SIMD width
+
+    SpeakerLayout sl = OctalSpeakerLayout();
+    Vbap vbapPanner(sl);
+    vbapPanner.compile();
+
+    AudioIOData audioData;
+    audioData.framesPerBuffer(fpb);
+    audioData.framesPerSecond(44100);
+    audioData.channelsIn(0);
+    audioData.channelsOut(sl.numSpeakers());
+
+    float samples[fpb];
+    for (int i = 0; i < fpb; i++) {
+        samples[i] = 1.0f;
+    }
+
+    // Ramp between two poses in the same speaker pair
+    Pose previousPose, pose;
+    previousPose.pos(0,0,-4); // Center
+    pose.pos(1,0,-1); // 45 deg. front right
+    audioData.zeroOut();
+    vbapPanner.renderBufferRamp(audioData, previousPose, pose, samples, fpb);
+    for (int i = 0; i < fpb; i++) {
+        float t = (i + 1) / float(fpb);
+        REQUIRE(almostEqual(audioData.out(0,i), 1.0f - t, 1e-5));
+        REQUIRE(almostEqual(audioData.out(7,i), t, 1e-5));
+    }
+
+    // Crossfade when moving to a different speaker pair
+    previousPose.pos(-2,0,0); // Hard Left
+    audioData.zeroOut();
+    vbapPanner.renderBufferRamp(audioData, previousPose, pose, samples, fpb);
+    for (int i = 0; i < fpb; i++) {
+        float t = (i + 1) / float(fpb);
+        REQUIRE(almostEqual(audioData.out(2,i), 1.0f - t, 1e-5));
+        REQUIRE(almostEqual(audioData.out(7,i), t, 1e-5));
+        REQUIRE(almostEqual(audioData.out(0,i), 0.0f, 1e-5));
+    }
+
+    // No movement renders the same as renderBuffer()
+    audioData.zeroOut();
+    vbapPanner.renderBufferRamp(audioData, pose, pose, samples, fpb);
+    std::vector<float> ramped(audioData.outBuffer(7), audioData.outBuffer(7) + fpb);
+    audioData.zeroOut();
+    vbapPanner.renderBuffer(audioData, pose, samples, fpb);
+    for (int i = 0; i < fpb; i++) {
+        REQUIRE(ramped[i] == audioData.out(7,i));
+    }
+}
+
+// Reference VBAP gains per speaker from a linear search of all triplets
+static std::vector<float> bruteForceGains(Vbap &panner, const Pose &pose, bool is3D, int numChannels)
+{
+    std::vector<float> speakerGains(numChannels, 0.0f);
+    Vec3d vec = pose.quat().rotate(pose.vec());
+    vec = Vec3d(-vec.z, -vec.x, vec.y);
+    unsigned dimensions = is3D ? 3 : 2;
+    for (auto &triple: panner.triplets()) {
+        Vec3d gains(0, 0, 0);
+        for (unsigned i = 0; i < dimensions; i++) {
+            for (unsigned j = 0; j < dimensions; j++) {
+                gains[i] += vec[j] * triple.mat(j, i);
+            }
+        }
+        if (gains[0] >= 0 && gains[1] >= 0 && (!is3D || gains[2] >= 0)) {
+            gains.normalize();
+            speakerGains[triple.s1Chan] += gains[0];
+            speakerGains[triple.s2Chan] += gains[1];
+            if (is3D) {
+                speakerGains[triple.s3Chan] += gains[2];
+            }
+            break;
+        }
+    }
+    return speakerGains;
+}
+
+TEST_CASE ( "VBAP triplet lookup matches linear search")
+{
+    for (bool is3D : {false, true}) {
+        SpeakerLayout sl = is3D ? SpeakerLayout(AlloSphereSpeakerLayout()) : SpeakerLayout(OctalSpeakerLayout());
+        Vbap vbapPanner(sl, is3D);
+        vbapPanner.compile();
+
+        int numChannels = 0;
+        for (auto &speaker: sl.speakers()) {
+            numChannels = std::max(numChannels, (int) speaker.deviceChannel + 1);
+        }
+        AudioIOData audioData;
+        audioData.framesPerBuffer(1);
+        audioData.framesPerSecond(44100);
+        audioData.channelsIn(0);
+        audioData.channelsOut(numChannels);
+
+        float sample = 1.0f;
+        srand(1);
+        for (int n = 0; n < 5000; n++) {
+            Pose pose;
+            pose.pos(rand() / (double) RAND_MAX - 0.5,
+                     rand() / (double) RAND_MAX - 0.5,
+                     rand() / (double) RAND_MAX - 0.5);
+            audioData.zeroOut();
+            vbapPanner.renderBuffer(audioData, pose, &sample, 1);
+            std::vector<float> expected = bruteForceGains(vbapPanner, pose, is3D, numChannels);
+            for (int chan = 0; chan < numChannels; chan++) {
+                REQUIRE(almostEqual(audioData.out(chan, 0), expected[chan], 1e-4));
+            }
+        }
+    }
+}